@@ -0,0 +1,90 @@
+#pragma once
+// Minimal timing harness shared by the frogklan_bench translation units.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern volatile size_t g_sink;
+
+// Heap traffic seen by the counting operator new in bench_sip.cpp.
+extern std::atomic<uint64_t> g_alloc_count;
+extern std::atomic<uint64_t> g_alloc_bytes;
+
+// Timed repetitions per bench() case (--reps, default 3).
+extern int g_bench_reps;
+
+struct BenchResult {
+    std::string name;
+    size_t iters = 0;          // calls per repetition
+    int reps = 0;
+    double ns_median = 0;
+    double ns_min = 0;
+    double allocs_per_op = 0;
+    double bytes_per_op = 0;
+};
+
+// Every bench() case run so far, in order; written out by --json.
+std::vector<BenchResult>& bench_results();
+
+// Warms up with iters/10 calls, then times g_bench_reps repetitions of iters
+// calls each. Reports the median and fastest repetition in ns/op, and heap
+// allocations and bytes per op averaged over all of them.
+template <class Fn>
+inline void bench(const char* name, size_t iters, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    if (iters == 0) iters = 1;
+    const int reps = g_bench_reps > 0 ? g_bench_reps : 1;
+    std::vector<double> ns((size_t)reps);
+    for (size_t i = 0; i < iters / 10; i++) fn(); // warmup
+    const uint64_t a0 = g_alloc_count.load(std::memory_order_relaxed);
+    const uint64_t b0 = g_alloc_bytes.load(std::memory_order_relaxed);
+    for (int r = 0; r < reps; r++) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < iters; i++) fn();
+        auto t1 = Clock::now();
+        ns[(size_t)r] = std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)iters;
+    }
+    const double ops = (double)iters * reps;
+    BenchResult res;
+    res.allocs_per_op = (double)(g_alloc_count.load(std::memory_order_relaxed) - a0) / ops;
+    res.bytes_per_op = (double)(g_alloc_bytes.load(std::memory_order_relaxed) - b0) / ops;
+    std::sort(ns.begin(), ns.end());
+    res.name = name;
+    res.iters = iters;
+    res.reps = reps;
+    res.ns_median = ns[ns.size() / 2];
+    res.ns_min = ns[0];
+    std::printf("%-40s %10.1f ns/op  min %9.1f  %6.2f allocs/op %8.1f B/op\n",
+                name, res.ns_median, res.ns_min, res.allocs_per_op, res.bytes_per_op);
+    bench_results().push_back(std::move(res));
+}
+
+// bench_calls.cpp: dialog table at 200k live, then call flows against the responder.
+int run_calls_benchmarks();
+// bench_capacity.cpp: capacity search convergence, then a short search against the responder.
+int run_capacity_benchmarks();
+// bench_id.cpp: sip_id uniqueness across threads and IDs per second.
+int run_id_benchmarks();
+// bench_metrics.cpp: Prometheus exposition and a live /metrics scrape.
+int run_metrics_benchmarks();
+// bench_monitor.cpp: probe schedule spread and health hysteresis.
+int run_monitor_benchmarks();
+// bench_net.cpp: UDP round trips against an in-process echo stand-in.
+int run_net_benchmarks();
+// bench_responder.cpp: local responder exchanges, then load and storm against it.
+int run_responder_benchmarks();
+// bench_replay.cpp: pcap and pcapng parsing, then a capture replayed against the responder.
+int run_replay_benchmarks();
+// bench_resultlog.cpp: binary log round trip and report scan rate.
+int run_resultlog_benchmarks();
+// bench_scenario.cpp: scenario compilation, rendering, and flows against the responder.
+int run_scenario_benchmarks();
+// bench_tcp.cpp: stream framing, then pipelined SIP over TCP to the responder.
+int run_tcp_benchmarks();
+// bench_timer.cpp: TimerWheel and RFC 3261 timer checks on a virtual clock.
+int run_timer_benchmarks();
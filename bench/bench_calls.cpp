@@ -0,0 +1,169 @@
+// Call load: DialogTable correctness and lookup cost at 200k live dialogs,
+// then INVITE/ACK/BYE flows from run_calls against the local responder.
+#include "bench.h"
+#include "calls.h"
+#include "dialog.h"
+#include "responder.h"
+#include "sip.h"
+#include "sip_id.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+bool fail(const char* what) {
+    std::fprintf(stderr, "calls bench: %s\n", what);
+    return false;
+}
+
+struct Key {
+    std::string call_id;
+    std::string tag;
+};
+
+std::vector<Key> make_keys(size_t n) {
+    std::vector<Key> keys(n);
+    for (auto& k : keys) {
+        k.call_id = sip_new_call_id();
+        k.tag = sip_new_tag();
+    }
+    return keys;
+}
+
+bool check_table() {
+    if (sizeof(Dialog) >= 1024) return fail("Dialog is 1 KB or more");
+
+    const size_t n = 50000;
+    auto keys = make_keys(n);
+    DialogTable t(n);
+    if (t.bytes() / t.capacity() >= 1024) return fail("table memory per dialog is 1 KB or more");
+    for (auto& k : keys) {
+        if (!t.insert(k.call_id, k.tag)) return fail("insert failed below capacity");
+    }
+    if (t.insert("one-more@frogklan", "x") || t.insert(keys[0].call_id, keys[0].tag)) {
+        return fail("insert past capacity or of a live key succeeded");
+    }
+
+    // Erase every other key, then make sure probe runs survived the shifts.
+    const uint64_t a0 = g_alloc_count.load();
+    for (size_t i = 0; i < n; i += 2) t.erase(t.find(keys[i].call_id, keys[i].tag));
+    for (size_t i = 0; i < n; i++) {
+        Dialog* d = t.find(keys[i].call_id, keys[i].tag);
+        if ((i % 2 == 0) != (d == nullptr)) return fail("lookup after erase disagrees");
+        if (d && (d->call_id_view() != keys[i].call_id || d->local_tag_view() != keys[i].tag)) {
+            return fail("lookup returned the wrong dialog");
+        }
+    }
+    if (t.find(keys[1].call_id, "other-tag")) return fail("a different tag matched");
+    if (g_alloc_count.load() != a0) return fail("lookups or erases allocated");
+    if (t.size() != n / 2) return fail("size is off after erases");
+    for (size_t i = 0; i < n; i += 2) {
+        if (!t.insert(keys[i].call_id, keys[i].tag)) return fail("re-insert into freed slots failed");
+    }
+
+    if (sip_header_tag("<sip:a@b;tag=uri>;tag=abc;x=1") != "abc" || sip_header_tag("sip:a@b ; TAG=q") != "q" ||
+        !sip_header_tag("<sip:a@b;tag=uri>").empty()) {
+        return fail("sip_header_tag picked the wrong parameter");
+    }
+    return true;
+}
+
+// With a tenth of requests dropped, every call must still be answered and
+// ended, by retransmitting its INVITE and BYE.
+bool check_lossy() {
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 1;
+    rc.drop = 0.1;
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) return fail(err.c_str());
+    CallConfig cc;
+    cc.host = "127.0.0.1";
+    cc.port = r.port();
+    cc.from_uri = "sip:qa@example.com";
+    cc.to_uri = "sip:echo@example.com";
+    cc.user_agent = "bench";
+    cc.rate = 2000;
+    cc.duration_s = 0.5;
+    cc.hold_ms = 50;
+    cc.timeout_ms = 2000;
+    cc.timers.t1_ms = 20;
+    CallResult cr = run_calls(cc);
+    ResponderStats rs = r.stats();
+    r.stop();
+    if (!cr.ok || cr.answered != cr.attempted || cr.completed != cr.attempted || cr.retransmits == 0 ||
+        rs.dropped == 0) {
+        std::fprintf(stderr, "calls bench: lossy %llu/%llu answered, %llu completed, %llu retransmits, "
+                     "%llu dropped (%s)\n", (unsigned long long)cr.answered, (unsigned long long)cr.attempted,
+                     (unsigned long long)cr.completed, (unsigned long long)cr.retransmits,
+                     (unsigned long long)rs.dropped, cr.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_calls_benchmarks() {
+    if (!check_table()) return 1;
+
+    const size_t live = 200000;
+    auto keys = make_keys(live);
+    DialogTable t(live);
+    for (auto& k : keys) t.insert(k.call_id, k.tag);
+    std::printf("%-40s %10zu B/dialog (sizeof Dialog %zu)\n", "DialogTable memory, 200k", t.bytes() / t.capacity(),
+                sizeof(Dialog));
+    size_t i = 0;
+    bench("DialogTable::find (200k live)", 1000000, [&]{
+        const Key& k = keys[i++ % live];
+        g_sink = (size_t)t.find(k.call_id, k.tag);
+    });
+    bench("DialogTable erase+insert (200k live)", 1000000, [&]{
+        const Key& k = keys[i++ % live];
+        t.erase(t.find(k.call_id, k.tag));
+        g_sink = (size_t)t.insert(k.call_id, k.tag);
+    });
+
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 2;
+    rc.ring_ms = 5;
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) {
+        std::fprintf(stderr, "calls bench: %s\n", err.c_str());
+        return 1;
+    }
+    CallConfig cc;
+    cc.host = "127.0.0.1";
+    cc.port = r.port();
+    cc.from_uri = "sip:qa@example.com";
+    cc.to_uri = "sip:echo@example.com";
+    cc.user_agent = "bench";
+    cc.rate = 5000;
+    cc.duration_s = 1.0;
+    cc.hold_ms = 200;
+    cc.timeout_ms = 2000;
+    CallResult cr = run_calls(cc);
+    ResponderStats rs = r.stats();
+    r.stop();
+    if (!cr.ok || cr.answered != cr.attempted || cr.completed != cr.attempted || cr.stray != 0 ||
+        rs.invites != cr.attempted || rs.byes != cr.attempted) {
+        std::fprintf(stderr, "calls bench: %llu/%llu answered, %llu completed, %llu stray (%s)\n",
+                     (unsigned long long)cr.answered, (unsigned long long)cr.attempted,
+                     (unsigned long long)cr.completed, (unsigned long long)cr.stray, cr.error.c_str());
+        return 1;
+    }
+    // The responder rings at once and answers --ring ms later.
+    if (cr.answer.percentile(50) < 5000 || cr.pdd.percentile(50) >= cr.answer.percentile(50)) {
+        std::fprintf(stderr, "calls bench: post-dial delay and answer latency do not reflect --ring\n");
+        return 1;
+    }
+    std::printf("%-40s %10.0f calls/s (peak %llu dialogs; pdd p50 %llu us, answer p50 %llu us, bye p50 %llu us)\n",
+                "calls INVITE/ACK/BYE -> responder", (double)cr.completed / cr.elapsed_s,
+                (unsigned long long)cr.peak_dialogs, (unsigned long long)cr.pdd.percentile(50),
+                (unsigned long long)cr.answer.percentile(50), (unsigned long long)cr.bye.percentile(50));
+    return check_lossy() ? 0 : 1;
+}
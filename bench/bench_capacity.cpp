@@ -0,0 +1,111 @@
+// Capacity search: binary and AIMD convergence against a synthetic knee, then
+// short OPTIONS and REGISTER searches against the responder, and one where
+// injected 503s fail the first step.
+#include "bench.h"
+#include "capacity.h"
+#include "responder.h"
+
+#include <string>
+
+namespace {
+
+// Runs the search against a target that passes every rate up to `knee`.
+bool converge(CapacityConfig cfg, double knee, const char* name) {
+    CapacitySearch s(cfg);
+    int steps = 0;
+    for (double rate; (rate = s.next()) > 0; steps++) s.record(rate, rate <= knee);
+    bool ok;
+    if (knee < cfg.min_rate) ok = s.knee() == 0;
+    else if (knee >= cfg.max_rate) ok = s.knee() == cfg.max_rate && s.first_fail() == 0;
+    else ok = s.knee() <= knee && s.first_fail() > knee && s.first_fail() - s.knee() <= cfg.resolution * s.knee();
+    if (!ok || steps > cfg.max_steps) {
+        std::fprintf(stderr, "capacity bench: %s found %.0f..%.0f in %d steps for a knee at %.0f\n", name, s.knee(),
+                     s.first_fail(), steps, knee);
+        return false;
+    }
+    std::printf("%-40s %10d steps (knee %.0f of %.0f)\n", name, steps, s.knee(), knee);
+    return true;
+}
+
+} // namespace
+
+int run_capacity_benchmarks() {
+    CapacityConfig cfg;
+    cfg.min_rate = 100;
+    cfg.max_rate = 100000;
+    if (!converge(cfg, 12345, "capacity search binary")) return 1;
+    if (!converge(cfg, 50, "capacity search binary, min fails")) return 1;
+    if (!converge(cfg, 1e9, "capacity search binary, max passes")) return 1;
+    cfg.strategy = CapacityStrategy::Aimd;
+    cfg.aimd_increase = 2000;
+    if (!converge(cfg, 12345, "capacity search aimd")) return 1;
+    if (!converge(cfg, 50, "capacity search aimd, min fails")) return 1;
+
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 2;
+    rc.users["qa"] = "secret";
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) {
+        std::fprintf(stderr, "capacity bench: %s\n", err.c_str());
+        return 1;
+    }
+
+    CapacityConfig live;
+    live.min_rate = 1000;
+    live.max_rate = 4000;
+    live.step_s = 0.3;
+    live.cooldown_ms = 50;
+    live.load.host = "127.0.0.1";
+    live.load.port = r.port();
+    live.load.from_uri = "sip:qa@127.0.0.1";
+    live.load.to_uri = "sip:qa@127.0.0.1";
+    live.storm.host = "127.0.0.1";
+    live.storm.port = r.port();
+    live.storm.workers = 2;
+    live.storm.timers.timeout_ms = 2000;
+    live.creds.push_back({"sip:qa@127.0.0.1", "sip:qa@127.0.0.1:5090", "qa", "secret"});
+
+    // 1000, 2000 and 4000/s all well within the default SLO on loopback.
+    CapacityResult cr = run_capacity(live);
+    if (!cr.ok || cr.knee != live.max_rate || cr.steps.size() != 3 || cr.steps[2].ok != cr.steps[2].sent) {
+        std::fprintf(stderr, "capacity bench: OPTIONS knee %.0f after %zu steps (%s)\n", cr.knee, cr.steps.size(),
+                     cr.error.c_str());
+        r.stop();
+        return 1;
+    }
+    std::printf("%-40s %10.0f /s knee (p99 %llu us at the top)\n", "capacity OPTIONS -> responder", cr.knee,
+                (unsigned long long)cr.steps.back().latency.percentile(99));
+
+    live.method = CapacityMethod::Register;
+    live.max_rate = 2000;
+    cr = run_capacity(live);
+    r.stop();
+    if (!cr.ok || cr.knee != live.max_rate || cr.steps.size() != 2 || cr.steps[1].ok != cr.steps[1].sent) {
+        std::fprintf(stderr, "capacity bench: REGISTER knee %.0f after %zu steps (%s)\n", cr.knee, cr.steps.size(),
+                     cr.error.c_str());
+        return 1;
+    }
+    std::printf("%-40s %10.0f /s knee (p99 %llu us at the top)\n", "capacity REGISTER -> responder", cr.knee,
+                (unsigned long long)cr.steps.back().latency.percentile(99));
+
+    // A target shedding a fifth of its load fails on 503s at the first step.
+    rc.fail_503 = 0.2;
+    SipResponder busy;
+    if (!busy.start(rc, &err)) {
+        std::fprintf(stderr, "capacity bench: %s\n", err.c_str());
+        return 1;
+    }
+    live.method = CapacityMethod::Options;
+    live.load.port = busy.port();
+    cr = run_capacity(live);
+    busy.stop();
+    if (!cr.ok || cr.knee != 0 || cr.steps.size() != 1 || cr.steps[0].why != "503") {
+        std::fprintf(stderr, "capacity bench: 503s gave knee %.0f after %zu steps, failed on \"%s\"\n", cr.knee,
+                     cr.steps.size(), cr.steps.empty() ? "" : cr.steps[0].why.c_str());
+        return 1;
+    }
+    g_sink = (size_t)cr.steps[0].unavailable;
+    return 0;
+}
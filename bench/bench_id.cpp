@@ -0,0 +1,101 @@
+// sip_id: uniqueness across threads first, then per-ID cost on one core and
+// aggregate throughput with every core generating at once.
+#include "bench.h"
+#include "sip_id.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Several threads each draw branches and tags; no value may repeat anywhere,
+// and every branch must carry the RFC 3261 magic cookie.
+bool check_unique() {
+    const int nthreads = 8;
+    const size_t per = 100000;
+    std::vector<std::vector<std::string>> branches(nthreads), tags(nthreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.emplace_back([&, t] {
+            char b[kSipBranchLen], g[kSipTagHex];
+            branches[t].reserve(per);
+            tags[t].reserve(per);
+            for (size_t i = 0; i < per; i++) {
+                sip_id_branch(b);
+                sip_id_tag(g);
+                branches[t].emplace_back(b, sizeof(b));
+                tags[t].emplace_back(g, sizeof(g));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (auto* set : {&branches, &tags}) {
+        std::vector<std::string> all;
+        for (auto& v : *set) all.insert(all.end(), v.begin(), v.end());
+        std::sort(all.begin(), all.end());
+        if (std::adjacent_find(all.begin(), all.end()) != all.end()) {
+            std::fprintf(stderr, "sip_id: duplicate %s across threads\n", set == &tags ? "tag" : "branch");
+            return false;
+        }
+    }
+    for (auto& v : branches) {
+        for (auto& b : v) {
+            if (b.compare(0, 7, "z9hG4bK") != 0 ||
+                b.find_first_not_of("0123456789abcdef", 7) != std::string::npos) {
+                std::fprintf(stderr, "sip_id: malformed branch %s\n", b.c_str());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int run_id_benchmarks() {
+    if (!check_unique()) return 1;
+
+    const size_t iters = 20000000;
+    char buf[kSipBranchLen];
+    bench("sip_id_branch", iters, [&]{
+        sip_id_branch(buf);
+        g_sink = (size_t)buf[kSipBranchLen - 1];
+    });
+    bench("sip_id_tag", iters, [&]{
+        sip_id_tag(buf);
+        g_sink = (size_t)buf[kSipTagHex - 1];
+    });
+    bench("sip_id_random (16 hex)", iters, [&]{
+        sip_id_random(buf, 16);
+        g_sink = (size_t)buf[15];
+    });
+    bench("sip_new_call_id (std::string)", iters / 10, [&]{
+        g_sink = sip_new_call_id().size();
+    });
+
+    // Every core at once: no shared state is touched after each thread's
+    // first ID, so this should scale with the core count.
+    unsigned nthreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t per = 5000000;
+    std::vector<std::thread> threads;
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < nthreads; t++) {
+        threads.emplace_back([per] {
+            char b[kSipBranchLen];
+            size_t x = 0;
+            for (size_t i = 0; i < per; i++) { sip_id_branch(b); x += (size_t)b[kSipBranchLen - 1]; }
+            g_sink = x;
+        });
+    }
+    for (auto& th : threads) th.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double total = (double)per * nthreads;
+    std::printf("%-40s %10.1f M/s (%u threads, %.1f M/s per thread)\n", "sip_id_branch aggregate",
+                total / s / 1e6, nthreads, total / s / 1e6 / nthreads);
+    return 0;
+}
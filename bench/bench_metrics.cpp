@@ -0,0 +1,124 @@
+// Prometheus metrics: exposition checks, a live scrape over loopback while
+// another thread keeps recording, then the cost of one hot-path update.
+#include "bench.h"
+#include "metrics.h"
+#include "net.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool contains(const std::string& text, const char* want) {
+    if (text.find(want) != std::string::npos) return true;
+    std::fprintf(stderr, "metrics: missing line: %s\n", want);
+    return false;
+}
+
+bool check_render() {
+    MetricsRegistry reg({"sip.example.com:5060", "a\"b:5070"});
+    auto& m = reg.at(0);
+    m.record_rtt_us(400);        // 0.0005 bucket
+    m.record_rtt_us(1000);       // 0.001, bound inclusive
+    m.record_rtt_us(30000000);   // +Inf
+    for (int c = 200; c < 210; c++) m.record_status(c);  // two more codes than slots
+    m.record_status(200);
+    m.add_sent(3);
+    m.add_timeout();
+    m.add_dns_error();
+    m.set_health(1);
+
+    std::string out;
+    reg.render(out);
+    return contains(out, "# TYPE frogklan_rtt_seconds histogram\n") &&
+           contains(out, "frogklan_rtt_seconds_bucket{target=\"sip.example.com:5060\",le=\"0.0005\"} 1\n") &&
+           contains(out, "frogklan_rtt_seconds_bucket{target=\"sip.example.com:5060\",le=\"0.001\"} 2\n") &&
+           contains(out, "frogklan_rtt_seconds_bucket{target=\"sip.example.com:5060\",le=\"10\"} 2\n") &&
+           contains(out, "frogklan_rtt_seconds_bucket{target=\"sip.example.com:5060\",le=\"+Inf\"} 3\n") &&
+           contains(out, "frogklan_rtt_seconds_sum{target=\"sip.example.com:5060\"} 30.001400\n") &&
+           contains(out, "frogklan_rtt_seconds_count{target=\"sip.example.com:5060\"} 3\n") &&
+           contains(out, "frogklan_responses_total{target=\"sip.example.com:5060\",code=\"200\"} 2\n") &&
+           contains(out, "frogklan_responses_total{target=\"sip.example.com:5060\",code=\"other\"} 2\n") &&
+           contains(out, "frogklan_requests_total{target=\"sip.example.com:5060\"} 3\n") &&
+           contains(out, "frogklan_timeouts_total{target=\"sip.example.com:5060\"} 1\n") &&
+           contains(out, "frogklan_transport_errors_total{target=\"sip.example.com:5060\",kind=\"dns\"} 1\n") &&
+           contains(out, "frogklan_target_health{target=\"sip.example.com:5060\"} 1\n") &&
+           contains(out, "frogklan_timeouts_total{target=\"a\\\"b:5070\"} 0\n");
+}
+
+std::string http_get(uint16_t port, const char* path) {
+    int fd = tcp_connect("127.0.0.1", port);
+    if (fd < 0) return "";
+    std::string req = std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string resp;
+    if (tcp_send_all(fd, req.data(), req.size())) {
+        char buf[65536];
+        int n;
+        while ((n = tcp_recv(fd, buf, sizeof(buf), 2000)) > 0) resp.append(buf, (size_t)n);
+    }
+    tcp_close(fd);
+    return resp;
+}
+
+// Scrapes repeatedly while a writer records flat out: every scrape answers,
+// and the writer is never held up by one.
+bool check_server() {
+    MetricsRegistry reg({"10.0.0.5:5060"});
+    MetricsServer server(reg);
+    std::string err;
+    if (!server.start(0, &err)) { std::fprintf(stderr, "metrics: %s\n", err.c_str()); return false; }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> writes{0};
+    std::thread writer([&] {
+        auto& m = reg.at(0);
+        uint64_t i = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            m.record_rtt_us(i % 20000);
+            m.record_status(200);
+            i++;
+        }
+        writes = i;
+    });
+    bool ok = true;
+    for (int k = 0; k < 20 && ok; k++) {
+        std::string r = http_get(server.port(), "/metrics");
+        ok = r.compare(0, 15, "HTTP/1.1 200 OK") == 0 &&
+             r.find("frogklan_responses_total{target=\"10.0.0.5:5060\",code=\"200\"}") != std::string::npos;
+    }
+    if (ok) ok = http_get(server.port(), "/nope").compare(0, 12, "HTTP/1.1 404") == 0;
+    stop = true;
+    writer.join();
+    server.stop();
+    if (!ok || writes == 0) { std::fprintf(stderr, "metrics: HTTP scrape failed\n"); return false; }
+    return true;
+}
+
+} // namespace
+
+int run_metrics_benchmarks() {
+    if (!check_render() || !check_server()) return 1;
+
+    MetricsRegistry reg({"10.0.0.5:5060"});
+    auto& m = reg.at(0);
+    uint64_t k = 0;
+    bench("TargetMetrics rtt+status", 10000000, [&]{
+        m.record_rtt_us(k++ & 0xffff);
+        m.record_status(200);
+    });
+
+    std::vector<std::string> labels;
+    for (int i = 0; i < 10000; i++) labels.push_back("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ":5060");
+    MetricsRegistry big(labels);
+    for (size_t i = 0; i < big.size(); i++) { big.at(i).record_rtt_us(i); big.at(i).record_status(200); }
+    std::string out;
+    bench("MetricsRegistry::render (10k targets)", 20, [&]{
+        big.render(out);
+        g_sink = out.size();
+    });
+    std::printf("  (%zu bytes per scrape)\n", out.size());
+    return 0;
+}
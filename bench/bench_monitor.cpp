@@ -0,0 +1,158 @@
+// Monitor scheduling and health hysteresis: correctness checks on a virtual
+// clock, then the cost of folding one probe outcome into the health table.
+// Also the per-target RTT sketch: percentiles against exact ones, merging,
+// and its cost over a 50k-target table.
+#include "bench.h"
+#include "monitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+// 10k targets over 30 s with 10% jitter: no 100 ms window may see more than
+// twice its fair share, and a target's probes stay one interval apart give
+// or take the jitter, however late each one finished.
+bool check_schedule() {
+    const size_t n = 10000;
+    const uint32_t interval = 30000;
+    MonitorSchedule s(n, interval, 0.1);
+
+    std::vector<uint32_t> buckets(interval / 100 * 4, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t at = s.first(i);
+        for (int round = 0; round < 3; round++) {
+            buckets[at / 100]++;
+            // Finish somewhere inside the 32 s transaction window.
+            uint64_t done = at + (i * 7919) % 32000;
+            uint64_t nx = s.next(i, done);
+            if (nx <= done || nx - at < interval - interval / 10 || nx > done + interval + interval / 10) {
+                std::fprintf(stderr, "MonitorSchedule: target %zu scheduled %llu after %llu (done %llu)\n", i,
+                             (unsigned long long)nx, (unsigned long long)at, (unsigned long long)done);
+                return false;
+            }
+            at = nx;
+            if (at / 100 >= buckets.size()) break;
+        }
+    }
+    const uint32_t fair = (uint32_t)(n / (interval / 100));
+    // The first interval and the steady state behind it; the tail is partial.
+    uint32_t worst = *std::max_element(buckets.begin() + 1, buckets.begin() + interval / 100 * 2);
+    if (worst > fair * 2) {
+        std::fprintf(stderr, "MonitorSchedule: burst of %u probes in 100 ms (fair share %u)\n", worst, fair);
+        return false;
+    }
+    return true;
+}
+
+bool check_hysteresis() {
+    HealthPolicy p;   // rise 2, fall 3
+    TargetHealthRow r;
+    const TargetHealth U = TargetHealth::Up, D = TargetHealth::Down, G = TargetHealth::Degraded;
+    struct Step { TargetHealth seen; TargetHealth want; };
+    const Step steps[] = {
+        {U, U},                         // first answer decides at once
+        {D, U}, {D, U}, {U, U},         // two losses, then a reply: streak resets
+        {D, U}, {D, U}, {D, D},         // third loss in a row: down
+        {U, D}, {G, D}, {U, D}, {U, U}, // mixed answers do not count together
+        {G, U}, {G, G},
+    };
+    uint32_t t = 0;
+    for (const auto& s : steps) {
+        r.observe(s.seen, p, t++);
+        if (r.health != s.want) {
+            std::fprintf(stderr, "TargetHealthRow: step %u is %s, want %s\n", t - 1,
+                         target_health_name(r.health), target_health_name(s.want));
+            return false;
+        }
+    }
+    if (r.probes != t || r.failures != 5 || r.changed_s != t - 1) {
+        std::fprintf(stderr, "TargetHealthRow: counters wrong\n");
+        return false;
+    }
+    return true;
+}
+
+// Log-normal RTTs around 20 ms with a tail past 1 s: every reported
+// percentile must sit within 2% of the exact one, and a sketch merged from
+// four shards (one folding far outliers) must agree with the whole.
+bool check_sketch() {
+    std::mt19937_64 rng(7);
+    std::lognormal_distribution<double> rtt(std::log(20000.0), 0.8);
+    std::vector<uint64_t> v(200000);
+    for (auto& x : v) x = (uint64_t)rtt(rng) + 1;
+    TargetStats whole, parts[4];
+    for (size_t i = 0; i < v.size(); i++) {
+        whole.record_reply(i % 50 ? 200 : 503, v[i]);
+        parts[i % 4].record_reply(i % 50 ? 200 : 503, v[i]);
+    }
+    TargetStats merged;
+    for (auto& p : parts) merged.merge(p);
+    std::sort(v.begin(), v.end());
+    for (double p : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+        uint64_t exact = v[(size_t)(p / 100.0 * v.size() + 0.5) - 1];
+        for (const TargetStats* s : {&whole, &merged}) {
+            uint64_t got = s->rtt().percentile(p);
+            if (std::fabs((double)got - (double)exact) > 0.02 * (double)exact) {
+                std::fprintf(stderr, "monitor bench: sketch p%.1f = %llu, exact %llu\n", p,
+                             (unsigned long long)got, (unsigned long long)exact);
+                return false;
+            }
+        }
+    }
+    if (merged.replies() != v.size() || merged.status_count(503) != whole.status_count(503) ||
+        merged.rtt().min() != v.front() || merged.rtt().max() != v.back()) {
+        std::fprintf(stderr, "monitor bench: merged sketch totals differ\n");
+        return false;
+    }
+    // 1 us to 30 s is past the sketch's range: the low end folds, p99 holds.
+    TargetStats wide = whole;
+    wide.record_reply(200, 1);
+    wide.record_reply(200, 30000000);
+    uint64_t p99 = wide.rtt().percentile(99);
+    if (!wide.rtt().collapsed() || std::fabs((double)p99 - (double)v[v.size() * 99 / 100]) > 0.02 * (double)p99) {
+        std::fprintf(stderr, "monitor bench: wide sketch p99 %llu\n", (unsigned long long)p99);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_monitor_benchmarks() {
+    if (!check_schedule() || !check_hysteresis() || !check_sketch()) return 1;
+    std::printf("TargetHealthRow: %zu bytes\n", sizeof(TargetHealthRow));
+
+    std::vector<TargetHealthRow> table(10000);
+    HealthPolicy p;
+    size_t k = 0;
+    bench("TargetHealthRow::observe (10k table)", 10000000, [&]{
+        auto& r = table[k % table.size()];
+        TargetHealth seen = (k & 0x70) ? TargetHealth::Up : TargetHealth::Down;
+        g_sink = r.observe(seen, p, (uint32_t)(k >> 10));
+        k += 7;
+    });
+
+    std::vector<TargetStats> stats(50000);
+    std::printf("TargetStats: %zu bytes, %.1f MB for %zu targets\n", sizeof(TargetStats),
+                (double)(sizeof(TargetStats) * stats.size()) / (1 << 20), stats.size());
+    std::mt19937_64 rng(11);
+    std::vector<uint64_t> rtts(4096);
+    std::lognormal_distribution<double> rtt(std::log(20000.0), 0.8);
+    for (auto& x : rtts) x = (uint64_t)rtt(rng);
+    k = 0;
+    bench("TargetStats::record_reply (50k table)", 10000000, [&]{
+        stats[k % stats.size()].record_reply(200, rtts[k & 4095]);
+        k += 7;
+    });
+    TargetStats all;
+    bench("TargetStats::merge (50k table)", 10, [&]{
+        all = TargetStats();
+        for (auto& s : stats) all.merge(s);
+        g_sink = all.rtt().percentile(99);
+    });
+    return 0;
+}
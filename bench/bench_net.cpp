@@ -0,0 +1,205 @@
+// UDP transport throughput: plain sendto/recvfrom versus UdpBatch
+// (sendmmsg/recvmmsg on Linux) and UdpBatch on io_uring where the kernel has
+// it, each against the same in-process echo stand-in bound to loopback.
+// Reported as echoed datagrams per second.
+// Also compares loopback RTT timed in userspace against kernel socket
+// timestamps, and checks that stamps land where they should.
+#include "bench.h"
+#include "net.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct EchoServer {
+    UdpSocket sock;
+    std::atomic<bool> stop{false};
+    std::thread th;
+
+    bool start() {
+        if (!sock.open(8 << 20) || !sock.bind("127.0.0.1", 0)) return false;
+        th = std::thread([this]{
+            UdpPoller poller;
+            poller.add(sock);
+            UdpBatch io;
+            std::vector<int> ready;
+            std::vector<UdpDatagram> out(io.max_batch());
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (poller.wait(10, ready) <= 0) continue;
+                int n;
+                while ((n = io.recv(sock)) > 0) {
+                    for (int i = 0; i < n; i++) out[i] = io.at(i);
+                    int off = 0;
+                    while (off < n) {
+                        int r = io.send(sock, out.data() + off, (size_t)(n - off));
+                        if (r < 0) break;
+                        off += r;
+                    }
+                }
+            }
+        });
+        return true;
+    }
+
+    ~EchoServer() {
+        stop = true;
+        if (th.joinable()) th.join();
+    }
+};
+
+// Sends `total` datagrams in windows of `window`, waiting for each window's
+// echoes (or a short timeout) before the next. Returns echoes per second.
+// `io`, if given, is handed to the poller (see UdpPoller::use).
+template <class SendWindow, class RecvSome>
+double run_rounds(size_t total, size_t window, UdpSocket& sock, UdpBatch* io, SendWindow&& send_window,
+                  RecvSome&& recv_some) {
+    UdpPoller poller;
+    poller.add(sock);
+    if (io) poller.use(*io);
+    std::vector<int> ready;
+    size_t echoed = 0;
+    auto t0 = Clock::now();
+    for (size_t sent = 0; sent < total; sent += window) {
+        send_window(window);
+        size_t got = 0;
+        auto deadline = Clock::now() + std::chrono::milliseconds(50);
+        while (got < window && Clock::now() < deadline) {
+            if (poller.wait(5, ready) <= 0) continue;
+            got += recv_some();
+        }
+        echoed += got;
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    return (double)echoed / secs;
+}
+
+// Median elapsed_ns over n UdpClient round trips; -1 if any went unanswered.
+int64_t median_rtt_ns(UdpClient& c, const UdpAddr& dst, const std::string& payload, int n, bool* all_kernel) {
+    std::vector<int64_t> v;
+    *all_kernel = true;
+    for (int i = 0; i < n; i++) {
+        auto before = Clock::now();
+        UdpReply r = c.request(dst, payload, 1000);
+        auto after = Clock::now();
+        if (!r.ok || r.elapsed_ns <= 0 ||
+            r.elapsed_ns > std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()) return -1;
+        if (!r.kernel_ts) *all_kernel = false;
+        v.push_back(r.elapsed_ns);
+    }
+    std::nth_element(v.begin(), v.begin() + n / 2, v.end());
+    return v[n / 2];
+}
+
+} // namespace
+
+int run_net_benchmarks() {
+    EchoServer echo;
+    if (!echo.start()) {
+        std::fprintf(stderr, "net bench: cannot bind echo socket\n");
+        return 1;
+    }
+    UdpAddr dst;
+    resolve_udp_addr("127.0.0.1", echo.sock.local_port(), &dst);
+
+    const size_t total = 200000, window = 64;
+    const std::string payload(320, 'x'); // about one OPTIONS
+
+    UdpSocket plain;
+    plain.open(8 << 20);
+    std::vector<char> buf(65536);
+    double plain_rate = run_rounds(total, window, plain, nullptr,
+        [&](size_t n){ for (size_t i = 0; i < n; i++) plain.send_to(dst, payload.data(), payload.size()); },
+        [&]{
+            size_t got = 0;
+            UdpAddr src;
+            while (plain.recv_from(buf.data(), buf.size(), &src) > 0) got++;
+            return got;
+        });
+
+    std::vector<UdpDatagram> out(window, UdpDatagram{dst, payload.data(), payload.size()});
+    // Echo rate through one UdpBatch, then the receive stamps it hands out,
+    // which must fall between the send and the moment recv() returned.
+    auto run_batch = [&](UdpBatch& io, double* rate) {
+        UdpSocket batched;
+        batched.open(8 << 20);
+        *rate = run_rounds(total, window, batched, &io,
+            [&](size_t n){
+                size_t off = 0;
+                while (off < n) {
+                    int r = io.send(batched, out.data() + off, n - off);
+                    if (r <= 0) break;
+                    off += (size_t)r;
+                }
+            },
+            [&]{
+                size_t got = 0;
+                int n;
+                while ((n = io.recv(batched)) > 0) {
+                    for (int i = 0; i < n; i++) got += io.at(i).len == payload.size();
+                }
+                return got;
+            });
+
+        UdpSocket stamped;
+        stamped.open(8 << 20);
+        if (!stamped.enable_rx_timestamps()) return true;
+        auto before = Clock::now();
+        io.send(stamped, out.data(), window);
+        size_t got = 0;
+        auto deadline = before + std::chrono::milliseconds(500);
+        while (got < window && Clock::now() < deadline) {
+            int n = io.recv(stamped);
+            auto after = Clock::now();
+            for (int i = 0; i < n; i++, got++) {
+                auto t = udp_rx_time(io.at(i), Clock::time_point::min());
+                if (t < before || t > after) {
+                    std::fprintf(stderr, "net bench: receive stamp outside send..recv window\n");
+                    return false;
+                }
+            }
+        }
+        if (got == 0) {
+            std::fprintf(stderr, "net bench: no stamped echoes\n");
+            return false;
+        }
+        return true;
+    };
+
+    double batch_rate = 0, uring_rate = 0;
+    UdpBatch io;
+    if (!run_batch(io, &batch_rate)) return 1;
+    UdpBatch ring;
+    bool have_uring = ring.use_uring();
+    if (have_uring && !run_batch(ring, &uring_rate)) return 1;
+
+    std::printf("%-40s %10.0f dgram/s\n", "udp echo sendto/recvfrom", plain_rate);
+    std::printf("%-40s %10.0f dgram/s\n", "udp echo UdpBatch (mmsg)", batch_rate);
+    if (have_uring) {
+        std::printf("%-40s %10.0f dgram/s\n", "udp echo UdpBatch (io_uring)", uring_rate);
+    } else {
+        std::printf("%-40s %10s\n", "udp echo UdpBatch (io_uring)", "unsupported");
+    }
+
+    const int rtts = 2000;
+    UdpClient user_client, kernel_client;
+    bool user_kernel = false, kernel_kernel = false;
+    int64_t user_ns = median_rtt_ns(user_client, dst, payload, rtts, &user_kernel);
+    bool have_kts = kernel_client.enable_kernel_timestamps();
+    int64_t kernel_ns = median_rtt_ns(kernel_client, dst, payload, rtts, &kernel_kernel);
+    if (user_ns < 0 || kernel_ns < 0 || user_kernel || (have_kts && !kernel_kernel)) {
+        std::fprintf(stderr, "net bench: loopback RTT check failed\n");
+        return 1;
+    }
+    std::printf("%-40s %10.1f us p50\n", "udp rtt, userspace clock", user_ns / 1e3);
+    std::printf("%-40s %10.1f us p50%s\n", "udp rtt, kernel timestamps", kernel_ns / 1e3,
+                have_kts ? "" : " (unsupported, userspace)");
+    g_sink = (size_t)(plain_rate + batch_rate + uring_rate) + (size_t)(user_ns + kernel_ns);
+    return 0;
+}
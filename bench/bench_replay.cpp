@@ -0,0 +1,310 @@
+// Capture replay: a synthetic incident written as classic pcap (Ethernet,
+// IPv4) and as pcapng (802.1Q, IPv6, nanosecond stamps) must parse to the
+// same datagrams, fold the capture's retransmissions, match its responses,
+// and replay against the responder with every request answered. INVITEs
+// that ring past Timer B must still be answered, not timed out. Then the
+// scan rate of PcapReader over a larger capture.
+#include "bench.h"
+#include "pcap.h"
+#include "replay.h"
+#include "responder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint64_t kT0 = 1700000000ull * 1000000000;   // ns
+const uint8_t kClient[4] = {10, 1, 1, 1};
+const uint8_t kServer[4] = {10, 2, 2, 2};
+
+struct Frame {
+    uint64_t ts_ns;
+    std::string bytes;
+};
+
+void put16(std::string& o, uint16_t v) { o += (char)(v >> 8); o += (char)v; }
+void le16(std::string& o, uint16_t v) { o += (char)v; o += (char)(v >> 8); }
+void le32(std::string& o, uint32_t v) { le16(o, (uint16_t)v); le16(o, (uint16_t)(v >> 16)); }
+
+// Ethernet frame carrying one UDP datagram (proto 17) or a stub of another
+// protocol, over IPv4 or, with a VLAN tag, over IPv6 (addresses mapped from
+// the IPv4 ones).
+std::string frame(const uint8_t* src, const uint8_t* dst, uint16_t sport, uint16_t dport, const std::string& payload,
+                  bool v6, uint8_t proto = 17) {
+    std::string o(12, '\x02');
+    std::string udp;
+    put16(udp, sport);
+    put16(udp, dport);
+    put16(udp, (uint16_t)(8 + payload.size()));
+    put16(udp, 0);
+    udp += payload;
+    if (!v6) {
+        put16(o, 0x0800);
+        o += '\x45';
+        o += '\0';
+        put16(o, (uint16_t)(20 + udp.size()));
+        put16(o, 0);
+        put16(o, 0);
+        o += '\x40';
+        o += (char)proto;
+        put16(o, 0);
+        o.append((const char*)src, 4);
+        o.append((const char*)dst, 4);
+    } else {
+        put16(o, 0x8100);
+        put16(o, 42);
+        put16(o, 0x86dd);
+        o += '\x60';
+        o.append(3, '\0');
+        put16(o, (uint16_t)udp.size());
+        o += (char)proto;
+        o += '\x40';
+        for (const uint8_t* a : {src, dst}) {
+            o.append(10, '\0');
+            o.append(2, '\xff');
+            o.append((const char*)a, 4);
+        }
+    }
+    return o + udp;
+}
+
+std::string request(size_t i, const std::string& method = "OPTIONS") {
+    return method + " sip:probe@10.2.2.2:5060 SIP/2.0\r\n"
+           "Via: SIP/2.0/UDP 10.1.1.1:5060;branch=z9hG4bKcap" + std::to_string(i) + "\r\n"
+           "Max-Forwards: 70\r\n"
+           "From: <sip:qa@10.1.1.1>;tag=t" + std::to_string(i) + "\r\n"
+           "To: <sip:probe@10.2.2.2>\r\n"
+           "Call-ID: c" + std::to_string(i) + "@cap\r\n"
+           "CSeq: 1 " + method + "\r\n"
+           "Content-Length: 0\r\n\r\n";
+}
+
+std::string ok(size_t i, const std::string& method = "OPTIONS") {
+    return "SIP/2.0 200 OK\r\n"
+           "Via: SIP/2.0/UDP 10.1.1.1:5060;branch=z9hG4bKcap" + std::to_string(i) + "\r\n"
+           "From: <sip:qa@10.1.1.1>;tag=t" + std::to_string(i) + "\r\n"
+           "To: <sip:probe@10.2.2.2>;tag=s" + std::to_string(i) + "\r\n"
+           "Call-ID: c" + std::to_string(i) + "@cap\r\n"
+           "CSeq: 1 " + method + "\r\n"
+           "Content-Length: 0\r\n\r\n";
+}
+
+// n OPTIONS 1 ms apart, each answered 3 ms later; every 10th sent twice,
+// the copy 500 ms on. Plus one request the other way, an RTP-ish datagram
+// and a TCP segment.
+std::vector<Frame> incident(size_t n, bool v6) {
+    std::vector<Frame> f;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t t = kT0 + i * 1000000;
+        f.push_back({t, frame(kClient, kServer, 5060, 5060, request(i), v6)});
+        f.push_back({t + 3000000, frame(kServer, kClient, 5060, 5060, ok(i), v6)});
+        if (i % 10 == 0) f.push_back({t + 500000000, frame(kClient, kServer, 5060, 5060, request(i), v6)});
+    }
+    f.push_back({kT0 + 5000000, frame(kServer, kClient, 5060, 5060, request(n), v6)});
+    f.push_back({kT0 + 6000000, frame(kClient, kServer, 40000, 40002, std::string(172, '\x80'), v6)});
+    f.push_back({kT0 + 7000000, frame(kClient, kServer, 5060, 5060, "", v6, 6)});
+    return f;
+}
+
+void write_pcap(const fs::path& p, const std::vector<Frame>& frames) {
+    std::string o;
+    le32(o, 0xa1b2c3d4);
+    le16(o, 2);
+    le16(o, 4);
+    le32(o, 0);
+    le32(o, 0);
+    le32(o, 65535);
+    le32(o, 1);
+    for (auto& f : frames) {
+        le32(o, (uint32_t)(f.ts_ns / 1000000000));
+        le32(o, (uint32_t)(f.ts_ns % 1000000000 / 1000));
+        le32(o, (uint32_t)f.bytes.size());
+        le32(o, (uint32_t)f.bytes.size());
+        o += f.bytes;
+    }
+    std::ofstream(p, std::ios::binary) << o;
+}
+
+void write_pcapng(const fs::path& p, const std::vector<Frame>& frames) {
+    std::string o;
+    le32(o, 0x0a0d0d0a);
+    le32(o, 28);
+    le32(o, 0x1a2b3c4d);
+    le16(o, 1);
+    le16(o, 0);
+    le32(o, 0xffffffff);
+    le32(o, 0xffffffff);
+    le32(o, 28);
+    // Interface 0: Ethernet, if_tsresol 9 (nanoseconds).
+    le32(o, 1);
+    le32(o, 32);
+    le16(o, 1);
+    le16(o, 0);
+    le32(o, 65535);
+    le16(o, 9);
+    le16(o, 1);
+    o += '\x09';
+    o.append(3, '\0');
+    le32(o, 0);
+    le32(o, 32);
+    for (auto& f : frames) {
+        size_t pad = (4 - f.bytes.size() % 4) % 4;
+        uint32_t len = (uint32_t)(32 + f.bytes.size() + pad);
+        le32(o, 6);
+        le32(o, len);
+        le32(o, 0);
+        le32(o, (uint32_t)(f.ts_ns >> 32));
+        le32(o, (uint32_t)f.ts_ns);
+        le32(o, (uint32_t)f.bytes.size());
+        le32(o, (uint32_t)f.bytes.size());
+        o += f.bytes;
+        o.append(pad, '\0');
+        le32(o, len);
+    }
+    std::ofstream(p, std::ios::binary) << o;
+}
+
+bool fail(const char* what) {
+    std::fprintf(stderr, "replay bench: %s\n", what);
+    return false;
+}
+
+// Both files must yield the same datagrams at the same times.
+bool check_formats(const fs::path& a, const fs::path& b) {
+    PcapReader ra, rb;
+    std::string err;
+    if (!ra.open(a.string(), &err) || !rb.open(b.string(), &err)) return fail(err.c_str());
+    PcapUdp da, db;
+    while (ra.next(&da)) {
+        if (!rb.next(&db)) return fail("pcapng ended early");
+        if (da.ts_ns != db.ts_ns || da.len != db.len || std::memcmp(da.data, db.data, da.len) != 0 ||
+            da.src_port != db.src_port || da.dst_port != db.dst_port || db.ip_version != 6 ||
+            std::memcmp(da.src, db.src + 12, 4) != 0) {
+            return fail("pcap and pcapng datagrams differ");
+        }
+    }
+    if (rb.next(&db) || ra.skipped() != 1 || rb.skipped() != 1 || !rb.pcapng() ||
+        pcap_addr_str(da, true) != "10.1.1.1") {
+        return fail("capture record counts differ");
+    }
+    return true;
+}
+
+// INVITEs answered after 300 ms of ringing, with T1 cut to 2 ms so Timer B
+// fires at 128 ms: the 180 must stop the clock. A retransmission or two may
+// leave before the 180 is read; without it each INVITE is sent eight times.
+bool check_ringing(const fs::path& dir) {
+    std::vector<Frame> f;
+    const size_t n = 20;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t t = kT0 + i * 1000000;
+        f.push_back({t, frame(kClient, kServer, 5060, 5060, request(i, "INVITE"), false)});
+        f.push_back({t + 3000000, frame(kServer, kClient, 5060, 5060, ok(i, "INVITE"), false)});
+    }
+    write_pcap(dir / "ringing.pcap", f);
+
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 1;
+    rc.ring_ms = 300;
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) return fail(err.c_str());
+    ReplayConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = r.port();
+    cfg.timers.t1_ms = 2;
+    ReplayResult res = run_replay((dir / "ringing.pcap").string(), cfg);
+    ResponderStats rs = r.stats();
+    r.stop();
+    const ReplayMethodStats& m = res.methods["INVITE"];
+    if (!res.ok || m.answered != n || m.timeouts != 0 || m.same_status != n || rs.invites > 2 * n) {
+        std::fprintf(stderr, "replay bench: ringing INVITEs %llu/%zu answered, %llu timed out, %llu reached the "
+                     "responder (%s)\n", (unsigned long long)m.answered, n, (unsigned long long)m.timeouts,
+                     (unsigned long long)rs.invites, res.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool check_replay(const fs::path& p, uint16_t port, const char* src, size_t n) {
+    ReplayConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = port;
+    cfg.speed = 20;
+    cfg.src_ip = src;
+    cfg.timers.timeout_ms = 2000;
+    ReplayResult r = run_replay(p.string(), cfg);
+    if (!r.ok) return fail(r.error.c_str());
+    const ReplayMethodStats& m = r.methods["OPTIONS"];
+    if (m.requests != n || m.sent != n || m.capture_answered != n || m.answered != n || m.same_status != n ||
+        r.capture_retransmits != n / 10 || r.filtered != 1 || r.not_sip != 1 || r.not_udp != 1 ||
+        m.capture_latency.percentile(50) != 3000 || r.elapsed_s > r.capture_span_s) {
+        std::fprintf(stderr, "replay bench: %s: %llu sent, %llu answered (%llu same), %llu retransmits folded, "
+                     "%llu filtered, %llu not SIP (%s)\n", p.filename().string().c_str(), (unsigned long long)m.sent,
+                     (unsigned long long)m.answered, (unsigned long long)m.same_status,
+                     (unsigned long long)r.capture_retransmits, (unsigned long long)r.filtered,
+                     (unsigned long long)r.not_sip, r.error.c_str());
+        return false;
+    }
+    std::printf("%-40s %10.0f req/s (p50 %llu us lab, %llu us captured)\n",
+                r.pcapng ? "replay pcapng -> responder" : "replay pcap -> responder", (double)m.sent / r.elapsed_s,
+                (unsigned long long)m.latency.percentile(50), (unsigned long long)m.capture_latency.percentile(50));
+    return true;
+}
+
+} // namespace
+
+int run_replay_benchmarks() {
+    fs::path dir = fs::temp_directory_path() / "frogklan_bench_replay";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir);
+    const size_t n = 2000;
+    write_pcap(dir / "incident.pcap", incident(n, false));
+    write_pcapng(dir / "incident.pcapng", incident(n, true));
+    if (!check_formats(dir / "incident.pcap", dir / "incident.pcapng")) return 1;
+
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 1;
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) {
+        std::fprintf(stderr, "replay bench: %s\n", err.c_str());
+        return 1;
+    }
+    bool ok = check_replay(dir / "incident.pcap", r.port(), "10.1.1.1", n) &&
+              check_replay(dir / "incident.pcapng", r.port(), "::ffff:10.1.1.1", n);
+    r.stop();
+    if (!ok || !check_ringing(dir)) return 1;
+
+    // Scan rate: 200k requests and answers, payloads read in place.
+    write_pcap(dir / "big.pcap", incident(100000, false));
+    auto t0 = std::chrono::steady_clock::now();
+    PcapReader big;
+    if (!big.open((dir / "big.pcap").string(), &err)) {
+        fail(err.c_str());
+        return 1;
+    }
+    PcapUdp d;
+    size_t bytes = 0, dgrams = 0;
+    while (big.next(&d)) {
+        bytes += d.len;
+        dgrams++;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("%-40s %10.0f MB/s (%zu datagrams, %.3f s)\n", "PcapReader scan",
+                (double)fs::file_size(dir / "big.pcap") / secs / 1e6, dgrams, secs);
+    g_sink = bytes;
+    fs::remove_all(dir, ec);
+    return 0;
+}
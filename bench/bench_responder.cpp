@@ -0,0 +1,317 @@
+// The local responder as a target: OPTIONS and Digest REGISTER exchanges
+// through UdpClient, fault injection, then open-loop OPTIONS load and a
+// REGISTER storm from frogklan's own engines against it over loopback, with
+// a load worker sweep and a multi-target probe split across workers, each
+// also run with UDP on io_uring where the kernel has it. A small registrar
+// that does track nonce counts checks the storm never repeats one.
+#include "bench.h"
+#include "load.h"
+#include "net.h"
+#include "prober.h"
+#include "responder.h"
+#include "sip.h"
+#include "storm.h"
+#include "udp_uring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+bool fail(const char* what) {
+    std::fprintf(stderr, "responder bench: %s\n", what);
+    return false;
+}
+
+bool check_exchanges() {
+    ResponderConfig cfg;
+    cfg.port = 0;
+    cfg.workers = 2;
+    cfg.users["1001"] = "secret";
+    SipResponder r;
+    std::string err;
+    if (!r.start(cfg, &err)) return fail(err.c_str());
+
+    UdpAddr dst;
+    resolve_udp_addr("127.0.0.1", r.port(), &dst);
+    UdpClient c;
+    const std::string host = "127.0.0.1";
+    const std::string uri = "sip:" + host + ":" + std::to_string(r.port());
+
+    std::string msg = make_sip_options(host, r.port(), "sip:qa@example.com", "sip:qa@example.com", "bench",
+                                       "opt-1@frogklan", 1, "z9hG4bKopt1", "t1");
+    UdpReply rep = c.request(dst, msg, 1000);
+    SipResponse resp = parse_sip_response(rep.data);
+    if (!rep.ok || resp.status != 200 || sip_top_via_branch(resp) != "z9hG4bKopt1" ||
+        sip_call_id(resp) != "opt-1@frogklan" || resp.headers_lc["to"].find(";tag=") == std::string::npos) {
+        return fail("OPTIONS was not answered 200 with the request's Via, Call-ID and a To tag");
+    }
+
+    auto reg = [&](const std::string& branch, int cseq, const std::string& auth) {
+        std::string m = make_sip_register(host, r.port(), "sip:1001@example.com", "sip:1001@127.0.0.1", "bench",
+                                          "reg-1@frogklan", cseq, branch, "t2", 300, auth);
+        UdpReply p = c.request(dst, m, 1000);
+        return p.ok ? parse_sip_response(p.data) : SipResponse{};
+    };
+    resp = reg("z9hG4bKreg1", 1, "");
+    SipAuthChallenge ch = parse_www_authenticate_digest(resp);
+    if (resp.status != 401 || !ch.ok || ch.realm != cfg.realm) return fail("REGISTER was not challenged");
+    resp = reg("z9hG4bKreg2", 2, build_digest_authorization("REGISTER", uri, "1001", "secret", ch, "c1", "00000001"));
+    if (resp.status != 200) return fail("valid credentials were not accepted");
+    resp = reg("z9hG4bKreg3", 3, build_digest_authorization("REGISTER", uri, "1001", "wrong", ch, "c2", "00000002"));
+    if (resp.status != 403) return fail("a wrong password was not refused");
+    SipAuthChallenge forged = ch;
+    forged.nonce[0] = forged.nonce[0] == '0' ? '1' : '0';
+    resp = reg("z9hG4bKreg4", 4, build_digest_authorization("REGISTER", uri, "1001", "secret", forged, "c3", "00000001"));
+    if (resp.status != 401) return fail("a forged nonce was not re-challenged");
+
+    ResponderStats s = r.stats();
+    if (s.options != 1 || s.registers != 4 || s.registered != 1 || s.forbidden != 1 || s.challenged != 2) {
+        return fail("stats do not match the exchanges");
+    }
+    r.stop();
+
+    // Every request answered 503, then every request dropped.
+    cfg.fail_503 = 1;
+    SipResponder busy;
+    if (!busy.start(cfg, &err)) return fail(err.c_str());
+    resolve_udp_addr("127.0.0.1", busy.port(), &dst);
+    rep = c.request(dst, msg, 1000);
+    if (!rep.ok || parse_sip_response(rep.data).status != 503) return fail("--fail-503 1 did not answer 503");
+    busy.stop();
+
+    cfg.fail_503 = 0;
+    cfg.drop = 1;
+    SipResponder lossy;
+    if (!lossy.start(cfg, &err)) return fail(err.c_str());
+    resolve_udp_addr("127.0.0.1", lossy.port(), &dst);
+    if (c.request(dst, msg, 100).ok || lossy.stats().dropped != 1) return fail("--drop 1 still answered");
+    return true;
+}
+
+// Registrar for the nonce-count check: each nonce is handed to three
+// challenges in a row from the same source port (one storm worker), and every
+// nc= it comes back with must be higher than the last one seen on that nonce.
+// Retransmissions, known by their branch, are answered again unchecked, as a
+// transaction layer would absorb them. The digest itself is not verified;
+// the responder bench above covers that.
+class NcRegistrar {
+public:
+    bool start() {
+        if (!sock_.open() || !sock_.bind("127.0.0.1", 0) || !poller_.add(sock_)) return false;
+        th_ = std::thread([this] { run(); });
+        return true;
+    }
+    void stop() {
+        stop_ = true;
+        if (th_.joinable()) th_.join();
+    }
+    uint16_t port() const { return sock_.local_port(); }
+    uint64_t replays() const { return replays_; }
+    uint64_t max_nc() const { return max_nc_; }
+
+private:
+    void run() {
+        std::vector<int> ready;
+        std::vector<char> buf(65536);
+        SipRequestView q;
+        std::string o;
+        while (!stop_) {
+            if (poller_.wait(20, ready) <= 0) continue;
+            UdpAddr src;
+            int n;
+            while ((n = sock_.recv_from(buf.data(), buf.size(), &src)) > 0) {
+                if (!parse_sip_request_view(buf.data(), (size_t)n, &q) || q.method != "REGISTER") continue;
+                bool ok = false;
+                if (!q.authorization.empty()) {
+                    SipDigestCredentials c = parse_digest_credentials(q.authorization);
+                    uint32_t nc = (uint32_t)std::strtoul(c.nc.c_str(), nullptr, 16);
+                    // A request lost here comes back later by retransmission,
+                    // behind higher counts, so only a repeat is a replay.
+                    if (branches_.emplace(sip_via_branch(q.vias[0])).second) {
+                        if (!used_.emplace(c.nonce + ":" + c.nc).second) replays_++;
+                        if (nc > max_nc_) max_nc_ = nc;
+                    }
+                    ok = true;
+                }
+                o.assign(ok ? "SIP/2.0 200 OK\r\n" : "SIP/2.0 401 Unauthorized\r\n");
+                for (size_t i = 0; i < q.via_count; i++) o.append("Via: ").append(q.vias[i]).append("\r\n");
+                o.append("From: ").append(q.from).append("\r\nTo: ").append(q.to).append(";tag=nc\r\n");
+                o.append("Call-ID: ").append(q.call_id).append("\r\nCSeq: ").append(q.cseq).append("\r\n");
+                if (!ok) {
+                    o.append("WWW-Authenticate: Digest realm=\"nc\", nonce=\"n")
+                     .append(std::to_string(src.port)).append("-")
+                     .append(std::to_string(challenges_[src.port]++ / 3)).append("\", qop=\"auth\", algorithm=MD5\r\n");
+                }
+                o.append("Content-Length: 0\r\n\r\n");
+                sock_.send_to(src, o.data(), o.size());
+            }
+        }
+    }
+
+    UdpSocket sock_;
+    UdpPoller poller_;
+    std::thread th_;
+    std::atomic<bool> stop_{false};
+    std::unordered_set<std::string> used_;                // "nonce:nc" pairs seen
+    std::unordered_set<std::string> branches_;
+    std::unordered_map<uint16_t, uint64_t> challenges_;   // per source port
+    std::atomic<uint64_t> replays_{0};
+    std::atomic<uint64_t> max_nc_{0};
+};
+
+// Batched challenge answers and the preemptive ones after them share each
+// worker's nonce counts: no nc is sent twice on one nonce.
+bool check_nonce_counts() {
+    NcRegistrar reg;
+    if (!reg.start()) return fail("cannot bind the nonce-count registrar");
+    std::vector<StormCredential> creds;
+    for (int i = 0; i < 3000; i++) {
+        std::string u = std::to_string(300000 + i);
+        creds.push_back(StormCredential{"sip:" + u + "@example.com", "sip:" + u + "@127.0.0.1", u, "pw"});
+    }
+    StormConfig sc;
+    sc.host = "127.0.0.1";
+    sc.port = reg.port();
+    sc.user_agent = "bench";
+    sc.rate = 20000;
+    sc.workers = 2;
+    StormResult st = run_storm(creds, sc);
+    reg.stop();
+    if (!st.ok || st.registered != creds.size() || st.preemptive == 0 || reg.max_nc() < 2 || reg.replays() != 0) {
+        std::fprintf(stderr, "responder bench: storm nonce counts: %llu registered, %llu preemptive, "
+                     "max nc %llu, %llu replayed (%s)\n", (unsigned long long)st.registered,
+                     (unsigned long long)st.preemptive, (unsigned long long)reg.max_nc(),
+                     (unsigned long long)reg.replays(), st.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_responder_benchmarks() {
+    if (!check_exchanges() || !check_nonce_counts()) return 1;
+
+    ResponderConfig cfg;
+    cfg.port = 0;
+    cfg.workers = 4;
+    const size_t kUsers = 5000;
+    std::vector<StormCredential> creds;
+    for (size_t i = 0; i < kUsers; i++) {
+        std::string u = std::to_string(200000 + i);
+        cfg.users[u] = "pw" + u;
+        creds.push_back(StormCredential{"sip:" + u + "@example.com", "sip:" + u + "@127.0.0.1", u, "pw" + u});
+    }
+    SipResponder r;
+    std::string err;
+    if (!r.start(cfg, &err)) {
+        std::fprintf(stderr, "responder bench: %s\n", err.c_str());
+        return 1;
+    }
+
+    LoadConfig lc;
+    lc.host = "127.0.0.1";
+    lc.port = r.port();
+    lc.from_uri = lc.to_uri = "sip:qa@example.com";
+    lc.user_agent = "bench";
+    lc.rate = 50000;
+    lc.duration_s = 1.0;
+    lc.sockets = 2;
+    LoadResult lr = run_load(lc);
+    double lrate = lr.elapsed_s > 0 ? (double)lr.replies_2xx / lr.elapsed_s : 0;
+    if (!lr.ok || lr.replies_2xx == 0) {
+        std::fprintf(stderr, "responder bench: load run got no 200s (%s)\n", lr.error.c_str());
+        return 1;
+    }
+    std::printf("%-40s %10.0f 200/s (%llu timeouts, p99 %llu us)\n", "load OPTIONS -> responder", lrate,
+                (unsigned long long)lr.timeouts, (unsigned long long)lr.service.percentile(99));
+
+    // Worker sweep well above what one core sends: every request must be
+    // accounted for exactly once however the schedule was split.
+    const int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    lc.rate = 200000;
+    lc.duration_s = 0.5;
+    lc.timeout_ms = 1000;
+    lc.sockets = 1;
+    const uint64_t total = (uint64_t)(lc.rate * lc.duration_s);
+    for (int w = 1; w <= std::max(4, std::min(cores, 16)); w *= 2) {
+        lc.workers = w;
+        LoadResult wr = run_load(lc);
+        uint64_t claimed = 0;
+        for (uint64_t n : wr.per_worker_sent) claimed += n;
+        if (!wr.ok || wr.per_worker_sent.size() != (size_t)w || claimed != wr.sent ||
+            wr.sent + wr.send_errors != total || wr.replies_2xx + wr.replies_non2xx + wr.timeouts != wr.sent) {
+            std::fprintf(stderr, "responder bench: %d-worker load lost requests: %llu sent + %llu errors of %llu (%s)\n",
+                         w, (unsigned long long)wr.sent, (unsigned long long)wr.send_errors,
+                         (unsigned long long)total, wr.error.c_str());
+            return 1;
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "load OPTIONS -> responder, %d workers", w);
+        std::printf("%-40s %10.0f 200/s (%d cores, lag max %llu us)\n", name,
+                    (double)wr.replies_2xx / wr.elapsed_s, cores, (unsigned long long)wr.max_send_lag_us);
+    }
+
+    // The same accounting with the workers' UDP on io_uring.
+    const bool have_uring = udp_uring_supported();
+    if (have_uring) {
+        lc.workers = 2;
+        lc.uring = true;
+        LoadResult ur = run_load(lc);
+        if (!ur.ok || !ur.uring || ur.sent + ur.send_errors != total ||
+            ur.replies_2xx + ur.replies_non2xx + ur.timeouts != ur.sent) {
+            std::fprintf(stderr, "responder bench: io_uring load lost requests: %llu sent + %llu errors of %llu (%s)\n",
+                         (unsigned long long)ur.sent, (unsigned long long)ur.send_errors,
+                         (unsigned long long)total, ur.error.c_str());
+            return 1;
+        }
+        std::printf("%-40s %10.0f 200/s (lag max %llu us)\n", "load OPTIONS -> responder, 2w io_uring",
+                    (double)ur.replies_2xx / ur.elapsed_s, (unsigned long long)ur.max_send_lag_us);
+        lc.uring = false;
+    }
+    lc.workers = 1;
+
+    // Multi-target probing split across workers: every target answered once.
+    std::vector<ProbeTarget> targets(3000, ProbeTarget{"127.0.0.1", r.port()});
+    MultiProbeConfig mc;
+    mc.from_uri = "sip:qa@example.com";
+    mc.user_agent = "bench";
+    mc.workers = 3;
+    for (bool uring : {false, true}) {
+        if (uring && !have_uring) continue;
+        mc.uring = uring;
+        auto pr = run_multi_probe(targets, mc);
+        for (const auto& res : pr) {
+            if (!res.ok || res.status != 200) {
+                std::fprintf(stderr, "responder bench: multi-probe with 3 workers%s: %s\n",
+                             uring ? " on io_uring" : "", res.note.c_str());
+                return 1;
+            }
+        }
+    }
+
+    StormConfig sc;
+    sc.host = "127.0.0.1";
+    sc.port = r.port();
+    sc.user_agent = "bench";
+    sc.rate = 20000;
+    sc.workers = 2;
+    StormResult st = run_storm(creds, sc);
+    if (!st.ok || st.registered != kUsers) {
+        std::fprintf(stderr, "responder bench: storm registered %llu/%zu (%s)\n",
+                     (unsigned long long)st.registered, kUsers, st.error.c_str());
+        return 1;
+    }
+    std::printf("%-40s %10.0f reg/s (%llu preemptive)\n", "storm REGISTER -> responder",
+                st.elapsed_s > 0 ? (double)st.registered / st.elapsed_s : 0, (unsigned long long)st.preemptive);
+    r.stop();
+    g_sink = (size_t)lrate;
+    return 0;
+}
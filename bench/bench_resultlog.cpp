@@ -0,0 +1,118 @@
+// Binary result log: records written through ResultLog across several
+// segments must come back exactly in build_log_report, then append cost and
+// report scan throughput.
+#include "bench.h"
+#include "resultlog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint64_t kT0 = 1699999200ull * 1000000;   // a fixed Unix time on the hour, in us
+
+// Target i: every 10th probe times out, every 7th answers 503, RTT cycles
+// 1..1000 ms. Written one hour per 100k records so windows split cleanly.
+ProbeRecord make_record(uint64_t k, uint32_t target) {
+    ProbeRecord r;
+    r.ts_us = kT0 + k * 36000;
+    r.target = target;
+    if (k % 10 == 0) {
+        r.outcome = (uint8_t)ProbeOutcome::Timeout;
+        r.retransmits = 10;
+    } else {
+        r.status = (k % 7 == 0) ? 503 : 200;
+        r.rtt_us = (uint32_t)(1 + k % 1000) * 1000;
+        r.peer_ip = 0x0100007f;
+        r.peer_port = 5060;
+    }
+    return r;
+}
+
+bool check_roundtrip(const fs::path& dir) {
+    const uint64_t n = 200000;
+    {
+        ResultLog log;
+        std::string err;
+        if (!log.open(dir.string(), &err, 1 << 20)) { std::fprintf(stderr, "ResultLog: %s\n", err.c_str()); return false; }
+        uint32_t a = log.target_id("10.0.0.1:5060"), b = log.target_id("10.0.0.2:5060");
+        for (uint64_t k = 0; k < n; k++) log.append(make_record(k, (k & 1) ? b : a));
+    }
+
+    LogReportConfig cfg;
+    cfg.dir = dir.string();
+    cfg.window_s = 3600;
+    cfg.threads = 4;
+    LogReport r;
+    std::string err;
+    if (!build_log_report(cfg, &r, &err)) { std::fprintf(stderr, "report: %s\n", err.c_str()); return false; }
+    if (r.records_scanned != n || r.segments < 6 || r.rows.size() != 4) {
+        std::fprintf(stderr, "report: %llu records in %d segments, %zu rows\n",
+                     (unsigned long long)r.records_scanned, r.segments, r.rows.size());
+        return false;
+    }
+    uint64_t probes = 0, timeouts = 0, err5 = 0, ok = 0;
+    for (auto& w : r.rows) {
+        probes += w.probes; timeouts += w.timeouts; err5 += w.class_3xx_6xx[2]; ok += w.ok_2xx;
+        if (w.rtt_max_us < 999000 || w.rtt_p50_us < 485000 || w.rtt_p50_us > 530000) {
+            std::fprintf(stderr, "report: %s p50=%llu max=%llu\n", w.target.c_str(),
+                         (unsigned long long)w.rtt_p50_us, (unsigned long long)w.rtt_max_us);
+            return false;
+        }
+    }
+    uint64_t want_to = n / 10, want5 = 0;
+    for (uint64_t k = 0; k < n; k++) if (k % 10 && k % 7 == 0) want5++;
+    if (probes != n || timeouts != want_to || err5 != want5 || ok != n - want_to - want5) {
+        std::fprintf(stderr, "report: totals wrong\n");
+        return false;
+    }
+
+    // A target filter and a time range narrow the scan.
+    cfg.target = "10.0.0.2:5060";
+    cfg.window_s = 0;
+    cfg.since_s = (kT0 + 100000 * 36000ull) / 1000000;
+    LogReport one;
+    if (!build_log_report(cfg, &one, &err) || one.rows.size() != 1 || one.rows[0].probes != 50000) {
+        std::fprintf(stderr, "report: filtered scan wrong\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_resultlog_benchmarks() {
+    fs::path dir = fs::temp_directory_path() / "frogklan_bench_log";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    if (!check_roundtrip(dir)) return 1;
+    fs::remove_all(dir, ec);
+
+    const uint64_t n = 4000000;   // 128 MB
+    {
+        ResultLog log;
+        std::string err;
+        if (!log.open(dir.string(), &err)) return 1;
+        uint32_t ids[64];
+        for (int i = 0; i < 64; i++) ids[i] = log.target_id("10.0.1." + std::to_string(i) + ":5060");
+        uint64_t k = 0;
+        bench("ResultLog::append", n, [&]{
+            log.append(make_record(k, ids[k & 63]));
+            k++;
+        });
+    }
+    LogReportConfig cfg;
+    cfg.dir = dir.string();
+    cfg.window_s = 3600;
+    LogReport r;
+    std::string err;
+    if (!build_log_report(cfg, &r, &err)) return 1;
+    std::printf("%-40s %10.1f MB/s (%llu records, %d threads, %.3f s)\n", "build_log_report",
+                r.bytes_mapped / 1e6 / r.elapsed_s, (unsigned long long)r.records_scanned, r.threads, r.elapsed_s);
+    fs::remove_all(dir, ec);
+    return 0;
+}
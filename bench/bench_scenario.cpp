@@ -0,0 +1,413 @@
+// Scenarios: compile errors and the step table, message rendering cost, then
+// REGISTER-with-Digest and INVITE/ACK/BYE flows run against the responder,
+// REGISTER again with a tenth of requests dropped (retransmissions must
+// carry every flow through), and a challenged INVITE against a peer that
+// checks each ACK's branch.
+#include "bench.h"
+#include "net.h"
+#include "responder.h"
+#include "scenario.h"
+#include "sip.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+bool fail(const char* what) {
+    std::fprintf(stderr, "scenario bench: %s\n", what);
+    return false;
+}
+
+const char* kRegister =
+    "default expires 60\n"
+    "timeout 2000\n"
+    "label register\n"
+    "send\n"
+    "REGISTER sip:[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:[user]@[domain]>\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] REGISTER\n"
+    "Contact: <sip:[user]@[local_ip]:[local_port]>\n"
+    "Expires: [expires]\n"
+    "[auth]\n"
+    "Content-Length: [len]\n"
+    ".\n"
+    "expect 200 401:register\n";
+
+const char* kCall =
+    "timeout 2000\n"
+    "send\n"
+    "INVITE sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] INVITE\n"
+    "Content-Type: application/sdp\n"
+    "Content-Length: [len]\n"
+    "\n"
+    "v=0\n"
+    "o=frogklan 1 1 IN IP4 [local_ip]\n"
+    "c=IN IP4 [local_ip]\n"
+    "m=audio 40000 RTP/AVP 0\n"
+    ".\n"
+    "expect 18x\n"
+    "expect 2xx\n"
+    "send\n"
+    "ACK sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>;tag=[to_tag]\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] ACK\n"
+    "Content-Length: 0\n"
+    ".\n"
+    "pause [hold]\n"
+    "send\n"
+    "BYE sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>;tag=[to_tag]\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] BYE\n"
+    "Content-Length: 0\n"
+    ".\n"
+    "expect 200\n";
+
+// As scenarios/call.sf: a challenged INVITE is ACKed and sent again with
+// credentials; the answer is ACKed and the call ends there.
+const char* kChallengedCall =
+    "timeout 2000\n"
+    "label invite\n"
+    "send\n"
+    "INVITE sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] INVITE\n"
+    "[auth]\n"
+    "Content-Length: [len]\n"
+    ".\n"
+    "expect 200 401:retry\n"
+    "goto answered\n"
+    "label retry\n"
+    "send\n"
+    "ACK sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>;tag=[to_tag]\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] ACK\n"
+    "Content-Length: 0\n"
+    ".\n"
+    "goto invite\n"
+    "label answered\n"
+    "send\n"
+    "ACK sip:echo@[domain] SIP/2.0\n"
+    "Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]\n"
+    "From: <sip:[user]@[domain]>;tag=[tag]\n"
+    "To: <sip:echo@[domain]>;tag=[to_tag]\n"
+    "Call-ID: [call_id]\n"
+    "CSeq: [cseq] ACK\n"
+    "Content-Length: 0\n"
+    ".\n";
+
+std::map<std::string, std::string> consts() {
+    return {{"domain", "example.com"}, {"user", "qa"}, {"hold", "50"}};
+}
+
+bool compiles(const std::string& text, std::string* err) {
+    Scenario sc;
+    return compile_scenario(text, consts(), &sc, err);
+}
+
+bool check_compile() {
+    Scenario sc;
+    std::string err;
+    if (!compile_scenario(kCall, consts(), &sc, &err)) return fail(err.c_str());
+    if (sc.steps.size() != 7 || sc.messages.size() != 3 || sc.messages[0].method != "INVITE" ||
+        sc.messages[0].uri != "sip:echo@example.com" || sc.steps[5].op != ScenarioOp::Send ||
+        sc.steps[4].op != ScenarioOp::Pause || sc.steps[4].arg != 50) {
+        return fail("call scenario compiled to the wrong step table");
+    }
+    if (sc.alts[sc.steps[1].alt_begin].lo != 180 || sc.alts[sc.steps[1].alt_begin].hi != 189) {
+        return fail("18x did not become 180-189");
+    }
+
+    // Each broken file names the problem and its line.
+    struct Bad { std::string text; const char* expect; };
+    const Bad bad[] = {
+        {"send\nOPTIONS sip:[nope] SIP/2.0\n.\n", "line 2: unknown variable [nope]"},
+        {"send\nOPTIONS sip:[call_id] SIP/2.0\n.\n", "line 2: [call_id] cannot appear"},
+        {"send\nOPTIONS sip:a SIP/2.0\n", "line 1: send without"},
+        {"send\nOPTIONS sip:a SIP/2.0\nX: [len]\n\nbody [len]\n.\n", "line 5: [len] cannot appear"},
+        {"send\nOPTIONS sip:a SIP/2.0\n.\nexpect 200:later\n", "line 4: no label later"},
+        {"send\nOPTIONS sip:a SIP/2.0\n.\nexpect 2x0\n", "line 4: bad status"},
+        {"label top\nsend\nOPTIONS sip:a SIP/2.0\n.\ngoto top\n", "line 5: loop with no expect"},
+        {"pause 10\n", "scenario sends nothing"},
+    };
+    for (const Bad& b : bad) {
+        if (compiles(b.text, &err) || err.compare(0, std::strlen(b.expect), b.expect) != 0) {
+            std::fprintf(stderr, "scenario bench: wanted \"%s\", got \"%s\"\n", b.expect, err.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_render(const Scenario& sc) {
+    std::string out, body;
+    ScenarioValues v;
+    v.call_id = "abc@frogklan";
+    v.tag = "t1";
+    v.branch = "z9hG4bKx";
+    v.local_ip = "127.0.0.1";
+    v.local_port = "5070";
+    v.cseq = 7;
+    sc.render(sc.messages[0], v, out, body);
+    if (out.find("CSeq: 7 REGISTER\r\n") == std::string::npos || out.find("Expires: 60\r\n") == std::string::npos ||
+        out.find("Authorization") != std::string::npos ||
+        out.size() < 21 || out.compare(out.size() - 21, 21, "Content-Length: 0\r\n\r\n") != 0) {
+        return fail("REGISTER rendered wrong without credentials");
+    }
+    v.auth = "Authorization: Digest username=\"qa\"\r\n";
+    sc.render(sc.messages[0], v, out, body);
+    if (out.find("\r\nAuthorization: Digest username=\"qa\"\r\nContent-Length: 0\r\n") == std::string::npos) {
+        return fail("[auth] line not rendered in place");
+    }
+
+    Scenario call;
+    std::string err;
+    compile_scenario(kCall, consts(), &call, &err);
+    call.render(call.messages[0], v, out, body);
+    const std::string tail = "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    if (body.empty() || out.size() < tail.size() || out.compare(out.size() - tail.size(), tail.size(), tail) != 0) {
+        return fail("INVITE Content-Length does not match its body");
+    }
+    return true;
+}
+
+// UAS for kChallengedCall: the first INVITE of each call gets a 401, the
+// second a 200. The ACK for the 401 must carry that INVITE's branch (RFC
+// 3261 17.1.1.3) and the ACK for the 200 a new one.
+class AckCheckPeer {
+public:
+    bool start() {
+        // ACKs are never retransmitted, so none may be lost to a full queue.
+        if (!sock_.open(4 << 20) || !sock_.bind("127.0.0.1", 0) || !poller_.add(sock_)) return false;
+        th_ = std::thread([this] { run(); });
+        return true;
+    }
+    void stop() {
+        stop_ = true;
+        if (th_.joinable()) th_.join();
+    }
+    uint16_t port() const { return sock_.local_port(); }
+    uint64_t acks_ok() const { return acks_ok_; }
+    uint64_t acks_bad() const { return acks_bad_; }
+
+private:
+    struct Call {
+        std::string branch;    // of the last INVITE
+        int answered = 0;      // final sent to it
+    };
+
+    void run() {
+        std::vector<int> ready;
+        std::vector<char> buf(65536);
+        SipRequestView q;
+        std::string o;
+        while (!stop_) {
+            if (poller_.wait(20, ready) <= 0) continue;
+            UdpAddr src;
+            int n;
+            while ((n = sock_.recv_from(buf.data(), buf.size(), &src)) > 0) {
+                if (!parse_sip_request_view(buf.data(), (size_t)n, &q)) continue;
+                Call& c = calls_[std::string(q.call_id)];
+                std::string_view branch = sip_via_branch(q.vias[0]);
+                if (q.method == "ACK") {
+                    bool same = branch == c.branch;
+                    if (same == (c.answered == 401)) acks_ok_++;
+                    else acks_bad_++;
+                    continue;
+                }
+                if (q.method != "INVITE") continue;
+                if (branch != c.branch) {
+                    c.branch = std::string(branch);
+                    c.answered = q.authorization.empty() ? 401 : 200;
+                }
+                o.assign(c.answered == 401 ? "SIP/2.0 401 Unauthorized\r\n" : "SIP/2.0 200 OK\r\n");
+                for (size_t i = 0; i < q.via_count; i++) o.append("Via: ").append(q.vias[i]).append("\r\n");
+                o.append("From: ").append(q.from).append("\r\nTo: ").append(q.to).append(";tag=uas\r\n");
+                o.append("Call-ID: ").append(q.call_id).append("\r\nCSeq: ").append(q.cseq).append("\r\n");
+                if (c.answered == 401) o.append("WWW-Authenticate: Digest realm=\"r\", nonce=\"n\", qop=\"auth\"\r\n");
+                o.append("Content-Length: 0\r\n\r\n");
+                sock_.send_to(src, o.data(), o.size());
+            }
+        }
+    }
+
+    UdpSocket sock_;
+    UdpPoller poller_;
+    std::thread th_;
+    std::atomic<bool> stop_{false};
+    std::unordered_map<std::string, Call> calls_;
+    std::atomic<uint64_t> acks_ok_{0}, acks_bad_{0};
+};
+
+bool check_challenged_acks() {
+    AckCheckPeer peer;
+    if (!peer.start()) return fail("cannot bind the ACK-checking peer");
+    Scenario sc;
+    std::string err;
+    if (!compile_scenario(kChallengedCall, consts(), &sc, &err)) {
+        peer.stop();
+        return fail(err.c_str());
+    }
+    ScenarioConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = peer.port();
+    cfg.user = "qa";
+    cfg.pass = "secret";
+    cfg.rate = 5000;
+    cfg.count = 1000;
+    ScenarioResult sr = run_scenario(sc, cfg);
+    // The last ACK may still be on its way.
+    for (int i = 0; i < 100 && peer.acks_ok() + peer.acks_bad() < 2 * cfg.count; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    peer.stop();
+    if (!sr.ok || sr.completed != cfg.count || peer.acks_ok() != 2 * cfg.count || peer.acks_bad() != 0) {
+        std::fprintf(stderr, "scenario bench: challenged calls %llu/%llu completed, ACK branches %llu right, "
+                     "%llu wrong (%s)\n", (unsigned long long)sr.completed, (unsigned long long)cfg.count,
+                     (unsigned long long)peer.acks_ok(), (unsigned long long)peer.acks_bad(), sr.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// With requests dropped at the responder, Timer E retransmissions (T1 cut
+// to 20 ms to keep the run short) must still complete every flow.
+bool check_lossy(const Scenario& reg) {
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 1;
+    rc.drop = 0.1;
+    rc.users["qa"] = "secret";
+    SipResponder r;
+    std::string err;
+    if (!r.start(rc, &err)) return fail(err.c_str());
+    ScenarioConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = r.port();
+    cfg.user = "qa";
+    cfg.pass = "secret";
+    cfg.rate = 2000;
+    cfg.count = 1000;
+    cfg.timers.t1_ms = 20;
+    ScenarioResult sr = run_scenario(reg, cfg);
+    ResponderStats rs = r.stats();
+    r.stop();
+    if (!sr.ok || sr.completed != cfg.count || sr.retransmits == 0 || rs.dropped == 0) {
+        std::fprintf(stderr, "scenario bench: lossy register %llu/%llu completed, %llu retransmits, "
+                     "%llu dropped (%s)\n", (unsigned long long)sr.completed, (unsigned long long)cfg.count,
+                     (unsigned long long)sr.retransmits, (unsigned long long)rs.dropped, sr.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_scenario_benchmarks() {
+    if (!check_compile()) return 1;
+    Scenario reg;
+    std::string err;
+    if (!compile_scenario(kRegister, consts(), &reg, &err)) { fail(err.c_str()); return 1; }
+    if (!check_render(reg)) return 1;
+
+    std::string out, body;
+    ScenarioValues v;
+    v.call_id = "0123456789abcdef0123456789abcdef@frogklan";
+    v.tag = "0123456789abcdef";
+    v.branch = "z9hG4bK0123456789abcdef0123456789abcdef";
+    v.local_ip = "127.0.0.1";
+    v.local_port = "5070";
+    bench("Scenario::render REGISTER", 1000000, [&]{
+        v.cseq++;
+        g_sink = reg.render(reg.messages[0], v, out, body);
+    });
+
+    ResponderConfig rc;
+    rc.port = 0;
+    rc.workers = 2;
+    rc.ring_ms = 5;
+    rc.users["qa"] = "secret";
+    SipResponder r;
+    if (!r.start(rc, &err)) {
+        std::fprintf(stderr, "scenario bench: %s\n", err.c_str());
+        return 1;
+    }
+    ScenarioConfig cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = r.port();
+    cfg.user = "qa";
+    cfg.pass = "secret";
+    cfg.rate = 20000;
+    cfg.count = 5000;
+
+    // Each instance is challenged once, then registers.
+    ScenarioResult sr = run_scenario(reg, cfg);
+    ResponderStats rs = r.stats();
+    if (!sr.ok || sr.completed != cfg.count || sr.failed != 0 || sr.stray != 0 || sr.steps[0].sent != 2 * cfg.count ||
+        sr.steps[1].statuses[401] != cfg.count || sr.steps[1].statuses[200] != cfg.count ||
+        rs.registered != cfg.count) {
+        std::fprintf(stderr, "scenario bench: register %llu/%llu completed, %llu failed, %llu stray (%s)\n",
+                     (unsigned long long)sr.completed, (unsigned long long)cfg.count, (unsigned long long)sr.failed,
+                     (unsigned long long)sr.stray, sr.error.c_str());
+        r.stop();
+        return 1;
+    }
+    std::printf("%-40s %10.0f flows/s (p50 %llu us, peak %llu live)\n", "scenario REGISTER+Digest -> responder",
+                (double)sr.completed / sr.elapsed_s, (unsigned long long)sr.duration.percentile(50),
+                (unsigned long long)sr.peak_live);
+
+    // The same flows split over three workers, each with its own socket.
+    cfg.workers = 3;
+    sr = run_scenario(reg, cfg);
+    uint64_t started = 0;
+    for (uint64_t n : sr.per_worker_started) started += n;
+    if (!sr.ok || sr.completed != cfg.count || started != cfg.count || sr.per_worker_started.size() != 3) {
+        std::fprintf(stderr, "scenario bench: 3 workers completed %llu/%llu (%s)\n", (unsigned long long)sr.completed,
+                     (unsigned long long)cfg.count, sr.error.c_str());
+        r.stop();
+        return 1;
+    }
+    cfg.workers = 1;
+
+    Scenario call;
+    compile_scenario(kCall, consts(), &call, &err);
+    sr = run_scenario(call, cfg);
+    rs = r.stats();
+    r.stop();
+    if (!sr.ok || sr.completed != cfg.count || sr.failed != 0 || rs.byes != cfg.count) {
+        std::fprintf(stderr, "scenario bench: call %llu/%llu completed, %llu failed, %llu stray (%s)\n",
+                     (unsigned long long)sr.completed, (unsigned long long)cfg.count, (unsigned long long)sr.failed,
+                     (unsigned long long)sr.stray, sr.error.c_str());
+        return 1;
+    }
+    // Ringing comes at once, the answer after --ring.
+    if (sr.duration.percentile(50) < 50000) { fail("call flows finished before ring + hold"); return 1; }
+    std::printf("%-40s %10.0f flows/s (p50 %llu us, peak %llu live)\n", "scenario INVITE/ACK/BYE -> responder",
+                (double)sr.completed / sr.elapsed_s, (unsigned long long)sr.duration.percentile(50),
+                (unsigned long long)sr.peak_live);
+    if (!check_lossy(reg) || !check_challenged_acks()) return 1;
+    return 0;
+}
@@ -0,0 +1,387 @@
+// Microbenchmarks for SIP hot paths. Build with -DFROGKLAN_BUILD_BENCH=ON and
+// run ./frogklan_bench [--reps N] [--json <file>]; results are ns per
+// operation plus heap allocations and bytes per operation. --json writes the
+// bench() cases as one document for tracking regressions between releases.
+#include "app.h"
+#include "bench.h"
+#include "md5.h"
+#include "sip.h"
+#include "sip_template.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+volatile size_t g_sink;
+int g_bench_reps = 3;
+std::atomic<uint64_t> g_alloc_count{0};
+std::atomic<uint64_t> g_alloc_bytes{0};
+
+std::vector<BenchResult>& bench_results() {
+    static std::vector<BenchResult> r;
+    return r;
+}
+
+// Counting global allocator: every plain and array new in the process goes
+// through here, so bench() can report allocations per op.
+void* operator new(size_t n) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+static std::string resp_200_ok() {
+    return
+        "SIP/2.0 200 OK\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.5:5060;branch=z9hG4bK-7f3a9c1e2b4d6a80-1a2b;received=192.0.2.10;rport=5060\r\n"
+        "From: <sip:qa@example.com>;tag=7f3a9c1e\r\n"
+        "To: <sip:qa@example.com>;tag=as5b1c7d2e\r\n"
+        "Call-ID: 7f3a9c1e2b4d6a80-1a2b@frogklan\r\n"
+        "CSeq: 1 OPTIONS\r\n"
+        "Server: Asterisk PBX 18.10.0\r\n"
+        "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, SUBSCRIBE, NOTIFY, INFO, PUBLISH, MESSAGE\r\n"
+        "Supported: replaces, timer\r\n"
+        "Accept: application/sdp\r\n"
+        "Content-Length: 0\r\n\r\n";
+}
+
+static std::string resp_401() {
+    return
+        "SIP/2.0 401 Unauthorized\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.5:5060;branch=z9hG4bK-7f3a9c1e2b4d6a80-1a2c;received=192.0.2.10;rport=5060\r\n"
+        "From: <sip:1001@example.com>;tag=7f3a9c1e\r\n"
+        "To: <sip:1001@example.com>;tag=as1f2e3d4c\r\n"
+        "Call-ID: 7f3a9c1e2b4d6a80-1a2c@frogklan\r\n"
+        "CSeq: 1 REGISTER\r\n"
+        "Server: Asterisk PBX 18.10.0\r\n"
+        "WWW-Authenticate: Digest algorithm=MD5, realm=\"asterisk\", nonce=\"1f7c3e2a\", qop=\"auth\", opaque=\"5ccc069c\"\r\n"
+        "Content-Length: 0\r\n\r\n";
+}
+
+static std::string resp_407() {
+    return
+        "SIP/2.0 407 Proxy Authentication Required\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.5:5060;branch=z9hG4bK-7f3a9c1e2b4d6a80-1a2d;received=192.0.2.10;rport=5060\r\n"
+        "From: <sip:1001@example.com>;tag=7f3a9c1e\r\n"
+        "To: <sip:1001@example.com>;tag=3f6e1c2b-5a9d\r\n"
+        "Call-ID: 7f3a9c1e2b4d6a80-1a2d@frogklan\r\n"
+        "CSeq: 1 REGISTER\r\n"
+        "Proxy-Authenticate: Digest realm=\"carrier.example.net\", "
+        "nonce=\"Y2FmZWJhYmUtMTcwMDAwMDAwMC0xMjM0NTY3ODkw\", algorithm=MD5, qop=\"auth,auth-int\", stale=FALSE\r\n"
+        "Content-Length: 0\r\n\r\n";
+}
+
+// OPTIONS answered with a capabilities body, as some SBCs do.
+static std::string resp_200_sdp() {
+    std::string sdp =
+        "v=0\r\n"
+        "o=- 1700000000 1700000000 IN IP4 198.51.100.20\r\n"
+        "s=-\r\n"
+        "c=IN IP4 198.51.100.20\r\n"
+        "t=0 0\r\n"
+        "m=audio 0 RTP/AVP 0 8 9 18 101\r\n"
+        "a=rtpmap:0 PCMU/8000\r\n"
+        "a=rtpmap:8 PCMA/8000\r\n"
+        "a=rtpmap:9 G722/8000\r\n"
+        "a=rtpmap:18 G729/8000\r\n"
+        "a=rtpmap:101 telephone-event/8000\r\n"
+        "a=fmtp:101 0-16\r\n";
+    return
+        "SIP/2.0 200 OK\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.5:5060;branch=z9hG4bK-7f3a9c1e2b4d6a80-1a2e;received=192.0.2.10;rport=5060\r\n"
+        "From: <sip:qa@example.com>;tag=7f3a9c1e\r\n"
+        "To: <sip:qa@example.com>;tag=sbc-91c2\r\n"
+        "Call-ID: 7f3a9c1e2b4d6a80-1a2e@frogklan\r\n"
+        "CSeq: 1 OPTIONS\r\n"
+        "Contact: <sip:198.51.100.20:5060>\r\n"
+        "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, UPDATE, PRACK\r\n"
+        "Accept: application/sdp\r\n"
+        "Content-Type: application/sdp\r\n"
+        "Content-Length: " + std::to_string(sdp.size()) + "\r\n\r\n" + sdp;
+}
+
+// n Via and n Record-Route headers, as seen behind a chain of proxies.
+static std::string resp_large(int n) {
+    std::string s = "SIP/2.0 200 OK\r\n";
+    for (int i = 0; i < n; i++) {
+        s += "Via: SIP/2.0/UDP proxy" + std::to_string(i) + ".carrier.example.net:5060;branch=z9hG4bK"
+             + std::to_string(1000 + i) + "abcdef;received=198.51.100." + std::to_string(i) + "\r\n";
+    }
+    for (int i = 0; i < n; i++) {
+        s += "Record-Route: <sip:edge" + std::to_string(i) + ".carrier.example.net;lr;transport=udp>\r\n";
+    }
+    s += "From: <sip:qa@example.com>;tag=7f3a9c1e\r\n"
+         "To: <sip:qa@example.com>;tag=as5b1c7d2e\r\n"
+         "Call-ID: 7f3a9c1e2b4d6a80-1a2b@frogklan\r\n"
+         "CSeq: 1 OPTIONS\r\n"
+         "Content-Length: 0\r\n\r\n";
+    return s;
+}
+
+static bool write_json(const char* path) {
+    std::ofstream f(path);
+    if (!f) return false;
+    f << "{\n  \"app\": \"" << APP_NAME << "\",\n  \"version\": \"" << APP_VERSION << "\",\n"
+      << "  \"md5_batch_backend\": \"" << md5_batch_backend() << "\",\n  \"benchmarks\": [";
+    const auto& all = bench_results();
+    for (size_t i = 0; i < all.size(); i++) {
+        const auto& b = all[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"name\": \"%s\", \"iters\": %zu, \"reps\": %d, \"ns_per_op\": %.2f, "
+                      "\"ns_per_op_min\": %.2f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}",
+                      i ? "," : "", b.name.c_str(), b.iters, b.reps, b.ns_median, b.ns_min,
+                      b.allocs_per_op, b.bytes_per_op);
+        f << line;
+    }
+    f << "\n  ]\n}\n";
+    return (bool)f;
+}
+
+static int run_all();
+
+int main(int argc, char** argv) {
+    const char* json_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--reps" && i + 1 < argc) g_bench_reps = std::atoi(argv[++i]);
+        else if (a == "--json" && i + 1 < argc) json_path = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: frogklan_bench [--reps 3] [--json <file>]\n");
+            return 2;
+        }
+    }
+    int rc = run_all();
+    if (rc == 0 && json_path && !write_json(json_path)) {
+        std::fprintf(stderr, "cannot write %s\n", json_path);
+        return 1;
+    }
+    return rc;
+}
+
+static int run_all() {
+    struct Case { const char* name; std::string msg; };
+    std::vector<Case> corpus = {
+        {"200_ok", resp_200_ok()},
+        {"200_ok_sdp", resp_200_sdp()},
+        {"401_challenge", resp_401()},
+        {"407_challenge", resp_407()},
+        {"large_24_route", resp_large(12)},
+        {"large_64_route", resp_large(32)},
+    };
+
+    const size_t iters = 200000;
+    for (const auto& c : corpus) {
+        std::string label = std::string("parse_sip_response/") + c.name;
+        bench(label.c_str(), iters, [&]{
+            auto r = parse_sip_response(c.msg);
+            g_sink = r.headers_lc.size() + (size_t)r.status;
+        });
+
+        SipResponseView v;
+        label = std::string("parse_sip_response_view/") + c.name;
+        bench(label.c_str(), iters, [&]{
+            parse_sip_response_view(c.msg.data(), c.msg.size(), &v);
+            g_sink = v.header_count + (size_t)v.status + sip_top_via_branch(v).size();
+        });
+    }
+
+    // Folded headers: the captured Via and challenge must span every line.
+    {
+        const std::string folded =
+            "SIP/2.0 401 Unauthorized\r\n"
+            "Via: SIP/2.0/UDP 10.0.0.1:5060\r\n"
+            " ;branch=z9hG4bKfold1;rport\r\n"
+            "Call-ID: fold@x\r\n"
+            "CSeq: 1 REGISTER\r\n"
+            "WWW-Authenticate: Digest realm=\"asterisk\",\r\n"
+            "\tnonce=\"f01d\", qop=\"auth\"\r\n"
+            "Content-Length: 0\r\n\r\n";
+        SipResponseView v;
+        parse_sip_response_view(folded.data(), folded.size(), &v);
+        SipAuthChallenge ch = parse_www_authenticate_digest(v);
+        if (sip_top_via_branch(v) != "z9hG4bKfold1" || !ch.ok || ch.nonce != "f01d" || ch.qop != "auth") {
+            std::fprintf(stderr, "parse_sip_response_view truncates folded headers\n");
+            return 1;
+        }
+    }
+
+    // Challenge parsing, from a parsed response (the qa path) and a view (storm).
+    for (const auto& c : corpus) {
+        if (c.msg.compare(8, 1, "4") != 0) continue;
+        const SipResponse full = parse_sip_response(c.msg);
+        SipResponseView v;
+        parse_sip_response_view(c.msg.data(), c.msg.size(), &v);
+        if (!parse_www_authenticate_digest(full).ok || !parse_www_authenticate_digest(v).ok) {
+            std::fprintf(stderr, "parse_www_authenticate_digest failed on %s\n", c.name);
+            return 1;
+        }
+        std::string label = std::string("parse_www_authenticate_digest/") + c.name;
+        bench(label.c_str(), iters, [&]{
+            g_sink = parse_www_authenticate_digest(full).nonce.size();
+        });
+        label = std::string("parse_www_authenticate_digest_view/") + c.name;
+        bench(label.c_str(), iters, [&]{
+            g_sink = parse_www_authenticate_digest(v).nonce.size();
+        });
+    }
+
+    // Request construction: fresh ostringstream build vs. pre-rendered template.
+    const std::string host = "sip.example.com", from = "sip:qa@example.com", to = "sip:qa@example.com";
+    const std::string ua = "frogklan-sip-qa/bench";
+    const std::string call_id = "7f3a9c1e2b4d6a80-1a2b@frogklan", branch = "z9hG4bK-7f3a9c1e2b4d6a80-1a2b";
+    const std::string tag = "7f3a9c1e", auth = "Digest username=\"1001\", realm=\"asterisk\", nonce=\"1f7c3e2a\", "
+        "uri=\"sip:sip.example.com\", response=\"6629fae49393a05397450978507c4ef1\", algorithm=MD5";
+
+    auto opt_tpl = SipRequestTemplate::options(host, 5060, from, to, ua);
+    auto reg_tpl = SipRequestTemplate::reg(host, 5060, "sip:1001@example.com", "sip:1001@10.0.0.5", ua, 300);
+    SipRequestTemplate::Fields f;
+    f.branch = branch; f.tag = tag; f.call_id = call_id; f.cseq = 2;
+    std::string out;
+
+    // The template must reproduce the builders byte for byte.
+    opt_tpl.render(f, out);
+    if (out != make_sip_options(host, 5060, from, to, ua, call_id, 2, branch, tag)) {
+        std::fprintf(stderr, "SipRequestTemplate::options output differs from make_sip_options\n");
+        return 1;
+    }
+    f.authorization = auth;
+    reg_tpl.render(f, out);
+    if (out != make_sip_register(host, 5060, "sip:1001@example.com", "sip:1001@10.0.0.5", ua,
+                                 call_id, 2, branch, tag, 300, auth)) {
+        std::fprintf(stderr, "SipRequestTemplate::reg output differs from make_sip_register\n");
+        return 1;
+    }
+    f.authorization = {};
+
+    bench("make_sip_options", iters, [&]{
+        g_sink = make_sip_options(host, 5060, from, to, ua, call_id, 2, branch, tag).size();
+    });
+    bench("SipRequestTemplate::options", iters, [&]{
+        g_sink = opt_tpl.render(f, out);
+    });
+    bench("make_sip_register/auth", iters, [&]{
+        g_sink = make_sip_register(host, 5060, "sip:1001@example.com", "sip:1001@10.0.0.5", ua,
+                                   call_id, 2, branch, tag, 300, auth).size();
+    });
+    f.authorization = auth;
+    bench("SipRequestTemplate::reg/auth", iters, [&]{
+        g_sink = reg_tpl.render(f, out);
+    });
+
+    // Batched MD5: every length across the 1- and 2-block padding edges, in a
+    // group size that leaves partially filled lanes, must match the MD5 class.
+    std::vector<std::string> md5_msgs;
+    for (size_t len = 0; len < 200; len++) {
+        std::string m(len, '\0');
+        for (size_t i = 0; i < len; i++) m[i] = (char)('a' + (len * 7 + i * 13) % 26);
+        md5_msgs.push_back(m);
+    }
+    std::vector<std::string_view> md5_views(md5_msgs.begin(), md5_msgs.end());
+    std::vector<uint8_t> digests(md5_views.size() * 16);
+    md5_batch(md5_views.data(), md5_views.size(), reinterpret_cast<uint8_t(*)[16]>(digests.data()));
+    for (size_t i = 0; i < md5_msgs.size(); i++) {
+        if (MD5::hex(&digests[i * 16], 16) != MD5::md5_hex(md5_msgs[i])) {
+            std::fprintf(stderr, "md5_batch (%s) differs from MD5 for length %zu\n", md5_batch_backend(), i);
+            return 1;
+        }
+    }
+
+    SipAuthChallenge ch;
+    ch.ok = true; ch.realm = "asterisk"; ch.nonce = "1f7c3e2a"; ch.qop = "auth"; ch.opaque = "5ccc069c";
+    SipAuthChallenge ch_noqop = ch;
+    ch_noqop.qop.clear();
+    const size_t kDigests = 64;
+    std::vector<std::string> users(kDigests), passes(kDigests), cnonces(kDigests);
+    std::vector<SipDigestInput> din(kDigests);
+    for (size_t i = 0; i < kDigests; i++) {
+        users[i] = std::to_string(100000 + i);
+        passes[i] = "secret-" + std::to_string(i * 31);
+        cnonces[i] = "c" + std::to_string(i);
+        din[i] = SipDigestInput{"REGISTER", "sip:sip.example.com", users[i], passes[i],
+                                (i % 5) ? &ch : &ch_noqop, cnonces[i], "00000001", {}};
+    }
+    std::vector<std::string> dout(kDigests);
+    build_digest_authorization_batch(din.data(), kDigests, dout.data());
+    for (size_t i = 0; i < kDigests; i++) {
+        std::string one = build_digest_authorization("REGISTER", "sip:sip.example.com", users[i], passes[i],
+                                                     *din[i].ch, cnonces[i], "00000001");
+        if (one != dout[i]) {
+            std::fprintf(stderr, "build_digest_authorization_batch differs at %zu\n", i);
+            return 1;
+        }
+    }
+
+    std::printf("md5_batch backend: %s\n", md5_batch_backend());
+    std::vector<uint8_t> stream(1400);
+    for (size_t i = 0; i < stream.size(); i++) stream[i] = (uint8_t)(i * 31);
+    bench("MD5::update 1400B (64B chunks)", iters / 16, [&]{
+        MD5 m;
+        for (size_t off = 0; off < stream.size(); off += 64) {
+            m.update(stream.data() + off, std::min<size_t>(64, stream.size() - off));
+        }
+        uint8_t d[16];
+        m.final_raw(d);
+        g_sink = d[0];
+    });
+    std::vector<std::string_view> md5_64(kDigests, std::string_view(md5_msgs[60]));
+    bench("MD5::md5_hex x64 (60B)", iters / 64, [&]{
+        size_t t = 0;
+        for (auto v : md5_64) t += MD5::md5_hex(std::string(v)).size();
+        g_sink = t;
+    });
+    bench("md5_batch x64 (60B)", iters / 64, [&]{
+        md5_batch(md5_64.data(), md5_64.size(), reinterpret_cast<uint8_t(*)[16]>(digests.data()));
+        g_sink = digests[0];
+    });
+    bench("build_digest_authorization x64", iters / 64, [&]{
+        size_t t = 0;
+        for (size_t i = 0; i < kDigests; i++) {
+            t += build_digest_authorization("REGISTER", "sip:sip.example.com", users[i], passes[i],
+                                            *din[i].ch, cnonces[i], "00000001").size();
+        }
+        g_sink = t;
+    });
+    bench("build_digest_authorization_batch x64", iters / 64, [&]{
+        build_digest_authorization_batch(din.data(), kDigests, dout.data());
+        g_sink = dout[0].size();
+    });
+    std::vector<std::string> ha1s(kDigests);
+    std::vector<SipDigestInput> din_ha1 = din;
+    for (size_t i = 0; i < kDigests; i++) {
+        ha1s[i] = MD5::md5_hex(users[i] + ":" + din[i].ch->realm + ":" + passes[i]);
+        din_ha1[i].ha1_hex = ha1s[i];
+    }
+    std::vector<std::string> dout_ha1(kDigests);
+    build_digest_authorization_batch(din_ha1.data(), kDigests, dout_ha1.data());
+    if (dout_ha1 != dout) {
+        std::fprintf(stderr, "build_digest_authorization_batch with cached HA1 differs\n");
+        return 1;
+    }
+    bench("build_digest_authorization_batch x64 (HA1)", iters / 64, [&]{
+        build_digest_authorization_batch(din_ha1.data(), kDigests, dout_ha1.data());
+        g_sink = dout_ha1[0].size();
+    });
+
+    if (int rc = run_id_benchmarks()) return rc;
+    if (int rc = run_monitor_benchmarks()) return rc;
+    if (int rc = run_metrics_benchmarks()) return rc;
+    if (int rc = run_resultlog_benchmarks()) return rc;
+    if (int rc = run_responder_benchmarks()) return rc;
+    if (int rc = run_tcp_benchmarks()) return rc;
+    if (int rc = run_calls_benchmarks()) return rc;
+    if (int rc = run_scenario_benchmarks()) return rc;
+    if (int rc = run_capacity_benchmarks()) return rc;
+    if (int rc = run_replay_benchmarks()) return rc;
+    if (int rc = run_timer_benchmarks()) return rc;
+    return run_net_benchmarks();
+}
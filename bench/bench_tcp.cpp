@@ -0,0 +1,147 @@
+// SIP over TCP: SipStreamFramer on a stream cut at every possible point,
+// then transactions and pipelined open-loop load against the local
+// responder's TCP listener.
+#include "bench.h"
+#include "load.h"
+#include "responder.h"
+#include "sip.h"
+#include "tcp_transport.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+bool fail(const char* what) {
+    std::fprintf(stderr, "tcp bench: %s\n", what);
+    return false;
+}
+
+std::vector<std::string> stream_messages() {
+    const std::string sdp = "v=0\r\no=- 1 1 IN IP4 10.0.0.1\r\ns=-\r\nc=IN IP4 10.0.0.1\r\nt=0 0\r\n";
+    return {
+        "SIP/2.0 100 Trying\r\nVia: SIP/2.0/TCP a;branch=z9hG4bK1\r\nContent-Length: 0\r\n\r\n",
+        "SIP/2.0 200 OK\r\nVia: SIP/2.0/TCP a;branch=z9hG4bK1\r\nContent-Type: application/sdp\r\n"
+        "Content-Length: " + std::to_string(sdp.size()) + "\r\n\r\n" + sdp,
+        // compact form, odd spacing, and a body that itself holds CRLFCRLF
+        "SIP/2.0 200 OK\r\nv: SIP/2.0/TCP a;branch=z9hG4bK2\r\nL :  8\r\n\r\n\r\n\r\nabcd",
+        // no Content-Length at all: an empty body
+        "OPTIONS sip:b SIP/2.0\r\nVia: SIP/2.0/TCP a;branch=z9hG4bK3\r\nMax-Forwards: 70\r\n\r\n",
+    };
+}
+
+bool check_framer() {
+    auto msgs = stream_messages();
+    std::string stream = "\r\n\r\n";  // keepalive ahead of the first message
+    for (auto& m : msgs) stream += m + "\r\n";
+
+    // Every chunk size from a byte at a time up to the whole stream.
+    for (size_t chunk = 1; chunk <= stream.size(); chunk++) {
+        SipStreamFramer f;
+        std::vector<std::string> got;
+        std::string_view m;
+        for (size_t off = 0; off < stream.size(); off += chunk) {
+            f.append(stream.data() + off, std::min(chunk, stream.size() - off));
+            while (f.next(&m)) got.emplace_back(m);
+        }
+        if (got != msgs || f.broken()) return fail("framed messages differ from those sent");
+    }
+
+    SipStreamFramer f;
+    std::string_view m;
+    std::string junk(SipStreamFramer::kMaxHeader + 1, 'x');
+    f.append(junk.data(), junk.size());
+    if (f.next(&m) || !f.broken()) return fail("an endless header was not flagged");
+    f.reset();
+    const std::string bad = "SIP/2.0 200 OK\r\nContent-Length: 12x\r\n\r\n";
+    f.append(bad.data(), bad.size());
+    if (f.next(&m) || !f.broken()) return fail("a bad Content-Length was not flagged");
+    return true;
+}
+
+bool check_transactions(uint16_t port) {
+    UdpAddr dst;
+    resolve_udp_addr("127.0.0.1", port, &dst);
+    SipTcpConnection c;
+    int64_t connect_us = -1;
+    if (!c.connect(dst, 1000, &connect_us) || connect_us < 0) return fail("cannot connect to the responder");
+
+    // Pipelined: every request goes out before any answer is read, and each
+    // answer is found by its own branch.
+    std::vector<std::string> reqs;
+    for (int i = 0; i < 32; i++) {
+        reqs.push_back(make_sip_options("127.0.0.1", port, "sip:qa@example.com", "sip:qa@example.com", "bench",
+                                        "tcp-" + std::to_string(i) + "@frogklan", 1,
+                                        "z9hG4bKtcp" + std::to_string(i), "t1", SipTransport::Tcp));
+        if (reqs.back().find("Via: SIP/2.0/TCP ") == std::string::npos) return fail("Via does not name TCP");
+    }
+    for (size_t i = 0; i + 1 < reqs.size(); i++) {
+        if (!c.send(reqs[i])) return fail("pipelined send failed");
+    }
+    // The last request's answer comes after all the others; request() skips
+    // them on the way.
+    UdpReply rep = c.request(reqs.back(), 1000);
+    SipResponse resp = parse_sip_response(rep.data);
+    if (!rep.ok || resp.status != 200 || sip_top_via_branch(resp) != "z9hG4bKtcp31" || rep.elapsed_ns <= 0) {
+        return fail("pipelined OPTIONS were not answered in order");
+    }
+    rep = c.request(reqs[0], 1000);
+    if (!rep.ok || sip_top_via_branch(parse_sip_response(rep.data)) != "z9hG4bKtcp0") {
+        return fail("the connection was not reusable");
+    }
+    return true;
+}
+
+} // namespace
+
+int run_tcp_benchmarks() {
+    if (!check_framer()) return 1;
+
+    std::string stream;
+    for (int i = 0; i < 64; i++) stream += stream_messages()[1];
+    bench("SipStreamFramer 64x 200_ok_sdp, 1460B", 2000, [&]{
+        static SipStreamFramer f;
+        std::string_view m;
+        size_t n = 0;
+        for (size_t off = 0; off < stream.size(); off += 1460) {
+            f.append(stream.data() + off, std::min<size_t>(1460, stream.size() - off));
+            while (f.next(&m)) n += m.size();
+        }
+        g_sink = n;
+    });
+
+    ResponderConfig cfg;
+    cfg.port = 0;
+    cfg.workers = 1;
+    cfg.tcp = true;
+    SipResponder r;
+    std::string err;
+    if (!r.start(cfg, &err)) {
+        std::fprintf(stderr, "tcp bench: %s\n", err.c_str());
+        return 1;
+    }
+    if (!check_transactions(r.port())) return 1;
+
+    LoadConfig lc;
+    lc.host = "127.0.0.1";
+    lc.port = r.port();
+    lc.from_uri = lc.to_uri = "sip:qa@example.com";
+    lc.user_agent = "bench";
+    lc.rate = 50000;
+    lc.duration_s = 1.0;
+    lc.transport = SipTransport::Tcp;
+    lc.connections = 4;
+    LoadResult lr = run_load(lc);
+    if (!lr.ok || lr.replies_2xx != lr.sent || lr.connect.count() != 4) {
+        std::fprintf(stderr, "tcp bench: load over TCP got %llu/%llu 200s (%s)\n",
+                     (unsigned long long)lr.replies_2xx, (unsigned long long)lr.sent, lr.error.c_str());
+        return 1;
+    }
+    r.stop();
+    double rate = lr.elapsed_s > 0 ? (double)lr.replies_2xx / lr.elapsed_s : 0;
+    std::printf("%-40s %10.0f 200/s (p99 %llu us, connect p50 %llu us)\n", "load OPTIONS -> responder, TCP x4", rate,
+                (unsigned long long)lr.service.percentile(99), (unsigned long long)lr.connect.percentile(50));
+    g_sink = (size_t)rate;
+    return 0;
+}
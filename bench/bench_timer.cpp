@@ -0,0 +1,162 @@
+// TimerWheel and the RFC 3261 retransmit schedule, driven by a virtual clock:
+// correctness checks first, then schedule/cancel/fire cost per timer.
+#include "bench.h"
+#include "sip_timers.h"
+#include "timer_wheel.h"
+
+#include <cstdio>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Random expiries spread over every level, a quarter cancelled, the clock
+// stepped unevenly: each live timer must fire exactly once, on the first
+// advance that reaches it, and next_delay_ms must never overshoot one.
+bool check_wheel() {
+    const size_t n = 200000;
+    const uint64_t span = 6ull * 3600 * 1000; // reaches the top level
+    std::mt19937_64 rng(12345);
+
+    TimerWheel w(1000);
+    std::vector<uint64_t> expires(n);
+    std::vector<TimerWheel::TimerId> ids(n);
+    std::vector<uint8_t> state(n, 0); // 0 pending, 1 cancelled, 2 fired
+    std::set<std::pair<uint64_t, size_t>> pending;
+    for (size_t i = 0; i < n; i++) {
+        // Bias towards the near future, where SIP timers live.
+        uint64_t d = (i % 4 == 0) ? rng() % span : rng() % 70000;
+        expires[i] = 1001 + d;
+        ids[i] = w.schedule(expires[i], i);
+        pending.insert({expires[i], i});
+    }
+    for (size_t i = 0; i < n; i += 4) {
+        if (!w.cancel(ids[i + 1])) { std::fprintf(stderr, "TimerWheel: cancel failed\n"); return false; }
+        if (w.cancel(ids[i + 1])) { std::fprintf(stderr, "TimerWheel: double cancel succeeded\n"); return false; }
+        state[i + 1] = 1;
+        pending.erase({expires[i + 1], i + 1});
+    }
+
+    std::vector<uint64_t> fired;
+    uint64_t prev = w.now();
+    while (!pending.empty()) {
+        uint64_t delay = w.next_delay_ms(~0ull);
+        if (pending.begin()->first < w.now() + delay) {
+            std::fprintf(stderr, "TimerWheel: next_delay_ms %llu overshoots a timer\n", (unsigned long long)delay);
+            return false;
+        }
+        uint64_t step = (rng() % 3 == 0) ? 1 + rng() % 5000 : 1 + rng() % 40;
+        if (delay > step && rng() % 2) step = delay; // also jump straight to the hint
+        fired.clear();
+        w.advance(prev + step, fired);
+        for (uint64_t c : fired) {
+            if (state[c] != 0 || expires[c] > w.now() || expires[c] <= prev) {
+                std::fprintf(stderr, "TimerWheel: timer %llu fired wrongly (expires %llu, window %llu..%llu)\n",
+                             (unsigned long long)c, (unsigned long long)expires[c],
+                             (unsigned long long)prev, (unsigned long long)w.now());
+                return false;
+            }
+            state[c] = 2;
+            pending.erase({expires[c], (size_t)c});
+        }
+        if (!pending.empty() && pending.begin()->first <= w.now()) {
+            std::fprintf(stderr, "TimerWheel: timer due at %llu did not fire by %llu\n",
+                         (unsigned long long)pending.begin()->first, (unsigned long long)w.now());
+            return false;
+        }
+        prev = w.now();
+    }
+    if (w.size() != 0) { std::fprintf(stderr, "TimerWheel: %zu timers left\n", w.size()); return false; }
+
+    // A time in the past fires on the very next advance, even a zero step.
+    w.schedule(w.now() - 5, 7);
+    fired.clear();
+    if (w.advance(w.now(), fired) != 1 || fired[0] != 7) {
+        std::fprintf(stderr, "TimerWheel: past-due timer did not fire immediately\n");
+        return false;
+    }
+    return true;
+}
+
+// Non-INVITE with defaults: sends at 0, .5, 1.5, 3.5, 7.5 s, then every 4 s
+// (Timer E capped at T2) until Timer F at 32 s.
+bool check_timer_e() {
+    SipTimers t;
+    TimerWheel w(0);
+    SipRetransmit r;
+    std::vector<uint64_t> sends;
+    std::vector<uint64_t> fired;
+    sends.push_back(0);
+    w.schedule(r.on_send(t, 0), 1);
+    uint64_t end = 0;
+    for (uint64_t now = 1; now <= 40000 && !end; now++) {
+        fired.clear();
+        if (!w.advance(now, fired)) continue;
+        if (r.expired(t, now)) { end = now; break; }
+        sends.push_back(now);
+        w.schedule(r.on_send(t, now), 1);
+    }
+    const std::vector<uint64_t> want = {0, 500, 1500, 3500, 7500, 11500, 15500, 19500, 23500, 27500, 31500};
+    if (sends != want || end != 32000 || r.retransmits() != 10) {
+        std::fprintf(stderr, "Timer E/F schedule wrong: %zu sends, timeout at %llu\n",
+                     sends.size(), (unsigned long long)end);
+        return false;
+    }
+
+    // With a retransmit cap the last wait runs straight to Timer F.
+    SipTimers capped;
+    capped.max_retransmits = 2;
+    SipRetransmit c;
+    if (c.on_send(capped, 0) != 500 || c.on_send(capped, 500) != 1500 || c.on_send(capped, 1500) != 32000) {
+        std::fprintf(stderr, "Timer E with --retries cap wrong\n");
+        return false;
+    }
+
+    // INVITE (Timer A) keeps doubling past T2.
+    SipRetransmit inv;
+    uint64_t at = 0, now = 0;
+    for (int i = 0; i < 5; i++) { at = inv.on_send(t, now, true); now = at; }
+    if (inv.interval_ms != 8000 || at != 15500) {
+        std::fprintf(stderr, "Timer A schedule wrong\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_timer_benchmarks() {
+    if (!check_wheel() || !check_timer_e()) return 1;
+
+    const size_t live = 100000;
+    TimerWheel w(0);
+    w.reserve(live * 2);
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < live; i++) w.schedule(1 + rng() % 32000, i);
+
+    std::vector<uint64_t> delays(4096);
+    for (auto& d : delays) d = 1 + rng() % 32000;
+    size_t k = 0;
+    bench("TimerWheel schedule+cancel (100k live)", 1000000, [&]{
+        auto id = w.schedule(w.now() + delays[k++ & 4095], 0);
+        g_sink = w.cancel(id);
+    });
+
+    // Steady state: every tick fires what is due and re-arms the same number,
+    // like a run holding 100k transactions open.
+    std::vector<uint64_t> fired;
+    size_t total = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < 64000; tick++) {
+        fired.clear();
+        w.advance(w.now() + 1, fired);
+        for (uint64_t c : fired) w.schedule(w.now() + delays[c & 4095], c);
+        total += fired.size();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)(total ? total : 1);
+    std::printf("%-40s %10.1f ns/op (%zu fired)\n", "TimerWheel fire+rearm (100k live)", ns, total);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "app.h"
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+const char* APP_NAME = "frogklan";
+const char* APP_VERSION = "1.0.0-qa";
+
+std::string os_name() {
+#if defined(_WIN32)
+    return "Windows";
+#elif defined(__APPLE__)
+    return "macOS";
+#elif defined(__linux__)
+    return "Linux";
+#else
+    return "Unknown";
+#endif
+}
+
+fs::path app_data_dir() {
+#if defined(_WIN32)
+    const char* p = std::getenv("APPDATA");
+    return fs::path(p ? p : fs::temp_directory_path().string()) / APP_NAME;
+#elif defined(__APPLE__)
+    const char* h = std::getenv("HOME");
+    return fs::path(h ? h : "/tmp") / "Library/Application Support" / APP_NAME;
+#else
+    const char* h = std::getenv("HOME");
+    return fs::path(h ? h : "/tmp") / (std::string(".") + APP_NAME);
+#endif
+}
+
+std::string json_escape(const std::string& s){
+    std::string o; o.reserve(s.size()+8);
+    for (char c: s){
+        switch(c){
+            case '\\': o += "\\\\"; break;
+            case '"': o += "\\\""; break;
+            case '\n': o += "\\n"; break;
+            case '\r': o += "\\r"; break;
+            case '\t': o += "\\t"; break;
+            default: o.push_back(c); break;
+        }
+    }
+    return o;
+}
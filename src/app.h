@@ -0,0 +1,10 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+extern const char* APP_NAME;
+extern const char* APP_VERSION;
+
+std::string os_name();
+std::filesystem::path app_data_dir();
+std::string json_escape(const std::string& s);
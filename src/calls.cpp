@@ -0,0 +1,415 @@
+#include "calls.h"
+#include "app.h"
+#include "dialog.h"
+#include "net.h"
+#include "resolver.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "sip_template.h"
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// The dialog's INVITE or BYE client transaction, kept beside its table slot.
+struct CallTxn {
+    bool retx_on = false;      // still unanswered: resent on Timer A/E
+    bool invite = false;       // ...and an INVITE: Timer A, ended by a 1xx
+    uint64_t deadline_ms = 0;  // no final by then fails the call
+    uint64_t retx_at_ms = 0;   // next retransmission
+    SipRetransmit retx;
+};
+
+} // namespace
+
+CallResult run_calls(const CallConfig& cfg) {
+    CallResult res;
+    if (cfg.rate <= 0 || cfg.duration_s <= 0) { res.error = "rate and duration must be positive"; return res; }
+    if (cfg.hold_ms < 0 || cfg.timeout_ms <= 0) { res.error = "hold must be >= 0 and timeout positive"; return res; }
+
+    UdpAddr dst;
+    if (!resolver_cache().resolve(cfg.host, cfg.port, &dst, &res.dns_us)) { res.error = "DNS resolution failed"; return res; }
+
+    int nsock = cfg.sockets < 1 ? 1 : cfg.sockets;
+    std::vector<std::unique_ptr<UdpSocket>> socks;
+    UdpPoller poller;
+    for (int i = 0; i < nsock; i++) {
+        auto s = std::make_unique<UdpSocket>();
+        if (!s->open(8 << 20) || !poller.add(*s)) { res.error = "Failed to open UDP socket"; return res; }
+        socks.push_back(std::move(s));
+    }
+
+    DialogTable table(cfg.max_dialogs);
+    std::vector<CallTxn> txns(table.capacity());
+    res.dialog_bytes = table.bytes() / table.capacity() + sizeof(CallTxn);
+    TimerWheel wheel(0);
+    wheel.reserve(table.capacity());
+    std::vector<uint64_t> fired;
+
+    const std::string sdp = "v=0\r\no=frogklan 1 1 IN IP4 " + cfg.media_ip + "\r\ns=-\r\nc=IN IP4 " + cfg.media_ip +
+                            "\r\nt=0 0\r\nm=audio 40000 RTP/AVP 0 8\r\na=rtpmap:0 PCMU/8000\r\na=rtpmap:8 PCMA/8000\r\n";
+    const auto invite_tpl = SipRequestTemplate::invite(cfg.host, cfg.port, cfg.from_uri, cfg.to_uri, cfg.user_agent, sdp);
+    const auto ack_tpl = SipRequestTemplate::in_dialog("ACK", cfg.host, cfg.port, cfg.from_uri, cfg.to_uri, cfg.user_agent);
+    const auto bye_tpl = SipRequestTemplate::in_dialog("BYE", cfg.host, cfg.port, cfg.from_uri, cfg.to_uri, cfg.user_agent);
+
+    // Outgoing requests are staged and sent a batch at a time. A receive
+    // batch stages at most one ACK per reply, so twice the batch size never
+    // fills up part way through one.
+    UdpBatch io;
+    if (cfg.uring && io.use_uring() && !poller.use(io)) { res.error = "io_uring setup failed"; return res; }
+    res.uring = io.uring();
+    const size_t kBatch = io.max_batch();
+    std::vector<std::string> msgs(2 * kBatch);
+    std::vector<UdpDatagram> dgrams(2 * kBatch);
+    size_t nout = 0;
+    uint64_t batch_no = 0;
+    auto flush = [&] {
+        size_t off = 0;
+        while (off < nout) {
+            size_t n = std::min(kBatch, nout - off);
+            int r = io.send(*socks[batch_no++ % (uint64_t)nsock], dgrams.data() + off, n);
+            if (r <= 0) break;
+            off += (size_t)r;
+        }
+        res.send_errors += nout - off;
+        nout = 0;
+    };
+    auto stage = [&](const SipRequestTemplate& tpl, const SipRequestTemplate::Fields& f) {
+        if (nout == msgs.size()) flush();
+        tpl.render(f, msgs[nout]);
+        dgrams[nout] = UdpDatagram{dst, msgs[nout].data(), msgs[nout].size()};
+        nout++;
+    };
+
+    char idbuf[kSipBranchLen];
+    char tagbuf[kSipTagHex];
+    char cidbuf[kSipIdHex + 9];
+    std::memcpy(cidbuf + kSipIdHex, "@frogklan", 9);
+
+    auto in_dialog = [&](const SipRequestTemplate& tpl, Dialog& d, int cseq, std::string_view branch) {
+        SipRequestTemplate::Fields f;
+        f.branch = branch;
+        f.tag = d.local_tag_view();
+        f.call_id = d.call_id_view();
+        f.cseq = cseq;
+        f.to_tag = d.remote_tag_view();
+        stage(tpl, f);
+    };
+    // INVITE and BYE are rendered again from the dialog for each
+    // retransmission; the same fields give the same bytes.
+    auto send_invite = [&](Dialog& d) {
+        SipRequestTemplate::Fields f;
+        f.branch = d.branch_view();
+        f.tag = d.local_tag_view();
+        f.call_id = d.call_id_view();
+        f.cseq = 1;
+        stage(invite_tpl, f);
+    };
+    auto send_bye = [&](Dialog& d) { in_dialog(bye_tpl, d, 2, d.branch_view()); };
+    // Starts Timer A/E for the request just staged; the dialog's timer wakes
+    // for the next retransmission or the deadline, whichever comes first.
+    auto arm = [&](Dialog* d, uint64_t now_ms, bool invite) {
+        const uint32_t idx = table.index_of(d);
+        CallTxn& t = txns[idx];
+        t = CallTxn{};
+        t.retx_on = true;
+        t.invite = invite;
+        t.deadline_ms = now_ms + (uint64_t)cfg.timeout_ms;
+        t.retx_at_ms = t.retx.on_send(cfg.timers, now_ms, invite);
+        d->timer = wheel.schedule(std::min(t.retx_at_ms, t.deadline_ms), idx);
+    };
+    auto finish = [&](Dialog* d) {
+        if (d->timer) wheel.cancel(d->timer);
+        table.erase(d);
+    };
+
+    const uint64_t total = (uint64_t)std::llround(cfg.rate * cfg.duration_s);
+    const std::chrono::duration<double> interval(1.0 / cfg.rate);
+    const auto start = Clock::now() + std::chrono::milliseconds(10);
+
+    SipResponseView resp;
+    std::vector<int> ready;
+    uint64_t seq = 0;
+
+    auto on_reply = [&](const char* data, size_t len, uint64_t t_us) {
+        if (!parse_sip_response_view(data, len, &resp)) { res.stray++; return; }
+        Dialog* d = table.find(resp.call_id, sip_header_tag(resp.header("from", "f")));
+        if (!d) { res.stray++; return; }
+        std::string_view method = sip_cseq_method(resp.cseq);
+        const uint64_t now_ms = t_us / 1000;
+
+        if (method == "INVITE") {
+            if (d->state == DialogState::Confirmed || d->state == DialogState::Terminating) {
+                // A retransmitted 2xx: our ACK went missing, send another.
+                if (resp.status >= 200 && resp.status < 300) {
+                    sip_id_branch(idbuf);
+                    in_dialog(ack_tpl, *d, 1, std::string_view(idbuf, kSipBranchLen));
+                }
+                return;
+            }
+            if (sip_top_via_branch(resp) != d->branch_view()) { res.stray++; return; }
+            if (resp.status < 200) {
+                if (resp.status >= 180 && !d->ring_us) d->ring_us = t_us;
+                d->state = DialogState::Proceeding;
+                txns[table.index_of(d)].retx_on = false;
+                return;
+            }
+            res.invite_status[resp.status]++;
+            std::string_view to_tag = sip_header_tag(resp.header("to", "t"));
+            if (resp.status >= 300) {
+                // The ACK for a failure shares the INVITE's branch (RFC 3261 17.1.1.3).
+                res.rejected++;
+                if (d->set_remote_tag(to_tag)) in_dialog(ack_tpl, *d, 1, d->branch_view());
+                finish(d);
+                return;
+            }
+            if (to_tag.empty() || !d->set_remote_tag(to_tag)) {
+                // No usable dialog ID: the call cannot be ACKed or ended.
+                res.rejected++;
+                finish(d);
+                return;
+            }
+            res.answered++;
+            d->answer_us = t_us;
+            res.answer.record(t_us - d->invite_us);
+            res.pdd.record((d->ring_us ? d->ring_us : t_us) - d->invite_us);
+            sip_id_branch(idbuf);
+            in_dialog(ack_tpl, *d, 1, std::string_view(idbuf, kSipBranchLen));
+            d->state = DialogState::Confirmed;
+            wheel.cancel(d->timer);
+            d->timer = wheel.schedule(now_ms + (uint64_t)cfg.hold_ms, table.index_of(d));
+            return;
+        }
+        if (method == "BYE") {
+            if (d->state != DialogState::Terminating || sip_top_via_branch(resp) != d->branch_view()) {
+                res.stray++;
+                return;
+            }
+            if (resp.status < 200) return;
+            res.bye.record(t_us - d->bye_us);
+            if (resp.status < 300) res.completed++;
+            else res.bye_failed++;
+            finish(d);
+            return;
+        }
+        res.stray++;
+    };
+
+    for (;;) {
+        auto now = Clock::now();
+        const uint64_t now_us = us_between(start, now);
+
+        // Every call due by now is placed.
+        while (seq < total) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(interval * (double)seq);
+            if (due > now) break;
+            seq++;
+            res.attempted++;
+            sip_id_unique(cidbuf);
+            sip_id_tag(tagbuf);
+            Dialog* d = table.insert(std::string_view(cidbuf, sizeof(cidbuf)), std::string_view(tagbuf, kSipTagHex));
+            if (!d) { res.table_full++; continue; }
+            sip_id_branch(d->branch);
+            d->invite_us = now_us;
+            send_invite(*d);
+            arm(d, now_us / 1000, true);
+            res.invites_sent++;
+            if (table.size() > res.peak_dialogs) res.peak_dialogs = table.size();
+        }
+
+        // Hold expiries send BYE; an unanswered INVITE or BYE is resent while
+        // Timer A/E runs and fails the call at its deadline.
+        fired.clear();
+        const uint64_t now_ms = now_us / 1000;
+        wheel.advance(now_ms, fired);
+        for (uint64_t idx : fired) {
+            Dialog* d = table.at((uint32_t)idx);
+            CallTxn& t = txns[idx];
+            d->timer = 0;
+            if (d->state == DialogState::Confirmed) {
+                sip_id_branch(d->branch);
+                d->bye_us = now_us;
+                d->state = DialogState::Terminating;
+                send_bye(*d);
+                arm(d, now_ms, false);
+            } else if (now_ms < t.deadline_ms) {
+                if (t.retx_on && t.retx.expired(cfg.timers, now_ms)) {
+                    t.retx_on = false;
+                } else if (t.retx_on && now_ms >= t.retx_at_ms) {
+                    if (t.invite) send_invite(*d);
+                    else send_bye(*d);
+                    t.retx_at_ms = t.retx.on_send(cfg.timers, now_ms, t.invite);
+                    res.retransmits++;
+                }
+                d->timer = wheel.schedule(t.retx_on ? std::min(t.retx_at_ms, t.deadline_ms) : t.deadline_ms, idx);
+            } else {
+                if (d->state == DialogState::Terminating) res.bye_timeouts++;
+                else res.invite_timeouts++;
+                table.erase(d);
+            }
+        }
+        flush();
+
+        if (seq >= total && table.size() == 0) break;
+
+        int wait_ms = (int)wheel.next_delay_ms(1000);
+        if (seq < total) {
+            auto next = start + std::chrono::duration_cast<Clock::duration>(interval * (double)seq);
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+            if (ms < wait_ms) wait_ms = ms < 0 ? 0 : (int)ms;
+        }
+        if (poller.wait(wait_ms, ready) < 0) { res.error = "poll failed"; break; }
+
+        for (int si : ready) {
+            int n;
+            while ((n = io.recv(*socks[si])) > 0) {
+                auto batch_t = Clock::now();
+                for (int i = 0; i < n; i++) {
+                    const auto& dg = io.at(i);
+                    on_reply(dg.data, dg.len, us_between(start, udp_rx_time(dg, batch_t)));
+                }
+                flush();
+            }
+        }
+    }
+
+    res.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void calls_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan calls --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                 --rate <calls/s> --duration <seconds> [--hold 10000] [--timeout 32000]\n"
+"                 [--sockets 1] [--max-dialogs 200000] [--media-ip 127.0.0.1]\n"
+"                 [--t1 500] [--t2 4000] [--io-uring]\n"
+"\n"
+"Places calls at a constant rate: INVITE with an SDP offer, ACK on answer,\n"
+"BYE after --hold ms. Reports post-dial delay (INVITE to first 18x), answer\n"
+"latency (INVITE to 2xx) and BYE latency. Signaling only: no media is sent.\n"
+"INVITE and BYE are retransmitted on Timer A/E (--t1, --t2) until answered,\n"
+"for at most --timeout ms.\n"
+"--io-uring moves UDP onto io_uring (Linux 6.0+) where the kernel has it.\n"
+"\n"
+"Example:\n"
+"  frogklan calls --host 10.0.0.5 --from sip:qa@ex.com --to sip:echo@ex.com --rate 500 --duration 60\n";
+}
+
+int cmd_calls(int argc, char** argv) {
+    CallConfig cfg;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--host") cfg.host = need("--host");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--from") cfg.from_uri = need("--from");
+        else if (a == "--to") cfg.to_uri = need("--to");
+        else if (a == "--rate") cfg.rate = std::stod(need("--rate"));
+        else if (a == "--duration") cfg.duration_s = std::stod(need("--duration"));
+        else if (a == "--hold") cfg.hold_ms = std::stoi(need("--hold"));
+        else if (a == "--timeout") cfg.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--t1") cfg.timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") cfg.timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--sockets") cfg.sockets = std::stoi(need("--sockets"));
+        else if (a == "--max-dialogs") cfg.max_dialogs = (size_t)std::stoull(need("--max-dialogs"));
+        else if (a == "--media-ip") cfg.media_ip = need("--media-ip");
+        else if (a == "--io-uring") cfg.uring = true;
+        else if (a == "--help") { calls_usage(); return 0; }
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (cfg.host.empty() || cfg.from_uri.empty() || cfg.to_uri.empty()) {
+        std::cerr << "Missing required args.\n";
+        calls_usage();
+        return 2;
+    }
+    if (cfg.timers.t1_ms <= 0 || cfg.timers.t2_ms < cfg.timers.t1_ms) {
+        std::cerr << "--t1 must be positive and --t2 at least --t1\n";
+        return 2;
+    }
+    cfg.user_agent = "frogklan-sip-qa/" + std::string(APP_VERSION);
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_calls_report.json";
+
+    CallResult r = run_calls(cfg);
+    if (!r.ok) {
+        std::cerr << "calls: " << r.error << "\n";
+        return 3;
+    }
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.host) << "\", \"port\": " << cfg.port << "},\n"
+"  \"rate_target\": " << cfg.rate << ",\n"
+"  \"hold_ms\": " << cfg.hold_ms << ",\n"
+"  \"dns_us\": " << r.dns_us << ",\n"
+"  \"elapsed_s\": " << r.elapsed_s << ",\n"
+"  \"attempted\": " << r.attempted << ",\n"
+"  \"table_full\": " << r.table_full << ",\n"
+"  \"invites_sent\": " << r.invites_sent << ",\n"
+"  \"send_errors\": " << r.send_errors << ",\n"
+"  \"retransmits\": " << r.retransmits << ",\n"
+"  \"answered\": " << r.answered << ",\n"
+"  \"rejected\": " << r.rejected << ",\n"
+"  \"invite_timeouts\": " << r.invite_timeouts << ",\n"
+"  \"completed\": " << r.completed << ",\n"
+"  \"bye_failed\": " << r.bye_failed << ",\n"
+"  \"bye_timeouts\": " << r.bye_timeouts << ",\n"
+"  \"stray\": " << r.stray << ",\n"
+"  \"peak_dialogs\": " << r.peak_dialogs << ",\n"
+"  \"dialog_bytes\": " << r.dialog_bytes << ",\n"
+"  \"udp_io\": \"" << (r.uring ? "io_uring" : "mmsg") << "\",\n"
+"  \"invite_status\": {";
+    bool first = true;
+    for (auto& kv : r.invite_status) {
+        f << (first ? "" : ", ") << "\"" << kv.first << "\": " << kv.second;
+        first = false;
+    }
+    f << "},\n  \"pdd_us\": ";
+    json_hist(f, r.pdd);
+    f << ",\n  \"answer_us\": ";
+    json_hist(f, r.answer);
+    f << ",\n  \"bye_us\": ";
+    json_hist(f, r.bye);
+    f << "\n}\n";
+    f.close();
+
+    std::cout << "SIP calls report: " << report_path << "\n";
+    if (cfg.uring && !r.uring) std::cout << "io_uring unavailable here; ran on recvmmsg/sendmmsg\n";
+    std::cout << "calls: attempted=" << r.attempted << " answered=" << r.answered << " rejected=" << r.rejected
+              << " invite_timeouts=" << r.invite_timeouts << " completed=" << r.completed
+              << " bye_timeouts=" << r.bye_timeouts << " table_full=" << r.table_full
+              << " stray=" << r.stray << " retransmits=" << r.retransmits << "\n";
+    std::cout << "peak_dialogs=" << r.peak_dialogs << " (" << r.dialog_bytes << " bytes per dialog slot)\n";
+    print_hist(std::cout, "pdd_us    (INVITE -> first 18x)", r.pdd);
+    print_hist(std::cout, "answer_us (INVITE -> 2xx)      ", r.answer);
+    print_hist(std::cout, "bye_us    (BYE -> final)       ", r.bye);
+    return 0;
+}
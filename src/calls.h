@@ -0,0 +1,61 @@
+#pragma once
+#include "histogram.h"
+#include "sip_timers.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+struct CallConfig {
+    std::string host;
+    uint16_t port = 5060;
+    std::string from_uri;
+    std::string to_uri;
+    std::string user_agent;
+    std::string media_ip = "127.0.0.1"; // c= line of the SDP offer; no RTP is ever sent
+    double rate = 100.0;       // new calls per second, held regardless of answers
+    double duration_s = 10.0;  // calls are started for this long, then drained
+    int hold_ms = 10000;       // answer -> BYE
+    int timeout_ms = 32000;    // INVITE or BYE without a final answer by then fails (64*T1)
+    SipTimers timers;          // Timer A/E retransmits until timeout_ms
+    int sockets = 1;
+    bool uring = false;        // UDP over io_uring where the kernel has it (UdpBatch::use_uring)
+    size_t max_dialogs = 200000;  // a call due while this many are live is skipped and counted
+};
+
+struct CallResult {
+    bool ok = false;
+    std::string error;
+    int64_t dns_us = 0;
+    double elapsed_s = 0;
+    uint64_t attempted = 0;        // calls that came due
+    uint64_t table_full = 0;       // of those, skipped at max_dialogs
+    uint64_t invites_sent = 0;
+    uint64_t send_errors = 0;      // datagrams the socket refused, any method
+    uint64_t retransmits = 0;      // INVITE and BYE resent on Timer A/E
+    uint64_t answered = 0;         // INVITE answered 2xx
+    uint64_t rejected = 0;         // INVITE answered >= 300
+    uint64_t invite_timeouts = 0;
+    uint64_t completed = 0;        // BYE answered 2xx
+    uint64_t bye_failed = 0;       // BYE answered >= 300
+    uint64_t bye_timeouts = 0;
+    uint64_t stray = 0;            // unmatched or unparsable replies
+    uint64_t peak_dialogs = 0;
+    size_t dialog_bytes = 0;       // table memory per dialog slot
+    bool uring = false;            // io_uring actually carried the traffic
+    std::map<int, uint64_t> invite_status;  // final INVITE statuses
+    LatencyHistogram pdd;          // INVITE -> first 18x, or the answer when none came
+    LatencyHistogram answer;       // INVITE -> 2xx
+    LatencyHistogram bye;          // BYE -> final
+};
+
+// Open-loop call load: call k is placed at start + k/rate as INVITE with an
+// SDP offer; 1xx are noted, a 2xx is ACKed and the call held hold_ms before
+// its BYE, any other final is ACKed and counted. INVITE and BYE are resent
+// on Timer A/E until answered (a 1xx ends an INVITE's), so only a loss that
+// outlasts timeout_ms shows up as a timeout. Dialogs live in a DialogTable
+// sized for max_dialogs up front; hold, retransmit and timeout expiries in a
+// TimerWheel.
+CallResult run_calls(const CallConfig& cfg);
+
+int cmd_calls(int argc, char** argv);
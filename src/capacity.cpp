@@ -0,0 +1,288 @@
+#include "capacity.h"
+#include "app.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+CapacitySearch::CapacitySearch(const CapacityConfig& cfg) : cfg_(cfg) {
+    increase_ = cfg.aimd_increase > 0 ? cfg.aimd_increase : cfg.min_rate;
+    next_ = cfg.min_rate > 0 && cfg.max_rate >= cfg.min_rate ? cfg.min_rate : 0;
+}
+
+void CapacitySearch::record(double rate, bool pass) {
+    steps_++;
+    if (pass) {
+        lo_ = std::max(lo_, rate);
+        if (hi_ > 0 && hi_ <= lo_) hi_ = 0;   // a noisy step passed above an earlier failure
+    } else {
+        if (rate > lo_ && (hi_ == 0 || rate < hi_)) hi_ = rate;
+        increase_ /= 2;
+    }
+    plan(rate, pass);
+}
+
+void CapacitySearch::plan(double rate, bool pass) {
+    next_ = 0;
+    if (steps_ >= cfg_.max_steps) return;
+    if (lo_ == 0) return;                          // min_rate failed: nothing below to try
+    if (hi_ == 0 && lo_ >= cfg_.max_rate) return;  // the ceiling passed
+    if (hi_ > 0 && hi_ - lo_ <= cfg_.resolution * lo_) return;
+
+    if (cfg_.strategy == CapacityStrategy::Binary) {
+        next_ = hi_ == 0 ? std::min(cfg_.max_rate, lo_ * 2) : (lo_ + hi_) / 2;
+        return;
+    }
+    // AIMD carries on from the rate it just tried. After a failure it backs
+    // off, but never to a rate already known to pass.
+    double r = pass ? rate + increase_ : std::max(rate * cfg_.aimd_decrease, lo_ + increase_);
+    r = std::min(cfg_.max_rate, r);
+    if (hi_ > 0 && r >= hi_) r = (lo_ + hi_) / 2;
+    next_ = r;
+}
+
+namespace {
+
+CapacityStep run_step(const CapacityConfig& cfg, double rate) {
+    CapacityStep s;
+    s.offered = rate;
+    if (cfg.method == CapacityMethod::Options) {
+        LoadConfig lc = cfg.load;
+        lc.rate = rate;
+        lc.duration_s = cfg.step_s;
+        LoadResult r = run_load(lc);
+        if (!r.ok) { s.why = "error: " + r.error; return s; }
+        s.achieved = r.send_window_s > 0 ? (double)r.sent / r.send_window_s : 0;
+        s.sent = r.sent;
+        s.ok = r.replies_2xx;
+        s.timeouts = r.timeouts;
+        auto it = r.status_counts.find(503);
+        s.unavailable = it == r.status_counts.end() ? 0 : it->second;
+        s.other = r.replies_non2xx - s.unavailable + r.send_errors;
+        s.latency = std::move(r.latency);
+    } else {
+        // Enough registrations for one step, the rows reused round-robin.
+        const size_t n = (size_t)std::max(1.0, std::round(rate * cfg.step_s));
+        std::vector<StormCredential> creds;
+        creds.reserve(n);
+        for (size_t i = 0; i < n; i++) creds.push_back(cfg.creds[i % cfg.creds.size()]);
+        StormConfig sc = cfg.storm;
+        sc.rate = rate;
+        StormResult r = run_storm(creds, sc);
+        if (!r.ok) { s.why = "error: " + r.error; return s; }
+        // The storm has no separate send window; its clock also covers the
+        // last finals, so achieved reads a little low and is not checked.
+        s.achieved = r.elapsed_s > 0 ? (double)r.attempted / r.elapsed_s : 0;
+        s.sent = r.attempted;
+        s.ok = r.registered;
+        s.timeouts = r.timeouts;
+        s.unavailable = r.unavailable;
+        s.other = r.rejected - r.unavailable + r.bad_challenge + r.send_errors;
+        s.latency = std::move(r.final_latency);
+    }
+
+    const double sent = (double)std::max<uint64_t>(1, s.sent);
+    const CapacitySlo& slo = cfg.slo;
+    if (cfg.method == CapacityMethod::Options && s.achieved < slo.min_achieved * rate) s.why = "sender";
+    else if ((double)s.timeouts / sent > slo.timeout_ratio) s.why = "timeouts";
+    else if ((double)s.unavailable / sent > slo.unavailable_ratio) s.why = "503";
+    else if (s.latency.percentile(99) > slo.p99_us) s.why = "p99";
+    s.pass = s.why.empty();
+    return s;
+}
+
+} // namespace
+
+CapacityResult run_capacity(const CapacityConfig& cfg, const std::function<void(const CapacityStep&)>& on_step) {
+    CapacityResult res;
+    if (cfg.min_rate <= 0 || cfg.max_rate < cfg.min_rate) { res.error = "need 0 < min rate <= max rate"; return res; }
+    if (cfg.step_s <= 0) { res.error = "step length must be positive"; return res; }
+    if (cfg.method == CapacityMethod::Register && cfg.creds.empty()) { res.error = "REGISTER needs credentials"; return res; }
+
+    CapacitySearch search(cfg);
+    for (double rate; (rate = search.next()) > 0;) {
+        if (!res.steps.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(cfg.cooldown_ms));
+        CapacityStep s = run_step(cfg, rate);
+        // An engine error says nothing about the target; stop rather than
+        // read it as a failed step.
+        if (s.why.compare(0, 6, "error:") == 0) {
+            res.error = s.why.substr(7);
+            break;
+        }
+        search.record(rate, s.pass);
+        res.steps.push_back(std::move(s));
+        if (on_step) on_step(res.steps.back());
+    }
+    res.knee = search.knee();
+    res.first_fail = search.first_fail();
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void capacity_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan capacity --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                    [--method options|register] [--creds <file.csv>] [--search binary|aimd]\n"
+"                    [--min-rate 100] [--max-rate 100000] [--step 5] [--cooldown 1000]\n"
+"                    [--resolution 0.05] [--max-steps 20] [--aimd-increase <min-rate>]\n"
+"                    [--aimd-decrease 0.5] [--slo-p99 100000] [--slo-timeouts 0.001]\n"
+"                    [--slo-503 0.001] [--timeout 2000] [--workers 1] [--sockets 1] [--io-uring]\n"
+"\n"
+"Offers rising OPTIONS (or REGISTER, answering Digest challenges with --creds)\n"
+"rates for --step seconds each and reports the highest rate at which p99\n"
+"latency (us, from the scheduled send), the timeout ratio and the 503 ratio\n"
+"all stayed within the --slo-* limits, with the latency curve of every step.\n"
+"binary doubles from --min-rate until a step fails, then bisects; aimd adds\n"
+"--aimd-increase per pass and scales by --aimd-decrease per failure. Either\n"
+"stops when the knee is bracketed within --resolution. A step whose sender\n"
+"fell below 95% of the offered rate fails as \"sender\": add --workers.\n"
+"\n"
+"Example:\n"
+"  frogklan capacity --host 10.0.0.5 --from sip:qa@ex.com --to sip:qa@ex.com --max-rate 200000 --workers 4\n";
+}
+
+static void print_step(const CapacityStep& s) {
+    std::cout << std::fixed << std::setprecision(0) << std::setw(10) << s.offered << "/s  achieved "
+              << std::setw(10) << s.achieved << "/s  p50=" << s.latency.percentile(50)
+              << " p99=" << s.latency.percentile(99) << " timeouts=" << s.timeouts << " 503=" << s.unavailable
+              << "  " << (s.pass ? "pass" : "FAIL " + s.why) << "\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+int cmd_capacity(int argc, char** argv) {
+    CapacityConfig cfg;
+    std::string creds_path;
+    int timeout_ms = 2000, workers = 1;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--host") cfg.load.host = need("--host");
+        else if (a == "--port") cfg.load.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--from") cfg.load.from_uri = need("--from");
+        else if (a == "--to") cfg.load.to_uri = need("--to");
+        else if (a == "--method") {
+            std::string m = need("--method");
+            if (m == "register") cfg.method = CapacityMethod::Register;
+            else if (m != "options") { std::cerr << "--method must be options or register\n"; return 2; }
+        }
+        else if (a == "--creds") creds_path = need("--creds");
+        else if (a == "--search") {
+            std::string s = need("--search");
+            if (s == "aimd") cfg.strategy = CapacityStrategy::Aimd;
+            else if (s != "binary") { std::cerr << "--search must be binary or aimd\n"; return 2; }
+        }
+        else if (a == "--min-rate") cfg.min_rate = std::stod(need("--min-rate"));
+        else if (a == "--max-rate") cfg.max_rate = std::stod(need("--max-rate"));
+        else if (a == "--step") cfg.step_s = std::stod(need("--step"));
+        else if (a == "--cooldown") cfg.cooldown_ms = std::stoi(need("--cooldown"));
+        else if (a == "--resolution") cfg.resolution = std::stod(need("--resolution"));
+        else if (a == "--max-steps") cfg.max_steps = std::stoi(need("--max-steps"));
+        else if (a == "--aimd-increase") cfg.aimd_increase = std::stod(need("--aimd-increase"));
+        else if (a == "--aimd-decrease") cfg.aimd_decrease = std::stod(need("--aimd-decrease"));
+        else if (a == "--slo-p99") cfg.slo.p99_us = std::stoull(need("--slo-p99"));
+        else if (a == "--slo-timeouts") cfg.slo.timeout_ratio = std::stod(need("--slo-timeouts"));
+        else if (a == "--slo-503") cfg.slo.unavailable_ratio = std::stod(need("--slo-503"));
+        else if (a == "--timeout") timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--workers") workers = std::stoi(need("--workers"));
+        else if (a == "--sockets") cfg.load.sockets = std::stoi(need("--sockets"));
+        else if (a == "--io-uring") cfg.load.uring = true;
+        else if (a == "--help") { capacity_usage(); return 0; }
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    const bool reg = cfg.method == CapacityMethod::Register;
+    if (cfg.load.host.empty() || (!reg && (cfg.load.from_uri.empty() || cfg.load.to_uri.empty())) ||
+        (reg && creds_path.empty())) {
+        std::cerr << "Missing required args.\n";
+        capacity_usage();
+        return 2;
+    }
+    if (cfg.aimd_decrease <= 0 || cfg.aimd_decrease >= 1) {
+        std::cerr << "--aimd-decrease must be between 0 and 1\n";
+        return 2;
+    }
+    if (reg) {
+        std::string err;
+        if (!load_storm_credentials(creds_path, &cfg.creds, &err)) {
+            std::cerr << err << "\n";
+            return 2;
+        }
+    }
+    const std::string ua = "frogklan-sip-qa/" + std::string(APP_VERSION);
+    cfg.load.user_agent = ua;
+    cfg.load.timeout_ms = timeout_ms;
+    cfg.load.workers = workers;
+    cfg.storm.host = cfg.load.host;
+    cfg.storm.port = cfg.load.port;
+    cfg.storm.user_agent = ua;
+    cfg.storm.timers.timeout_ms = timeout_ms;
+    cfg.storm.workers = workers;
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_capacity_report.json";
+
+    const char* method = reg ? "REGISTER" : "OPTIONS";
+    std::cout << "capacity search (" << (cfg.strategy == CapacityStrategy::Aimd ? "aimd" : "binary") << ", "
+              << method << ", " << cfg.step_s << " s steps):\n";
+    CapacityResult r = run_capacity(cfg, print_step);
+    if (!r.ok) {
+        std::cerr << "capacity: " << r.error << "\n";
+        return 3;
+    }
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.load.host) << "\", \"port\": " << cfg.load.port << "},\n"
+"  \"method\": \"" << method << "\",\n"
+"  \"search\": \"" << (cfg.strategy == CapacityStrategy::Aimd ? "aimd" : "binary") << "\",\n"
+"  \"slo\": {\"p99_us\": " << cfg.slo.p99_us << ", \"timeout_ratio\": " << cfg.slo.timeout_ratio
+    << ", \"unavailable_ratio\": " << cfg.slo.unavailable_ratio << ", \"min_achieved\": " << cfg.slo.min_achieved << "},\n"
+"  \"step_s\": " << cfg.step_s << ",\n"
+"  \"workers\": " << workers << ",\n"
+"  \"knee_rate\": " << r.knee << ",\n"
+"  \"first_fail_rate\": " << r.first_fail << ",\n"
+"  \"steps\": [";
+    for (size_t i = 0; i < r.steps.size(); i++) {
+        const CapacityStep& s = r.steps[i];
+        f << (i ? ",\n" : "\n") << "    {\"offered\": " << s.offered << ", \"achieved\": " << s.achieved
+          << ", \"sent\": " << s.sent << ", \"ok\": " << s.ok << ", \"timeouts\": " << s.timeouts
+          << ", \"unavailable\": " << s.unavailable << ", \"other\": " << s.other
+          << ", \"pass\": " << (s.pass ? "true" : "false") << ", \"failed_on\": \"" << s.why << "\", \"latency_us\": ";
+        json_hist(f, s.latency);
+        f << "}";
+    }
+    f << "\n  ]\n}\n";
+    f.close();
+
+    std::cout << "SIP capacity report: " << report_path << "\n";
+    if (r.knee == 0) {
+        std::cout << "No step met the SLO; even " << cfg.min_rate << "/s failed.\n";
+    } else {
+        std::cout << "knee: " << r.knee << " " << method << "/s within SLO";
+        if (r.first_fail > 0) std::cout << " (" << r.first_fail << "/s failed)";
+        else if (r.knee >= cfg.max_rate) std::cout << " (--max-rate reached; the target may go higher)";
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "histogram.h"
+#include "load.h"
+#include "storm.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class CapacityMethod { Options, Register };
+enum class CapacityStrategy { Binary, Aimd };
+
+// A step passes while all of these hold.
+struct CapacitySlo {
+    uint64_t p99_us = 100000;        // from scheduled send, so queueing counts
+    double timeout_ratio = 0.001;    // timeouts / sent
+    double unavailable_ratio = 0.001;  // 503s / sent
+    double min_achieved = 0.95;      // achieved / offered: below, the sender was the limit
+};
+
+struct CapacityConfig {
+    CapacityMethod method = CapacityMethod::Options;
+    CapacityStrategy strategy = CapacityStrategy::Binary;
+    CapacitySlo slo;
+    double min_rate = 100;           // first step
+    double max_rate = 100000;        // never offered more than this
+    double step_s = 5;               // each step's length
+    int cooldown_ms = 1000;          // between steps, for the target to drain
+    double resolution = 0.05;        // stop once the knee is bracketed this tightly (fraction)
+    int max_steps = 20;
+    double aimd_increase = 0;        // AIMD: added after a pass; 0 -> min_rate
+    double aimd_decrease = 0.5;      // AIMD: rate multiplied by this after a failure
+
+    LoadConfig load;                 // Options: target, URIs, timeout, workers; rate/duration per step
+    StormConfig storm;               // Register: target, timers, workers; rate per step
+    std::vector<StormCredential> creds;  // Register: reused round-robin to fill a step
+};
+
+struct CapacityStep {
+    double offered = 0;
+    double achieved = 0;             // sends per second actually made
+    uint64_t sent = 0;
+    uint64_t ok = 0;                 // 2xx finals
+    uint64_t timeouts = 0;
+    uint64_t unavailable = 0;        // 503 finals
+    uint64_t other = 0;              // other non-2xx finals and send errors
+    LatencyHistogram latency;        // from scheduled send, us
+    bool pass = false;
+    std::string why;                 // first SLO broken: "p99", "timeouts", "503", "sender", "error"
+};
+
+struct CapacityResult {
+    bool ok = false;
+    std::string error;
+    double knee = 0;                 // highest passing offered rate; 0 if even min_rate failed
+    double first_fail = 0;           // lowest failing rate above it, 0 if none failed
+    std::vector<CapacityStep> steps; // in the order tried
+};
+
+// Chooses each step's rate from the ones before. Binary doubles from
+// min_rate until a step fails (or max_rate passes), then bisects between the
+// highest pass and the lowest failure. AIMD adds aimd_increase after a pass
+// and multiplies by aimd_decrease after a failure (but not below the highest
+// pass plus the increase), halving the increase each time, so it closes in
+// from below the way a congested sender backs off.
+// Both stop once the bracket is within `resolution` of the knee, or after
+// max_steps.
+class CapacitySearch {
+public:
+    explicit CapacitySearch(const CapacityConfig& cfg);
+
+    // Rate for the next step, or 0 when the search is over.
+    double next() const { return next_; }
+    void record(double rate, bool pass);
+    double knee() const { return lo_; }
+    double first_fail() const { return hi_; }
+
+private:
+    void plan(double rate, bool pass);
+
+    const CapacityConfig& cfg_;
+    double lo_ = 0;                  // highest pass
+    double hi_ = 0;                  // lowest failure above lo_, 0 if none
+    double next_ = 0;
+    double increase_ = 0;
+    int steps_ = 0;
+};
+
+// Runs the search against the target, one load (OPTIONS) or storm
+// (REGISTER) run per step; on_step, if set, sees each step as it finishes.
+CapacityResult run_capacity(const CapacityConfig& cfg,
+                            const std::function<void(const CapacityStep&)>& on_step = {});
+
+int cmd_capacity(int argc, char** argv);
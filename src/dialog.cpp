@@ -0,0 +1,87 @@
+#include "dialog.h"
+#include <cstring>
+
+bool Dialog::set_remote_tag(std::string_view tag) {
+    if (tag.size() > kTagMax) return false;
+    std::memcpy(remote_tag, tag.data(), tag.size());
+    remote_tag_len = (uint8_t)tag.size();
+    return true;
+}
+
+DialogTable::DialogTable(size_t max_dialogs) {
+    if (max_dialogs == 0) max_dialogs = 1;
+    pool_.resize(max_dialogs);
+    free_.reserve(max_dialogs);
+    for (size_t i = max_dialogs; i-- > 0;) free_.push_back((uint32_t)i);
+    size_t n = 16;
+    while (n < max_dialogs * 2) n <<= 1;
+    buckets_.assign(n, Bucket{0, 0});
+    mask_ = n - 1;
+}
+
+uint32_t DialogTable::hash_of(std::string_view call_id, std::string_view local_tag) {
+    // FNV-1a over both parts with a separator, folded to 32 bits.
+    uint64_t h = 1469598103934665603ull;
+    for (char c : call_id) h = (h ^ (uint8_t)c) * 1099511628211ull;
+    h = (h ^ 0xff) * 1099511628211ull;
+    for (char c : local_tag) h = (h ^ (uint8_t)c) * 1099511628211ull;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+size_t DialogTable::probe(uint32_t h, std::string_view call_id, std::string_view local_tag) const {
+    for (size_t i = h & mask_;; i = (i + 1) & mask_) {
+        const Bucket& b = buckets_[i];
+        if (b.slot == 0) return i;
+        if (b.hash != h) continue;
+        const Dialog& d = pool_[b.slot - 1];
+        if (d.call_id_view() == call_id && d.local_tag_view() == local_tag) return i;
+    }
+}
+
+Dialog* DialogTable::insert(std::string_view call_id, std::string_view local_tag) {
+    if (free_.empty() || call_id.size() > Dialog::kCallIdMax || local_tag.size() > Dialog::kTagMax) return nullptr;
+    uint32_t h = hash_of(call_id, local_tag);
+    size_t i = probe(h, call_id, local_tag);
+    if (buckets_[i].slot != 0) return nullptr;
+
+    uint32_t s = free_.back();
+    free_.pop_back();
+    Dialog& d = pool_[s];
+    d = Dialog{};
+    std::memcpy(d.call_id, call_id.data(), call_id.size());
+    d.call_id_len = (uint8_t)call_id.size();
+    std::memcpy(d.local_tag, local_tag.data(), local_tag.size());
+    d.local_tag_len = (uint8_t)local_tag.size();
+    d.hash = h;
+    d.state = DialogState::Calling;
+    buckets_[i] = Bucket{h, s + 1};
+    live_++;
+    return &d;
+}
+
+Dialog* DialogTable::find(std::string_view call_id, std::string_view local_tag) {
+    uint32_t h = hash_of(call_id, local_tag);
+    size_t i = probe(h, call_id, local_tag);
+    return buckets_[i].slot ? &pool_[buckets_[i].slot - 1] : nullptr;
+}
+
+void DialogTable::erase(Dialog* d) {
+    if (!d || d->state == DialogState::Free) return;
+    size_t i = probe(d->hash, d->call_id_view(), d->local_tag_view());
+    if (buckets_[i].slot == 0) return;
+
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole whenever their home bucket does not lie strictly after it.
+    for (size_t j = (i + 1) & mask_; buckets_[j].slot != 0; j = (j + 1) & mask_) {
+        size_t home = buckets_[j].hash & mask_;
+        if (((j - home) & mask_) >= ((j - i) & mask_)) {
+            buckets_[i] = buckets_[j];
+            i = j;
+        }
+    }
+    buckets_[i] = Bucket{0, 0};
+
+    free_.push_back(index_of(d));
+    d->state = DialogState::Free;
+    live_--;
+}
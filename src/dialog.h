@@ -0,0 +1,80 @@
+#pragma once
+#include "sip_id.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum class DialogState : uint8_t { Free, Calling, Proceeding, Confirmed, Terminating };
+
+// One UAC call, fixed size so a slot costs the same few hundred bytes
+// whatever the peer sends: IDs longer than the arrays are refused rather
+// than allocated for. Times are steady-clock microseconds since the run
+// started; 0 means "not yet".
+struct Dialog {
+    static const size_t kCallIdMax = 64;
+    static const size_t kTagMax = 64;
+
+    char call_id[kCallIdMax];
+    char local_tag[kTagMax];
+    char remote_tag[kTagMax];        // To tag from the 2xx
+    char branch[kSipBranchLen];      // the client transaction in progress
+    uint8_t call_id_len = 0;
+    uint8_t local_tag_len = 0;
+    uint8_t remote_tag_len = 0;
+    DialogState state = DialogState::Free;
+    uint32_t hash = 0;
+    uint64_t timer = 0;              // TimerWheel id: timeout or hold expiry
+    uint64_t invite_us = 0;
+    uint64_t ring_us = 0;            // first 18x
+    uint64_t answer_us = 0;
+    uint64_t bye_us = 0;
+
+    std::string_view call_id_view() const { return {call_id, call_id_len}; }
+    std::string_view local_tag_view() const { return {local_tag, local_tag_len}; }
+    std::string_view remote_tag_view() const { return {remote_tag, remote_tag_len}; }
+    std::string_view branch_view() const { return {branch, kSipBranchLen}; }
+    // False (and nothing stored) when the tag does not fit.
+    bool set_remote_tag(std::string_view tag);
+};
+
+// Live dialogs keyed by (Call-ID, local tag), the half of the RFC 3261
+// dialog ID that a UAC picks itself and so knows before any answer. State
+// lives in a pool allocated once for max_dialogs; the index is open
+// addressing with linear probing over a power-of-two table at most half
+// full, and erase shifts followers back instead of leaving tombstones, so
+// churn never degrades probing. Nothing allocates after construction.
+class DialogTable {
+public:
+    explicit DialogTable(size_t max_dialogs);
+
+    // A fresh slot for the key, or nullptr when the pool is exhausted, the
+    // key is already live or does not fit.
+    Dialog* insert(std::string_view call_id, std::string_view local_tag);
+    Dialog* find(std::string_view call_id, std::string_view local_tag);
+    void erase(Dialog* d);
+
+    uint32_t index_of(const Dialog* d) const { return (uint32_t)(d - pool_.data()); }
+    Dialog* at(uint32_t i) { return &pool_[i]; }
+
+    size_t size() const { return live_; }
+    size_t capacity() const { return pool_.size(); }
+    // Pool plus index, for reporting memory per dialog.
+    size_t bytes() const {
+        return pool_.size() * sizeof(Dialog) + buckets_.size() * sizeof(Bucket) + free_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct Bucket {
+        uint32_t hash;
+        uint32_t slot;   // pool index + 1; 0 when empty
+    };
+    static uint32_t hash_of(std::string_view call_id, std::string_view local_tag);
+    size_t probe(uint32_t h, std::string_view call_id, std::string_view local_tag) const;
+
+    std::vector<Dialog> pool_;
+    std::vector<uint32_t> free_;
+    std::vector<Bucket> buckets_;
+    size_t mask_ = 0;
+    size_t live_ = 0;
+};
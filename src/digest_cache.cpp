@@ -0,0 +1,49 @@
+#include "digest_cache.h"
+#include "md5.h"
+
+const std::string& DigestAuthCache::ha1(const std::string& realm, const std::string& user, const std::string& pass) {
+    std::string key;
+    key.reserve(realm.size() + user.size() + pass.size() + 2);
+    key.append(realm).push_back('\0');
+    key.append(user).push_back('\0');
+    key.append(pass);
+    auto it = ha1_.find(key);
+    if (it != ha1_.end()) return it->second;
+    return ha1_.emplace(std::move(key), MD5::md5_hex(user + ":" + realm + ":" + pass)).first->second;
+}
+
+void DigestAuthCache::remember(const SipAuthChallenge& ch, bool proxy) {
+    ch_ = ch;
+    proxy_ = proxy;
+    have_ = ch.ok;
+}
+
+std::string DigestAuthCache::next_nc(const std::string& nonce) {
+    if (nc_.size() >= kMaxNonces && !nc_.count(nonce)) {
+        // Keep the remembered nonce's count; the rest are long superseded.
+        uint32_t keep = nonce_count();
+        nc_.clear();
+        if (have_ && keep) nc_.emplace(ch_.nonce, keep);
+    }
+    static const char* h = "0123456789abcdef";
+    uint32_t nc = ++nc_[nonce];
+    std::string nc_hex8(8, '0');
+    for (int i = 7; i >= 0; i--) { nc_hex8[i] = h[nc & 15]; nc >>= 4; }
+    return nc_hex8;
+}
+
+uint32_t DigestAuthCache::nonce_count() const {
+    if (!have_) return 0;
+    auto it = nc_.find(ch_.nonce);
+    return it == nc_.end() ? 0 : it->second;
+}
+
+bool DigestAuthCache::authorize(const std::string& method, const std::string& uri,
+                                const std::string& user, const std::string& pass,
+                                const std::string& cnonce, std::string* auth, bool* proxy) {
+    if (!have_) return false;
+    *auth = build_digest_authorization_ha1(method, uri, user, ha1(ch_.realm, user, pass),
+                                           ch_, cnonce, next_nc(ch_.nonce));
+    *proxy = proxy_;
+    return true;
+}
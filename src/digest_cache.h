@@ -0,0 +1,44 @@
+#pragma once
+#include "sip.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Client-side digest state for one registrar/proxy: HA1 per (realm, user),
+// precomputed once, the last challenge seen, and the last nonce count sent
+// on each nonce, so requests can carry credentials up front and no nc= is
+// ever repeated on a nonce. Not thread-safe; each worker keeps its own.
+class DigestAuthCache {
+public:
+    // HA1 = MD5(user:realm:pass).
+    const std::string& ha1(const std::string& realm, const std::string& user, const std::string& pass);
+
+    // Adopts the challenge from a 401/407 as the one to answer from now on.
+    // Its nonce count carries on if this nonce has been answered before.
+    void remember(const SipAuthChallenge& ch, bool proxy);
+    bool has_challenge() const { return have_; }
+    void forget() { have_ = false; }
+
+    // Authorization value for the remembered nonce with the next nc. False if
+    // no challenge has been seen yet.
+    bool authorize(const std::string& method, const std::string& uri,
+                   const std::string& user, const std::string& pass,
+                   const std::string& cnonce, std::string* auth, bool* proxy);
+
+    // Takes the next nonce count on `nonce`, as the 8 hex digits of nc=, for
+    // a caller answering a challenge itself (a batched digest, say).
+    std::string next_nc(const std::string& nonce);
+
+    // Last nc sent on the remembered nonce.
+    uint32_t nonce_count() const;
+
+private:
+    // Counts for nonces no longer in use are dropped past this many.
+    static const size_t kMaxNonces = 1024;
+
+    std::unordered_map<std::string, std::string> ha1_;
+    std::unordered_map<std::string, uint32_t> nc_;    // nonce -> last nc sent
+    SipAuthChallenge ch_;
+    bool proxy_ = false;
+    bool have_ = false;
+};
@@ -0,0 +1,93 @@
+#include "histogram.h"
+
+#include <ostream>
+
+static const int kSubBits = 11;                        // 2048 sub-buckets
+static const uint64_t kSubCount = 1ull << kSubBits;
+static const uint64_t kHalfCount = kSubCount / 2;
+static const uint64_t kMaxValue = (1ull << 32) - 1;   // ~71 minutes in us
+
+static inline int msb64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#else
+    int r = 0;
+    while (v >>= 1) r++;
+    return r;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() : counts_(index_of(kMaxValue) + 1, 0) {}
+
+size_t LatencyHistogram::index_of(uint64_t v) {
+    if (v < kSubCount) return (size_t)v;
+    // Shift so the top kSubBits bits of v land in [kHalfCount, kSubCount).
+    int shift = msb64(v) - (kSubBits - 1);
+    return (size_t)((uint64_t)(shift + 1) * kHalfCount + ((v >> shift) - kHalfCount));
+}
+
+uint64_t LatencyHistogram::highest_equivalent(size_t idx) {
+    if (idx < kSubCount) return idx;
+    int shift = (int)(idx / kHalfCount) - 1;
+    uint64_t sub = idx % kHalfCount + kHalfCount;
+    return (sub << shift) + ((1ull << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    if (us > kMaxValue) us = kMaxValue;
+    counts_[index_of(us)]++;
+    count_++;
+    sum_ += us;
+    if (us < min_) min_ = us;
+    if (us > max_) max_ = us;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+    for (size_t i = 0; i < counts_.size(); i++) counts_[i] += o.counts_[i];
+    count_ += o.count_;
+    sum_ += o.sum_;
+    if (o.min_ < min_) min_ = o.min_;
+    if (o.max_ > max_) max_ = o.max_;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& c : counts_) c = 0;
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) return 0;
+    if (p >= 100.0) return max_;
+    uint64_t want = (uint64_t)(p / 100.0 * (double)count_ + 0.5);
+    if (want < 1) want = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+        seen += counts_[i];
+        if (seen >= want) {
+            uint64_t v = highest_equivalent(i);
+            return v > max_ ? max_ : v;
+        }
+    }
+    return max_;
+}
+
+uint64_t us_between(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+    auto d = std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    return d < 0 ? 0 : (uint64_t)d;
+}
+
+void json_hist(std::ostream& o, const LatencyHistogram& h) {
+    o << "{\"count\": " << h.count() << ", \"min\": " << h.min() << ", \"mean\": " << h.mean()
+      << ", \"p50\": " << h.percentile(50) << ", \"p90\": " << h.percentile(90)
+      << ", \"p99\": " << h.percentile(99) << ", \"p99_9\": " << h.percentile(99.9)
+      << ", \"max\": " << h.max() << "}";
+}
+
+void print_hist(std::ostream& o, const char* name, const LatencyHistogram& h) {
+    o << name << ": p50=" << h.percentile(50) << " p90=" << h.percentile(90)
+      << " p99=" << h.percentile(99) << " p99.9=" << h.percentile(99.9)
+      << " max=" << h.max() << " (n=" << h.count() << ")\n";
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// HDR-style log-linear latency histogram in microseconds. Values are kept to
+// 3 significant digits (2048 linear sub-buckets per power of two) from 1 us
+// up to ~71 minutes; larger values are clamped. Recording is O(1) and never
+// allocates; histograms with the same layout merge by adding counts.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t us);
+    void merge(const LatencyHistogram& o);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / (double)count_ : 0.0; }
+    // Smallest recorded value v such that p percent of samples are <= v.
+    uint64_t percentile(double p) const;
+
+private:
+    static size_t index_of(uint64_t v);
+    static uint64_t highest_equivalent(size_t idx);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+// Microseconds from a to b, 0 if b comes first: one sample as the engines
+// record it.
+uint64_t us_between(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b);
+
+// The forms every report uses: a JSON object (count, min, mean, p50, p90,
+// p99, p99_9, max) and a console line headed by name.
+void json_hist(std::ostream& o, const LatencyHistogram& h);
+void print_hist(std::ostream& o, const char* name, const LatencyHistogram& h);
@@ -0,0 +1,519 @@
+#include "load.h"
+#include "app.h"
+#include "metrics.h"
+#include "net.h"
+#include "resolver.h"
+#include "resultlog.h"
+#include "schedule.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "sip_template.h"
+#include "tcp_transport.h"
+#include "txn.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct LoadSlot {
+    Clock::time_point due;
+    Clock::time_point sent;
+    std::string branch;
+    bool live = false;
+};
+
+// One worker's share of the run: its own sockets or connections, slot ring
+// and transaction table, fed from the shared schedule. Nothing here is
+// shared with other workers except the claims, the metrics entry and the
+// log, all of which are thread-safe.
+LoadResult load_worker(const LoadConfig& cfg, const UdpAddr& dst, ScheduleClaims& claims, StartGate& gate,
+                       int connections, uint64_t cap) {
+    LoadResult res;
+    TargetMetrics* mx = cfg.metrics ? &cfg.metrics->at(0) : nullptr;
+
+    const bool tcp = cfg.transport == SipTransport::Tcp;
+    int nsock = cfg.sockets < 1 ? 1 : cfg.sockets;
+    std::vector<std::unique_ptr<UdpSocket>> socks;
+    UdpPoller poller;
+    for (int i = 0; i < nsock && !tcp; i++) {
+        auto s = std::make_unique<UdpSocket>();
+        if (!s->open(8 << 20) || !poller.add(*s)) { res.error = "Failed to open UDP socket"; break; }
+        if (cfg.kernel_ts) s->enable_rx_timestamps();
+        socks.push_back(std::move(s));
+    }
+
+    SipTcpPool pool(connections, cfg.timeout_ms);
+    std::vector<SipTcpConnection*> conns;
+    std::vector<TcpWaitFd> wait_fds;
+    if (tcp) {
+        for (int i = 0; i < connections && res.error.empty(); i++) {
+            int64_t us = 0;
+            if (!pool.get(dst, &us)) { res.error = "TCP connect failed"; break; }
+            res.connect.record((uint64_t)us);
+        }
+        pool.connections(dst, conns);
+    }
+
+    // Every worker arrives, set up or not, so none waits forever.
+    const auto start = gate.arrive(std::chrono::milliseconds(10));
+    if (!res.error.empty()) return res;
+
+    const std::chrono::duration<double> interval(1.0 / cfg.rate);
+    const auto timeout = std::chrono::milliseconds(cfg.timeout_ms);
+    std::vector<LoadSlot> ring(cap);
+
+    const std::string tag = sip_new_tag();
+    char idbuf[kSipBranchLen];
+    const auto tpl = SipRequestTemplate::options(cfg.host, cfg.port, cfg.from_uri, cfg.to_uri, cfg.user_agent,
+                                                 cfg.transport);
+    SipRequestTemplate::Fields fields;
+    fields.tag = tag;
+    UdpBatch io;
+    if (!tcp && cfg.uring && io.use_uring() && !poller.use(io)) { res.error = "io_uring setup failed"; return res; }
+    res.uring = io.uring();
+    std::vector<std::string> msgs(io.max_batch());
+    std::vector<std::string> call_ids(io.max_batch());
+    std::vector<UdpDatagram> dgrams(io.max_batch());
+    uint64_t batch_no = 0;
+
+    TxnTable txns;
+    txns.reserve(cap);
+
+    std::vector<int> ready;
+    SipResponseView resp;
+    std::string_view framed;
+
+    // seq and oldest count this worker's requests; the schedule position of
+    // each is kept in its slot's due time.
+    ScheduleCursor cursor(claims);
+    uint64_t seq = 0;      // next request to send
+    uint64_t oldest = 0;   // every request below this is resolved
+    uint64_t live = 0;
+    Clock::time_point last_send;
+    auto due_of = [&](uint64_t k) { return start + std::chrono::duration_cast<Clock::duration>(interval * (double)k); };
+
+    const uint64_t sys_start_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        (std::chrono::system_clock::now() + (start - Clock::now())).time_since_epoch()).count();
+    const uint32_t log_id = cfg.log ? cfg.log->target_id(cfg.host + ":" + std::to_string(cfg.port)) : 0;
+    // Timestamped at the actual send, like the service histogram.
+    auto log_outcome = [&](const LoadSlot& s, ProbeOutcome outcome, int status, const UdpAddr* peer,
+                           Clock::time_point t) {
+        ProbeRecord rec;
+        rec.ts_us = sys_start_us + (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(s.sent - start).count();
+        rec.target = log_id;
+        rec.outcome = (uint8_t)outcome;
+        rec.status = (uint16_t)status;
+        if (peer) {
+            rec.rtt_us = (uint32_t)std::min<uint64_t>(us_between(s.sent, t), ProbeRecord::kNoRtt - 1);
+            rec.peer_ip = peer->ip;
+            rec.peer_port = peer->port;
+        }
+        cfg.log->append(rec);
+    };
+
+    auto expire = [&](uint64_t k) {
+        auto& s = ring[k % cap];
+        if (cfg.log) log_outcome(s, ProbeOutcome::Timeout, 0, nullptr, s.sent);
+        txns.remove(s.branch);
+        s.live = false;
+        live--;
+        res.timeouts++;
+        if (mx) mx->add_timeout();
+    };
+
+    auto on_reply = [&](const char* data, size_t len, const UdpAddr& peer, Clock::time_point t) {
+        if (!parse_sip_response_view(data, len, &resp)) { res.stray++; return; }
+        uint32_t slot;
+        if (!txns.match(sip_top_via_branch(resp), resp.call_id, &slot)) { res.stray++; return; }
+        if (resp.status < 200) return; // provisional: keep waiting for the final
+        auto& s = ring[slot];
+        res.latency.record(us_between(s.due, t));
+        res.service.record(us_between(s.sent, t));
+        if (mx) {
+            mx->record_rtt_us(us_between(s.sent, t));
+            mx->record_status(resp.status);
+        }
+        if (cfg.log) log_outcome(s, ProbeOutcome::Reply, resp.status, &peer, t);
+        res.status_counts[resp.status]++;
+        if (resp.status < 300) res.replies_2xx++;
+        else res.replies_non2xx++;
+        txns.remove(s.branch);
+        s.live = false;
+        live--;
+    };
+
+    for (;;) {
+        auto now = Clock::now();
+        bool ring_full = false;
+
+        while (cursor.has_next()) {
+            // A batch only takes slots behind the oldest live transaction.
+            // When there are none, this worker sends nothing more until a
+            // reply or a timeout frees one: live transactions are never cut
+            // short, and other workers claim the schedule meanwhile.
+            while (oldest < seq && !ring[oldest % cap].live) oldest++;
+            const uint64_t room = cap - (seq - oldest);
+            if (room == 0) { ring_full = true; break; }
+
+            // Everything due by now goes out together, one syscall per batch.
+            // A batch stays within one claimed chunk.
+            size_t nb = 0;
+            const size_t limit = (size_t)std::min<uint64_t>({io.max_batch(), cursor.left_in_chunk(), room});
+            while (nb < limit) {
+                auto due = due_of(cursor.next());
+                if (due > now) break;
+                auto& s = ring[(seq + nb) % cap];
+                sip_id_branch(idbuf);
+                s.branch.assign(idbuf, kSipBranchLen);
+                s.due = due;
+                sip_id_unique(idbuf);
+                call_ids[nb].assign(idbuf, kSipIdHex).append("@frogklan");
+                fields.branch = s.branch;
+                fields.call_id = call_ids[nb];
+                tpl.render(fields, msgs[nb]);
+                dgrams[nb] = UdpDatagram{dst, msgs[nb].data(), msgs[nb].size()};
+                cursor.take();
+                nb++;
+            }
+            if (nb == 0) break;
+
+            auto t = Clock::now();
+            int rc = 0;
+            if (tcp) {
+                // Same contract as sendmmsg: a failure ends the batch, the
+                // rest go next pass on a reopened connection.
+                while ((size_t)rc < nb) {
+                    int64_t us = -1;
+                    SipTcpConnection* c = pool.get(dst, &us);
+                    if (us >= 0) res.connect.record((uint64_t)us);
+                    if (!c || !c->send(msgs[rc])) break;
+                    rc++;
+                }
+                if (rc == 0) rc = -1;
+            } else {
+                rc = io.send(*socks[batch_no++ % (uint64_t)nsock], dgrams.data(), nb);
+            }
+            size_t accepted = rc < 0 ? 1 : (size_t)rc;
+            for (size_t i = 0; i < accepted; i++) {
+                auto& s = ring[(seq + i) % cap];
+                s.sent = t;
+                uint64_t lag = us_between(s.due, t);
+                if (lag > res.max_send_lag_us) res.max_send_lag_us = lag;
+                if (rc < 0) {
+                    res.send_errors++;
+                    if (mx) mx->add_send_error();
+                    if (cfg.log) log_outcome(s, ProbeOutcome::SendError, 0, nullptr, t);
+                } else {
+                    s.live = true;
+                    live++;
+                    txns.add(s.branch, call_ids[i], (uint32_t)((seq + i) % cap));
+                    res.sent++;
+                    if (mx) mx->add_sent();
+                }
+            }
+            last_send = t;
+            seq += accepted;
+            cursor.give_back(nb - accepted);
+            if (rc >= 0 && accepted < nb) break; // socket buffer full: the rest go next pass, lag is measured
+        }
+
+        while (oldest < seq) {
+            auto& s = ring[oldest % cap];
+            if (s.live) {
+                if (s.sent + timeout > now) break;
+                expire(oldest);
+            }
+            oldest++;
+        }
+        if (seq - oldest < cap) ring_full = false;
+
+        const bool more = cursor.has_next();
+        if (!more && live == 0) break;
+
+        // Sleep until the next send is due or the oldest transaction expires;
+        // sub-millisecond gaps spin on a zero-timeout poll.
+        auto wake = Clock::time_point::max();
+        if (more && !ring_full) wake = due_of(cursor.next());
+        if (oldest < seq && ring[oldest % cap].live) {
+            auto exp = ring[oldest % cap].sent + timeout;
+            if (exp < wake) wake = exp;
+        }
+        int wait_ms = 0;
+        if (wake != Clock::time_point::max()) {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count();
+            wait_ms = ms < 0 ? 0 : (int)ms;
+        }
+        if (tcp) {
+            wait_fds.resize(conns.size());
+            for (size_t i = 0; i < conns.size(); i++) wait_fds[i] = TcpWaitFd{conns[i]->fd(), conns[i]->want_write()};
+            if (tcp_wait(wait_fds, wait_ms) < 0) { res.error = "poll failed"; break; }
+            for (size_t i = 0; i < conns.size(); i++) {
+                SipTcpConnection& c = *conns[i];
+                if (wait_fds[i].writable) c.flush();
+                if (!wait_fds[i].readable) continue;
+                c.recv();
+                auto t = Clock::now();
+                while (c.framer().next(&framed)) on_reply(framed.data(), framed.size(), dst, t);
+                if (c.framer().broken()) c.close();
+            }
+            continue;
+        }
+
+        if (poller.wait(wait_ms, ready) < 0) { res.error = "poll failed"; break; }
+
+        for (int si : ready) {
+            int n;
+            while ((n = io.recv(*socks[si])) > 0) {
+                auto batch_t = Clock::now();
+                for (int i = 0; i < n; i++) {
+                    const auto& d = io.at(i);
+                    on_reply(d.data, d.len, d.addr, udp_rx_time(d, batch_t));
+                }
+            }
+        }
+    }
+
+    res.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    if (seq > 0) res.send_window_s = std::chrono::duration<double>(last_send - start).count();
+    return res;
+}
+
+void merge_result(LoadResult& into, const LoadResult& p) {
+    if (into.error.empty()) into.error = p.error;
+    into.elapsed_s = std::max(into.elapsed_s, p.elapsed_s);
+    into.send_window_s = std::max(into.send_window_s, p.send_window_s);
+    into.sent += p.sent;
+    into.send_errors += p.send_errors;
+    into.replies_2xx += p.replies_2xx;
+    into.replies_non2xx += p.replies_non2xx;
+    into.timeouts += p.timeouts;
+    into.stray += p.stray;
+    into.max_send_lag_us = std::max(into.max_send_lag_us, p.max_send_lag_us);
+    for (auto& kv : p.status_counts) into.status_counts[kv.first] += kv.second;
+    into.latency.merge(p.latency);
+    into.service.merge(p.service);
+    into.connect.merge(p.connect);
+    into.per_worker_sent.push_back(p.sent);
+    into.uring = p.uring;
+}
+
+} // namespace
+
+LoadResult run_load(const LoadConfig& cfg) {
+    LoadResult res;
+    if (cfg.rate <= 0 || cfg.duration_s <= 0) { res.error = "rate and duration must be positive"; return res; }
+    if (cfg.workers < 1) { res.error = "workers must be positive"; return res; }
+
+    UdpAddr dst;
+    if (!resolver_cache().resolve(cfg.host, cfg.port, &dst, &res.dns_us)) { res.error = "DNS resolution failed"; return res; }
+
+    const int nw = cfg.workers;
+    const uint64_t total = (uint64_t)std::llround(cfg.rate * cfg.duration_s);
+    ScheduleClaims claims(total, ScheduleClaims::chunk_for(cfg.rate, UdpBatch().max_batch()));
+    StartGate gate(nw);
+
+    // Anything older than the timeout has been expired, so a ring never
+    // needs more than rate * timeout live slots. Workers split the rate but
+    // may drift apart, so each gets room for twice its even share; one that
+    // fills its ring stops claiming until it drains.
+    const double share = nw == 1 ? 1.0 : std::min(1.0, 2.0 / nw);
+    const uint64_t cap = (uint64_t)std::ceil(cfg.rate * cfg.timeout_ms / 1000.0 * share) + 1024;
+
+    // TCP connections are split across workers, at least one each.
+    const int conns = cfg.connections < 1 ? 1 : cfg.connections;
+    std::vector<LoadResult> parts(nw);
+    auto work = [&](int w) {
+        int mine = std::max(1, conns / nw + (w < conns % nw ? 1 : 0));
+        parts[w] = load_worker(cfg, dst, claims, gate, mine, cap);
+    };
+    std::vector<std::thread> pool;
+    for (int w = 1; w < nw; w++) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    for (auto& p : parts) merge_result(res, p);
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void load_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan load --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                --rate <req/s> --duration <seconds> [--timeout 2000] [--sockets 1] [--metrics-port N]\n"
+"                [--log <dir>] [--kernel-ts] [--transport udp|tcp] [--connections 1] [--workers 1]\n"
+"                [--io-uring]\n"
+"\n"
+"--workers N spreads the schedule over N threads, each with its own sockets\n"
+"(or its share of --connections); use up to one per core.\n"
+"--metrics-port serves Prometheus metrics on http://127.0.0.1:N/metrics during the run.\n"
+"--log <dir> appends every request's outcome to a binary log; see frogklan report.\n"
+"--kernel-ts ends each RTT on the kernel's receive stamp where supported.\n"
+"--transport tcp pipelines every request over --connections persistent TCP\n"
+"connections, opened before the run; connect time is reported separately.\n"
+"--io-uring moves UDP onto io_uring (Linux 6.0+) where the kernel has it,\n"
+"else recvmmsg/sendmmsg as usual.\n"
+"\n"
+"Example:\n"
+"  frogklan load --host 10.0.0.5 --from sip:qa@ex.com --to sip:qa@ex.com --rate 20000 --duration 30\n";
+}
+
+int cmd_load(int argc, char** argv) {
+    LoadConfig cfg;
+    int metrics_port = 0;
+    std::string log_dir;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--host") cfg.host = need("--host");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--from") cfg.from_uri = need("--from");
+        else if (a == "--to") cfg.to_uri = need("--to");
+        else if (a == "--rate") cfg.rate = std::stod(need("--rate"));
+        else if (a == "--duration") cfg.duration_s = std::stod(need("--duration"));
+        else if (a == "--timeout") cfg.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--sockets") cfg.sockets = std::stoi(need("--sockets"));
+        else if (a == "--workers") cfg.workers = std::stoi(need("--workers"));
+        else if (a == "--metrics-port") metrics_port = std::stoi(need("--metrics-port"));
+        else if (a == "--log") log_dir = need("--log");
+        else if (a == "--kernel-ts") cfg.kernel_ts = true;
+        else if (a == "--io-uring") cfg.uring = true;
+        else if (a == "--transport") {
+            std::string t = need("--transport");
+            if (t == "tcp") cfg.transport = SipTransport::Tcp;
+            else if (t != "udp") { std::cerr << "--transport must be udp or tcp\n"; return 2; }
+        }
+        else if (a == "--connections") cfg.connections = std::stoi(need("--connections"));
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (cfg.host.empty() || cfg.from_uri.empty() || cfg.to_uri.empty()) {
+        std::cerr << "Missing required args.\n";
+        load_usage();
+        return 2;
+    }
+    cfg.user_agent = "frogklan-sip-qa/" + std::string(APP_VERSION);
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_load_report.json";
+
+    MetricsRegistry metrics({cfg.host + ":" + std::to_string(cfg.port)});
+    MetricsServer server(metrics);
+    if (metrics_port > 0) {
+        std::string err;
+        if (!server.start((uint16_t)metrics_port, &err)) {
+            std::cerr << "load: " << err << "\n";
+            return 3;
+        }
+        cfg.metrics = &metrics;
+        std::cout << "Metrics: http://127.0.0.1:" << server.port() << "/metrics\n" << std::flush;
+    }
+
+    ResultLog log;
+    if (!log_dir.empty()) {
+        std::string err;
+        if (!log.open(log_dir, &err)) {
+            std::cerr << "load: " << err << "\n";
+            return 3;
+        }
+        cfg.log = &log;
+    }
+
+    LoadResult r = run_load(cfg);
+    log.close();
+    if (!r.ok) {
+        std::cerr << "load: " << r.error << "\n";
+        return 3;
+    }
+    double achieved = r.send_window_s > 0 ? (double)r.sent / r.send_window_s : 0;
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.host) << "\", \"port\": " << cfg.port << "},\n"
+"  \"transport\": \"" << sip_transport_name(cfg.transport) << "\",\n"
+"  \"rate_target\": " << cfg.rate << ",\n"
+"  \"rate_achieved\": " << achieved << ",\n"
+"  \"dns_us\": " << r.dns_us << ",\n"
+"  \"elapsed_s\": " << r.elapsed_s << ",\n"
+"  \"send_window_s\": " << r.send_window_s << ",\n"
+"  \"sent\": " << r.sent << ",\n"
+"  \"send_errors\": " << r.send_errors << ",\n"
+"  \"replies_2xx\": " << r.replies_2xx << ",\n"
+"  \"replies_non2xx\": " << r.replies_non2xx << ",\n"
+"  \"timeouts\": " << r.timeouts << ",\n"
+"  \"stray\": " << r.stray << ",\n"
+"  \"max_send_lag_us\": " << r.max_send_lag_us << ",\n"
+"  \"workers\": " << cfg.workers << ",\n"
+"  \"per_worker_sent\": [";
+    for (size_t i = 0; i < r.per_worker_sent.size(); i++) f << (i ? ", " : "") << r.per_worker_sent[i];
+    f << "],\n  \"status_counts\": {";
+    bool first = true;
+    for (auto& kv : r.status_counts) {
+        f << (first ? "" : ", ") << "\"" << kv.first << "\": " << kv.second;
+        first = false;
+    }
+    f << "},\n  \"latency_us\": ";
+    json_hist(f, r.latency);
+    f << ",\n  \"service_us\": ";
+    json_hist(f, r.service);
+    if (cfg.transport == SipTransport::Tcp) {
+        f << ",\n  \"connections\": " << cfg.connections << ",\n  \"connect_us\": ";
+        json_hist(f, r.connect);
+    } else {
+        f << ",\n  \"udp_io\": \"" << (r.uring ? "io_uring" : "mmsg") << "\"";
+    }
+    if (cfg.log) {
+        f << ",\n  \"log_dropped\": " << log.dropped() << ",\n  \"log_write_errors\": " << log.write_errors();
+    }
+    f << "\n}\n";
+    f.close();
+
+    std::cout << "SIP load report: " << report_path << "\n";
+    std::cout << "OPTIONS load: target=" << cfg.rate << "/s achieved=" << achieved << "/s over "
+              << r.send_window_s << " s\n";
+    if (cfg.uring && !r.uring && cfg.transport == SipTransport::Udp) {
+        std::cout << "io_uring unavailable here; ran on recvmmsg/sendmmsg\n";
+    }
+    if (cfg.workers > 1) {
+        std::cout << "per worker sent:";
+        for (uint64_t n : r.per_worker_sent) std::cout << " " << n;
+        std::cout << "\n";
+    }
+    std::cout << "sent=" << r.sent << " 2xx=" << r.replies_2xx << " non2xx=" << r.replies_non2xx
+              << " timeouts=" << r.timeouts << " send_errors=" << r.send_errors
+              << " stray=" << r.stray << " max_send_lag_us=" << r.max_send_lag_us << "\n";
+    print_hist(std::cout, "latency_us (from scheduled send)", r.latency);
+    print_hist(std::cout, "service_us (from actual send)   ", r.service);
+    if (cfg.transport == SipTransport::Tcp) print_hist(std::cout, "connect_us (TCP handshakes)     ", r.connect);
+    if (cfg.log) {
+        std::cout << "log: " << log_dir << " dropped=" << log.dropped()
+                  << " write_errors=" << log.write_errors() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "histogram.h"
+#include "sip.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class MetricsRegistry;
+class ResultLog;
+
+struct LoadConfig {
+    std::string host;
+    uint16_t port = 5060;
+    std::string from_uri;
+    std::string to_uri;
+    std::string user_agent;
+    double rate = 1000.0;      // OPTIONS per second, held regardless of replies
+    double duration_s = 10.0;
+    int timeout_ms = 2000;     // a reply later than this counts as a timeout
+    int sockets = 1;           // per worker
+    int workers = 1;           // threads, each with its own sockets or connections
+    bool kernel_ts = false;    // end RTTs on kernel receive stamps where supported (UDP)
+    bool uring = false;        // UDP over io_uring where the kernel has it (UdpBatch::use_uring)
+    SipTransport transport = SipTransport::Udp;
+    int connections = 1;       // TCP: pooled connections in all, split across workers
+    MetricsRegistry* metrics = nullptr;  // optional, one entry: the target
+    ResultLog* log = nullptr;            // optional, every request's outcome appended
+};
+
+struct LoadResult {
+    bool ok = false;
+    std::string error;
+    int64_t dns_us = 0;                  // target lookup, done before the clock starts
+    double elapsed_s = 0;
+    double send_window_s = 0;            // first to last send; basis of achieved rate
+    uint64_t sent = 0;
+    uint64_t send_errors = 0;
+    uint64_t replies_2xx = 0;
+    uint64_t replies_non2xx = 0;
+    uint64_t timeouts = 0;
+    uint64_t stray = 0;                  // unmatched or late replies
+    uint64_t max_send_lag_us = 0;        // how far our own sender fell behind
+    std::map<int, uint64_t> status_counts;
+    LatencyHistogram latency;            // from scheduled send time
+    LatencyHistogram service;            // from actual send time
+    LatencyHistogram connect;            // TCP handshakes, us; never part of the above
+    std::vector<uint64_t> per_worker_sent;
+    bool uring = false;                  // io_uring actually carried the UDP traffic
+};
+
+// Open-loop OPTIONS load: request k is due at start + k/rate whether or not
+// earlier requests were answered, and its latency is measured from that due
+// time so a stalled target or sender cannot hide queueing delay. Over TCP
+// the pool is connected before the clock starts and requests are pipelined
+// on it; a connection that drops is reopened by the next send.
+//
+// With workers > 1 each thread owns its sockets, connections, slot ring and
+// transaction table, and claims short runs of the shared schedule as it
+// goes (see ScheduleClaims), so no lock is taken per request and a worker
+// that falls behind is covered by the others. Results are merged at the end.
+LoadResult run_load(const LoadConfig& cfg);
+
+int cmd_load(int argc, char** argv);
@@ -1,102 +1,295 @@
+#include "app.h"
+#include "calls.h"
+#include "capacity.h"
+#include "digest_cache.h"
+#include "load.h"
+#include "monitor.h"
 #include "net.h"
+#include "prober.h"
+#include "replay.h"
+#include "responder.h"
+#include "resultlog.h"
+#include "resolver.h"
+#include "scenario.h"
 #include "sip.h"
+#include "sip_id.h"
+#include "sip_timers.h"
+#include "storm.h"
+#include "tcp_transport.h"
+#include "udp_uring.h"
 
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <chrono>
-#include <random>
+#include <thread>
+#include <vector>
 
 namespace fs = std::filesystem;
 
-static const char* APP_NAME = "frogklan";
-static const char* APP_VERSION = "1.0.0-qa";
-
-static std::string os_name() {
-#if defined(_WIN32)
-    return "Windows";
-#elif defined(__APPLE__)
-    return "macOS";
-#elif defined(__linux__)
-    return "Linux";
-#else
-    return "Unknown";
-#endif
-}
-
-static fs::path app_data_dir() {
-#if defined(_WIN32)
-    const char* p = std::getenv("APPDATA");
-    return fs::path(p ? p : fs::temp_directory_path().string()) / APP_NAME;
-#elif defined(__APPLE__)
-    const char* h = std::getenv("HOME");
-    return fs::path(h ? h : "/tmp") / "Library/Application Support" / APP_NAME;
-#else
-    const char* h = std::getenv("HOME");
-    return fs::path(h ? h : "/tmp") / (std::string(".") + APP_NAME);
-#endif
-}
-
-static std::string rand_hex(size_t nbytes) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis(0,255);
-    static const char* h="0123456789abcdef";
-    std::string s; s.reserve(nbytes*2);
-    for (size_t i=0;i<nbytes;i++){
-        int v=dis(gen);
-        s.push_back(h[(v>>4)&15]); s.push_back(h[v&15]);
-    }
-    return s;
-}
-
 static void usage() {
     std::cout <<
 "frogklan (SIP QA) " << APP_VERSION << "\n"
 "Usage:\n"
-"  frogklan qa --host <sip.host> [--port 5060] [--timeout 1200] [--retries 2]\n"
-"              --from <sip:you@domain> --to <sip:dest@domain>\n"
+"  frogklan qa --host <sip.host> [--port 5060] [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N]\n"
+"              --from <sip:you@domain> --to <sip:dest@domain> [--kernel-ts] [--transport udp|tcp]\n"
 "              [--register --aor <sip:you@domain> --contact <sip:you@host>\n"
-"               --user <u> --pass <p> --expires 300]\n"
+"               --user <u> --pass <p> --expires 300 [--refresh 0]]\n"
+"  frogklan qa --targets <file> --from <sip:you@domain> [--to <sip:dest@domain>]\n"
+"              [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N] [--inflight 2000] [--sockets 1]\n"
+"              [--workers 1] [--kernel-ts] [--io-uring]\n"
+"  frogklan load --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                --rate <req/s> --duration <seconds> [--timeout 2000] [--sockets 1] [--metrics-port N]\n"
+"                [--log <dir>] [--kernel-ts] [--transport udp|tcp] [--connections 1] [--workers 1]\n"
+"                [--io-uring]\n"
+"  frogklan storm --host <sip.host> [--port 5060] --creds <file.csv> [--rate 1000]\n"
+"                 [--workers 4] [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N]\n"
+"                 [--expires 300] [--inflight 10000] [--no-preemptive]\n"
+"  frogklan capacity --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                    [--method options|register] [--creds <file.csv>] [--search binary|aimd]\n"
+"                    [--min-rate 100] [--max-rate 100000] [--step 5] [--cooldown 1000]\n"
+"                    [--slo-p99 100000] [--slo-timeouts 0.001] [--slo-503 0.001] [--workers 1]\n"
+"  frogklan calls --host <sip.host> [--port 5060] --from <sip:you@domain> --to <sip:dest@domain>\n"
+"                 --rate <calls/s> --duration <seconds> [--hold 10000] [--timeout 32000]\n"
+"                 [--sockets 1] [--max-dialogs 200000] [--media-ip 127.0.0.1] [--io-uring]\n"
+"  frogklan scenario --file <flow.sf> --host <sip.host> [--port 5060] [--rate 10] [--count 1]\n"
+"                    [--concurrency 1000] [--workers 1] [--user <name> --pass <pw>] [--set name=value]\n"
+"                    [--check] [--io-uring]\n"
+"  frogklan monitor --targets <file> --from <sip:you@domain> [--interval 30] [--jitter 0.1]\n"
+"                   [--rise 2] [--fall 3] [--degraded-rtt 1000] [--status-every 60] [--duration 0]\n"
+"                   [--metrics-port N] [--log <dir>] [--kernel-ts]\n"
+"  frogklan replay <file.pcap|file.pcapng> --host <lab.host> [--port 5060] [--speed 1]\n"
+"                  [--src <ip>] [--dst-port <port>] [--local-ip 127.0.0.1]\n"
+"  frogklan report [--log <dir>] [--since 24h] [--until <time>] [--window 1h] [--target <host:port>]\n"
+"  frogklan responder [--bind 127.0.0.1] [--port 5060] [--workers 4] [--creds <file.csv>]\n"
+"                     [--user <u> --pass <p>] [--delay 0] [--ring 0] [--drop 0] [--fail-503 0] [--tcp]\n"
+"                     [--duration 0]\n"
+"\n"
+"Requests are retransmitted per RFC 3261 Timer E (T1 doubling to T2) until\n"
+"--timeout (Timer F) expires; --retries caps the number of retransmissions.\n"
+"--kernel-ts takes RTT from kernel socket timestamps where the OS has them,\n"
+"leaving scheduler and syscall latency out of the measurement.\n"
+"--transport tcp keeps one persistent connection per target and sends no\n"
+"retransmissions (Timer F only); connect time is reported apart from RTT.\n"
+"--io-uring runs the multi-socket engines' UDP on io_uring (multishot receive,\n"
+"batched sends) where the kernel has it, and on recvmmsg/sendmmsg otherwise.\n"
 "\n"
 "Examples:\n"
 "  frogklan qa --host sip.example.com --from sip:qa@ex.com --to sip:qa@ex.com\n"
 "  frogklan qa --host sip.example.com --from sip:qa@ex.com --to sip:qa@ex.com \\\n"
 "      --register --aor sip:1001@example.com --contact sip:1001@sip.example.com \\\n"
-"      --user 1001 --pass secret --expires 120\n";
+"      --user 1001 --pass secret --expires 120\n"
+"  frogklan qa --targets trunks.txt --from sip:qa@ex.com\n";
 }
 
-static std::string json_escape(const std::string& s){
-    std::string o; o.reserve(s.size()+8);
-    for (char c: s){
-        switch(c){
-            case '\\': o += "\\\\"; break;
-            case '"': o += "\\\""; break;
-            case '\n': o += "\\n"; break;
-            case '\r': o += "\\r"; break;
-            case '\t': o += "\\t"; break;
-            default: o.push_back(c); break;
+// One refresh REGISTER after the initial registration. `challenged` is set
+// when the cached nonce was refused and a second round trip was needed.
+struct RegisterRefresh {
+    SipProbeResult res;
+    bool challenged = false;
+    bool stale = false;
+};
+
+// One non-INVITE client transaction: the request is resent unchanged on the
+// Timer E schedule until a final response to it arrives or Timer F fires.
+// Replies are matched on the top Via branch and Call-ID, so a late answer to
+// an earlier transaction's retransmission on the same socket is skipped, as
+// are provisionals. elapsed_ns spans the whole transaction, from the first
+// transmission; when the first send is answered directly it is the
+// kernel-stamped time the client measured, if it had one. Over TCP (tcp set)
+// nothing is retransmitted and only Timer F applies; a dropped connection is
+// reopened first, outside the timed transaction.
+static UdpReply request_transaction(UdpClient& udp, SipTcpConnection* tcp, const UdpAddr& dst,
+                                    const std::string& msg, const SipTimers& timers, int* retransmits) {
+    if (tcp) {
+        if (retransmits) *retransmits = 0;
+        if (!tcp->is_open() && !tcp->connect(dst, timers.transaction_timeout_ms())) return UdpReply{};
+        return tcp->request(msg, timers.transaction_timeout_ms());
+    }
+    using Clock = std::chrono::steady_clock;
+    const auto t0 = Clock::now();
+    auto now_ms = [&]{
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    };
+
+    SipRequestView req;
+    std::string branch, call_id;
+    if (parse_sip_request_view(msg.data(), msg.size(), &req) && req.via_count > 0) {
+        branch = std::string(sip_via_branch(req.vias[0]));
+        call_id = std::string(req.call_id);
+    }
+    SipResponseView resp;
+    auto answers = [&](const UdpReply& r) {
+        return r.ok && parse_sip_response_view(r.data.data(), r.data.size(), &resp) && resp.status >= 200 &&
+               sip_top_via_branch(resp) == branch && resp.call_id == call_id;
+    };
+
+    SipRetransmit retx;
+    uint64_t now = 0;
+    uint64_t fire = retx.on_send(timers, now);
+    UdpReply rep = udp.request(dst, msg, (int)(fire > now ? fire - now : 1));
+    bool direct = true;   // rep came back on the first send's own receive
+    for (;;) {
+        if (answers(rep)) break;
+        const bool stray = rep.ok;
+        now = now_ms();
+        if (retx.expired(timers, now)) { rep = UdpReply{}; break; }
+        if (now >= fire) {
+            fire = retx.on_send(timers, now);
+            rep = udp.request(dst, msg, (int)(fire > now ? fire - now : 1));
+        } else if (stray) {
+            // Someone else's answer, or a provisional: keep waiting on the
+            // time left before the next retransmission.
+            rep = udp.receive((int)(fire - now));
+        } else {
+            // The receive failed early; hold the schedule rather than resend.
+            std::this_thread::sleep_for(std::chrono::milliseconds(fire - now));
+            rep = UdpReply{};
         }
+        direct = false;
+    }
+    const int64_t t0_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t0.time_since_epoch()).count();
+    if (rep.ok && !direct) {
+        rep.elapsed_ns = rep.rx_ns - t0_ns;
+        rep.kernel_ts = false;
+    }
+    if (retransmits) *retransmits = retx.retransmits();
+    return rep;
+}
+
+// RTT for reports and the console: fractional milliseconds, -1 if none.
+static std::string rtt_ms_text(int64_t ns) {
+    if (ns < 0) return "-1";
+    char b[32];
+    std::snprintf(b, sizeof(b), "%.3f", ns / 1e6);
+    return b;
+}
+
+static int run_targets_qa(const std::string& targets_path,
+                          const std::string& from_uri, const std::string& to_uri,
+                          const SipTimers& timers, int max_inflight, int sockets, int workers,
+                          bool kernel_ts, bool uring) {
+    std::vector<ProbeTarget> targets;
+    std::string err;
+    if (!load_probe_targets(targets_path, &targets, &err)) {
+        std::cerr << err << "\n";
+        return 2;
+    }
+    if (targets.empty()) {
+        std::cerr << "No targets in " << targets_path << "\n";
+        return 2;
+    }
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_qa_targets_report.json";
+
+    MultiProbeConfig cfg;
+    cfg.from_uri = from_uri;
+    cfg.to_uri = to_uri;
+    cfg.user_agent = "frogklan-sip-qa/" + std::string(APP_VERSION);
+    cfg.timers = timers;
+    cfg.max_inflight = max_inflight;
+    cfg.sockets = sockets;
+    cfg.workers = workers;
+    cfg.kernel_ts = kernel_ts;
+    cfg.uring = uring && udp_uring_supported();
+    if (uring && !cfg.uring) std::cout << "io_uring unavailable here; running on recvmmsg/sendmmsg\n";
+
+    // DNS is paid once, in parallel, before the probe clock starts.
+    std::vector<std::string> hosts;
+    for (auto& t : targets) hosts.push_back(t.host);
+    int64_t dns_us = resolver_cache().prefetch(hosts, cfg.resolve_threads);
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto results = run_multi_probe(targets, cfg);
+    auto t1 = std::chrono::steady_clock::now();
+    auto wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+
+    size_t up = 0;
+    for (auto& r : results) if (r.ok) up++;
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"elapsed_ms\": " << wall_ms << ",\n"
+"  \"dns_us\": " << dns_us << ",\n"
+"  \"timers\": {\"t1_ms\": " << timers.t1_ms << ", \"t2_ms\": " << timers.t2_ms
+    << ", \"timeout_ms\": " << timers.transaction_timeout_ms() << "},\n"
+"  \"targets_total\": " << targets.size() << ",\n"
+"  \"targets_ok\": " << up << ",\n"
+"  \"udp_io\": \"" << (cfg.uring ? "io_uring" : "mmsg") << "\",\n"
+"  \"targets\": [";
+    for (size_t i = 0; i < targets.size(); i++) {
+        const auto& t = targets[i];
+        const auto& r = results[i];
+        f << (i ? ",\n" : "\n")
+          << "    {\"host\": \"" << json_escape(t.host) << "\", \"port\": " << t.port
+          << ", \"ok\": " << (r.ok ? "true" : "false")
+          << ", \"status\": " << r.status
+          << ", \"rtt_ns\": " << r.rtt_ns
+          << ", \"rtt_ms\": " << rtt_ms_text(r.rtt_ns)
+          << ", \"kernel_ts\": " << (r.kernel_ts ? "true" : "false")
+          << ", \"retransmits\": " << r.retransmits
+          << ", \"dns_us\": " << r.dns_us
+          << ", \"peer_ip\": \"" << json_escape(r.peer_ip) << "\""
+          << ", \"peer_port\": " << r.peer_port
+          << ", \"note\": \"" << json_escape(r.note) << "\"}";
+    }
+    f << "\n  ]\n}\n";
+    f.close();
+
+    std::cout << "SIP QA report: " << report_path << "\n";
+    for (size_t i = 0; i < targets.size(); i++) {
+        const auto& r = results[i];
+        std::cout << "OPTIONS " << targets[i].host << ":" << targets[i].port << ": "
+                  << (r.ok ? "OK" : "FAIL")
+                  << " status=" << r.status << " rtt_ms=" << rtt_ms_text(r.rtt_ns)
+                  << " peer=" << r.peer_ip << ":" << r.peer_port
+                  << " (" << r.note << ")\n";
     }
-    return o;
+    std::cout << up << "/" << targets.size() << " targets answered in " << wall_ms << " ms"
+              << " (DNS " << dns_us / 1000 << " ms before start)\n";
+    return 0;
 }
 
 int main(int argc, char** argv) {
     if (argc < 2) { usage(); return 0; }
     std::string cmd = argv[1];
+    if (cmd == "load") return cmd_load(argc, argv);
+    if (cmd == "storm") return cmd_storm(argc, argv);
+    if (cmd == "capacity") return cmd_capacity(argc, argv);
+    if (cmd == "calls") return cmd_calls(argc, argv);
+    if (cmd == "scenario") return cmd_scenario(argc, argv);
+    if (cmd == "monitor") return cmd_monitor(argc, argv);
+    if (cmd == "report") return cmd_report(argc, argv);
+    if (cmd == "replay") return cmd_replay(argc, argv);
+    if (cmd == "responder") return cmd_responder(argc, argv);
     if (cmd != "qa") { usage(); return 1; }
 
     std::string host;
     uint16_t port = 5060;
-    int timeout_ms = 1200;
-    int retries = 2;
+    SipTimers timers;
 
     std::string from_uri, to_uri;
 
     bool do_register = false;
     std::string aor_uri, contact_uri, user, pass;
     int expires = 300;
+    int refresh = 0;
+
+    std::string targets_path;
+    int max_inflight = 2000;
+    int sockets = 1;
+    int workers = 1;
+    bool uring = false;
+    bool kernel_ts = false;
+    SipTransport transport = SipTransport::Udp;
 
     // very simple arg parse
     for (int i=2;i<argc;i++){
@@ -108,8 +301,10 @@ int main(int argc, char** argv) {
 
         if (a == "--host") host = need("--host");
         else if (a == "--port") port = (uint16_t)std::stoi(need("--port"));
-        else if (a == "--timeout") timeout_ms = std::stoi(need("--timeout"));
-        else if (a == "--retries") retries = std::stoi(need("--retries"));
+        else if (a == "--t1") timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--timeout") timers.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--retries") timers.max_retransmits = std::stoi(need("--retries"));
         else if (a == "--from") from_uri = need("--from");
         else if (a == "--to") to_uri = need("--to");
         else if (a == "--register") do_register = true;
@@ -118,12 +313,45 @@ int main(int argc, char** argv) {
         else if (a == "--user") user = need("--user");
         else if (a == "--pass") pass = need("--pass");
         else if (a == "--expires") expires = std::stoi(need("--expires"));
+        else if (a == "--refresh") refresh = std::stoi(need("--refresh"));
+        else if (a == "--targets") targets_path = need("--targets");
+        else if (a == "--inflight") max_inflight = std::stoi(need("--inflight"));
+        else if (a == "--sockets") sockets = std::stoi(need("--sockets"));
+        else if (a == "--workers") workers = std::stoi(need("--workers"));
+        else if (a == "--kernel-ts") kernel_ts = true;
+        else if (a == "--io-uring") uring = true;
+        else if (a == "--transport") {
+            std::string t = need("--transport");
+            if (t == "tcp") transport = SipTransport::Tcp;
+            else if (t != "udp") { std::cerr << "--transport must be udp or tcp\n"; return 2; }
+        }
         else {
             std::cerr << "Unknown arg: " << a << "\n";
             return 2;
         }
     }
 
+    if (timers.t1_ms <= 0 || timers.t2_ms < timers.t1_ms) {
+        std::cerr << "--t1 must be positive and --t2 at least --t1\n";
+        return 2;
+    }
+
+    if (!targets_path.empty()) {
+        if (from_uri.empty()) {
+            std::cerr << "--targets requires --from\n";
+            return 2;
+        }
+        if (do_register) {
+            std::cerr << "--register is not supported with --targets\n";
+            return 2;
+        }
+        if (transport != SipTransport::Udp) {
+            std::cerr << "--transport tcp is not supported with --targets\n";
+            return 2;
+        }
+        return run_targets_qa(targets_path, from_uri, to_uri, timers, max_inflight, sockets, workers, kernel_ts, uring);
+    }
+
     if (host.empty() || from_uri.empty() || to_uri.empty()) {
         std::cerr << "Missing required args.\n";
         usage();
@@ -145,25 +373,45 @@ int main(int argc, char** argv) {
         std::cerr << "Failed to open UDP socket.\n";
         return 3;
     }
+    if (kernel_ts && !udp.enable_kernel_timestamps()) {
+        std::cerr << "Kernel timestamps unavailable; timing in userspace.\n";
+    }
 
-    UdpEndpoint ep{host, port};
+    // Resolved once up front; every probe and retry below reuses the address,
+    // so lookup time is reported on its own and never lands in rtt_ns.
+    UdpAddr dst;
+    int64_t dns_us = 0;
+    if (!resolver_cache().resolve(host, port, &dst, &dns_us)) {
+        std::cerr << "DNS resolution failed for " << host << "\n";
+        return 3;
+    }
     std::string ua = "frogklan-sip-qa/" + std::string(APP_VERSION);
 
+    // The TCP handshake is timed on its own, like DNS, and the connection is
+    // then reused by every transaction below.
+    SipTcpConnection tcp_conn;
+    SipTcpConnection* tcp = nullptr;
+    int64_t connect_us = -1;
+    if (transport == SipTransport::Tcp) {
+        if (!tcp_conn.connect(dst, timers.transaction_timeout_ms(), &connect_us)) {
+            std::cerr << "TCP connect to " << udp_addr_ip(dst) << ":" << port << " failed\n";
+            return 3;
+        }
+        tcp = &tcp_conn;
+    }
+
     // OPTIONS probe
     SipProbeResult opt_res;
     {
-        std::string call_id = rand_hex(12) + "@frogklan";
-        std::string branch = "z9hG4bK-" + rand_hex(8);
-        std::string tag = rand_hex(6);
+        std::string call_id = sip_new_call_id();
+        std::string branch = sip_new_branch();
+        std::string tag = sip_new_tag();
 
         int cseq = 1;
-        std::string msg = make_sip_options(host, port, from_uri, to_uri, ua, call_id, cseq, branch, tag);
+        std::string msg = make_sip_options(host, port, from_uri, to_uri, ua, call_id, cseq, branch, tag,
+                                           transport);
 
-        UdpReply rep;
-        for (int k=0;k<=retries;k++){
-            rep = udp.request(ep, msg, timeout_ms);
-            if (rep.ok) break;
-        }
+        UdpReply rep = request_transaction(udp, tcp, dst, msg, timers, &opt_res.retransmits);
 
         if (!rep.ok) {
             opt_res.ok = false;
@@ -172,7 +420,8 @@ int main(int argc, char** argv) {
             auto resp = parse_sip_response(rep.data);
             opt_res.ok = (resp.status >= 100);
             opt_res.status = resp.status;
-            opt_res.rtt_ms = rep.elapsed_ms;
+            opt_res.rtt_ns = rep.elapsed_ns;
+            opt_res.kernel_ts = rep.kernel_ts;
             opt_res.peer_ip = rep.peer_ip;
             opt_res.peer_port = rep.peer_port;
             opt_res.note = resp.reason;
@@ -181,19 +430,19 @@ int main(int argc, char** argv) {
 
     // REGISTER probe (optional)
     SipProbeResult reg_res;
+    std::vector<RegisterRefresh> refreshes;
+    DigestAuthCache auth_cache;
+    const std::string reg_uri = "sip:" + host + (port != 5060 ? (":" + std::to_string(port)) : "");
     if (do_register) {
-        std::string call_id = rand_hex(12) + "@frogklan";
-        std::string branch = "z9hG4bK-" + rand_hex(8);
-        std::string tag = rand_hex(6);
+        std::string call_id = sip_new_call_id();
+        std::string branch = sip_new_branch();
+        std::string tag = sip_new_tag();
         int cseq = 1;
 
         // 1) initial REGISTER
-        std::string msg1 = make_sip_register(host, port, aor_uri, contact_uri, ua, call_id, cseq, branch, tag, expires, "");
-        UdpReply rep1;
-        for (int k=0;k<=retries;k++){
-            rep1 = udp.request(ep, msg1, timeout_ms);
-            if (rep1.ok) break;
-        }
+        std::string msg1 = make_sip_register(host, port, aor_uri, contact_uri, ua, call_id, cseq, branch, tag, expires, "",
+                                             false, transport);
+        UdpReply rep1 = request_transaction(udp, tcp, dst, msg1, timers, &reg_res.retransmits);
 
         if (!rep1.ok) {
             reg_res.ok = false;
@@ -201,7 +450,8 @@ int main(int argc, char** argv) {
         } else {
             auto resp1 = parse_sip_response(rep1.data);
             reg_res.status = resp1.status;
-            reg_res.rtt_ms = rep1.elapsed_ms;
+            reg_res.rtt_ns = rep1.elapsed_ns;
+            reg_res.kernel_ts = rep1.kernel_ts;
             reg_res.peer_ip = rep1.peer_ip;
             reg_res.peer_port = rep1.peer_port;
             reg_res.note = resp1.reason;
@@ -212,21 +462,19 @@ int main(int argc, char** argv) {
                     reg_res.ok = false;
                     reg_res.note = "REGISTER got 401 but no parsable Digest challenge";
                 } else {
-                    // 2) retry with Authorization
-                    std::string uri = "sip:" + host + (port != 5060 ? (":" + std::to_string(port)) : "");
-                    std::string cnonce = rand_hex(8);
-                    std::string nc = "00000001";
-                    std::string auth = build_digest_authorization("REGISTER", uri, user, pass, ch, cnonce, nc);
+                    // 2) retry with Authorization; the challenge is kept for refreshes
+                    auth_cache.remember(ch, resp1.status == 407);
+                    std::string auth;
+                    bool proxy = false;
+                    auth_cache.authorize("REGISTER", reg_uri, user, pass, sip_new_cnonce(), &auth, &proxy);
 
                     cseq += 1;
                     std::string msg2 = make_sip_register(host, port, aor_uri, contact_uri, ua, call_id, cseq,
-                                                         "z9hG4bK-" + rand_hex(8), tag, expires, auth);
+                                                         sip_new_branch(), tag, expires, auth, proxy, transport);
 
-                    UdpReply rep2;
-                    for (int k=0;k<=retries;k++){
-                        rep2 = udp.request(ep, msg2, timeout_ms);
-                        if (rep2.ok) break;
-                    }
+                    int retx2 = 0;
+                    UdpReply rep2 = request_transaction(udp, tcp, dst, msg2, timers, &retx2);
+                    reg_res.retransmits += retx2;
 
                     if (!rep2.ok) {
                         reg_res.ok = false;
@@ -235,7 +483,8 @@ int main(int argc, char** argv) {
                         auto resp2 = parse_sip_response(rep2.data);
                         reg_res.ok = (resp2.status >= 200 && resp2.status < 300);
                         reg_res.status = resp2.status;
-                        reg_res.rtt_ms = rep2.elapsed_ms;
+                        reg_res.rtt_ns = rep2.elapsed_ns;
+                        reg_res.kernel_ts = rep2.kernel_ts;
                         reg_res.peer_ip = rep2.peer_ip;
                         reg_res.peer_port = rep2.peer_port;
                         reg_res.note = resp2.reason;
@@ -245,6 +494,59 @@ int main(int argc, char** argv) {
                 reg_res.ok = (resp1.status >= 200 && resp1.status < 300);
             }
         }
+
+        // 3) refreshes: credentials go up front against the cached nonce with
+        // an incrementing nc; only a refused (e.g. stale) nonce costs a second
+        // round trip.
+        for (int r = 0; r < refresh && reg_res.ok; r++) {
+            RegisterRefresh rr;
+            std::string auth;
+            bool proxy = false;
+            auth_cache.authorize("REGISTER", reg_uri, user, pass, sip_new_cnonce(), &auth, &proxy);
+            cseq += 1;
+            std::string msg = make_sip_register(host, port, aor_uri, contact_uri, ua, call_id, cseq,
+                                                sip_new_branch(), tag, expires, auth, proxy, transport);
+            UdpReply rep = request_transaction(udp, tcp, dst, msg, timers, &rr.res.retransmits);
+            int64_t total_ns = rep.elapsed_ns;
+            bool total_kernel = rep.kernel_ts;
+            SipResponse resp;
+            if (rep.ok) {
+                resp = parse_sip_response(rep.data);
+                if (resp.status == 401 || resp.status == 407) {
+                    auto ch = parse_www_authenticate_digest(resp);
+                    rr.challenged = true;
+                    rr.stale = ch.stale;
+                    if (ch.ok) {
+                        auth_cache.remember(ch, resp.status == 407);
+                        auth_cache.authorize("REGISTER", reg_uri, user, pass, sip_new_cnonce(), &auth, &proxy);
+                        cseq += 1;
+                        msg = make_sip_register(host, port, aor_uri, contact_uri, ua, call_id, cseq,
+                                                sip_new_branch(), tag, expires, auth, proxy, transport);
+                        int retx = 0;
+                        rep = request_transaction(udp, tcp, dst, msg, timers, &retx);
+                        rr.res.retransmits += retx;
+                        if (rep.ok) {
+                            resp = parse_sip_response(rep.data);
+                            total_ns += rep.elapsed_ns;
+                            total_kernel = total_kernel && rep.kernel_ts;
+                        }
+                    }
+                }
+            }
+            if (!rep.ok) {
+                rr.res.note = "Refresh REGISTER timed out";
+            } else {
+                rr.res.ok = (resp.status >= 200 && resp.status < 300);
+                rr.res.status = resp.status;
+                rr.res.rtt_ns = total_ns;
+                rr.res.kernel_ts = total_kernel;
+                rr.res.peer_ip = rep.peer_ip;
+                rr.res.peer_port = rep.peer_port;
+                rr.res.note = resp.reason;
+            }
+            refreshes.push_back(rr);
+            if (!rr.res.ok) break;
+        }
     }
 
     // Write JSON report
@@ -254,11 +556,20 @@ int main(int argc, char** argv) {
 "  \"app\": \"" << APP_NAME << "\",\n"
 "  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
 "  \"os\": \"" << json_escape(os_name()) << "\",\n"
-"  \"target\": {\"host\": \"" << json_escape(host) << "\", \"port\": " << port << "},\n"
+"  \"target\": {\"host\": \"" << json_escape(host) << "\", \"port\": " << port
+    << ", \"ip\": \"" << udp_addr_ip(dst) << "\"},\n"
+"  \"dns_us\": " << dns_us << ",\n"
+"  \"transport\": \"" << sip_transport_name(transport) << "\",\n"
+"  \"connect_us\": " << connect_us << ",\n"
+"  \"timers\": {\"t1_ms\": " << timers.t1_ms << ", \"t2_ms\": " << timers.t2_ms
+    << ", \"timeout_ms\": " << timers.transaction_timeout_ms() << "},\n"
 "  \"options\": {\n"
 "    \"ok\": " << (opt_res.ok ? "true" : "false") << ",\n"
 "    \"status\": " << opt_res.status << ",\n"
-"    \"rtt_ms\": " << opt_res.rtt_ms << ",\n"
+"    \"rtt_ns\": " << opt_res.rtt_ns << ",\n"
+"    \"rtt_ms\": " << rtt_ms_text(opt_res.rtt_ns) << ",\n"
+"    \"kernel_ts\": " << (opt_res.kernel_ts ? "true" : "false") << ",\n"
+"    \"retransmits\": " << opt_res.retransmits << ",\n"
 "    \"peer_ip\": \"" << json_escape(opt_res.peer_ip) << "\",\n"
 "    \"peer_port\": " << opt_res.peer_port << ",\n"
 "    \"note\": \"" << json_escape(opt_res.note) << "\"\n"
@@ -269,26 +580,54 @@ int main(int argc, char** argv) {
 "  \"register\": {\n"
 "    \"ok\": " << (reg_res.ok ? "true" : "false") << ",\n"
 "    \"status\": " << reg_res.status << ",\n"
-"    \"rtt_ms\": " << reg_res.rtt_ms << ",\n"
+"    \"rtt_ns\": " << reg_res.rtt_ns << ",\n"
+"    \"rtt_ms\": " << rtt_ms_text(reg_res.rtt_ns) << ",\n"
+"    \"kernel_ts\": " << (reg_res.kernel_ts ? "true" : "false") << ",\n"
+"    \"retransmits\": " << reg_res.retransmits << ",\n"
 "    \"peer_ip\": \"" << json_escape(reg_res.peer_ip) << "\",\n"
 "    \"peer_port\": " << reg_res.peer_port << ",\n"
 "    \"note\": \"" << json_escape(reg_res.note) << "\"\n"
 "  }";
+        if (refresh > 0) {
+            f << ",\n  \"refreshes\": [";
+            for (size_t i = 0; i < refreshes.size(); i++) {
+                const auto& rr = refreshes[i];
+                f << (i ? ",\n" : "\n")
+                  << "    {\"ok\": " << (rr.res.ok ? "true" : "false")
+                  << ", \"status\": " << rr.res.status
+                  << ", \"rtt_ns\": " << rr.res.rtt_ns
+                  << ", \"rtt_ms\": " << rtt_ms_text(rr.res.rtt_ns)
+                  << ", \"retransmits\": " << rr.res.retransmits
+                  << ", \"challenged\": " << (rr.challenged ? "true" : "false")
+                  << ", \"stale\": " << (rr.stale ? "true" : "false")
+                  << ", \"note\": \"" << json_escape(rr.res.note) << "\"}";
+            }
+            f << "\n  ]";
+        }
     }
     f << "\n}\n";
     f.close();
 
     // Console summary
     std::cout << "SIP QA report: " << report_path << "\n";
+    std::cout << "DNS: " << host << " -> " << udp_addr_ip(dst) << " in " << dns_us << " us\n";
+    if (tcp) std::cout << "TCP connect: " << connect_us << " us\n";
     std::cout << "OPTIONS: " << (opt_res.ok ? "OK" : "FAIL")
-              << " status=" << opt_res.status << " rtt_ms=" << opt_res.rtt_ms
+              << " status=" << opt_res.status << " rtt_ms=" << rtt_ms_text(opt_res.rtt_ns)
               << " peer=" << opt_res.peer_ip << ":" << opt_res.peer_port
               << " (" << opt_res.note << ")\n";
     if (do_register) {
         std::cout << "REGISTER: " << (reg_res.ok ? "OK" : "FAIL")
-                  << " status=" << reg_res.status << " rtt_ms=" << reg_res.rtt_ms
+                  << " status=" << reg_res.status << " rtt_ms=" << rtt_ms_text(reg_res.rtt_ns)
                   << " peer=" << reg_res.peer_ip << ":" << reg_res.peer_port
                   << " (" << reg_res.note << ")\n";
+        for (size_t i = 0; i < refreshes.size(); i++) {
+            const auto& rr = refreshes[i];
+            std::cout << "REFRESH " << (i + 1) << ": " << (rr.res.ok ? "OK" : "FAIL")
+                      << " status=" << rr.res.status << " rtt_ms=" << rtt_ms_text(rr.res.rtt_ns)
+                      << (rr.challenged ? (rr.stale ? " challenged(stale)" : " challenged") : " preemptive")
+                      << " (" << rr.res.note << ")\n";
+        }
     }
 
     return 0;
@@ -0,0 +1,54 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+bool MappedFile::map(const std::filesystem::path& p) {
+    unmap();
+#if defined(_WIN32)
+    file_ = CreateFileW(p.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file_, &sz) || sz.QuadPart == 0) return false;
+    map_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!map_) return false;
+    data_ = (const char*)MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+    size_ = (size_t)sz.QuadPart;
+#else
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+    void* m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) return false;
+    madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+    data_ = (const char*)m;
+    size_ = (size_t)st.st_size;
+#endif
+    return data_ != nullptr;
+}
+
+void MappedFile::unmap() {
+#if defined(_WIN32)
+    if (data_) UnmapViewOfFile(data_);
+    if (map_) CloseHandle(map_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+    map_ = nullptr;
+#else
+    if (data_) munmap((void*)data_, size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
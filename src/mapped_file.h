@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+// Read-only view of a whole file, mapped for one sequential pass.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { unmap(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False for a missing or empty file.
+    bool map(const std::filesystem::path& p);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void unmap();
+
+#if defined(_WIN32)
+    void* file_ = (void*)-1;      // HANDLE, INVALID_HANDLE_VALUE when closed
+    void* map_ = nullptr;
+#endif
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
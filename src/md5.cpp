@@ -168,6 +168,10 @@ std::string MD5::final_hex() {
     return hex(out,16);
 }
 
+void MD5::final_raw(uint8_t out[16]) {
+    if (!finalized_) finalize(out);
+}
+
 std::string MD5::md5_hex(const std::string& s) {
     MD5 m; m.update(s); return m.final_hex();
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct MD5 {
@@ -8,6 +9,7 @@ struct MD5 {
     void update(const uint8_t* data, size_t len);
     void update(const std::string& s);
     std::string final_hex();
+    void final_raw(uint8_t out[16]);
 
     static std::string hex(const uint8_t* d, size_t n);
     static std::string md5_hex(const std::string& s);
@@ -22,3 +24,9 @@ private:
     size_t buffer_len_;
     bool finalized_;
 };
+
+// Hashes n independent messages into out[i], 8 at a time with AVX2 or 4 with
+// SSE2 when the CPU supports it (checked once at runtime), scalar otherwise.
+void md5_batch(const std::string_view* msgs, size_t n, uint8_t (*out)[16]);
+// "avx2", "sse2" or "scalar": the path md5_batch takes on this machine.
+const char* md5_batch_backend();
@@ -0,0 +1,30 @@
+// 8-lane MD5 kernel. This file alone is compiled with AVX2 enabled (see
+// CMakeLists.txt); it is only entered after a runtime CPU check.
+#include "md5_lanes.h"
+
+#if defined(FROGKLAN_MD5_AVX2)
+#include <immintrin.h>
+
+namespace {
+
+struct V8 {
+    using reg = __m256i;
+    static constexpr size_t kLanes = 8;
+    static reg load(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    static void store(uint32_t* p, reg v) { _mm256_store_si256((__m256i*)p, v); }
+    static reg set1(uint32_t v) { return _mm256_set1_epi32((int)v); }
+    static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+    static reg and_(reg a, reg b) { return _mm256_and_si256(a, b); }
+    static reg or_(reg a, reg b) { return _mm256_or_si256(a, b); }
+    static reg xor_(reg a, reg b) { return _mm256_xor_si256(a, b); }
+    static reg andnot(reg a, reg b) { return _mm256_andnot_si256(a, b); }
+    static reg not_(reg a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+    template <int S> static reg rol(reg x) { return _mm256_or_si256(_mm256_slli_epi32(x, S), _mm256_srli_epi32(x, 32 - S)); }
+};
+
+} // namespace
+
+void md5_batch_avx2(const std::string_view* msgs, size_t n, uint8_t (*out)[16]) {
+    md5_batch_lanes<V8>(msgs, n, out);
+}
+#endif
@@ -0,0 +1,80 @@
+#include "md5.h"
+#include "md5_lanes.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define FROGKLAN_MD5_SSE2 1
+#endif
+
+#if defined(FROGKLAN_MD5_AVX2)
+void md5_batch_avx2(const std::string_view* msgs, size_t n, uint8_t (*out)[16]);
+#endif
+
+namespace {
+
+#if defined(FROGKLAN_MD5_SSE2)
+struct V4 {
+    using reg = __m128i;
+    static constexpr size_t kLanes = 4;
+    static reg load(const uint32_t* p) { return _mm_load_si128((const __m128i*)p); }
+    static void store(uint32_t* p, reg v) { _mm_store_si128((__m128i*)p, v); }
+    static reg set1(uint32_t v) { return _mm_set1_epi32((int)v); }
+    static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+    static reg and_(reg a, reg b) { return _mm_and_si128(a, b); }
+    static reg or_(reg a, reg b) { return _mm_or_si128(a, b); }
+    static reg xor_(reg a, reg b) { return _mm_xor_si128(a, b); }
+    static reg andnot(reg a, reg b) { return _mm_andnot_si128(a, b); }
+    static reg not_(reg a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+    template <int S> static reg rol(reg x) { return _mm_or_si128(_mm_slli_epi32(x, S), _mm_srli_epi32(x, 32 - S)); }
+};
+#endif
+
+enum class Md5Backend { Scalar, Sse2, Avx2 };
+
+Md5Backend detect_backend() {
+#if defined(FROGKLAN_MD5_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2")) return Md5Backend::Avx2;
+#endif
+#if defined(FROGKLAN_MD5_SSE2)
+    return Md5Backend::Sse2;
+#else
+    return Md5Backend::Scalar;
+#endif
+}
+
+Md5Backend backend() {
+    static const Md5Backend b = detect_backend();
+    return b;
+}
+
+void md5_batch_scalar(const std::string_view* msgs, size_t n, uint8_t (*out)[16]) {
+    for (size_t i = 0; i < n; i++) {
+        MD5 m;
+        m.update(reinterpret_cast<const uint8_t*>(msgs[i].data()), msgs[i].size());
+        m.final_raw(out[i]);
+    }
+}
+
+} // namespace
+
+void md5_batch(const std::string_view* msgs, size_t n, uint8_t (*out)[16]) {
+    // A lone message gains nothing from lanes.
+    if (n == 1) { md5_batch_scalar(msgs, n, out); return; }
+    switch (backend()) {
+#if defined(FROGKLAN_MD5_AVX2)
+        case Md5Backend::Avx2: md5_batch_avx2(msgs, n, out); return;
+#endif
+#if defined(FROGKLAN_MD5_SSE2)
+        case Md5Backend::Sse2: md5_batch_lanes<V4>(msgs, n, out); return;
+#endif
+        default: md5_batch_scalar(msgs, n, out); return;
+    }
+}
+
+const char* md5_batch_backend() {
+    switch (backend()) {
+        case Md5Backend::Avx2: return "avx2";
+        case Md5Backend::Sse2: return "sse2";
+        default: return "scalar";
+    }
+}
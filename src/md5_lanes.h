@@ -0,0 +1,179 @@
+#pragma once
+// Lane-parallel MD5 shared by the SSE2 and AVX2 batch kernels (md5_batch.cpp,
+// md5_avx2.cpp). Each lane hashes an independent message. V supplies the
+// register type and ops; it must be declared in an anonymous namespace of the
+// including file so every ISA gets its own, internally linked, instantiation.
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+template <class V>
+inline void md5_compress_lanes(typename V::reg st[4], const typename V::reg X[16]) {
+    using R = typename V::reg;
+    R a = st[0], b = st[1], c = st[2], d = st[3];
+
+#define MD5L_F(x,y,z) V::or_(V::and_(x,y), V::andnot(x,z))
+#define MD5L_G(x,y,z) V::or_(V::and_(x,z), V::andnot(z,y))
+#define MD5L_H(x,y,z) V::xor_(V::xor_(x,y),z)
+#define MD5L_I(x,y,z) V::xor_(y, V::or_(x, V::not_(z)))
+#define STEP(f,a,b,c,d,x,t,s) a = V::add(b, V::template rol<s>(V::add(V::add(a, f(b,c,d)), V::add(x, V::set1(t)))))
+
+    // Round 1
+    STEP(MD5L_F,a,b,c,d,X[ 0],0xd76aa478, 7);
+    STEP(MD5L_F,d,a,b,c,X[ 1],0xe8c7b756,12);
+    STEP(MD5L_F,c,d,a,b,X[ 2],0x242070db,17);
+    STEP(MD5L_F,b,c,d,a,X[ 3],0xc1bdceee,22);
+    STEP(MD5L_F,a,b,c,d,X[ 4],0xf57c0faf, 7);
+    STEP(MD5L_F,d,a,b,c,X[ 5],0x4787c62a,12);
+    STEP(MD5L_F,c,d,a,b,X[ 6],0xa8304613,17);
+    STEP(MD5L_F,b,c,d,a,X[ 7],0xfd469501,22);
+    STEP(MD5L_F,a,b,c,d,X[ 8],0x698098d8, 7);
+    STEP(MD5L_F,d,a,b,c,X[ 9],0x8b44f7af,12);
+    STEP(MD5L_F,c,d,a,b,X[10],0xffff5bb1,17);
+    STEP(MD5L_F,b,c,d,a,X[11],0x895cd7be,22);
+    STEP(MD5L_F,a,b,c,d,X[12],0x6b901122, 7);
+    STEP(MD5L_F,d,a,b,c,X[13],0xfd987193,12);
+    STEP(MD5L_F,c,d,a,b,X[14],0xa679438e,17);
+    STEP(MD5L_F,b,c,d,a,X[15],0x49b40821,22);
+
+    // Round 2
+    STEP(MD5L_G,a,b,c,d,X[ 1],0xf61e2562, 5);
+    STEP(MD5L_G,d,a,b,c,X[ 6],0xc040b340, 9);
+    STEP(MD5L_G,c,d,a,b,X[11],0x265e5a51,14);
+    STEP(MD5L_G,b,c,d,a,X[ 0],0xe9b6c7aa,20);
+    STEP(MD5L_G,a,b,c,d,X[ 5],0xd62f105d, 5);
+    STEP(MD5L_G,d,a,b,c,X[10],0x02441453, 9);
+    STEP(MD5L_G,c,d,a,b,X[15],0xd8a1e681,14);
+    STEP(MD5L_G,b,c,d,a,X[ 4],0xe7d3fbc8,20);
+    STEP(MD5L_G,a,b,c,d,X[ 9],0x21e1cde6, 5);
+    STEP(MD5L_G,d,a,b,c,X[14],0xc33707d6, 9);
+    STEP(MD5L_G,c,d,a,b,X[ 3],0xf4d50d87,14);
+    STEP(MD5L_G,b,c,d,a,X[ 8],0x455a14ed,20);
+    STEP(MD5L_G,a,b,c,d,X[13],0xa9e3e905, 5);
+    STEP(MD5L_G,d,a,b,c,X[ 2],0xfcefa3f8, 9);
+    STEP(MD5L_G,c,d,a,b,X[ 7],0x676f02d9,14);
+    STEP(MD5L_G,b,c,d,a,X[12],0x8d2a4c8a,20);
+
+    // Round 3
+    STEP(MD5L_H,a,b,c,d,X[ 5],0xfffa3942, 4);
+    STEP(MD5L_H,d,a,b,c,X[ 8],0x8771f681,11);
+    STEP(MD5L_H,c,d,a,b,X[11],0x6d9d6122,16);
+    STEP(MD5L_H,b,c,d,a,X[14],0xfde5380c,23);
+    STEP(MD5L_H,a,b,c,d,X[ 1],0xa4beea44, 4);
+    STEP(MD5L_H,d,a,b,c,X[ 4],0x4bdecfa9,11);
+    STEP(MD5L_H,c,d,a,b,X[ 7],0xf6bb4b60,16);
+    STEP(MD5L_H,b,c,d,a,X[10],0xbebfbc70,23);
+    STEP(MD5L_H,a,b,c,d,X[13],0x289b7ec6, 4);
+    STEP(MD5L_H,d,a,b,c,X[ 0],0xeaa127fa,11);
+    STEP(MD5L_H,c,d,a,b,X[ 3],0xd4ef3085,16);
+    STEP(MD5L_H,b,c,d,a,X[ 6],0x04881d05,23);
+    STEP(MD5L_H,a,b,c,d,X[ 9],0xd9d4d039, 4);
+    STEP(MD5L_H,d,a,b,c,X[12],0xe6db99e5,11);
+    STEP(MD5L_H,c,d,a,b,X[15],0x1fa27cf8,16);
+    STEP(MD5L_H,b,c,d,a,X[ 2],0xc4ac5665,23);
+
+    // Round 4
+    STEP(MD5L_I,a,b,c,d,X[ 0],0xf4292244, 6);
+    STEP(MD5L_I,d,a,b,c,X[ 7],0x432aff97,10);
+    STEP(MD5L_I,c,d,a,b,X[14],0xab9423a7,15);
+    STEP(MD5L_I,b,c,d,a,X[ 5],0xfc93a039,21);
+    STEP(MD5L_I,a,b,c,d,X[12],0x655b59c3, 6);
+    STEP(MD5L_I,d,a,b,c,X[ 3],0x8f0ccc92,10);
+    STEP(MD5L_I,c,d,a,b,X[10],0xffeff47d,15);
+    STEP(MD5L_I,b,c,d,a,X[ 1],0x85845dd1,21);
+    STEP(MD5L_I,a,b,c,d,X[ 8],0x6fa87e4f, 6);
+    STEP(MD5L_I,d,a,b,c,X[15],0xfe2ce6e0,10);
+    STEP(MD5L_I,c,d,a,b,X[ 6],0xa3014314,15);
+    STEP(MD5L_I,b,c,d,a,X[13],0x4e0811a1,21);
+    STEP(MD5L_I,a,b,c,d,X[ 4],0xf7537e82, 6);
+    STEP(MD5L_I,d,a,b,c,X[11],0xbd3af235,10);
+    STEP(MD5L_I,c,d,a,b,X[ 2],0x2ad7d2bb,15);
+    STEP(MD5L_I,b,c,d,a,X[ 9],0xeb86d391,21);
+
+#undef STEP
+#undef MD5L_F
+#undef MD5L_G
+#undef MD5L_H
+#undef MD5L_I
+
+    st[0] = V::add(st[0], a);
+    st[1] = V::add(st[1], b);
+    st[2] = V::add(st[2], c);
+    st[3] = V::add(st[3], d);
+}
+
+// Writes block `b` of the MD5-padded form of `msg` (msg, 0x80, zeros, bit length).
+static inline void md5_padded_block(std::string_view msg, size_t b, size_t nblocks, uint8_t out[64]) {
+    size_t off = b * 64;
+    size_t len = msg.size();
+    size_t take = off < len ? (len - off < 64 ? len - off : 64) : 0;
+    if (take) std::memcpy(out, msg.data() + off, take);
+    std::memset(out + take, 0, 64 - take);
+    if (len >= off && len < off + 64) out[len - off] = 0x80;
+    if (b == nblocks - 1) {
+        uint64_t bits = (uint64_t)len * 8;
+        for (int i = 0; i < 8; i++) out[56 + i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static inline size_t md5_block_count(size_t len) { return (len + 8) / 64 + 1; }
+
+// Hashes msgs[0..n) V::kLanes at a time. Lanes whose message is shorter than
+// the longest in its group keep their finished state via a per-lane mask.
+template <class V>
+inline void md5_batch_lanes(const std::string_view* msgs, size_t n, uint8_t (*out)[16]) {
+    using R = typename V::reg;
+    constexpr size_t L = V::kLanes;
+
+    for (size_t g = 0; g < n; g += L) {
+        size_t cnt = (n - g < L) ? n - g : L;
+        size_t nblocks[L];
+        size_t maxb = 0;
+        for (size_t l = 0; l < L; l++) {
+            nblocks[l] = l < cnt ? md5_block_count(msgs[g + l].size()) : 0;
+            if (nblocks[l] > maxb) maxb = nblocks[l];
+        }
+
+        alignas(32) uint32_t state[4][L];
+        for (size_t l = 0; l < L; l++) {
+            state[0][l] = 0x67452301u; state[1][l] = 0xefcdab89u;
+            state[2][l] = 0x98badcfeu; state[3][l] = 0x10325476u;
+        }
+
+        for (size_t b = 0; b < maxb; b++) {
+            alignas(32) uint32_t words[16][L];
+            alignas(32) uint32_t mask[L];
+            for (size_t l = 0; l < L; l++) {
+                uint8_t blk[64];
+                mask[l] = b < nblocks[l] ? 0xffffffffu : 0;
+                if (mask[l]) md5_padded_block(msgs[g + l], b, nblocks[l], blk);
+                else std::memset(blk, 0, sizeof(blk));
+                for (int i = 0; i < 16; i++) {
+                    words[i][l] = (uint32_t)blk[i*4] | ((uint32_t)blk[i*4+1] << 8) |
+                                  ((uint32_t)blk[i*4+2] << 16) | ((uint32_t)blk[i*4+3] << 24);
+                }
+            }
+
+            R X[16];
+            for (int i = 0; i < 16; i++) X[i] = V::load(words[i]);
+            R st[4], orig[4];
+            for (int i = 0; i < 4; i++) orig[i] = st[i] = V::load(state[i]);
+            md5_compress_lanes<V>(st, X);
+            R m = V::load(mask);
+            for (int i = 0; i < 4; i++) {
+                V::store(state[i], V::or_(V::and_(m, st[i]), V::andnot(m, orig[i])));
+            }
+        }
+
+        for (size_t l = 0; l < cnt; l++) {
+            for (int i = 0; i < 4; i++) {
+                uint32_t v = state[i][l];
+                out[g + l][i*4+0] = (uint8_t)(v & 0xff);
+                out[g + l][i*4+1] = (uint8_t)((v >> 8) & 0xff);
+                out[g + l][i*4+2] = (uint8_t)((v >> 16) & 0xff);
+                out[g + l][i*4+3] = (uint8_t)((v >> 24) & 0xff);
+            }
+        }
+    }
+}
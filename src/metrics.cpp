@@ -0,0 +1,216 @@
+#include "metrics.h"
+#include <cstdio>
+#include <cstring>
+
+const uint64_t TargetMetrics::kRttBoundsUs[kRttBuckets - 1] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+    250000, 500000, 1000000, 2500000, 5000000, 10000000,
+};
+
+void TargetMetrics::record_rtt_us(uint64_t us) {
+    size_t b = 0;
+    while (b < kRttBuckets - 1 && us > kRttBoundsUs[b]) b++;
+    rtt_[b].fetch_add(1, std::memory_order_relaxed);
+    rtt_sum_us_.fetch_add(us, std::memory_order_relaxed);
+}
+
+void TargetMetrics::record_status(int code) {
+    // Slots are claimed once, by CAS from 0, and never released, so a code
+    // keeps its slot for the life of the run.
+    for (size_t i = 0; i < kCodes; i++) {
+        int c = codes_[i].load(std::memory_order_relaxed);
+        if (c == 0) {
+            int expected = 0;
+            if (codes_[i].compare_exchange_strong(expected, code, std::memory_order_relaxed) ||
+                expected == code) {
+                code_counts_[i].fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            c = expected;
+        }
+        if (c == code) {
+            code_counts_[i].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    other_codes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TargetMetrics::snapshot(Snapshot* s) const {
+    for (size_t i = 0; i < kRttBuckets; i++) s->rtt[i] = rtt_[i].load(std::memory_order_relaxed);
+    s->rtt_sum_us = rtt_sum_us_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kCodes; i++) {
+        s->codes[i] = codes_[i].load(std::memory_order_relaxed);
+        s->code_counts[i] = code_counts_[i].load(std::memory_order_relaxed);
+    }
+    s->other_codes = other_codes_.load(std::memory_order_relaxed);
+    s->sent = sent_.load(std::memory_order_relaxed);
+    s->timeouts = timeouts_.load(std::memory_order_relaxed);
+    s->send_errors = send_errors_.load(std::memory_order_relaxed);
+    s->dns_errors = dns_errors_.load(std::memory_order_relaxed);
+    s->health = health_.load(std::memory_order_relaxed);
+}
+
+static std::string escape_label(const std::string& v) {
+    std::string o;
+    o.reserve(v.size());
+    for (char c : v) {
+        if (c == '\\' || c == '"') { o.push_back('\\'); o.push_back(c); }
+        else if (c == '\n') o += "\\n";
+        else o.push_back(c);
+    }
+    return o;
+}
+
+MetricsRegistry::MetricsRegistry(std::vector<std::string> targets)
+    : labels_(std::move(targets)), metrics_(new TargetMetrics[labels_.size()]) {
+    for (auto& l : labels_) l = escape_label(l);
+}
+
+namespace {
+
+// Appends `name{target="label"<extra>} value\n`.
+void line(std::string& out, const char* name, const std::string& label, const char* extra, uint64_t v) {
+    char num[24];
+    int n = std::snprintf(num, sizeof(num), "%llu", (unsigned long long)v);
+    out += name;
+    out += "{target=\"";
+    out += label;
+    out += '"';
+    out += extra;
+    out += "} ";
+    out.append(num, (size_t)n);
+    out += '\n';
+}
+
+void family(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+} // namespace
+
+void MetricsRegistry::render(std::string& out) const {
+    out.clear();
+    const size_t n = labels_.size();
+    std::vector<TargetMetrics::Snapshot> snaps(n);
+    for (size_t i = 0; i < n; i++) metrics_[i].snapshot(&snaps[i]);
+
+    char le[TargetMetrics::kRttBuckets][40];
+    for (size_t b = 0; b + 1 < TargetMetrics::kRttBuckets; b++) {
+        std::snprintf(le[b], sizeof(le[b]), ",le=\"%g\"", TargetMetrics::kRttBoundsUs[b] / 1e6);
+    }
+    std::snprintf(le[TargetMetrics::kRttBuckets - 1], sizeof(le[0]), ",le=\"+Inf\"");
+
+    family(out, "frogklan_rtt_seconds", "histogram", "First transmission to final response.");
+    for (size_t i = 0; i < n; i++) {
+        const auto& s = snaps[i];
+        uint64_t cum = 0;
+        for (size_t b = 0; b < TargetMetrics::kRttBuckets; b++) {
+            cum += s.rtt[b];
+            line(out, "frogklan_rtt_seconds_bucket", labels_[i], le[b], cum);
+        }
+        char sum[48];
+        std::snprintf(sum, sizeof(sum), "} %.6f\n", s.rtt_sum_us / 1e6);
+        out += "frogklan_rtt_seconds_sum{target=\"";
+        out += labels_[i];
+        out += '"';
+        out += sum;
+        line(out, "frogklan_rtt_seconds_count", labels_[i], "", cum);
+    }
+
+    family(out, "frogklan_requests_total", "counter", "Requests sent, retransmissions excluded.");
+    for (size_t i = 0; i < n; i++) line(out, "frogklan_requests_total", labels_[i], "", snaps[i].sent);
+
+    family(out, "frogklan_responses_total", "counter", "Final responses by status code.");
+    for (size_t i = 0; i < n; i++) {
+        const auto& s = snaps[i];
+        for (size_t c = 0; c < TargetMetrics::kCodes; c++) {
+            if (!s.codes[c]) continue;
+            char extra[24];
+            std::snprintf(extra, sizeof(extra), ",code=\"%d\"", s.codes[c]);
+            line(out, "frogklan_responses_total", labels_[i], extra, s.code_counts[c]);
+        }
+        if (s.other_codes) line(out, "frogklan_responses_total", labels_[i], ",code=\"other\"", s.other_codes);
+    }
+
+    family(out, "frogklan_timeouts_total", "counter", "Transactions that got no final response in time.");
+    for (size_t i = 0; i < n; i++) line(out, "frogklan_timeouts_total", labels_[i], "", snaps[i].timeouts);
+
+    family(out, "frogklan_transport_errors_total", "counter", "Sends the socket refused, and failed name lookups.");
+    for (size_t i = 0; i < n; i++) {
+        line(out, "frogklan_transport_errors_total", labels_[i], ",kind=\"send\"", snaps[i].send_errors);
+        line(out, "frogklan_transport_errors_total", labels_[i], ",kind=\"dns\"", snaps[i].dns_errors);
+    }
+
+    bool any_health = false;
+    for (auto& s : snaps) if (s.health >= 0) { any_health = true; break; }
+    if (any_health) {
+        family(out, "frogklan_target_health", "gauge", "0 unknown, 1 up, 2 degraded, 3 down.");
+        for (size_t i = 0; i < n; i++) {
+            if (snaps[i].health >= 0) line(out, "frogklan_target_health", labels_[i], "", (uint64_t)snaps[i].health);
+        }
+    }
+}
+
+bool MetricsServer::start(uint16_t port, std::string* err) {
+    if (!listener_.listen("127.0.0.1", port)) {
+        *err = "cannot listen on 127.0.0.1:" + std::to_string(port);
+        return false;
+    }
+    port_ = listener_.local_port();
+    stop_ = false;
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!thread_.joinable()) return;
+    stop_ = true;
+    thread_.join();
+    listener_.close();
+}
+
+void MetricsServer::run() {
+    std::string body, head;
+    char buf[4096];
+    while (!stop_) {
+        int fd = listener_.accept(200);
+        if (fd < 0) continue;
+
+        // Only the request line matters; read until the header block ends.
+        std::string req;
+        int got;
+        while (req.find("\r\n\r\n") == std::string::npos && req.size() < 16384 &&
+               (got = tcp_recv(fd, buf, sizeof(buf), 1000)) > 0) {
+            req.append(buf, (size_t)got);
+        }
+        bool head_only = req.compare(0, 5, "HEAD ") == 0;
+        bool get = head_only || req.compare(0, 4, "GET ") == 0;
+        size_t p = req.find(' ');
+        size_t e = p == std::string::npos ? p : req.find_first_of(" ?", p + 1);
+        bool metrics = get && e != std::string::npos && req.compare(p + 1, e - p - 1, "/metrics") == 0;
+
+        const char* status = "200 OK";
+        if (metrics) {
+            reg_.render(body);
+        } else {
+            status = get ? "404 Not Found" : "405 Method Not Allowed";
+            body = "frogklan: only GET /metrics is served\n";
+        }
+        head = "HTTP/1.1 ";
+        head += status;
+        head += "\r\nContent-Type: ";
+        head += metrics ? "text/plain; version=0.0.4" : "text/plain";
+        head += "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        if (tcp_send_all(fd, head.data(), head.size()) && !head_only) tcp_send_all(fd, body.data(), body.size());
+        tcp_close(fd);
+    }
+}
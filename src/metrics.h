@@ -0,0 +1,98 @@
+#pragma once
+#include "net.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters for one probed target. Every update is a relaxed atomic add or
+// store, so the probe loop never takes a lock and a concurrent scrape only
+// ever reads. A scrape sees each value as of some instant during rendering,
+// not one consistent cut across all of them, which is what Prometheus
+// counters tolerate anyway.
+class TargetMetrics {
+public:
+    // RTT histogram upper bounds, in microseconds (Prometheus "le", cumulative
+    // at render time); the last bucket is +Inf.
+    static const size_t kRttBuckets = 15;
+    static const uint64_t kRttBoundsUs[kRttBuckets - 1];
+    // Distinct response codes tracked per target; further codes land in "other".
+    static const size_t kCodes = 8;
+
+    void record_rtt_us(uint64_t us);
+    void record_status(int code);
+    void add_sent(uint64_t n = 1) { sent_.fetch_add(n, std::memory_order_relaxed); }
+    void add_timeout() { timeouts_.fetch_add(1, std::memory_order_relaxed); }
+    void add_send_error() { send_errors_.fetch_add(1, std::memory_order_relaxed); }
+    void add_dns_error() { dns_errors_.fetch_add(1, std::memory_order_relaxed); }
+    // Monitor mode only: TargetHealth as an integer; < 0 -> not exported.
+    void set_health(int h) { health_.store(h, std::memory_order_relaxed); }
+
+    struct Snapshot {
+        uint64_t rtt[kRttBuckets];      // per bucket, not cumulative
+        uint64_t rtt_sum_us;
+        int codes[kCodes];              // 0 -> unused
+        uint64_t code_counts[kCodes];
+        uint64_t other_codes;
+        uint64_t sent, timeouts, send_errors, dns_errors;
+        int health;
+    };
+    void snapshot(Snapshot* s) const;
+
+private:
+    std::atomic<uint64_t> rtt_[kRttBuckets] = {};
+    std::atomic<uint64_t> rtt_sum_us_{0};
+    std::atomic<int> codes_[kCodes] = {};
+    std::atomic<uint64_t> code_counts_[kCodes] = {};
+    std::atomic<uint64_t> other_codes_{0};
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> send_errors_{0};
+    std::atomic<uint64_t> dns_errors_{0};
+    std::atomic<int> health_{-1};
+};
+
+// Fixed set of targets, labelled "host:port", created before the run starts
+// and never resized, so the hot path indexes straight into it.
+class MetricsRegistry {
+public:
+    explicit MetricsRegistry(std::vector<std::string> targets);
+
+    size_t size() const { return labels_.size(); }
+    TargetMetrics& at(size_t i) { return metrics_[i]; }
+    const TargetMetrics& at(size_t i) const { return metrics_[i]; }
+
+    // Prometheus text exposition format 0.0.4.
+    void render(std::string& out) const;
+
+private:
+    std::vector<std::string> labels_;   // already escaped for a label value
+    std::unique_ptr<TargetMetrics[]> metrics_;
+};
+
+// Minimal HTTP/1.1 server on 127.0.0.1 answering GET /metrics from its own
+// thread, one connection at a time, closing each after the response.
+class MetricsServer {
+public:
+    explicit MetricsServer(const MetricsRegistry& reg) : reg_(reg) {}
+    ~MetricsServer() { stop(); }
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Port 0 picks a free one; see port().
+    bool start(uint16_t port, std::string* err);
+    void stop();
+    uint16_t port() const { return port_; }
+
+private:
+    void run();
+
+    const MetricsRegistry& reg_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+    TcpListener listener_;
+    uint16_t port_ = 0;
+};
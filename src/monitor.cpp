@@ -0,0 +1,546 @@
+#include "monitor.h"
+#include "app.h"
+#include "metrics.h"
+#include "net.h"
+#include "resolver.h"
+#include "resultlog.h"
+#include "sip_id.h"
+#include "sip_template.h"
+#include "timer_wheel.h"
+#include "txn.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+const char* target_health_name(TargetHealth h) {
+    switch (h) {
+    case TargetHealth::Up: return "up";
+    case TargetHealth::Degraded: return "degraded";
+    case TargetHealth::Down: return "down";
+    default: return "unknown";
+    }
+}
+
+bool TargetHealthRow::observe(TargetHealth seen, const HealthPolicy& p, uint32_t now_s) {
+    probes++;
+    if (seen == TargetHealth::Down) failures++;
+    if (health == TargetHealth::Unknown || seen == health) {
+        streak = 0;
+        pending = seen;
+        if (health == seen) return false;
+        health = seen;
+        changed_s = now_s;
+        return true;
+    }
+    if (seen != pending) {
+        pending = seen;
+        streak = 0;
+    }
+    if (streak < 255) streak++;
+    if (streak < (seen == TargetHealth::Down ? p.fall : p.rise)) return false;
+    health = seen;
+    streak = 0;
+    changed_s = now_s;
+    return true;
+}
+
+MonitorSchedule::MonitorSchedule(size_t n, uint32_t interval_ms, double jitter)
+    : interval_ms_(interval_ms ? interval_ms : 1) {
+    double j = jitter < 0 ? 0 : jitter * interval_ms_;
+    jitter_ms_ = j >= interval_ms_ ? interval_ms_ - 1 : (uint32_t)j;
+    phase_.resize(n);
+    const uint64_t slot = n ? interval_ms_ / n : 0;
+    for (size_t i = 0; i < n; i++) {
+        phase_[i] = (uint32_t)((uint64_t)interval_ms_ * i / n + (slot ? sip_id_rand64() % slot : 0));
+    }
+}
+
+uint32_t MonitorSchedule::delay() {
+    return jitter_ms_ ? (uint32_t)(sip_id_rand64() % (jitter_ms_ + 1)) : 0;
+}
+
+uint64_t MonitorSchedule::first(size_t i) {
+    return phase_[i] + delay();
+}
+
+uint64_t MonitorSchedule::next(size_t i, uint64_t after_ms) {
+    uint64_t round = after_ms < phase_[i] ? 0 : (after_ms - phase_[i]) / interval_ms_ + 1;
+    return phase_[i] + round * interval_ms_ + delay();
+}
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_stop_signal(int) { g_stop = 1; }
+
+// Per-target probe state. The Call-ID is fixed for the target's lifetime
+// and each probe takes the next CSeq and a fresh branch, written into the
+// same string, so a round allocates nothing once every target has probed.
+struct MonitorSlot {
+    std::string branch;
+    std::string call_id;
+    Clock::time_point first_send;
+    SipRetransmit retx;
+    TimerWheel::TimerId timer = TimerWheel::kNoTimer;
+    UdpAddr addr;
+    int cseq = 0;
+    int sock = 0;
+    bool inflight = false;
+};
+
+// Re-resolves names whose cache entry has expired every `period`, so the
+// probe loop can read addresses with peek() and never block on a lookup.
+class DnsRefresher {
+public:
+    DnsRefresher(std::vector<std::string> hosts, int threads, std::chrono::seconds period)
+        : hosts_(std::move(hosts)), threads_(threads), period_(period),
+          thread_([this] { run(); }) {}
+    ~DnsRefresher() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (!cv_.wait_for(lk, period_, [this] { return stop_; })) {
+            lk.unlock();
+            resolver_cache().prefetch(hosts_, threads_);
+            lk.lock();
+        }
+    }
+
+    std::vector<std::string> hosts_;
+    int threads_;
+    std::chrono::seconds period_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+void json_stats(std::ostream& o, const TargetStats& s) {
+    const LatencySketch& h = s.rtt();
+    o << "\"rtt_us\": {\"count\": " << h.count() << ", \"min\": " << h.min() << ", \"mean\": " << (uint64_t)h.mean()
+      << ", \"p50\": " << h.percentile(50) << ", \"p90\": " << h.percentile(90) << ", \"p99\": " << h.percentile(99)
+      << ", \"max\": " << h.max() << "}, \"statuses\": {";
+    for (size_t i = 0; i < TargetStats::kCodes && s.code(i); i++) {
+        o << (i ? ", " : "") << "\"" << s.code(i) << "\": " << s.code_count(i);
+    }
+    if (s.other_codes()) o << (s.code(0) ? ", " : "") << "\"other\": " << s.other_codes();
+    o << "}, \"timeouts\": " << s.timeouts() << ", \"errors\": " << s.errors();
+}
+
+void write_status(const fs::path& path, const std::vector<ProbeTarget>& targets,
+                  const std::vector<TargetHealthRow>& table, const std::vector<TargetStats>& stats,
+                  const MonitorConfig& cfg, uint64_t uptime_s) {
+    size_t counts[4] = {0, 0, 0, 0};
+    for (auto& r : table) counts[(int)r.health]++;
+
+    // Written aside and renamed over the old file, so readers never see half.
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream f(tmp);
+        f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"uptime_s\": " << uptime_s << ",\n"
+"  \"interval_s\": " << cfg.interval_s << ",\n"
+"  \"up\": " << counts[(int)TargetHealth::Up] << ",\n"
+"  \"degraded\": " << counts[(int)TargetHealth::Degraded] << ",\n"
+"  \"down\": " << counts[(int)TargetHealth::Down] << ",\n"
+"  \"unknown\": " << counts[(int)TargetHealth::Unknown] << ",\n"
+"  \"targets\": [";
+        for (size_t i = 0; i < targets.size(); i++) {
+            const auto& r = table[i];
+            f << (i ? ",\n" : "\n")
+              << "    {\"host\": \"" << json_escape(targets[i].host) << "\", \"port\": " << targets[i].port
+              << ", \"health\": \"" << target_health_name(r.health) << "\""
+              << ", \"since_s\": " << r.changed_s
+              << ", \"probes\": " << r.probes
+              << ", \"failures\": " << r.failures
+              << ", \"last_status\": " << r.last_status
+              << ", \"last_rtt_ms\": " << (r.last_rtt_ms == 0xffff ? -1 : (int)r.last_rtt_ms) << ", ";
+            json_stats(f, stats[i]);
+            f << "}";
+        }
+        f << "\n  ]\n}\n";
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+}
+
+} // namespace
+
+bool run_monitor(const std::vector<ProbeTarget>& targets, const MonitorConfig& cfg,
+                 std::vector<TargetHealthRow>* table_out, std::string* err, std::vector<TargetStats>* stats_out) {
+    const size_t n = targets.size();
+    std::vector<TargetHealthRow>& table = *table_out;
+    table.assign(n, TargetHealthRow());
+    std::vector<TargetStats> own_stats;
+    std::vector<TargetStats>& stats = stats_out ? *stats_out : own_stats;
+    stats.assign(n, TargetStats());
+    std::vector<MonitorSlot> slots(n);
+    std::vector<SipRequestTemplate> tpls;
+    tpls.reserve(n);
+
+    int nsock = cfg.sockets < 1 ? 1 : cfg.sockets;
+    std::vector<std::unique_ptr<UdpSocket>> socks;
+    UdpPoller poller;
+    for (int i = 0; i < nsock; i++) {
+        auto s = std::make_unique<UdpSocket>();
+        if (!s->open(4 << 20) || !poller.add(*s)) { *err = "Failed to open UDP socket"; return false; }
+        if (cfg.kernel_ts) s->enable_rx_timestamps();
+        socks.push_back(std::move(s));
+    }
+
+    std::vector<std::string> hosts;
+    hosts.reserve(n);
+    for (auto& t : targets) hosts.push_back(t.host);
+    resolver_cache().prefetch(hosts, cfg.resolve_threads);
+    DnsRefresher refresher(hosts, cfg.resolve_threads,
+                           std::chrono::seconds(cfg.dns_refresh_s < 1 ? 1 : cfg.dns_refresh_s));
+
+    const std::string tag = sip_new_tag();
+    for (size_t i = 0; i < n; i++) {
+        const auto& t = targets[i];
+        std::string req_uri = "sip:" + t.host + (t.port != 5060 ? ":" + std::to_string(t.port) : "");
+        tpls.push_back(SipRequestTemplate::options(t.host, t.port, cfg.from_uri,
+                                                   cfg.to_uri.empty() ? req_uri : cfg.to_uri, cfg.user_agent));
+        slots[i].call_id = sip_new_call_id();
+        slots[i].branch.reserve(kSipBranchLen);
+        slots[i].sock = (int)(i % (size_t)nsock);
+    }
+
+    g_stop = 0;
+    auto prev_int = std::signal(SIGINT, on_stop_signal);
+    auto prev_term = std::signal(SIGTERM, on_stop_signal);
+
+    // Probe and retransmit timers share the wheel: a target has exactly one
+    // armed at a time, the retransmit one while a probe is in flight.
+    const auto base = Clock::now();
+    const uint64_t sys_base_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<uint32_t> log_ids;
+    if (cfg.log) {
+        log_ids.resize(n);
+        for (size_t i = 0; i < n; i++) log_ids[i] = cfg.log->target_id(targets[i].host + ":" + std::to_string(targets[i].port));
+    }
+    auto now_ms = [&]{ return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - base).count(); };
+    const uint64_t end_ms = cfg.duration_s > 0 ? (uint64_t)(cfg.duration_s * 1000) : ~0ull;
+    const uint32_t interval_ms = (uint32_t)(cfg.interval_s < 1 ? 1000 : cfg.interval_s * 1000);
+    MonitorSchedule sched(n, interval_ms, cfg.jitter);
+    TimerWheel wheel(0);
+    wheel.reserve(n);
+    for (size_t i = 0; i < n; i++) slots[i].timer = wheel.schedule(sched.first(i), i);
+
+    TxnTable txns;
+    txns.reserve(n);
+    std::vector<uint64_t> fired;
+    UdpBatch io;
+    std::vector<int> ready;
+    SipResponseView resp;
+    std::string msg;
+    SipRequestTemplate::Fields f;
+    f.tag = tag;
+    char idbuf[kSipBranchLen];
+
+    auto render = [&](uint32_t idx) {
+        auto& s = slots[idx];
+        f.branch = s.branch;
+        f.call_id = s.call_id;
+        f.cseq = s.cseq;
+        tpls[idx].render(f, msg);
+    };
+
+    // Ends the current probe (or a probe that never got sent) and arms the
+    // next one. rtt_us < 0 and peer == nullptr when nothing answered.
+    auto settle = [&](uint32_t idx, TargetHealth seen, ProbeOutcome outcome, int status, int64_t rtt_us,
+                      const UdpAddr* peer, uint64_t now) {
+        auto& s = slots[idx];
+        auto& r = table[idx];
+        switch (outcome) {
+        case ProbeOutcome::Reply: stats[idx].record_reply(status, (uint64_t)rtt_us); break;
+        case ProbeOutcome::Timeout: stats[idx].record_timeout(); break;
+        default: stats[idx].record_error(); break;
+        }
+        const int rtt_ms = rtt_us < 0 ? -1 : (int)(rtt_us / 1000);
+        if (cfg.log) {
+            ProbeRecord rec;
+            rec.ts_us = sys_base_us + (s.inflight
+                ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(s.first_send - base).count()
+                : now * 1000);
+            rec.target = log_ids[idx];
+            rec.outcome = (uint8_t)outcome;
+            rec.status = (uint16_t)status;
+            if (rtt_us >= 0) rec.rtt_us = (uint32_t)std::min<int64_t>(rtt_us, ProbeRecord::kNoRtt - 1);
+            if (peer) { rec.peer_ip = peer->ip; rec.peer_port = peer->port; }
+            rec.retransmits = (uint8_t)std::min(s.retx.retransmits(), 255);
+            cfg.log->append(rec);
+        }
+        if (s.inflight) {
+            txns.remove(s.branch);
+            s.inflight = false;
+        }
+        wheel.cancel(s.timer);
+        r.last_status = (uint16_t)status;
+        r.last_rtt_ms = rtt_ms < 0 ? 0xffff : (uint16_t)(rtt_ms < 0xfffe ? rtt_ms : 0xfffe);
+        TargetHealth was = r.health;
+        bool changed = r.observe(seen, cfg.policy, (uint32_t)(now / 1000));
+        if (cfg.metrics) cfg.metrics->at(idx).set_health((int)r.health);
+        if (changed) {
+            std::cout << "[" << now / 1000 << "s] " << targets[idx].host << ":" << targets[idx].port << " "
+                      << target_health_name(was) << " -> " << target_health_name(r.health)
+                      << " (status=" << status << " rtt_ms=" << rtt_ms << ")\n" << std::flush;
+        }
+        s.timer = wheel.schedule(sched.next(idx, now), idx);
+    };
+
+    // Starts a probe: new branch, next CSeq, first transmission.
+    auto start = [&](uint32_t idx, uint64_t now) {
+        auto& s = slots[idx];
+        if (!resolver_cache().peek(targets[idx].host, targets[idx].port, &s.addr)) {
+            if (cfg.metrics) cfg.metrics->at(idx).add_dns_error();
+            s.retx = SipRetransmit();
+            settle(idx, TargetHealth::Down, ProbeOutcome::DnsError, 0, -1, nullptr, now);
+            return;
+        }
+        sip_id_branch(idbuf);
+        s.branch.assign(idbuf, kSipBranchLen);
+        s.cseq++;
+        s.retx = SipRetransmit();
+        render(idx);
+        int rc = socks[s.sock]->send_to(s.addr, msg.data(), msg.size());
+        if (rc < 0) {
+            if (cfg.metrics) cfg.metrics->at(idx).add_send_error();
+            settle(idx, TargetHealth::Down, ProbeOutcome::SendError, 0, -1, nullptr, now);
+            return;
+        }
+        if (cfg.metrics) cfg.metrics->at(idx).add_sent();
+        // A full socket buffer counts as a send; Timer E resends it.
+        s.first_send = Clock::now();
+        s.inflight = true;
+        txns.add(s.branch, s.call_id, idx);
+        s.timer = wheel.schedule(s.retx.on_send(cfg.timers, now), idx);
+    };
+
+    uint64_t next_status = cfg.status_every_s > 0 ? (uint64_t)cfg.status_every_s * 1000 : ~0ull;
+    uint64_t now = 0;
+    while (!g_stop && now < end_ms) {
+        int wait_ms = (int)wheel.next_delay_ms(1000);
+        if (poller.wait(wait_ms, ready) < 0 && !g_stop) { *err = "poll failed"; break; }
+        now = now_ms();
+
+        for (int si : ready) {
+            int got;
+            while ((got = io.recv(*socks[si])) > 0) {
+                auto batch_t = Clock::now();
+                for (int k = 0; k < got; k++) {
+                    const auto& d = io.at(k);
+                    auto t = udp_rx_time(d, batch_t);
+                    if (!parse_sip_response_view(d.data, d.len, &resp)) continue;
+                    uint32_t idx;
+                    if (!txns.match(sip_top_via_branch(resp), resp.call_id, &idx)) continue;
+                    if (resp.status < 200) continue;  // keep waiting for the final answer
+                    auto rtt_us = std::chrono::duration_cast<std::chrono::microseconds>(t - slots[idx].first_send).count();
+                    if (cfg.metrics) {
+                        auto& m = cfg.metrics->at(idx);
+                        m.record_rtt_us((uint64_t)rtt_us);
+                        m.record_status(resp.status);
+                    }
+                    bool good = resp.status < 300 && rtt_us / 1000 <= cfg.policy.degraded_rtt_ms;
+                    settle(idx, good ? TargetHealth::Up : TargetHealth::Degraded, ProbeOutcome::Reply,
+                           resp.status, rtt_us, &d.addr, now);
+                }
+            }
+        }
+
+        fired.clear();
+        wheel.advance(now, fired);
+        for (uint64_t cookie : fired) {
+            uint32_t idx = (uint32_t)cookie;
+            auto& s = slots[idx];
+            s.timer = TimerWheel::kNoTimer;
+            if (!s.inflight) {
+                start(idx, now);
+            } else if (s.retx.expired(cfg.timers, now)) {
+                if (cfg.metrics) cfg.metrics->at(idx).add_timeout();
+                settle(idx, TargetHealth::Down, ProbeOutcome::Timeout, 0, -1, nullptr, now);
+            } else {
+                render(idx);
+                int rc = socks[s.sock]->send_to(s.addr, msg.data(), msg.size());
+                if (rc == 0) {
+                    s.timer = wheel.schedule(now + 1, idx);   // socket full; retry next tick
+                } else {
+                    if (rc < 0 && cfg.metrics) cfg.metrics->at(idx).add_send_error();
+                    s.timer = wheel.schedule(s.retx.on_send(cfg.timers, now), idx);
+                }
+            }
+        }
+
+        if (!cfg.status_path.empty() && now >= next_status) {
+            write_status(cfg.status_path, targets, table, stats, cfg, now / 1000);
+            next_status = now + (uint64_t)cfg.status_every_s * 1000;
+        }
+    }
+
+    if (!cfg.status_path.empty()) write_status(cfg.status_path, targets, table, stats, cfg, now / 1000);
+    std::signal(SIGINT, prev_int);
+    std::signal(SIGTERM, prev_term);
+    return err->empty();
+}
+
+static void monitor_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan monitor --targets <file> --from <sip:you@domain> [--to <sip:dest@domain>]\n"
+"                   [--interval 30] [--jitter 0.1] [--rise 2] [--fall 3] [--degraded-rtt 1000]\n"
+"                   [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N] [--sockets 1]\n"
+"                   [--status-every 60] [--duration 0] [--metrics-port N] [--log <dir>]\n"
+"                   [--kernel-ts]\n"
+"\n"
+"Probes every target with OPTIONS once per --interval seconds, spread evenly\n"
+"over the interval and delayed by up to --jitter of it. A target changes state\n"
+"after --rise matching answers (up, or degraded for non-2xx or slower than\n"
+"--degraded-rtt ms) or --fall failed probes in a row. Runs until SIGINT/SIGTERM\n"
+"or --duration seconds. --metrics-port serves Prometheus metrics on\n"
+"http://127.0.0.1:N/metrics. --log appends every probe outcome to a binary\n"
+"log in <dir>; summarise it with frogklan report. --kernel-ts ends each RTT on\n"
+"the kernel's receive stamp where supported.\n";
+}
+
+int cmd_monitor(int argc, char** argv) {
+    MonitorConfig cfg;
+    std::string targets_path;
+    int metrics_port = 0;
+    std::string log_dir;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--targets") targets_path = need("--targets");
+        else if (a == "--from") cfg.from_uri = need("--from");
+        else if (a == "--to") cfg.to_uri = need("--to");
+        else if (a == "--interval") cfg.interval_s = std::stoi(need("--interval"));
+        else if (a == "--jitter") cfg.jitter = std::stod(need("--jitter"));
+        else if (a == "--rise") cfg.policy.rise = std::stoi(need("--rise"));
+        else if (a == "--fall") cfg.policy.fall = std::stoi(need("--fall"));
+        else if (a == "--degraded-rtt") cfg.policy.degraded_rtt_ms = std::stoi(need("--degraded-rtt"));
+        else if (a == "--t1") cfg.timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") cfg.timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--timeout") cfg.timers.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--retries") cfg.timers.max_retransmits = std::stoi(need("--retries"));
+        else if (a == "--sockets") cfg.sockets = std::stoi(need("--sockets"));
+        else if (a == "--status-every") cfg.status_every_s = std::stoi(need("--status-every"));
+        else if (a == "--duration") cfg.duration_s = std::stod(need("--duration"));
+        else if (a == "--metrics-port") metrics_port = std::stoi(need("--metrics-port"));
+        else if (a == "--log") log_dir = need("--log");
+        else if (a == "--kernel-ts") cfg.kernel_ts = true;
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (targets_path.empty() || cfg.from_uri.empty()) {
+        std::cerr << "Missing required args.\n";
+        monitor_usage();
+        return 2;
+    }
+    if (cfg.timers.t1_ms <= 0 || cfg.timers.t2_ms < cfg.timers.t1_ms) {
+        std::cerr << "--t1 must be positive and --t2 at least --t1\n";
+        return 2;
+    }
+    if (cfg.interval_s < 1 || cfg.policy.rise < 1 || cfg.policy.fall < 1) {
+        std::cerr << "--interval, --rise and --fall must be at least 1\n";
+        return 2;
+    }
+
+    std::vector<ProbeTarget> targets;
+    std::string err;
+    if (!load_probe_targets(targets_path, &targets, &err)) {
+        std::cerr << err << "\n";
+        return 2;
+    }
+    if (targets.empty()) {
+        std::cerr << "No targets in " << targets_path << "\n";
+        return 2;
+    }
+    cfg.user_agent = "frogklan-sip-qa/" + std::string(APP_VERSION);
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    cfg.status_path = (data / "sip_monitor_status.json").string();
+
+    std::vector<std::string> labels;
+    for (auto& t : targets) labels.push_back(t.host + ":" + std::to_string(t.port));
+    MetricsRegistry metrics(std::move(labels));
+    MetricsServer server(metrics);
+    if (metrics_port > 0) {
+        if (!server.start((uint16_t)metrics_port, &err)) {
+            std::cerr << "monitor: " << err << "\n";
+            return 3;
+        }
+        cfg.metrics = &metrics;
+    }
+
+    ResultLog log;
+    if (!log_dir.empty()) {
+        if (!log.open(log_dir, &err)) {
+            std::cerr << "monitor: " << err << "\n";
+            return 3;
+        }
+        cfg.log = &log;
+    }
+
+    std::cout << "Monitoring " << targets.size() << " targets every " << cfg.interval_s
+              << " s; status: " << cfg.status_path << "\n";
+    if (cfg.metrics) std::cout << "Metrics: http://127.0.0.1:" << server.port() << "/metrics\n";
+    std::cout << std::flush;
+    std::vector<TargetHealthRow> table;
+    std::vector<TargetStats> stats;
+    if (!run_monitor(targets, cfg, &table, &err, &stats)) {
+        std::cerr << "monitor: " << err << "\n";
+        return 3;
+    }
+    log.close();
+
+    size_t counts[4] = {0, 0, 0, 0};
+    for (auto& r : table) counts[(int)r.health]++;
+    std::cout << "monitor stopped: up=" << counts[(int)TargetHealth::Up]
+              << " degraded=" << counts[(int)TargetHealth::Degraded]
+              << " down=" << counts[(int)TargetHealth::Down]
+              << " unknown=" << counts[(int)TargetHealth::Unknown] << "\n";
+    TargetStats all;
+    for (auto& s : stats) all.merge(s);
+    if (all.replies()) {
+        std::cout << "rtt over " << all.replies() << " replies: p50=" << all.rtt().percentile(50)
+                  << " p90=" << all.rtt().percentile(90) << " p99=" << all.rtt().percentile(99)
+                  << " max=" << all.rtt().max() << " us; " << all.timeouts() << " timeouts\n";
+    }
+    if (cfg.log) {
+        std::cout << "log: " << log_dir << " dropped=" << log.dropped()
+                  << " write_errors=" << log.write_errors() << "\n";
+    }
+    return 0;
+}
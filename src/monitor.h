@@ -0,0 +1,92 @@
+#pragma once
+#include "prober.h"
+#include "sip_timers.h"
+#include "target_stats.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MetricsRegistry;
+class ResultLog;
+
+enum class TargetHealth : uint8_t { Unknown, Up, Degraded, Down };
+
+const char* target_health_name(TargetHealth h);
+
+// When a probe outcome counts as what, and how many in a row it takes to
+// believe it.
+struct HealthPolicy {
+    int rise = 2;               // consecutive Up or Degraded probes to switch to that state
+    int fall = 3;               // consecutive failed probes to switch to Down
+    int degraded_rtt_ms = 1000; // a 2xx slower than this counts as Degraded
+};
+
+// One row of the health table, kept small so 10k+ targets stay in cache.
+struct TargetHealthRow {
+    uint32_t probes = 0;
+    uint32_t failures = 0;
+    uint32_t changed_s = 0;          // monitor uptime at the last state change
+    uint16_t last_status = 0;        // 0 -> no reply
+    uint16_t last_rtt_ms = 0xffff;   // capped; 0xffff -> no reply
+    TargetHealth health = TargetHealth::Unknown;
+    TargetHealth pending = TargetHealth::Unknown;  // state the streak argues for
+    uint8_t streak = 0;
+
+    // Folds in one probe outcome. The first outcome sets the state directly;
+    // after that a different state has to repeat `rise` (or `fall`, for Down)
+    // times in a row. Returns true when health changed.
+    bool observe(TargetHealth seen, const HealthPolicy& p, uint32_t now_s);
+};
+
+// Probe times for n targets sharing one interval. Target i owns a phase
+// inside slot i of interval/n, so the whole inventory is spread evenly over
+// each interval, and every probe is pushed back by a fresh random delay of up
+// to jitter * interval. Probes stay anchored to their phase: a slow or missed
+// round never drifts a target into its neighbours' slots.
+class MonitorSchedule {
+public:
+    MonitorSchedule(size_t n, uint32_t interval_ms, double jitter);
+
+    uint64_t first(size_t i);
+    // Target i's next probe in the first round that starts after after_ms.
+    uint64_t next(size_t i, uint64_t after_ms);
+
+private:
+    uint32_t delay();
+
+    uint32_t interval_ms_;
+    uint32_t jitter_ms_;
+    std::vector<uint32_t> phase_;
+};
+
+struct MonitorConfig {
+    std::string from_uri;
+    std::string to_uri;        // "" -> each target's own request URI
+    std::string user_agent;
+    SipTimers timers;          // per probe: Timer E retransmits, Timer F gives up
+    HealthPolicy policy;
+    int interval_s = 30;
+    double jitter = 0.1;       // fraction of the interval
+    int sockets = 1;
+    bool kernel_ts = false;    // end RTTs on kernel receive stamps where supported
+    int resolve_threads = 16;
+    int dns_refresh_s = 5;     // background re-resolve of expired names
+    int status_every_s = 60;   // status file rewrite period
+    double duration_s = 0;     // 0 -> until SIGINT/SIGTERM
+    std::string status_path;   // "" -> no status file
+    MetricsRegistry* metrics = nullptr;  // optional, one entry per target, in order
+    ResultLog* log = nullptr;            // optional, every probe outcome appended
+};
+
+// Probes every target with OPTIONS on its own schedule from one event loop
+// (non-blocking sockets, one TimerWheel for both probe and retransmit
+// timers) until the duration runs out or a stop signal arrives. Names are
+// resolved before the first probe and refreshed by a helper thread; the loop
+// itself never waits on DNS. Health transitions are printed as they happen.
+// Returns the final health table, in target order, through *table, and if
+// stats is set each target's RTT sketch and status counts for the whole run.
+bool run_monitor(const std::vector<ProbeTarget>& targets, const MonitorConfig& cfg,
+                 std::vector<TargetHealthRow>* table, std::string* err,
+                 std::vector<TargetStats>* stats = nullptr);
+
+int cmd_monitor(int argc, char** argv);
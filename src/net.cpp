@@ -1,4 +1,6 @@
 #include "net.h"
+#include "resolver.h"
+#include "udp_uring.h"
 #include <chrono>
 #include <cstring>
 
@@ -8,9 +10,19 @@
   static bool wsa_inited = false;
 #else
   #include <arpa/inet.h>
+  #include <errno.h>
+  #include <fcntl.h>
   #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
   #include <sys/socket.h>
   #include <unistd.h>
+  #if defined(__linux__)
+    #include <linux/net_tstamp.h>
+    #include <sys/epoll.h>
+    #include <time.h>
+  #endif
 #endif
 
 static void sock_close(int s) {
@@ -21,10 +33,7 @@ static void sock_close(int s) {
 #endif
 }
 
-UdpClient::UdpClient() {}
-UdpClient::~UdpClient() { close(); }
-
-bool UdpClient::open() {
+static bool net_init() {
 #if defined(_WIN32)
     if (!wsa_inited) {
         WSADATA w;
@@ -32,6 +41,77 @@ bool UdpClient::open() {
         wsa_inited = true;
     }
 #endif
+    return true;
+}
+
+static bool would_block() {
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined(__linux__)
+// Kernel stamps are CLOCK_REALTIME; everything else here runs on the steady
+// clock. Both are read back to back, so the shift is off by well under a
+// microsecond, and it is taken fresh for every receive so clock steps never
+// accumulate.
+static int64_t timespec_ns(const timespec& ts) {
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int64_t realtime_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec_ns(ts);
+}
+
+// Software stamp carried in a message's control data (CLOCK_REALTIME ns),
+// 0 if there is none.
+static int64_t cmsg_stamp_ns(msghdr* m) {
+    for (cmsghdr* c = CMSG_FIRSTHDR(m); c; c = CMSG_NXTHDR(m, c)) {
+        if (c->cmsg_level != SOL_SOCKET) continue;
+        if (c->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return timespec_ns(ts);
+        }
+        if (c->cmsg_type == SCM_TIMESTAMPING) {
+            timespec ts[3];   // [0] software, [2] hardware
+            std::memcpy(ts, CMSG_DATA(c), sizeof(ts));
+            return timespec_ns(ts[0]);
+        }
+    }
+    return 0;
+}
+
+// Empties the error queue, where send stamps land. Returns the newest one
+// (CLOCK_REALTIME ns), or 0.
+static int64_t drain_tx_stamps(int s) {
+    int64_t last = 0;
+    for (;;) {
+        char ctrl[256];
+        msghdr m{};
+        m.msg_control = ctrl;
+        m.msg_controllen = sizeof(ctrl);
+        if (recvmsg(s, &m, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+        if (int64_t t = cmsg_stamp_ns(&m)) last = t;
+    }
+    return last;
+}
+#endif
+
+UdpClient::UdpClient() {}
+UdpClient::~UdpClient() { close(); }
+
+bool UdpClient::open() {
+    if (!net_init()) return false;
     if (sock_ != -1) return true;
     int s = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (s < 0) return false;
@@ -43,9 +123,24 @@ void UdpClient::close() {
     if (sock_ != -1) {
         sock_close(sock_);
         sock_ = -1;
+        rcv_timeout_ms_ = -1;
+        kernel_ts_ = false;
     }
 }
 
+bool UdpClient::enable_kernel_timestamps() {
+#if defined(__linux__)
+    if (sock_ == -1 && !open()) return false;
+    unsigned flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                     SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(sock_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0) return false;
+    kernel_ts_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
 static bool resolve_ipv4(const std::string& host, uint16_t port, sockaddr_in* out) {
     std::memset(out, 0, sizeof(*out));
     out->sin_family = AF_INET;
@@ -66,13 +161,31 @@ static bool resolve_ipv4(const std::string& host, uint16_t port, sockaddr_in* ou
     return true;
 }
 
-UdpReply UdpClient::request(const UdpEndpoint& ep, const std::string& payload, int timeout_ms) {
-    UdpReply r;
-    if (sock_ == -1 && !open()) return r;
+bool resolve_udp_addr(const std::string& host, uint16_t port, UdpAddr* out) {
+    if (!net_init()) return false;
+    sockaddr_in sa{};
+    if (!resolve_ipv4(host, port, &sa)) return false;
+    out->ip = sa.sin_addr.s_addr;
+    out->port = port;
+    return true;
+}
 
-    sockaddr_in dst{};
-    if (!resolve_ipv4(ep.host, ep.port, &dst)) return r;
+std::string udp_addr_ip(const UdpAddr& a) {
+    in_addr ia{};
+    ia.s_addr = a.ip;
+    char ip[64];
+    inet_ntop(AF_INET, &ia, ip, sizeof(ip));
+    return ip;
+}
 
+UdpReply UdpClient::request(const UdpEndpoint& ep, const std::string& payload, int timeout_ms) {
+    UdpAddr dst;
+    if (!resolver_cache().resolve(ep.host, ep.port, &dst)) return UdpReply{};
+    return request(dst, payload, timeout_ms);
+}
+
+void UdpClient::set_timeout(int timeout_ms) {
+    if (timeout_ms == rcv_timeout_ms_) return;
 #if defined(_WIN32)
     DWORD tv = (DWORD)timeout_ms;
     setsockopt((SOCKET)sock_, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
@@ -82,20 +195,82 @@ UdpReply UdpClient::request(const UdpEndpoint& ep, const std::string& payload, i
     tv.tv_usec = (timeout_ms % 1000) * 1000;
     setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 #endif
+    rcv_timeout_ms_ = timeout_ms;
+}
 
-    auto t0 = std::chrono::steady_clock::now();
-    int sent = sendto(sock_, payload.data(), (int)payload.size(), 0, (sockaddr*)&dst, sizeof(dst));
-    if (sent <= 0) return r;
+UdpReply UdpClient::request(const UdpAddr& to, const std::string& payload, int timeout_ms) {
+    if (sock_ == -1 && !open()) return UdpReply{};
 
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = to.ip;
+    dst.sin_port = htons(to.port);
+    set_timeout(timeout_ms);
+
+    int64_t t0, tx_real = 0;
+#if defined(__linux__)
+    if (kernel_ts_) {
+        drain_tx_stamps(sock_);   // leftovers from an unanswered earlier send
+        t0 = steady_ns();
+        tx_real = realtime_ns();
+        if (sendto(sock_, payload.data(), payload.size(), 0, (sockaddr*)&dst, sizeof(dst)) <= 0) return UdpReply{};
+    } else
+#endif
+    {
+        t0 = steady_ns();
+        int sent = sendto(sock_, payload.data(), (int)payload.size(), 0, (sockaddr*)&dst, sizeof(dst));
+        if (sent <= 0) return UdpReply{};
+    }
+    return recv_reply(t0, tx_real);
+}
+
+UdpReply UdpClient::receive(int timeout_ms) {
+    if (sock_ == -1) return UdpReply{};
+    set_timeout(timeout_ms);
+    return recv_reply(0, 0);
+}
+
+UdpReply UdpClient::recv_reply(int64_t t0, int64_t tx_real) {
+    UdpReply r;
     char buf[65536];
     sockaddr_in src{};
+    int got;
+    int64_t t1;
+#if defined(__linux__)
+    int64_t rx_real = 0, now_real = 0;
+    if (kernel_ts_) {
+        iovec iov{buf, sizeof(buf) - 1};
+        char ctrl[256];
+        msghdr m{};
+        m.msg_name = &src;
+        m.msg_namelen = sizeof(src);
+        m.msg_iov = &iov;
+        m.msg_iovlen = 1;
+        m.msg_control = ctrl;
+        m.msg_controllen = sizeof(ctrl);
+        got = (int)recvmsg(sock_, &m, 0);
+        t1 = steady_ns();
+        now_real = realtime_ns();
+        if (got > 0) {
+            rx_real = cmsg_stamp_ns(&m);
+            if (t0) {
+                if (int64_t t = drain_tx_stamps(sock_)) {
+                    tx_real = t;
+                    r.kernel_ts = rx_real != 0;
+                }
+            }
+        }
+    } else
+#endif
+    {
 #if defined(_WIN32)
-    int slen = sizeof(src);
+        int slen = sizeof(src);
 #else
-    socklen_t slen = sizeof(src);
+        socklen_t slen = sizeof(src);
 #endif
-    int got = recvfrom(sock_, buf, (int)sizeof(buf)-1, 0, (sockaddr*)&src, &slen);
-    auto t1 = std::chrono::steady_clock::now();
+        got = recvfrom(sock_, buf, (int)sizeof(buf)-1, 0, (sockaddr*)&src, &slen);
+        t1 = steady_ns();
+    }
 
     if (got <= 0) return r;
     buf[got] = 0;
@@ -107,6 +282,496 @@ UdpReply UdpClient::request(const UdpEndpoint& ep, const std::string& payload, i
     r.data.assign(buf, got);
     r.peer_ip = ip;
     r.peer_port = ntohs(src.sin_port);
-    r.elapsed_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    r.elapsed_ns = t0 ? t1 - t0 : -1;
+    r.rx_ns = t1;
+#if defined(__linux__)
+    // Without a send stamp the userspace send time still pairs with the
+    // kernel receive stamp; both are CLOCK_REALTIME.
+    if (rx_real) {
+        if (t0) r.elapsed_ns = rx_real - tx_real;
+        r.rx_ns = t1 - (now_real - rx_real);
+    }
+#endif
     return r;
 }
+
+UdpSocket::UdpSocket() {}
+UdpSocket::~UdpSocket() { close(); }
+
+bool UdpSocket::open(int rcvbuf_bytes) {
+    if (!net_init()) return false;
+    if (sock_ != -1) return true;
+    int s = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) return false;
+
+#if defined(_WIN32)
+    u_long nb = 1;
+    if (ioctlsocket((SOCKET)s, FIONBIO, &nb) != 0) { sock_close(s); return false; }
+#else
+    int fl = fcntl(s, F_GETFL, 0);
+    if (fl < 0 || fcntl(s, F_SETFL, fl | O_NONBLOCK) < 0) { sock_close(s); return false; }
+#endif
+    if (rcvbuf_bytes > 0) {
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf_bytes, sizeof(rcvbuf_bytes));
+    }
+    sock_ = s;
+    return true;
+}
+
+void UdpSocket::close() {
+    if (sock_ != -1) {
+        sock_close(sock_);
+        sock_ = -1;
+    }
+}
+
+bool UdpSocket::bind(const std::string& ip, uint16_t port) {
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &sa.sin_addr) != 1) return false;
+    return ::bind(sock_, (sockaddr*)&sa, sizeof(sa)) == 0;
+}
+
+uint16_t UdpSocket::local_port() const {
+    sockaddr_in sa{};
+#if defined(_WIN32)
+    int slen = sizeof(sa);
+#else
+    socklen_t slen = sizeof(sa);
+#endif
+    if (getsockname(sock_, (sockaddr*)&sa, &slen) != 0) return 0;
+    return ntohs(sa.sin_port);
+}
+
+bool UdpSocket::reuse_port() {
+#if defined(__linux__)
+    int on = 1;
+    return setsockopt(sock_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == 0;
+#else
+    return false;
+#endif
+}
+
+bool UdpSocket::enable_rx_timestamps() {
+#if defined(__linux__)
+    int on = 1;
+    return setsockopt(sock_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0;
+#else
+    return false;
+#endif
+}
+
+int UdpSocket::send_to(const UdpAddr& dst, const char* data, size_t len) {
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(dst.port);
+    sa.sin_addr.s_addr = dst.ip;
+    int n = sendto(sock_, data, (int)len, 0, (sockaddr*)&sa, sizeof(sa));
+    if (n < 0) return would_block() ? 0 : -1;
+    return n;
+}
+
+int UdpSocket::recv_from(char* buf, size_t cap, UdpAddr* src) {
+    sockaddr_in sa{};
+#if defined(_WIN32)
+    int slen = sizeof(sa);
+#else
+    socklen_t slen = sizeof(sa);
+#endif
+    int n = recvfrom(sock_, buf, (int)cap, 0, (sockaddr*)&sa, &slen);
+    if (n < 0) return would_block() ? 0 : -1;
+    if (src) {
+        src->ip = sa.sin_addr.s_addr;
+        src->port = ntohs(sa.sin_port);
+    }
+    return n;
+}
+
+static int poll_one(int fd, short events, int timeout_ms) {
+    pollfd p{};
+    p.fd = fd;
+    p.events = events;
+#if defined(_WIN32)
+    return WSAPoll(&p, 1, timeout_ms);
+#else
+    return poll(&p, 1, timeout_ms);
+#endif
+}
+
+TcpListener::TcpListener() {}
+TcpListener::~TcpListener() { close(); }
+
+bool TcpListener::listen(const std::string& ip, uint16_t port) {
+    if (!net_init()) return false;
+    close();
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &sa.sin_addr) != 1) return false;
+
+    int s = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) return false;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+    if (::bind(s, (sockaddr*)&sa, sizeof(sa)) != 0 || ::listen(s, 16) != 0) {
+        sock_close(s);
+        return false;
+    }
+    sock_ = s;
+    return true;
+}
+
+void TcpListener::close() {
+    if (sock_ != -1) {
+        sock_close(sock_);
+        sock_ = -1;
+    }
+}
+
+uint16_t TcpListener::local_port() const {
+    sockaddr_in sa{};
+#if defined(_WIN32)
+    int slen = sizeof(sa);
+#else
+    socklen_t slen = sizeof(sa);
+#endif
+    if (getsockname(sock_, (sockaddr*)&sa, &slen) != 0) return 0;
+    return ntohs(sa.sin_port);
+}
+
+int TcpListener::accept(int timeout_ms) {
+    if (sock_ == -1 || poll_one(sock_, POLLIN, timeout_ms) <= 0) return -1;
+    int c = (int)::accept(sock_, nullptr, nullptr);
+    return c < 0 ? -1 : c;
+}
+
+int tcp_connect(const std::string& ip, uint16_t port) {
+    if (!net_init()) return -1;
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &sa.sin_addr) != 1) return -1;
+    int s = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) return -1;
+    if (connect(s, (sockaddr*)&sa, sizeof(sa)) != 0) {
+        sock_close(s);
+        return -1;
+    }
+    return s;
+}
+
+int tcp_recv(int fd, char* buf, size_t cap, int timeout_ms) {
+    int r = poll_one(fd, POLLIN, timeout_ms);
+    if (r <= 0) return r;
+    int n = recv(fd, buf, (int)cap, 0);
+    return n < 0 ? -1 : n;
+}
+
+bool tcp_send_all(int fd, const char* data, size_t len) {
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL; // a scraper hanging up must not kill the run
+#else
+    const int flags = 0;
+#endif
+    while (len > 0) {
+        int n = send(fd, data, (int)len, flags);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+void tcp_close(int fd) {
+    if (fd != -1) sock_close(fd);
+}
+
+bool tcp_set_nonblocking(int fd) {
+#if defined(_WIN32)
+    u_long nb = 1;
+    if (ioctlsocket((SOCKET)fd, FIONBIO, &nb) != 0) return false;
+#else
+    int fl = fcntl(fd, F_GETFL, 0);
+    if (fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0) return false;
+#endif
+    // Requests are written whole; Nagle would only hold back pipelined ones.
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    return true;
+}
+
+int tcp_connect_nb(const UdpAddr& dst, int timeout_ms) {
+    if (!net_init()) return -1;
+    int s = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) return -1;
+    if (!tcp_set_nonblocking(s)) { sock_close(s); return -1; }
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(dst.port);
+    sa.sin_addr.s_addr = dst.ip;
+    if (connect(s, (sockaddr*)&sa, sizeof(sa)) != 0) {
+#if defined(_WIN32)
+        bool pending = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        bool pending = errno == EINPROGRESS;
+#endif
+        int err = 0;
+#if defined(_WIN32)
+        int elen = sizeof(err);
+#else
+        socklen_t elen = sizeof(err);
+#endif
+        if (!pending || poll_one(s, POLLOUT, timeout_ms) <= 0 ||
+            getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &elen) != 0 || err != 0) {
+            sock_close(s);
+            return -1;
+        }
+    }
+    return s;
+}
+
+int tcp_write(int fd, const char* data, size_t len) {
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    int n = send(fd, data, (int)len, flags);
+    if (n < 0) return would_block() ? 0 : -1;
+    return n;
+}
+
+int tcp_read(int fd, char* buf, size_t cap) {
+    int n = recv(fd, buf, (int)cap, 0);
+    if (n < 0) return would_block() ? 0 : -1;
+    return n == 0 ? -1 : n;
+}
+
+int tcp_wait(std::vector<TcpWaitFd>& fds, int timeout_ms) {
+    std::vector<pollfd> p(fds.size());
+    for (size_t i = 0; i < fds.size(); i++) {
+        p[i].fd = fds[i].fd;
+        p[i].events = (short)(POLLIN | (fds[i].want_write ? POLLOUT : 0));
+    }
+#if defined(_WIN32)
+    int r = WSAPoll(p.data(), (ULONG)p.size(), timeout_ms);
+#else
+    int r = poll(p.data(), (nfds_t)p.size(), timeout_ms);
+#endif
+    if (r < 0) return would_block() ? 0 : -1;
+    for (size_t i = 0; i < fds.size(); i++) {
+        fds[i].readable = (p[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+        fds[i].writable = (p[i].revents & POLLOUT) != 0;
+    }
+    return r;
+}
+
+UdpPoller::UdpPoller() {
+#if defined(__linux__)
+    ep_ = epoll_create1(0);
+#endif
+}
+
+UdpPoller::~UdpPoller() {
+#if defined(__linux__)
+    if (ep_ != -1) close(ep_);
+#endif
+}
+
+bool UdpPoller::add(const UdpSocket& s) {
+    if (s.fd() == -1) return false;
+    if (ring_) {
+        if (!ring_->arm(s.fd())) return false;
+        fds_.push_back(s.fd());
+        return true;
+    }
+#if defined(__linux__)
+    if (ep_ == -1) return false;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)fds_.size();
+    if (epoll_ctl(ep_, EPOLL_CTL_ADD, s.fd(), &ev) != 0) return false;
+#endif
+    fds_.push_back(s.fd());
+    return true;
+}
+
+bool UdpPoller::use(UdpBatch& b) {
+    if (!b.uring_ || ring_ == b.uring_.get()) return true;
+#if defined(__linux__)
+    if (ep_ == -1) return false;
+    for (int fd : fds_) {
+        epoll_ctl(ep_, EPOLL_CTL_DEL, fd, nullptr);
+        if (!b.uring_->arm(fd)) return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    if (epoll_ctl(ep_, EPOLL_CTL_ADD, b.uring_->fd(), &ev) != 0) return false;
+    ring_ = b.uring_.get();
+    return true;
+#else
+    return false;
+#endif
+}
+
+int UdpPoller::wait(int timeout_ms, std::vector<int>& ready) {
+    ready.clear();
+#if defined(__linux__)
+    if (ring_) {
+        // Completions for every socket land on the one ring fd; only sleep
+        // when nothing is queued yet.
+        ring_->reap();
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (ring_->pending(fds_[i])) ready.push_back((int)i);
+        }
+        if (!ready.empty() || timeout_ms == 0) return (int)ready.size();
+        epoll_event ev;
+        if (epoll_wait(ep_, &ev, 1, timeout_ms) < 0 && errno != EINTR) return -1;
+        ring_->reap();
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (ring_->pending(fds_[i])) ready.push_back((int)i);
+        }
+        return (int)ready.size();
+    }
+    epoll_event evs[16];
+    int n = epoll_wait(ep_, evs, 16, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < n; i++) ready.push_back((int)evs[i].data.u32);
+#else
+    std::vector<pollfd> pfds(fds_.size());
+    for (size_t i = 0; i < fds_.size(); i++) {
+        pfds[i].fd = fds_[i];
+        pfds[i].events = POLLIN;
+    }
+  #if defined(_WIN32)
+    int n = WSAPoll(pfds.data(), (ULONG)pfds.size(), timeout_ms);
+  #else
+    int n = poll(pfds.data(), (nfds_t)pfds.size(), timeout_ms);
+  #endif
+    if (n < 0) return would_block() ? 0 : -1;
+    for (size_t i = 0; i < pfds.size(); i++) {
+        if (pfds[i].revents & POLLIN) ready.push_back((int)i);
+    }
+#endif
+    return (int)ready.size();
+}
+
+#if defined(__linux__)
+struct UdpBatch::Impl {
+    static const size_t kCtrl = 64;   // room for one SCM_TIMESTAMPNS
+    std::vector<mmsghdr> hdrs;
+    std::vector<iovec> iovs;
+    std::vector<sockaddr_in> addrs;
+    std::vector<char> ctrl;
+};
+#else
+struct UdpBatch::Impl {};
+#endif
+
+UdpBatch::UdpBatch(size_t max_batch, size_t max_datagram)
+: max_batch_(max_batch ? max_batch : 1), max_datagram_(max_datagram),
+  bufs_(max_batch_ * max_datagram_), got_(max_batch_), impl_(new Impl) {
+#if defined(__linux__)
+    impl_->hdrs.resize(max_batch_);
+    impl_->iovs.resize(max_batch_);
+    impl_->addrs.resize(max_batch_);
+    impl_->ctrl.resize(max_batch_ * Impl::kCtrl);
+#endif
+}
+
+UdpBatch::~UdpBatch() {}
+
+bool UdpBatch::use_uring() {
+    if (uring_) return true;
+    if (!udp_uring_supported()) return false;
+    std::unique_ptr<UdpUring> r(new UdpUring);
+    if (!r->init(max_batch_)) return false;
+    uring_ = std::move(r);
+    std::vector<char>().swap(bufs_);   // receives now land in the ring's buffers
+    return true;
+}
+
+int UdpBatch::send(UdpSocket& s, const UdpDatagram* msgs, size_t n) {
+    if (n > max_batch_) n = max_batch_;
+    if (n == 0) return 0;
+    if (uring_) return uring_->send(s.fd(), msgs, n);
+#if defined(__linux__)
+    auto& im = *impl_;
+    for (size_t i = 0; i < n; i++) {
+        auto& sa = im.addrs[i];
+        sa = sockaddr_in{};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(msgs[i].addr.port);
+        sa.sin_addr.s_addr = msgs[i].addr.ip;
+        im.iovs[i].iov_base = const_cast<char*>(msgs[i].data);
+        im.iovs[i].iov_len = msgs[i].len;
+        auto& h = im.hdrs[i];
+        h = mmsghdr{};
+        h.msg_hdr.msg_name = &sa;
+        h.msg_hdr.msg_namelen = sizeof(sa);
+        h.msg_hdr.msg_iov = &im.iovs[i];
+        h.msg_hdr.msg_iovlen = 1;
+    }
+    int r = sendmmsg(s.fd(), im.hdrs.data(), (unsigned)n, 0);
+    if (r < 0) return would_block() ? 0 : -1;
+    return r;
+#else
+    size_t i = 0;
+    for (; i < n; i++) {
+        int r = s.send_to(msgs[i].addr, msgs[i].data, msgs[i].len);
+        if (r < 0) return i == 0 ? -1 : (int)i;
+        if (r == 0) break;
+    }
+    return (int)i;
+#endif
+}
+
+int UdpBatch::recv(UdpSocket& s) {
+    if (uring_) return uring_->take(s.fd(), got_.data(), max_batch_);
+#if defined(__linux__)
+    auto& im = *impl_;
+    for (size_t i = 0; i < max_batch_; i++) {
+        im.iovs[i].iov_base = &bufs_[i * max_datagram_];
+        im.iovs[i].iov_len = max_datagram_;
+        auto& h = im.hdrs[i];
+        h = mmsghdr{};
+        h.msg_hdr.msg_name = &im.addrs[i];
+        h.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        h.msg_hdr.msg_iov = &im.iovs[i];
+        h.msg_hdr.msg_iovlen = 1;
+        h.msg_hdr.msg_control = &im.ctrl[i * Impl::kCtrl];
+        h.msg_hdr.msg_controllen = Impl::kCtrl;
+    }
+    int r = recvmmsg(s.fd(), im.hdrs.data(), (unsigned)max_batch_, MSG_DONTWAIT, nullptr);
+    if (r < 0) return would_block() ? 0 : -1;
+    int64_t shift = 0;   // steady - realtime, read once per batch if any stamp came
+    for (int i = 0; i < r; i++) {
+        auto& d = got_[i];
+        d.addr.ip = im.addrs[i].sin_addr.s_addr;
+        d.addr.port = ntohs(im.addrs[i].sin_port);
+        d.data = &bufs_[i * max_datagram_];
+        d.len = im.hdrs[i].msg_len;
+        d.rx_ns = 0;
+        if (im.hdrs[i].msg_hdr.msg_controllen) {
+            if (int64_t t = cmsg_stamp_ns(&im.hdrs[i].msg_hdr)) {
+                if (!shift) shift = steady_ns() - realtime_ns();
+                d.rx_ns = t + shift;
+            }
+        }
+    }
+    return r;
+#else
+    size_t i = 0;
+    for (; i < max_batch_; i++) {
+        char* b = &bufs_[i * max_datagram_];
+        int r = s.recv_from(b, max_datagram_, &got_[i].addr);
+        if (r < 0) return i == 0 ? -1 : (int)i;
+        if (r == 0) break;
+        got_[i].data = b;
+        got_[i].len = (size_t)r;
+        got_[i].rx_ns = 0;
+    }
+    return (int)i;
+#endif
+}
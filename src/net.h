@@ -1,6 +1,8 @@
 #pragma once
+#include <chrono>
 #include <string>
 #include <vector>
+#include <memory>
 #include <cstdint>
 
 struct UdpEndpoint {
@@ -8,14 +10,27 @@ struct UdpEndpoint {
     uint16_t port;
 };
 
+// Resolved IPv4 destination. ip is in network byte order, port in host order.
+struct UdpAddr {
+    uint32_t ip = 0;
+    uint16_t port = 0;
+};
+
 struct UdpReply {
     bool ok = false;
     std::string data;
     std::string peer_ip;
     uint16_t peer_port = 0;
-    int elapsed_ms = -1;
+    int64_t elapsed_ns = -1;   // send -> receive
+    int64_t rx_ns = 0;         // receive time on the steady clock, ns since its epoch
+    bool kernel_ts = false;    // elapsed_ns taken from kernel timestamps
 };
 
+// Uncached lookup (literal first, then getaddrinfo). Hot paths go through
+// ResolverCache in resolver.h instead.
+bool resolve_udp_addr(const std::string& host, uint16_t port, UdpAddr* out);
+std::string udp_addr_ip(const UdpAddr& a);
+
 class UdpClient {
 public:
     UdpClient();
@@ -24,9 +39,207 @@ public:
     bool open();
     void close();
 
+    // Asks the kernel to stamp sends and receives (SO_TIMESTAMPING, software
+    // stamps) so elapsed_ns leaves out scheduler and syscall latency. False
+    // where unsupported; request() then keeps timing in userspace, as it also
+    // does for any datagram that arrives without a stamp.
+    bool enable_kernel_timestamps();
+
     // Sends UDP and waits for a single reply. Retries are handled by caller.
+    // The endpoint form resolves through resolver_cache(); callers that send
+    // repeatedly should resolve once and use the UdpAddr form.
     UdpReply request(const UdpEndpoint& ep, const std::string& payload, int timeout_ms);
+    UdpReply request(const UdpAddr& dst, const std::string& payload, int timeout_ms);
+    // Waits for the next datagram without sending anything, for a caller
+    // whose last reply belonged to something else. elapsed_ns stays -1.
+    UdpReply receive(int timeout_ms);
+
+private:
+    void set_timeout(int timeout_ms);
+    // One recv after a send at t0 (steady ns; 0 -> nothing sent), tx_real
+    // its CLOCK_REALTIME reading when kernel stamps are on.
+    UdpReply recv_reply(int64_t t0, int64_t tx_real);
+
+    int sock_ = -1;
+    int rcv_timeout_ms_ = -1; // SO_RCVTIMEO currently set, to skip redundant setsockopt
+    bool kernel_ts_ = false;
+};
+
+// Non-blocking UDP socket for the multi-target engines. Never waits; callers
+// drive it from a UdpPoller.
+class UdpSocket {
+public:
+    UdpSocket();
+    ~UdpSocket();
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // rcvbuf_bytes > 0 asks the kernel for a larger receive queue so bursts
+    // of replies are not dropped while we are busy sending.
+    bool open(int rcvbuf_bytes = 0);
+    void close();
+    int fd() const { return sock_; }
+
+    // Binds to ip:port (port 0 picks a free one) for listening roles.
+    bool bind(const std::string& ip, uint16_t port);
+    // SO_REUSEPORT, before bind(): several sockets share one port and the
+    // kernel spreads incoming datagrams across them by flow hash. Linux only;
+    // false elsewhere.
+    bool reuse_port();
+    uint16_t local_port() const;
+
+    // SO_TIMESTAMPNS: UdpBatch::recv then fills UdpDatagram::rx_ns from the
+    // kernel's receive stamp. False where unsupported.
+    bool enable_rx_timestamps();
+
+    // Bytes sent, 0 if the socket would block, -1 on error.
+    int send_to(const UdpAddr& dst, const char* data, size_t len);
+    // Bytes received, 0 if nothing is pending, -1 on error.
+    int recv_from(char* buf, size_t cap, UdpAddr* src);
+
+private:
+    int sock_ = -1;
+};
+
+// Listening TCP socket for the local metrics endpoint. Connections are
+// plain blocking fds, driven with the tcp_* helpers below.
+class TcpListener {
+public:
+    TcpListener();
+    ~TcpListener();
+    TcpListener(const TcpListener&) = delete;
+    TcpListener& operator=(const TcpListener&) = delete;
+
+    // Binds ip:port (port 0 picks a free one) with SO_REUSEADDR and listens.
+    bool listen(const std::string& ip, uint16_t port);
+    void close();
+    uint16_t local_port() const;
+    int fd() const { return sock_; }
+
+    // Waits up to timeout_ms for a connection. Returns its fd, or -1 if none.
+    int accept(int timeout_ms);
 
 private:
     int sock_ = -1;
 };
+
+// Connects to ip:port; returns the fd or -1.
+int tcp_connect(const std::string& ip, uint16_t port);
+// Waits up to timeout_ms for data. Bytes read, 0 on timeout or peer close,
+// -1 on error.
+int tcp_recv(int fd, char* buf, size_t cap, int timeout_ms);
+bool tcp_send_all(int fd, const char* data, size_t len);
+void tcp_close(int fd);
+
+// Non-blocking TCP for persistent SIP connections (tcp_transport.h).
+// Connects within timeout_ms; the fd comes back non-blocking with
+// TCP_NODELAY set, or -1.
+int tcp_connect_nb(const UdpAddr& dst, int timeout_ms);
+// Puts an accepted fd into the same mode.
+bool tcp_set_nonblocking(int fd);
+// Bytes moved, 0 if the socket would block, -1 on error or (reads) when the
+// peer has closed.
+int tcp_write(int fd, const char* data, size_t len);
+int tcp_read(int fd, char* buf, size_t cap);
+
+struct TcpWaitFd {
+    int fd = -1;
+    bool want_write = false;
+    bool readable = false;     // also set on error or hangup, for the read to report
+    bool writable = false;
+};
+// poll() over the set; returns how many are ready, 0 on timeout, -1 on error.
+int tcp_wait(std::vector<TcpWaitFd>& fds, int timeout_ms);
+
+class UdpBatch;
+class UdpUring;
+
+// Readiness wait over a handful of sockets: epoll on Linux, poll elsewhere.
+class UdpPoller {
+public:
+    UdpPoller();
+    ~UdpPoller();
+    UdpPoller(const UdpPoller&) = delete;
+    UdpPoller& operator=(const UdpPoller&) = delete;
+
+    bool add(const UdpSocket& s);
+    // Once b runs on io_uring, waits on its ring instead of the sockets:
+    // those added before or after are armed there, and "readable" means
+    // the ring holds datagrams for them. A no-op for a plain UdpBatch.
+    bool use(UdpBatch& b);
+    // Waits up to timeout_ms and fills `ready` with the add() order index of
+    // each readable socket. Returns the count, or -1 on error.
+    int wait(int timeout_ms, std::vector<int>& ready);
+
+private:
+    int ep_ = -1;
+    std::vector<int> fds_;
+    UdpUring* ring_ = nullptr;
+};
+
+// One datagram in a UdpBatch. On send, addr is the destination and data the
+// caller's bytes; on receive, addr is the source and data points into the
+// batch's own buffers, valid until the next recv(). rx_ns is the kernel's
+// receive stamp moved onto the steady clock (ns since its epoch), or 0 when
+// the socket has no timestamps enabled.
+struct UdpDatagram {
+    UdpAddr addr;
+    const char* data = nullptr;
+    size_t len = 0;
+    int64_t rx_ns = 0;
+};
+
+// The steady clock now, in ns since its epoch: the time base of rx_ns.
+int64_t steady_ns();
+#if defined(__linux__)
+// CLOCK_REALTIME in ns, the clock kernel receive stamps are taken on.
+int64_t realtime_ns();
+#endif
+
+// When d arrived on the steady clock: its kernel stamp, or `fallback` (the
+// caller's own reading after recv) for an unstamped datagram.
+inline std::chrono::steady_clock::time_point udp_rx_time(const UdpDatagram& d,
+                                                         std::chrono::steady_clock::time_point fallback) {
+    if (!d.rx_ns) return fallback;
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(d.rx_ns)));
+}
+
+// Moves up to max_batch datagrams per syscall over a non-blocking UdpSocket:
+// sendmmsg/recvmmsg on Linux, a sendto/recvfrom loop elsewhere. Receive
+// buffers and message headers are allocated once, up front.
+class UdpBatch {
+public:
+    explicit UdpBatch(size_t max_batch = 64, size_t max_datagram = 65536);
+    ~UdpBatch();
+    UdpBatch(const UdpBatch&) = delete;
+    UdpBatch& operator=(const UdpBatch&) = delete;
+
+    size_t max_batch() const { return max_batch_; }
+
+    // Moves this batch onto io_uring (udp_uring.h) when udp_uring_supported();
+    // false, keeping sendmmsg/recvmmsg, otherwise. Call before any traffic
+    // and hand the batch to UdpPoller::use(). Received datagrams longer than
+    // UdpUring::kPayload are then cut short.
+    bool use_uring();
+    bool uring() const { return uring_ != nullptr; }
+
+    // Sends msgs[0..n), n <= max_batch. Returns how many the kernel took
+    // (fewer if the socket buffer filled), or -1 if msgs[0] failed outright.
+    int send(UdpSocket& s, const UdpDatagram* msgs, size_t n);
+    // Takes whatever is pending, up to max_batch, without waiting. Returns the
+    // count (0 if none) or -1 on error; datagrams are in at(0..count).
+    int recv(UdpSocket& s);
+    const UdpDatagram& at(size_t i) const { return got_[i]; }
+
+private:
+    struct Impl;
+    friend class UdpPoller;
+
+    size_t max_batch_;
+    size_t max_datagram_;
+    std::vector<char> bufs_;
+    std::vector<UdpDatagram> got_;
+    std::unique_ptr<Impl> impl_;
+    std::unique_ptr<UdpUring> uring_;
+};
@@ -0,0 +1,258 @@
+#include "pcap.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+#else
+  #include <arpa/inet.h>
+#endif
+
+namespace {
+
+const uint32_t kPcapMicros = 0xa1b2c3d4;
+const uint32_t kPcapNanos = 0xa1b23c4d;
+const uint32_t kNgSection = 0x0a0d0d0a;
+const uint32_t kNgByteOrder = 0x1a2b3c4d;
+const uint32_t kNgIface = 1;
+const uint32_t kNgSimple = 3;
+const uint32_t kNgEnhanced = 6;
+
+uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+uint32_t raw32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Wire fields are big-endian whatever order the file was written in.
+uint16_t be16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+} // namespace
+
+std::string pcap_addr_str(const PcapUdp& p, bool src) {
+    char buf[64];
+    const uint8_t* a = src ? p.src : p.dst;
+    if (!inet_ntop(p.ip_version == 6 ? AF_INET6 : AF_INET, a, buf, sizeof(buf))) return "?";
+    return buf;
+}
+
+uint16_t PcapReader::u16(const uint8_t* p) const {
+    uint16_t v;
+    std::memcpy(&v, p, 2);
+    return swap_ ? (uint16_t)(v >> 8 | v << 8) : v;
+}
+
+uint32_t PcapReader::u32(const uint8_t* p) const {
+    uint32_t v = raw32(p);
+    return swap_ ? swap32(v) : v;
+}
+
+bool PcapReader::open(const std::string& path, std::string* err) {
+    if (!file_.map(path)) { *err = "Cannot map " + path; return false; }
+    p_ = (const uint8_t*)file_.data();
+    end_ = p_ + file_.size();
+    if (file_.size() < 24) { *err = path + ": too short for a capture"; return false; }
+
+    uint32_t magic = raw32(p_);
+    if (magic == kNgSection) {
+        // The section header's byte-order magic says which way to read.
+        ng_ = true;
+        uint32_t bom = raw32(p_ + 8);
+        if (bom != kNgByteOrder && swap32(bom) != kNgByteOrder) { *err = path + ": bad pcapng section"; return false; }
+        swap_ = bom != kNgByteOrder;
+        return true;
+    }
+    if (magic == kPcapMicros || magic == kPcapNanos) swap_ = false;
+    else if (swap32(magic) == kPcapMicros || swap32(magic) == kPcapNanos) swap_ = true;
+    else { *err = path + ": not a pcap or pcapng file"; return false; }
+    nanos_ = (swap_ ? swap32(magic) : magic) == kPcapNanos;
+    link_ = (uint16_t)u32(p_ + 20);
+    p_ += 24;
+    return true;
+}
+
+bool PcapReader::next(PcapUdp* out) {
+    return ng_ ? next_ng(out) : next_classic(out);
+}
+
+bool PcapReader::next_classic(PcapUdp* out) {
+    while (p_ + 16 <= end_) {
+        uint32_t sec = u32(p_), frac = u32(p_ + 4), caplen = u32(p_ + 8);
+        const uint8_t* data = p_ + 16;
+        if (caplen > (size_t)(end_ - data)) { err_ = "truncated record"; return false; }
+        p_ = data + caplen;
+        packets_++;
+        out->ts_ns = (uint64_t)sec * 1000000000ull + (nanos_ ? frac : (uint64_t)frac * 1000);
+        if (decode(link_, data, caplen, out)) return true;
+        skipped_++;
+    }
+    return false;
+}
+
+bool PcapReader::next_ng(PcapUdp* out) {
+    while (p_ + 12 <= end_) {
+        uint32_t type = raw32(p_);
+        if (type == kNgSection) {
+            // A new section may flip the byte order and restarts the interface list.
+            uint32_t bom = raw32(p_ + 8);
+            if (bom != kNgByteOrder && swap32(bom) != kNgByteOrder) { err_ = "bad pcapng section"; return false; }
+            swap_ = bom != kNgByteOrder;
+            nifaces_ = 0;
+        }
+        type = u32(p_);
+        uint32_t blen = u32(p_ + 4);
+        if (blen < 12 || blen % 4 || blen > (size_t)(end_ - p_)) { err_ = "truncated block"; return false; }
+        const uint8_t* b = p_ + 8;
+        const uint8_t* bend = p_ + blen - 4;
+        p_ += blen;
+
+        if (type == kNgIface) {
+            if (bend - b < 8 || nifaces_ == kMaxIfaces) continue;
+            Iface& f = ifaces_[nifaces_++];
+            f = Iface();
+            f.link = u16(b);
+            for (const uint8_t* o = b + 8; o + 4 <= bend;) {
+                uint16_t code = u16(o), olen = u16(o + 2);
+                if (code == 0 || o + 4 + olen > bend) break;
+                if (code == 9 && olen >= 1) {   // if_tsresol
+                    uint8_t r = o[4] & 0x7f;
+                    if (o[4] & 0x80) {
+                        if (r <= 32) { f.ts_mul = 1000000000ull; f.ts_div = 1ull << r; }
+                    } else if (r <= 9) {
+                        f.ts_mul = 1;
+                        for (int i = r; i < 9; i++) f.ts_mul *= 10;
+                        f.ts_div = 1;
+                    } else if (r <= 18) {
+                        f.ts_mul = 1;
+                        f.ts_div = 1;
+                        for (int i = 9; i < r; i++) f.ts_div *= 10;
+                    }
+                }
+                o += 4 + ((olen + 3u) & ~3u);
+            }
+            continue;
+        }
+
+        const uint8_t* data;
+        size_t caplen;
+        uint32_t iface = 0;
+        uint64_t ticks = 0;
+        if (type == kNgEnhanced) {
+            if (bend - b < 20) continue;
+            iface = u32(b);
+            ticks = (uint64_t)u32(b + 4) << 32 | u32(b + 8);
+            caplen = u32(b + 12);
+            data = b + 20;
+        } else if (type == kNgSimple) {
+            // No interface or timestamp: interface 0, time 0.
+            if (bend - b < 4) continue;
+            caplen = u32(b);
+            data = b + 4;
+            if (caplen > (size_t)(bend - data)) caplen = (size_t)(bend - data);
+        } else {
+            continue;
+        }
+        packets_++;
+        if (caplen > (size_t)(bend - data) || iface >= nifaces_) { skipped_++; continue; }
+        const Iface& f = ifaces_[iface];
+        out->ts_ns = ticks / f.ts_div * f.ts_mul + ticks % f.ts_div * f.ts_mul / f.ts_div;
+        if (decode(f.link, data, caplen, out)) return true;
+        skipped_++;
+    }
+    return false;
+}
+
+bool PcapReader::decode(uint16_t link, const uint8_t* p, size_t len, PcapUdp* out) {
+    uint16_t proto = 0;    // ethertype; 0 -> go by the IP version nibble
+    switch (link) {
+    case 1: {              // Ethernet
+        if (len < 14) return false;
+        size_t off = 12;
+        proto = be16(p + off);
+        while ((proto == 0x8100 || proto == 0x88a8) && len >= off + 6) {
+            off += 4;
+            proto = be16(p + off);
+        }
+        p += off + 2;
+        len -= off + 2;
+        break;
+    }
+    case 113:              // Linux cooked v1
+        if (len < 16) return false;
+        proto = be16(p + 14);
+        p += 16;
+        len -= 16;
+        break;
+    case 276:              // Linux cooked v2
+        if (len < 20) return false;
+        proto = be16(p);
+        p += 20;
+        len -= 20;
+        break;
+    case 0:                // BSD loopback: address family in the capturing host's order
+    case 108:
+        if (len < 4) return false;
+        p += 4;
+        len -= 4;
+        break;
+    case 12: case 14: case 101: case 228: case 229:   // raw IP
+        break;
+    default:
+        return false;
+    }
+    if (len < 1) return false;
+    if (proto == 0) proto = (p[0] >> 4) == 6 ? 0x86dd : 0x0800;
+
+    if (proto == 0x0800) {
+        if (len < 20 || (p[0] >> 4) != 4) return false;
+        size_t ihl = (size_t)(p[0] & 15) * 4;
+        size_t total = be16(p + 2);
+        if (ihl < 20 || total < ihl || p[9] != 17) return false;
+        if (be16(p + 6) & 0x3fff) return false;    // a fragment
+        if (total < len) len = total;              // Ethernet padding
+        if (len < ihl) return false;
+        out->ip_version = 4;
+        std::memset(out->src, 0, sizeof(out->src));
+        std::memset(out->dst, 0, sizeof(out->dst));
+        std::memcpy(out->src, p + 12, 4);
+        std::memcpy(out->dst, p + 16, 4);
+        p += ihl;
+        len -= ihl;
+    } else if (proto == 0x86dd) {
+        if (len < 40 || (p[0] >> 4) != 6) return false;
+        size_t payload = be16(p + 4);
+        uint8_t next = p[6];
+        out->ip_version = 6;
+        std::memcpy(out->src, p + 8, 16);
+        std::memcpy(out->dst, p + 24, 16);
+        p += 40;
+        len -= 40;
+        if (payload < len) len = payload;
+        // Hop-by-hop, routing and destination options; a fragment header ends it.
+        while (next == 0 || next == 43 || next == 60) {
+            if (len < 8) return false;
+            size_t hl = ((size_t)p[1] + 1) * 8;
+            if (len < hl) return false;
+            next = p[0];
+            p += hl;
+            len -= hl;
+        }
+        if (next != 17) return false;
+    } else {
+        return false;
+    }
+
+    if (len < 8) return false;
+    size_t ulen = be16(p + 4);
+    if (ulen < 8) return false;
+    out->src_port = be16(p);
+    out->dst_port = be16(p + 2);
+    out->data = (const char*)p + 8;
+    out->len = ulen - 8 < len - 8 ? ulen - 8 : len - 8;
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One UDP datagram from a capture. data points into the mapped file, so it
+// lives as long as the PcapReader.
+struct PcapUdp {
+    uint64_t ts_ns = 0;        // capture time, ns since the Unix epoch
+    uint8_t ip_version = 4;    // 4 or 6
+    uint8_t src[16] = {};      // IPv4 uses the first 4 bytes, network order
+    uint8_t dst[16] = {};
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+    const char* data = nullptr;
+    size_t len = 0;            // as captured; shorter than sent if the snaplen cut it
+};
+
+// "a.b.c.d" or an IPv6 address, for reports.
+std::string pcap_addr_str(const PcapUdp& p, bool src);
+
+// Walks the UDP datagrams of a classic pcap (micro- or nanosecond, either
+// byte order) or pcapng file in place, without copying payloads. Link
+// types: Ethernet (with 802.1Q tags), Linux cooked v1 and v2, raw IP and
+// BSD loopback. IPv4 fragments and anything that is not UDP are skipped.
+class PcapReader {
+public:
+    bool open(const std::string& path, std::string* err);
+
+    // Next UDP datagram in file order; false at the end or on a truncated
+    // record (see error()).
+    bool next(PcapUdp* out);
+
+    const std::string& error() const { return err_; }
+    uint64_t packets() const { return packets_; }     // records seen, UDP or not
+    uint64_t skipped() const { return skipped_; }     // records that were not whole UDP datagrams
+    bool pcapng() const { return ng_; }
+
+private:
+    struct Iface {
+        uint16_t link = 0;
+        uint64_t ts_mul = 1000;    // ns = ticks * ts_mul / ts_div; microseconds by default
+        uint64_t ts_div = 1;
+    };
+    static const size_t kMaxIfaces = 16;
+
+    bool next_classic(PcapUdp* out);
+    bool next_ng(PcapUdp* out);
+    bool decode(uint16_t link, const uint8_t* p, size_t len, PcapUdp* out);
+    uint16_t u16(const uint8_t* p) const;
+    uint32_t u32(const uint8_t* p) const;
+
+    MappedFile file_;
+    const uint8_t* p_ = nullptr;
+    const uint8_t* end_ = nullptr;
+    bool swap_ = false;
+    bool ng_ = false;
+    bool nanos_ = false;             // classic pcap with nanosecond stamps
+    uint16_t link_ = 0;              // classic pcap
+    Iface ifaces_[kMaxIfaces];
+    size_t nifaces_ = 0;
+    uint64_t packets_ = 0;
+    uint64_t skipped_ = 0;
+    std::string err_;
+};
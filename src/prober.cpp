@@ -0,0 +1,281 @@
+#include "prober.h"
+#include "net.h"
+#include "resolver.h"
+#include "schedule.h"
+#include "sip_id.h"
+#include "timer_wheel.h"
+#include "txn.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+bool load_probe_targets(const std::string& path, std::vector<ProbeTarget>* out, std::string* err) {
+    std::ifstream f(path);
+    if (!f) { *err = "cannot open " + path; return false; }
+
+    std::string line;
+    int lineno = 0;
+    while (std::getline(f, line)) {
+        lineno++;
+        auto hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t b = line.find_first_not_of(" \t\r");
+        if (b == std::string::npos) continue;
+        size_t e = line.find_last_not_of(" \t\r");
+        line = line.substr(b, e - b + 1);
+
+        ProbeTarget t;
+        auto colon = line.rfind(':');
+        if (colon != std::string::npos) {
+            t.host = line.substr(0, colon);
+            int p = std::atoi(line.c_str() + colon + 1);
+            if (p <= 0 || p > 65535) {
+                *err = path + ":" + std::to_string(lineno) + ": bad port";
+                return false;
+            }
+            t.port = (uint16_t)p;
+        } else {
+            t.host = line;
+        }
+        out->push_back(t);
+    }
+    return true;
+}
+
+namespace {
+
+enum class ProbeState : uint8_t { Queued, InFlight, Done };
+
+struct ProbeSlot {
+    UdpAddr addr;
+    std::string msg;
+    std::string branch;
+    std::string call_id;
+    Clock::time_point first_send;
+    SipRetransmit retx;
+    TimerWheel::TimerId timer = TimerWheel::kNoTimer;
+    int sock = 0;
+    ProbeState state = ProbeState::Queued;
+    bool queued = false;       // waiting in its socket's send queue
+};
+
+// One worker's share of a multi-target run: its own sockets, transaction
+// table and timer wheel, probing the targets it claims. Slots and results
+// are shared, but each index is only touched by the worker that claimed it.
+void probe_worker(std::vector<ProbeSlot>& slots, std::vector<SipProbeResult>& results,
+                  const MultiProbeConfig& cfg, ScheduleClaims& claims, size_t max_inflight) {
+    int nsock = cfg.sockets < 1 ? 1 : cfg.sockets;
+    std::vector<std::unique_ptr<UdpSocket>> socks;
+    auto poller = std::make_unique<UdpPoller>();
+    for (int i = 0; i < nsock; i++) {
+        auto s = std::make_unique<UdpSocket>();
+        if (!s->open(4 << 20) || !poller->add(*s)) break;
+        if (cfg.kernel_ts) s->enable_rx_timestamps();
+        socks.push_back(std::move(s));
+    }
+    // Without a socket this worker claims nothing and the others cover.
+    if (socks.empty()) return;
+
+    auto io = std::make_unique<UdpBatch>();
+    if (cfg.uring && io->use_uring() && !poller->use(*io)) {
+        // The ring could not take the sockets over: drop it and run this
+        // worker on epoll and recvmmsg/sendmmsg instead.
+        poller = std::make_unique<UdpPoller>();
+        io = std::make_unique<UdpBatch>();
+        for (auto& s : socks) {
+            if (!poller->add(*s)) return;
+        }
+    }
+
+    TxnTable txns;
+    txns.reserve(max_inflight * 2);
+    // Timer E/F per transaction on one wheel, in ms since `base`.
+    const auto base = Clock::now();
+    auto now_ms = [&]{ return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - base).count(); };
+    TimerWheel wheel(0);
+    wheel.reserve(max_inflight);
+    std::vector<uint64_t> fired;
+
+    std::vector<int> ready;
+    SipResponseView resp;
+
+    ScheduleCursor cursor(claims);
+    size_t inflight = 0;
+    bool send_blocked = false;
+
+    // Queues the request (unchanged when retransmitted) for this pass's flush
+    // and arms its next timer. One still queued behind a full socket is only
+    // re-checked on the next tick, not counted as sent again.
+    std::vector<std::vector<uint32_t>> outq(socks.size());
+    std::vector<UdpDatagram> dgs(io->max_batch());
+    auto transmit = [&](uint32_t idx) {
+        auto& s = slots[idx];
+        if (s.queued) {
+            s.timer = wheel.schedule(now_ms() + 1, idx);
+            return;
+        }
+        s.queued = true;
+        outq[(size_t)s.sock % socks.size()].push_back(idx);
+        s.timer = wheel.schedule(s.retx.on_send(cfg.timers, now_ms()), idx);
+    };
+
+    // Hands every socket's queue to the kernel, max_batch datagrams per
+    // sendmmsg (or io_uring submission). False if a socket filled up; what
+    // it did not take stays queued for the next pass.
+    auto flush = [&]() -> bool {
+        bool ok = true;
+        for (size_t k = 0; k < socks.size(); k++) {
+            auto& q = outq[k];
+            size_t done = 0;
+            while (done < q.size()) {
+                size_t n = std::min(io->max_batch(), q.size() - done);
+                for (size_t i = 0; i < n; i++) {
+                    const auto& s = slots[q[done + i]];
+                    dgs[i].addr = s.addr;
+                    dgs[i].data = s.msg.data();
+                    dgs[i].len = s.msg.size();
+                }
+                auto t = Clock::now();
+                int rc = io->send(*socks[k], dgs.data(), n);
+                if (rc < 0) {
+                    // Hard send error: let the timeout path account for it.
+                    results[q[done]].note = "sendto failed";
+                    rc = 1;
+                }
+                for (int i = 0; i < rc; i++) {
+                    auto& s = slots[q[done + (size_t)i]];
+                    s.queued = false;
+                    if (s.retx.sent == 1) s.first_send = t;
+                }
+                done += (size_t)rc;
+                if ((size_t)rc < n) { ok = false; break; }
+            }
+            q.erase(q.begin(), q.begin() + (std::ptrdiff_t)done);
+        }
+        return ok;
+    };
+
+    auto finish = [&](uint32_t idx) {
+        auto& s = slots[idx];
+        s.state = ProbeState::Done;
+        wheel.cancel(s.timer);
+        txns.remove(s.branch);
+        results[idx].retransmits = s.retx.retransmits();
+        inflight--;
+    };
+
+    while (inflight > 0 || cursor.has_next()) {
+        // New probes wait while a socket is still full from the last pass.
+        while (!send_blocked && inflight < max_inflight && cursor.has_next()) {
+            const uint32_t next = (uint32_t)cursor.next();
+            auto& s = slots[next];
+            if (s.state != ProbeState::Queued) { cursor.take(); continue; }
+            transmit(next);
+            s.state = ProbeState::InFlight;
+            txns.add(s.branch, s.call_id, next);
+            inflight++;
+            cursor.take();
+        }
+
+        fired.clear();
+        const uint64_t now = now_ms();
+        wheel.advance(now, fired);
+        for (uint64_t cookie : fired) {
+            uint32_t idx = (uint32_t)cookie;
+            auto& s = slots[idx];
+            s.timer = TimerWheel::kNoTimer;
+            if (s.state != ProbeState::InFlight) continue;
+            if (s.retx.expired(cfg.timers, now)) {
+                if (results[idx].note.empty()) results[idx].note = "No reply to OPTIONS (timeout)";
+                finish(idx);
+            } else {
+                transmit(idx);
+            }
+        }
+
+        send_blocked = !flush();
+        int wait_ms = send_blocked ? 1 : (int)wheel.next_delay_ms(1000);
+        if (poller->wait(wait_ms, ready) < 0) break;
+
+        for (int si : ready) {
+            // One recvmmsg drains a batch and stamps it as it leaves the kernel,
+            // so parsing one reply never inflates the next one's RTT. With
+            // kernel timestamps each reply carries its own arrival time.
+            int got;
+            while ((got = io->recv(*socks[si])) > 0) {
+                auto batch_t = Clock::now();
+                for (int k = 0; k < got; k++) {
+                    const auto& d = io->at(k);
+                    auto t = udp_rx_time(d, batch_t);
+                    if (!parse_sip_response_view(d.data, d.len, &resp)) continue;
+                    uint32_t idx;
+                    if (!txns.match(sip_top_via_branch(resp), resp.call_id, &idx)) continue;
+                    auto& s = slots[idx];
+                    auto& r = results[idx];
+                    r.ok = (resp.status >= 100);
+                    r.status = resp.status;
+                    r.rtt_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - s.first_send).count();
+                    r.kernel_ts = d.rx_ns != 0;
+                    r.peer_ip = udp_addr_ip(d.addr);
+                    r.peer_port = d.addr.port;
+                    r.note = std::string(resp.reason);
+                    finish(idx);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::vector<SipProbeResult> run_multi_probe(const std::vector<ProbeTarget>& targets,
+                                            const MultiProbeConfig& cfg) {
+    const size_t n = targets.size();
+    std::vector<SipProbeResult> results(n);
+    std::vector<ProbeSlot> slots(n);
+    const int nsock = cfg.sockets < 1 ? 1 : cfg.sockets;
+
+    // Message text is built before the clock starts so per-target RTT covers
+    // only the wire, exactly like the single-probe path. Names come from the
+    // cache the caller prefetched (cmd_qa does it in parallel, timed as
+    // dns_us); any it missed are resolved here, one at a time.
+    const std::string tag = sip_new_tag();
+    for (size_t i = 0; i < n; i++) {
+        const auto& t = targets[i];
+        auto& s = slots[i];
+        if (!resolver_cache().resolve(t.host, t.port, &s.addr, &results[i].dns_us)) {
+            results[i].note = "DNS resolution failed";
+            s.state = ProbeState::Done;
+            continue;
+        }
+        s.branch = sip_new_branch();
+        s.call_id = sip_new_call_id();
+        std::string req_uri = "sip:" + t.host + (t.port != 5060 ? ":" + std::to_string(t.port) : "");
+        s.msg = make_sip_options(t.host, t.port, cfg.from_uri,
+                                 cfg.to_uri.empty() ? req_uri : cfg.to_uri,
+                                 cfg.user_agent, s.call_id, 1, s.branch, tag);
+        s.sock = (int)(i % (size_t)nsock);
+    }
+
+    // Targets are claimed a block at a time; max_inflight is split evenly.
+    const int nw = cfg.workers < 1 ? 1 : cfg.workers;
+    ScheduleClaims claims(n, 64);
+    const size_t per_worker = std::max<size_t>(1, (size_t)cfg.max_inflight / (size_t)nw);
+    std::vector<std::thread> pool;
+    for (int w = 1; w < nw; w++) {
+        pool.emplace_back([&] { probe_worker(slots, results, cfg, claims, per_worker); });
+    }
+    probe_worker(slots, results, cfg, claims, per_worker);
+    for (auto& t : pool) t.join();
+
+    for (size_t i = 0; i < n; i++) {
+        if (slots[i].state == ProbeState::Queued) results[i].note = "Failed to open UDP socket";
+    }
+    return results;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "sip.h"
+#include "sip_timers.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct ProbeTarget {
+    std::string host;
+    uint16_t port = 5060;
+};
+
+struct MultiProbeConfig {
+    std::string from_uri;
+    std::string to_uri;        // "" -> each target's own request URI
+    std::string user_agent;
+    SipTimers timers;          // Timer E retransmits, Timer F gives up
+    int max_inflight = 2000;
+    int sockets = 1;           // per worker
+    int workers = 1;           // threads, each with its own sockets, wheel and share of max_inflight
+    int resolve_threads = 16;  // concurrent lookups for the caller's prefetch
+    bool kernel_ts = false;    // end RTTs on kernel receive stamps where supported
+    bool uring = false;        // UDP over io_uring where the kernel has it (UdpBatch::use_uring)
+};
+
+// Target file: one "host[:port]" per line; blank lines and '#' comments are skipped.
+bool load_probe_targets(const std::string& path, std::vector<ProbeTarget>* out, std::string* err);
+
+// Sends OPTIONS to every target from non-blocking sockets, keeping up to
+// max_inflight transactions outstanding, each retransmitted on the RFC 3261
+// Timer E schedule from one TimerWheel. Replies are matched on Via branch and
+// Call-ID. Target names go through resolver_cache(), so a caller that
+// prefetched them pays no lookup here. Results are returned in target order.
+// With workers > 1 targets are claimed in blocks by each thread as it frees
+// up, so a shard of slow or silent targets does not hold the others back.
+std::vector<SipProbeResult> run_multi_probe(const std::vector<ProbeTarget>& targets,
+                                            const MultiProbeConfig& cfg);
@@ -0,0 +1,450 @@
+#include "replay.h"
+#include "app.h"
+#include "net.h"
+#include "pcap.h"
+#include "resolver.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "timer_wheel.h"
+#include "txn.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+#else
+  #include <arpa/inet.h>
+#endif
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// An INVITE that has had a 1xx no longer runs Timer B; it is given up after
+// this long without a final, as a proxy's Timer C (RFC 3261 16.6), so a call
+// nobody answers still ends the replay.
+const uint64_t kTimerCMs = 180000;
+
+// A captured request: views into the mapped file, the spans rewritten on
+// the way out, what the capture says happened to it, and its replay state.
+struct Req {
+    uint64_t ts_ns = 0;
+    const char* data = nullptr;
+    uint32_t len = 0;
+    uint32_t uri_b = 0, uri_e = 0;     // Request-URI host[:port]
+    uint32_t via_b = 0, via_e = 0;     // first Via in the first Via header
+    std::string_view method;
+    std::string_view call_id;
+    ReplayMethodStats* stats = nullptr;
+    int capture_status = 0;
+    uint32_t branch = 0;               // index into the replay's branches
+    bool inflight = false;
+    bool proceeding = false;           // an INVITE that has had a 1xx
+    SipRetransmit retx;
+    TimerWheel::TimerId timer = TimerWheel::kNoTimer;
+    Clock::time_point first_send;
+};
+
+// Finds the host[:port] of the Request-URI and the first Via of the top Via
+// header, as offsets into the message. False if either is missing.
+bool locate(const char* data, const SipRequestView& r, Req* q) {
+    std::string_view uri = r.uri;
+    size_t b = uri.find(':');
+    if (b == std::string_view::npos || r.via_count == 0) return false;
+    size_t at = uri.find('@', b);
+    if (at != std::string_view::npos && at < uri.find('?')) b = at;
+    size_t e = uri.find_first_of(";?>", b + 1);
+    if (e == std::string_view::npos) e = uri.size();
+    q->uri_b = (uint32_t)(uri.data() + b + 1 - data);
+    q->uri_e = (uint32_t)(uri.data() + e - data);
+
+    std::string_view via = r.vias[0].substr(0, r.vias[0].find(','));
+    q->via_b = (uint32_t)(via.data() - data);
+    q->via_e = (uint32_t)(via.data() + via.size() - data);
+    return q->via_b > q->uri_e;
+}
+
+// Matching key for the capture pass: retransmissions and responses share it.
+std::string capture_key(std::string_view branch, std::string_view call_id, std::string_view cseq) {
+    std::string k;
+    k.reserve(branch.size() + call_id.size() + cseq.size() + 2);
+    k.append(branch.data(), branch.size()).append(1, '|');
+    k.append(call_id.data(), call_id.size()).append(1, '|');
+    for (char c : sip_trim(cseq)) if (c != ' ' && c != '\t') k += c;
+    return k;
+}
+
+} // namespace
+
+ReplayResult run_replay(const std::string& path, const ReplayConfig& cfg) {
+    ReplayResult res;
+    if (!(cfg.speed > 0)) { res.error = "speed must be positive"; return res; }
+    uint8_t src_filter[16] = {};
+    int src_family = 0;
+    if (!cfg.src_ip.empty()) {
+        if (inet_pton(AF_INET, cfg.src_ip.c_str(), src_filter) == 1) src_family = 4;
+        else if (inet_pton(AF_INET6, cfg.src_ip.c_str(), src_filter) == 1) src_family = 6;
+        else { res.error = "bad source address " + cfg.src_ip; return res; }
+    }
+
+    PcapReader pcap;
+    if (!pcap.open(path, &res.error)) return res;
+    res.pcapng = pcap.pcapng();
+
+    // Pass over the capture: requests in, their retransmissions out, and the
+    // first final response to each noted against it.
+    std::vector<Req> reqs;
+    std::unordered_map<std::string, uint32_t> by_key;
+    std::vector<std::string_view> orig_branches;
+    PcapUdp d;
+    SipRequestView rq;
+    SipResponseView rs;
+    while (pcap.next(&d)) {
+        if (d.len == 0) { res.not_sip++; continue; }
+        if (parse_sip_request_view(d.data, d.len, &rq)) {
+            if ((src_family && (d.ip_version != src_family || std::memcmp(d.src, src_filter, src_family == 4 ? 4 : 16))) ||
+                (cfg.dst_port && d.dst_port != cfg.dst_port)) {
+                res.filtered++;
+                continue;
+            }
+            Req q;
+            if (!locate(d.data, rq, &q)) { res.not_sip++; continue; }
+            std::string_view branch = sip_via_branch(rq.vias[0]);
+            auto ins = by_key.emplace(capture_key(branch, rq.call_id, rq.cseq), (uint32_t)reqs.size());
+            if (!ins.second) { res.capture_retransmits++; continue; }
+            q.ts_ns = d.ts_ns;
+            q.data = d.data;
+            q.len = (uint32_t)d.len;
+            q.method = rq.method;
+            q.call_id = rq.call_id;
+            q.stats = &res.methods[std::string(rq.method)];
+            q.stats->requests++;
+            reqs.push_back(q);
+            orig_branches.push_back(branch);
+        } else if (parse_sip_response_view(d.data, d.len, &rs)) {
+            if (rs.status < 200) continue;
+            auto it = by_key.find(capture_key(sip_top_via_branch(rs), rs.call_id, rs.cseq));
+            if (it == by_key.end()) continue;
+            Req& q = reqs[it->second];
+            if (q.capture_status) continue;   // a retransmitted final
+            q.capture_status = rs.status;
+            q.stats->capture_answered++;
+            q.stats->capture_statuses[rs.status]++;
+            q.stats->capture_latency.record(d.ts_ns > q.ts_ns ? (d.ts_ns - q.ts_ns) / 1000 : 0);
+        } else {
+            res.not_sip++;
+        }
+    }
+    res.packets = pcap.packets();
+    res.not_udp = pcap.skipped();
+    if (!pcap.error().empty()) { res.error = path + ": " + pcap.error(); return res; }
+    if (reqs.empty()) { res.error = "no SIP requests over UDP in " + path; return res; }
+
+    // Captures merged from several interfaces need not be in time order.
+    std::vector<uint32_t> order(reqs.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return reqs[a].ts_ns < reqs[b].ts_ns; });
+    const uint64_t first_ns = reqs[order.front()].ts_ns;
+    res.capture_span_s = (double)(reqs[order.back()].ts_ns - first_ns) / 1e9;
+
+    // One fresh branch per captured one, so a CANCEL or a non-2xx ACK keeps
+    // sharing its INVITE's branch as the lab expects.
+    std::vector<std::string> branches;
+    {
+        std::unordered_map<std::string_view, uint32_t> fresh;
+        for (size_t i = 0; i < reqs.size(); i++) {
+            std::string_view b = orig_branches[i];
+            auto it = b.empty() ? fresh.end() : fresh.find(b);
+            if (it != fresh.end()) { reqs[i].branch = it->second; continue; }
+            reqs[i].branch = (uint32_t)branches.size();
+            if (!b.empty()) fresh.emplace(b, reqs[i].branch);
+            branches.push_back(sip_new_branch());
+        }
+    }
+
+    UdpAddr dst;
+    if (!resolver_cache().resolve(cfg.host, cfg.port, &dst, &res.dns_us)) { res.error = "DNS resolution failed"; return res; }
+    UdpSocket sock;
+    UdpPoller poller;
+    if (!sock.open(8 << 20) || !sock.bind(cfg.local_ip, 0) || !poller.add(sock)) {
+        res.error = "Failed to open UDP socket on " + cfg.local_ip;
+        return res;
+    }
+    const std::string target = cfg.host + (cfg.port != 5060 ? ":" + std::to_string(cfg.port) : "");
+    const std::string via_head = "SIP/2.0/UDP " + cfg.local_ip + ":" + std::to_string(sock.local_port()) + ";branch=";
+
+    // A CANCEL shares its INVITE's branch; its transaction is keyed apart.
+    std::string key;
+    auto txn_key = [&](std::string_view branch, bool cancel) -> const std::string& {
+        key.assign(branch.data(), branch.size());
+        if (cancel) key += ";cancel";
+        return key;
+    };
+
+    std::string msg;
+    auto render = [&](const Req& q) {
+        msg.assign(q.data, q.uri_b);
+        msg += target;
+        msg.append(q.data + q.uri_e, q.via_b - q.uri_e);
+        msg += via_head;
+        msg += branches[q.branch];
+        msg += ";rport";
+        msg.append(q.data + q.via_e, q.len - q.via_e);
+    };
+
+    TxnTable txns;
+    txns.reserve(1024);
+    TimerWheel wheel(0);
+    std::vector<uint64_t> fired;
+    UdpBatch io;
+    std::vector<int> ready;
+    size_t inflight = 0;
+    const auto t0 = Clock::now();
+    auto ms_at = [&](Clock::time_point t) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(t - t0).count();
+    };
+    auto due = [&](const Req& q) {
+        return t0 + std::chrono::nanoseconds((int64_t)((double)(q.ts_ns - first_ns) / cfg.speed));
+    };
+
+    auto settle = [&](uint32_t idx) {
+        Req& q = reqs[idx];
+        txns.remove(txn_key(branches[q.branch], q.method == "CANCEL"));
+        wheel.cancel(q.timer);
+        q.timer = TimerWheel::kNoTimer;
+        q.inflight = false;
+        inflight--;
+    };
+
+    auto start = [&](uint32_t idx, Clock::time_point now) {
+        Req& q = reqs[idx];
+        render(q);
+        // A full socket buffer (0) loses the request as surely as an error;
+        // only what the kernel took counts as sent.
+        if (sock.send_to(dst, msg.data(), msg.size()) <= 0) { res.send_errors++; return; }
+        q.stats->sent++;
+        if (q.method == "ACK") return;   // no response, no transaction
+        q.inflight = true;
+        q.first_send = now;
+        txns.add(txn_key(branches[q.branch], q.method == "CANCEL"), std::string(q.call_id), idx);
+        q.timer = wheel.schedule(q.retx.on_send(cfg.timers, ms_at(now), q.method == "INVITE"), idx);
+        inflight++;
+    };
+
+    size_t next = 0;
+    while (next < order.size() || inflight > 0) {
+        auto now = Clock::now();
+        while (next < order.size() && due(reqs[order[next]]) <= now) start(order[next++], now);
+        if (next == order.size() && inflight == 0) break;
+
+        int wait_ms = (int)wheel.next_delay_ms(1000);
+        if (next < order.size()) {
+            auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(due(reqs[order[next]]) - now).count();
+            wait_ms = std::min(wait_ms, (int)std::max<int64_t>(0, gap));
+        }
+        if (poller.wait(wait_ms, ready) < 0) { res.error = "poll failed"; break; }
+
+        if (!ready.empty()) {
+            int got;
+            while ((got = io.recv(sock)) > 0) {
+                auto batch_t = Clock::now();
+                for (int k = 0; k < got; k++) {
+                    const auto& dg = io.at(k);
+                    if (!parse_sip_response_view(dg.data, dg.len, &rs)) continue;
+                    uint32_t idx;
+                    const std::string& tk = txn_key(sip_top_via_branch(rs), sip_cseq_method(rs.cseq) == "CANCEL");
+                    if (!txns.match(tk, rs.call_id, &idx)) { res.stray++; continue; }
+                    Req& q = reqs[idx];
+                    if (rs.status < 200) {
+                        // Calling -> Proceeding (RFC 3261 17.1.1.2): Timer A
+                        // stops and Timer B no longer applies.
+                        if (q.method == "INVITE" && !q.proceeding) {
+                            q.proceeding = true;
+                            wheel.cancel(q.timer);
+                            q.timer = wheel.schedule(ms_at(batch_t) + kTimerCMs, idx);
+                        }
+                        continue;
+                    }
+                    q.stats->answered++;
+                    q.stats->statuses[rs.status]++;
+                    q.stats->latency.record(us_between(q.first_send, udp_rx_time(dg, batch_t)));
+                    if (rs.status == q.capture_status) q.stats->same_status++;
+                    settle(idx);
+                }
+            }
+        }
+
+        const uint64_t now_ms = ms_at(Clock::now());
+        fired.clear();
+        wheel.advance(now_ms, fired);
+        for (uint64_t cookie : fired) {
+            Req& q = reqs[(uint32_t)cookie];
+            q.timer = TimerWheel::kNoTimer;
+            if (!q.inflight) continue;
+            if (q.proceeding || q.retx.expired(cfg.timers, now_ms)) {
+                q.stats->timeouts++;
+                settle((uint32_t)cookie);
+                continue;
+            }
+            render(q);
+            int rc = sock.send_to(dst, msg.data(), msg.size());
+            if (rc == 0) {
+                q.timer = wheel.schedule(now_ms + 1, cookie);   // socket full; next tick
+                continue;
+            }
+            if (rc < 0) res.send_errors++;
+            q.timer = wheel.schedule(q.retx.on_send(cfg.timers, now_ms, q.method == "INVITE"), cookie);
+        }
+    }
+    res.elapsed_s = std::chrono::duration<double>(Clock::now() - t0).count();
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void replay_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan replay <file.pcap|file.pcapng> --host <lab.host> [--port 5060] [--speed 1]\n"
+"                  [--src <ip>] [--dst-port <port>] [--local-ip 127.0.0.1]\n"
+"                  [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N]\n"
+"\n"
+"Replays the SIP requests found in a capture (UDP over Ethernet, Linux cooked,\n"
+"raw IP or loopback; IPv4 or IPv6) against a lab target, keeping the captured\n"
+"spacing divided by --speed. Each request's Request-URI host and port are\n"
+"pointed at --host and its top Via at this tool, on a fresh branch;\n"
+"everything else, Call-ID, tags and any Authorization included, goes out\n"
+"as captured, so a lab that checks dialog state or credentials will answer\n"
+"differently and the report shows it. --src and --dst-port keep only the\n"
+"requests one side of the capture sent. The capture's retransmissions are\n"
+"dropped and ours follow the RFC 3261 timers; an INVITE that has had a 1xx\n"
+"stops retransmitting and waits up to 3 minutes (Timer C) for its final.\n"
+"\n"
+"Per method, the report sets the lab's status codes and latency (first send\n"
+"to final response) beside those in the capture.\n"
+"\n"
+"Example:\n"
+"  frogklan replay incident.pcap --host 10.0.0.5 --src 192.0.2.10 --speed 4\n";
+}
+
+static void json_statuses(std::ostream& o, const std::map<int, uint64_t>& m) {
+    o << "{";
+    bool first = true;
+    for (auto& kv : m) {
+        o << (first ? "" : ", ") << "\"" << kv.first << "\": " << kv.second;
+        first = false;
+    }
+    o << "}";
+}
+
+int cmd_replay(int argc, char** argv) {
+    ReplayConfig cfg;
+    std::string path;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--host") cfg.host = need("--host");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--speed") cfg.speed = std::stod(need("--speed"));
+        else if (a == "--src") cfg.src_ip = need("--src");
+        else if (a == "--dst-port") cfg.dst_port = (uint16_t)std::stoi(need("--dst-port"));
+        else if (a == "--local-ip") cfg.local_ip = need("--local-ip");
+        else if (a == "--t1") cfg.timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") cfg.timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--timeout") cfg.timers.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--retries") cfg.timers.max_retransmits = std::stoi(need("--retries"));
+        else if (a == "--help") { replay_usage(); return 0; }
+        else if (!a.empty() && a[0] != '-' && path.empty()) path = a;
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (path.empty() || cfg.host.empty()) {
+        std::cerr << "Missing required args.\n";
+        replay_usage();
+        return 2;
+    }
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_replay_report.json";
+
+    ReplayResult r = run_replay(path, cfg);
+    if (!r.ok) {
+        std::cerr << "replay: " << r.error << "\n";
+        return 3;
+    }
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"capture\": {\"file\": \"" << json_escape(path) << "\", \"format\": \"" << (r.pcapng ? "pcapng" : "pcap")
+    << "\", \"packets\": " << r.packets << ", \"not_udp\": " << r.not_udp << ", \"not_sip\": " << r.not_sip
+    << ", \"filtered\": " << r.filtered << ", \"retransmits\": " << r.capture_retransmits
+    << ", \"span_s\": " << r.capture_span_s << "},\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.host) << "\", \"port\": " << cfg.port << "},\n"
+"  \"dns_us\": " << r.dns_us << ",\n"
+"  \"speed\": " << cfg.speed << ",\n"
+"  \"elapsed_s\": " << r.elapsed_s << ",\n"
+"  \"send_errors\": " << r.send_errors << ",\n"
+"  \"stray\": " << r.stray << ",\n"
+"  \"methods\": {";
+    bool first = true;
+    for (auto& kv : r.methods) {
+        const ReplayMethodStats& m = kv.second;
+        f << (first ? "\n" : ",\n") << "    \"" << json_escape(kv.first) << "\": {\"requests\": " << m.requests
+          << ", \"sent\": " << m.sent << ", \"timeouts\": " << m.timeouts << ", \"same_status\": " << m.same_status
+          << ",\n      \"capture\": {\"answered\": " << m.capture_answered << ", \"statuses\": ";
+        json_statuses(f, m.capture_statuses);
+        f << ", \"latency_us\": ";
+        json_hist(f, m.capture_latency);
+        f << "},\n      \"lab\": {\"answered\": " << m.answered << ", \"statuses\": ";
+        json_statuses(f, m.statuses);
+        f << ", \"latency_us\": ";
+        json_hist(f, m.latency);
+        f << "}}";
+        first = false;
+    }
+    f << "\n  }\n}\n";
+    f.close();
+
+    std::cout << "Replayed " << path << " (" << r.capture_span_s << " s captured, " << r.elapsed_s << " s here) to "
+              << cfg.host << ":" << cfg.port << "\n";
+    std::cout << "SIP replay report: " << report_path << "\n";
+    std::cout << std::left << std::setw(10) << "method" << std::right << std::setw(8) << "sent" << std::setw(10)
+              << "answered" << std::setw(10) << "timeouts" << std::setw(10) << "same" << std::setw(22)
+              << "p50 us capture/lab" << std::setw(22) << "p99 us capture/lab" << "\n";
+    for (auto& kv : r.methods) {
+        const ReplayMethodStats& m = kv.second;
+        std::cout << std::left << std::setw(10) << kv.first << std::right << std::setw(8) << m.sent << std::setw(10)
+                  << m.answered << std::setw(10) << m.timeouts << std::setw(10) << m.same_status << std::setw(22)
+                  << (std::to_string(m.capture_latency.percentile(50)) + "/" + std::to_string(m.latency.percentile(50)))
+                  << std::setw(22)
+                  << (std::to_string(m.capture_latency.percentile(99)) + "/" + std::to_string(m.latency.percentile(99)))
+                  << "\n";
+    }
+    if (r.capture_retransmits || r.filtered || r.not_sip) {
+        std::cout << "skipped: " << r.capture_retransmits << " captured retransmissions, " << r.filtered
+                  << " filtered, " << r.not_sip << " not SIP\n";
+    }
+    return 0;
+}
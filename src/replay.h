@@ -0,0 +1,62 @@
+#pragma once
+#include "histogram.h"
+#include "sip_timers.h"
+#include <cstdint>
+#include <map>
+#include <string>
+
+struct ReplayConfig {
+    std::string host;          // lab target; every request is sent here
+    uint16_t port = 5060;
+    std::string local_ip = "127.0.0.1";  // written into Via; the socket binds here
+    double speed = 1.0;        // 2 -> the capture's gaps halved
+    SipTimers timers;          // per request: Timer E/A retransmits, Timer F/B gives up
+    std::string src_ip;        // "" -> every request; else only those the capture saw sent from here
+    uint16_t dst_port = 0;     // 0 -> any; else only requests the capture saw sent to this port
+};
+
+// One request method, in the capture and as replayed.
+struct ReplayMethodStats {
+    uint64_t requests = 0;               // distinct transactions, capture retransmissions folded
+    uint64_t sent = 0;
+    uint64_t capture_answered = 0;       // a final response in the capture
+    uint64_t answered = 0;               // a final response from the lab
+    uint64_t timeouts = 0;
+    uint64_t same_status = 0;            // lab final equals the captured one
+    std::map<int, uint64_t> capture_statuses;
+    std::map<int, uint64_t> statuses;
+    LatencyHistogram capture_latency;    // first transmission -> final, us, as captured
+    LatencyHistogram latency;            // the same against the lab
+};
+
+struct ReplayResult {
+    bool ok = false;
+    std::string error;
+    int64_t dns_us = 0;
+    bool pcapng = false;
+    uint64_t packets = 0;                // capture records
+    uint64_t not_udp = 0;                // records that were not whole UDP datagrams
+    uint64_t not_sip = 0;                // UDP payloads that parsed as neither request nor response
+    uint64_t filtered = 0;               // requests left out by src_ip / dst_port
+    uint64_t capture_retransmits = 0;    // repeats of a request already taken
+    uint64_t send_errors = 0;            // refused, or first sends a full socket dropped
+    uint64_t stray = 0;                  // lab responses matching nothing in flight
+    double capture_span_s = 0;           // first to last replayed request, as captured
+    double elapsed_s = 0;
+    std::map<std::string, ReplayMethodStats> methods;
+};
+
+// Replays the SIP requests of a pcap or pcapng capture against a lab target.
+// The file is memory-mapped and requests are kept as views into it; each is
+// rewritten only as it is sent: the Request-URI's host and port become the
+// target's, and the top Via is replaced with our own, on a fresh branch so
+// the lab's responses come back here and match through the transaction
+// table. Everything else, Call-ID and tags included, goes out as captured.
+// Requests keep their captured spacing, divided by speed, and are
+// retransmitted on the RFC 3261 timers until a final, or for an INVITE a
+// 1xx, after which it waits up to Timer C; the capture's own retransmissions
+// are dropped. Captured responses give each request's original status and
+// latency to compare against.
+ReplayResult run_replay(const std::string& path, const ReplayConfig& cfg);
+
+int cmd_replay(int argc, char** argv);
@@ -0,0 +1,108 @@
+#include "resolver.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+ResolverCache::ResolverCache(int ttl_ms, int negative_ttl_ms)
+    : ttl_ms_(ttl_ms), negative_ttl_ms_(negative_ttl_ms) {}
+
+bool ResolverCache::lookup_fresh(const std::string& host, Entry* e) const {
+    std::shared_lock<std::shared_mutex> lk(mu_);
+    auto it = map_.find(host);
+    if (it == map_.end() || it->second.expires <= Clock::now()) return false;
+    *e = it->second;
+    return true;
+}
+
+ResolverCache::Entry ResolverCache::fill(const std::string& host) {
+    Entry e;
+    UdpAddr a;
+    auto t0 = Clock::now();
+    e.ok = resolve_udp_addr(host, 0, &a);
+    auto t1 = Clock::now();
+    e.ip = a.ip;
+    e.lookup_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+    std::unique_lock<std::shared_mutex> lk(mu_);
+    Entry& cur = map_[host];
+    if (!e.ok && cur.ok) {
+        // A failed refresh keeps the last good address; only the time of the
+        // next attempt moves.
+        cur.expires = t1 + std::chrono::milliseconds(negative_ttl_ms_);
+        return cur;
+    }
+    e.expires = t1 + std::chrono::milliseconds(e.ok ? ttl_ms_ : negative_ttl_ms_);
+    cur = e;
+    return e;
+}
+
+bool ResolverCache::resolve(const std::string& host, uint16_t port, UdpAddr* out, int64_t* dns_us) {
+    Entry e;
+    if (!lookup_fresh(host, &e)) e = fill(host);
+    if (dns_us) *dns_us = e.lookup_us;
+    if (!e.ok) return false;
+    out->ip = e.ip;
+    out->port = port;
+    return true;
+}
+
+bool ResolverCache::peek(const std::string& host, uint16_t port, UdpAddr* out) const {
+    std::shared_lock<std::shared_mutex> lk(mu_);
+    auto it = map_.find(host);
+    if (it == map_.end() || !it->second.ok) return false;
+    out->ip = it->second.ip;
+    out->port = port;
+    return true;
+}
+
+int64_t ResolverCache::prefetch(const std::vector<std::string>& hosts, int threads) {
+    auto t0 = Clock::now();
+    std::vector<std::string> todo;
+    {
+        std::unordered_set<std::string> seen;
+        Entry e;
+        for (auto& h : hosts) {
+            if (!seen.insert(h).second) continue;
+            if (!lookup_fresh(h, &e)) todo.push_back(h);
+        }
+    }
+
+    size_t nthreads = std::min(todo.size(), (size_t)(threads < 1 ? 1 : threads));
+    if (nthreads <= 1) {
+        for (auto& h : todo) fill(h);
+    } else {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < nthreads; t++) {
+            pool.emplace_back([&] {
+                size_t i;
+                while ((i = next.fetch_add(1)) < todo.size()) fill(todo[i]);
+            });
+        }
+        for (auto& t : pool) t.join();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+}
+
+void ResolverCache::set_ttl_ms(int ttl_ms, int negative_ttl_ms) {
+    std::unique_lock<std::shared_mutex> lk(mu_);
+    ttl_ms_ = ttl_ms;
+    negative_ttl_ms_ = negative_ttl_ms;
+}
+
+void ResolverCache::clear() {
+    std::unique_lock<std::shared_mutex> lk(mu_);
+    map_.clear();
+}
+
+size_t ResolverCache::size() const {
+    std::shared_lock<std::shared_mutex> lk(mu_);
+    return map_.size();
+}
+
+ResolverCache& resolver_cache() {
+    static ResolverCache cache;
+    return cache;
+}
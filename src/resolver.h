@@ -0,0 +1,55 @@
+#pragma once
+#include "net.h"
+#include <chrono>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Host -> IPv4 cache in front of getaddrinfo, shared by every thread. Hits
+// take a shared lock only; a miss resolves outside the lock so one slow name
+// never stalls lookups of the others. Failures are cached too, for a shorter
+// time, so a dead name is not retried on every send; a refresh that fails
+// keeps the name's last good address and is retried after that shorter time.
+class ResolverCache {
+public:
+    explicit ResolverCache(int ttl_ms = 60000, int negative_ttl_ms = 5000);
+
+    // Fills *out for host:port. dns_us (optional) gets the time the lookup
+    // that produced this answer took; a cache hit reports that original cost
+    // rather than zero so reports stay stable however the cache was warmed.
+    bool resolve(const std::string& host, uint16_t port, UdpAddr* out, int64_t* dns_us = nullptr);
+
+    // Last answer for host, even if expired; never resolves. For loops that
+    // must not block and leave refreshing to prefetch() on another thread.
+    bool peek(const std::string& host, uint16_t port, UdpAddr* out) const;
+
+    // Resolves every distinct host in `hosts` that is not already fresh, up to
+    // `threads` lookups at once. Returns the wall time spent, in microseconds.
+    int64_t prefetch(const std::vector<std::string>& hosts, int threads = 16);
+
+    void set_ttl_ms(int ttl_ms, int negative_ttl_ms);
+    void clear();
+    size_t size() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Entry {
+        bool ok = false;
+        uint32_t ip = 0;           // network byte order
+        int64_t lookup_us = 0;
+        Clock::time_point expires;
+    };
+
+    bool lookup_fresh(const std::string& host, Entry* e) const;
+    Entry fill(const std::string& host);
+
+    mutable std::shared_mutex mu_;
+    std::unordered_map<std::string, Entry> map_;
+    int ttl_ms_;
+    int negative_ttl_ms_;
+};
+
+// Process-wide cache used by UdpClient and the multi-target engines.
+ResolverCache& resolver_cache();
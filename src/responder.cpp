@@ -0,0 +1,626 @@
+#include "responder.h"
+#include "app.h"
+#include "md5.h"
+#include "net.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "storm.h"
+#include "tcp_transport.h"
+
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_stop_signal(int) { g_stop = 1; }
+
+uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void put_hex(char* out, uint64_t v, size_t nhex) {
+    static const char kHex[] = "0123456789abcdef";
+    for (size_t i = 0; i < nhex; i++) out[i] = kHex[(v >> (4 * (nhex - 1 - i))) & 0xf];
+}
+
+bool read_hex(std::string_view s, uint64_t* v) {
+    uint64_t x = 0;
+    for (char c : s) {
+        int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        if (d < 0) return false;
+        x = (x << 4) | (uint64_t)d;
+    }
+    *v = x;
+    return true;
+}
+
+uint64_t unix_now_s() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool chance(double p) {
+    return p > 0 && (double)(sip_id_rand64() >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+// Nonce = 8 hex digits of issue time (Unix s) + 16 of a keyed hash of it.
+const size_t kNonceLen = 24;
+
+void make_nonce(uint64_t key, uint64_t now_s, char* out) {
+    put_hex(out, now_s & 0xffffffffu, 8);
+    put_hex(out + 8, mix64(key ^ (now_s & 0xffffffffu)), 16);
+}
+
+enum class NonceCheck { Bad, Stale, Fresh };
+
+NonceCheck check_nonce(uint64_t key, std::string_view nonce, uint64_t now_s, int ttl_s) {
+    uint64_t issued, mac;
+    if (nonce.size() != kNonceLen || !read_hex(nonce.substr(0, 8), &issued) || !read_hex(nonce.substr(8), &mac) ||
+        mac != mix64(key ^ issued)) {
+        return NonceCheck::Bad;
+    }
+    uint64_t age = ((now_s & 0xffffffffu) - issued) & 0xffffffffu;
+    return age > (uint64_t)ttl_s ? NonceCheck::Stale : NonceCheck::Fresh;
+}
+
+bool has_tag(std::string_view to) {
+    for (size_t i = to.find(';'); i != std::string_view::npos; i = to.find(';', i + 1)) {
+        size_t b = i + 1;
+        while (b < to.size() && (to[b] == ' ' || to[b] == '\t')) b++;
+        if (to.size() - b >= 4 && (to[b] | 0x20) == 't' && (to[b+1] | 0x20) == 'a' &&
+            (to[b+2] | 0x20) == 'g' && to[b+3] == '=') return true;
+    }
+    return false;
+}
+
+// Stateless response (RFC 3261 8.2.6): Via, From, To, Call-ID and CSeq are
+// copied from the request, and To gains a tag derived from the Call-ID so
+// every retransmission is answered with the same one.
+void build_response(std::string& o, int code, std::string_view reason, const SipRequestView& q,
+                    std::string_view extra, std::string_view sdp = {}) {
+    o.clear();
+    char num[8];
+    std::snprintf(num, sizeof(num), "%03d ", code);
+    o.append("SIP/2.0 ").append(num).append(reason).append("\r\n");
+    for (size_t i = 0; i < q.via_count; i++) o.append("Via: ").append(q.vias[i]).append("\r\n");
+    o.append("From: ").append(q.from).append("\r\n");
+    o.append("To: ").append(q.to);
+    if (!has_tag(q.to)) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (char c : q.call_id) h = (h ^ (uint8_t)c) * 0x100000001b3ull;
+        char tag[16];
+        put_hex(tag, h, 16);
+        o.append(";tag=").append(tag, 16);
+    }
+    o.append("\r\nCall-ID: ").append(q.call_id);
+    o.append("\r\nCSeq: ").append(q.cseq).append("\r\n");
+    o.append(extra);
+    o.append("Server: frogklan-responder\r\n");
+    if (sdp.empty()) {
+        o.append("Content-Length: 0\r\n\r\n");
+        return;
+    }
+    char len[24];
+    auto r = std::to_chars(len, len + sizeof(len), sdp.size());
+    o.append("Content-Type: application/sdp\r\nContent-Length: ").append(len, (size_t)(r.ptr - len));
+    o.append("\r\n\r\n").append(sdp);
+}
+
+} // namespace
+
+struct SipResponder::Worker {
+    UdpSocket sock;
+    TcpListener listener;  // the TCP worker only
+    std::thread th;
+    std::atomic<uint64_t> received{0}, malformed{0}, options{0}, registers{0}, challenged{0},
+        registered{0}, forbidden{0}, invites{0}, byes{0}, not_allowed{0}, busy{0}, dropped{0}, sent{0},
+        send_errors{0};
+};
+
+SipResponder::SipResponder() {}
+SipResponder::~SipResponder() { stop(); }
+
+bool SipResponder::start(const ResponderConfig& cfg, std::string* err) {
+    cfg_ = cfg;
+    ha1_.clear();
+    for (auto& u : cfg_.users) ha1_[u.first] = MD5::md5_hex(u.first + ":" + cfg_.realm + ":" + u.second);
+    nonce_key_ = sip_id_rand64();
+    sdp_answer_ = "v=0\r\no=frogklan 1 1 IN IP4 " + cfg_.bind_ip + "\r\ns=-\r\nc=IN IP4 " + cfg_.bind_ip +
+                  "\r\nt=0 0\r\nm=audio 40000 RTP/AVP 0\r\na=rtpmap:0 PCMU/8000\r\n";
+    stop_ = false;
+
+    int n = cfg_.workers < 1 ? 1 : cfg_.workers;
+#if !defined(__linux__)
+    n = 1;  // no SO_REUSEPORT load spreading here
+#endif
+    port_ = cfg_.port;
+    for (int i = 0; i < n; i++) {
+        auto w = std::make_unique<Worker>();
+        if (!w->sock.open(8 << 20)) { *err = "Failed to open UDP socket"; break; }
+        if (n > 1 && !w->sock.reuse_port()) { *err = "SO_REUSEPORT unavailable"; break; }
+        if (!w->sock.bind(cfg_.bind_ip, port_)) {
+            *err = "cannot bind " + cfg_.bind_ip + ":" + std::to_string(port_);
+            break;
+        }
+        port_ = w->sock.local_port();
+        workers_.push_back(std::move(w));
+    }
+    if ((int)workers_.size() != n) {
+        workers_.clear();
+        return false;
+    }
+    if (cfg_.tcp) {
+        tcp_ = std::make_unique<Worker>();
+        if (!tcp_->listener.listen(cfg_.bind_ip, port_)) {
+            *err = "cannot listen on TCP " + cfg_.bind_ip + ":" + std::to_string(port_);
+            tcp_.reset();
+            workers_.clear();
+            return false;
+        }
+    }
+    for (auto& w : workers_) {
+        Worker* p = w.get();
+        p->th = std::thread([this, p] { run(*p); });
+    }
+    if (tcp_) tcp_->th = std::thread([this] { run_tcp(*tcp_); });
+    return true;
+}
+
+void SipResponder::stop() {
+    stop_ = true;
+    for (auto& w : workers_) {
+        if (w->th.joinable()) w->th.join();
+    }
+    if (tcp_ && tcp_->th.joinable()) tcp_->th.join();
+}
+
+ResponderStats SipResponder::stats() const {
+    ResponderStats s;
+    std::vector<const Worker*> all;
+    for (auto& w : workers_) all.push_back(w.get());
+    if (tcp_) all.push_back(tcp_.get());
+    for (const Worker* w : all) {
+        s.received += w->received.load(std::memory_order_relaxed);
+        s.malformed += w->malformed.load(std::memory_order_relaxed);
+        s.options += w->options.load(std::memory_order_relaxed);
+        s.registers += w->registers.load(std::memory_order_relaxed);
+        s.challenged += w->challenged.load(std::memory_order_relaxed);
+        s.registered += w->registered.load(std::memory_order_relaxed);
+        s.forbidden += w->forbidden.load(std::memory_order_relaxed);
+        s.invites += w->invites.load(std::memory_order_relaxed);
+        s.byes += w->byes.load(std::memory_order_relaxed);
+        s.not_allowed += w->not_allowed.load(std::memory_order_relaxed);
+        s.busy += w->busy.load(std::memory_order_relaxed);
+        s.dropped += w->dropped.load(std::memory_order_relaxed);
+        s.sent += w->sent.load(std::memory_order_relaxed);
+        s.send_errors += w->send_errors.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+bool SipResponder::answer(Worker& w, const SipRequestView& q, std::string& extra, std::string& o,
+                          std::string& ring) {
+    const auto relaxed = std::memory_order_relaxed;
+    auto challenge = [&](bool stale) {
+        char nonce[kNonceLen];
+        make_nonce(nonce_key_, unix_now_s(), nonce);
+        extra.assign("WWW-Authenticate: Digest realm=\"").append(cfg_.realm);
+        extra.append("\", nonce=\"").append(nonce, kNonceLen).append("\", qop=\"auth\", algorithm=MD5");
+        if (stale) extra.append(", stale=true");
+        extra.append("\r\n");
+        build_response(o, 401, "Unauthorized", q, extra);
+        w.challenged.fetch_add(1, relaxed);
+    };
+
+    if (q.method == "ACK") return false;
+    if (chance(cfg_.drop)) {
+        w.dropped.fetch_add(1, relaxed);
+        return false;
+    }
+    if (chance(cfg_.fail_503)) {
+        build_response(o, 503, "Service Unavailable", q, {});
+        w.busy.fetch_add(1, relaxed);
+        return true;
+    }
+    if (q.method == "OPTIONS") {
+        build_response(o, 200, "OK", q, "Allow: OPTIONS, REGISTER, INVITE, ACK, BYE\r\nAccept: application/sdp\r\n");
+        w.options.fetch_add(1, relaxed);
+        return true;
+    }
+    if (q.method == "INVITE") {
+        build_response(ring, 180, "Ringing", q, {});
+        extra.assign("Contact: <sip:frogklan@").append(cfg_.bind_ip).append(">\r\n");
+        build_response(o, 200, "OK", q, extra, sdp_answer_);
+        w.invites.fetch_add(1, relaxed);
+        return true;
+    }
+    if (q.method == "BYE") {
+        build_response(o, 200, "OK", q, {});
+        w.byes.fetch_add(1, relaxed);
+        return true;
+    }
+    if (q.method != "REGISTER") {
+        build_response(o, 405, "Method Not Allowed", q, "Allow: OPTIONS, REGISTER, INVITE, ACK, BYE\r\n");
+        w.not_allowed.fetch_add(1, relaxed);
+        return true;
+    }
+
+    w.registers.fetch_add(1, relaxed);
+    if (q.authorization.empty()) {
+        challenge(false);
+        return true;
+    }
+    SipDigestCredentials c = parse_digest_credentials(q.authorization);
+    NonceCheck nc = c.ok ? check_nonce(nonce_key_, c.nonce, unix_now_s(), cfg_.nonce_ttl_s) : NonceCheck::Bad;
+    if (nc != NonceCheck::Fresh || c.realm != cfg_.realm) {
+        challenge(nc == NonceCheck::Stale);
+        return true;
+    }
+    auto it = ha1_.find(c.username);
+    bool good = false;
+    if (it != ha1_.end()) {
+        std::string want = digest_expected_response("REGISTER", c, it->second);
+        good = want.size() == c.response.size();
+        for (size_t i = 0; good && i < want.size(); i++) good = want[i] == (char)(c.response[i] | 0x20);
+    }
+    if (!good) {
+        build_response(o, 403, "Forbidden", q, {});
+        w.forbidden.fetch_add(1, relaxed);
+        return true;
+    }
+    extra.clear();
+    if (!q.contact.empty()) extra.append("Contact: ").append(q.contact).append("\r\n");
+    extra.append("Expires: ").append(q.expires.empty() ? std::string_view("3600") : q.expires).append("\r\n");
+    build_response(o, 200, "OK", q, extra);
+    w.registered.fetch_add(1, relaxed);
+    return true;
+}
+
+void SipResponder::run(Worker& w) {
+    const auto relaxed = std::memory_order_relaxed;
+    UdpPoller poller;
+    poller.add(w.sock);
+    UdpBatch io;
+    std::vector<int> ready;
+    std::vector<std::string> bufs(2 * io.max_batch());  // an INVITE is answered twice
+    std::vector<UdpDatagram> out(2 * io.max_batch());
+    SipRequestView q;
+    std::string extra, fin, ring;
+
+    struct Held {
+        Clock::time_point due;
+        UdpAddr to;
+        std::string msg;
+    };
+    // Both delays are constant, so each queue is already in due order.
+    std::deque<Held> held;     // --delay
+    std::deque<Held> ringing;  // INVITE 200s: --delay plus --ring
+    const auto delay = std::chrono::milliseconds(cfg_.delay_ms);
+    const auto ring_delay = delay + std::chrono::milliseconds(cfg_.ring_ms);
+
+    auto send_all = [&](size_t n) {
+        size_t off = 0;
+        while (off < n) {
+            int r = io.send(w.sock, out.data() + off, n - off);
+            if (r <= 0) break;
+            off += (size_t)r;
+        }
+        w.sent.fetch_add(off, relaxed);
+        w.send_errors.fetch_add(n - off, relaxed);
+    };
+
+    size_t n = 0;
+    // Queues msg for now + after, or stages it in the outgoing batch; msg is
+    // left holding a spare buffer either way.
+    auto emit = [&](std::string& msg, const UdpAddr& to, std::deque<Held>& dq, std::chrono::milliseconds after) {
+        if (after.count() > 0) {
+            dq.push_back(Held{Clock::now() + after, to, msg});
+            return;
+        }
+        bufs[n].swap(msg);
+        out[n] = UdpDatagram{to, bufs[n].data(), bufs[n].size()};
+        n++;
+    };
+
+    while (!stop_.load(relaxed)) {
+        int wait_ms = 100;
+        for (auto* dq : {&held, &ringing}) {
+            if (dq->empty()) continue;
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(dq->front().due - Clock::now()).count();
+            int m = ms < 0 ? 0 : (int)ms;
+            if (m < wait_ms) wait_ms = m;
+        }
+        poller.wait(wait_ms, ready);
+
+        auto now = Clock::now();
+        n = 0;
+        for (auto* dq : {&held, &ringing}) {
+            while (!dq->empty() && dq->front().due <= now && n < out.size()) {
+                bufs[n].swap(dq->front().msg);
+                out[n] = UdpDatagram{dq->front().to, bufs[n].data(), bufs[n].size()};
+                dq->pop_front();
+                n++;
+            }
+        }
+        if (n) send_all(n);
+
+        int got;
+        while ((got = io.recv(w.sock)) > 0) {
+            w.received.fetch_add((uint64_t)got, relaxed);
+            n = 0;
+            for (int k = 0; k < got; k++) {
+                const auto& d = io.at(k);
+                if (!parse_sip_request_view(d.data, d.len, &q)) {
+                    w.malformed.fetch_add(1, relaxed);
+                    continue;
+                }
+                ring.clear();
+                if (!answer(w, q, extra, fin, ring)) continue;
+                if (ring.empty()) {
+                    emit(fin, d.addr, held, delay);
+                } else {
+                    emit(ring, d.addr, held, delay);
+                    emit(fin, d.addr, ringing, ring_delay);
+                }
+            }
+            if (n) send_all(n);
+        }
+    }
+}
+
+// Every connection is served from this one thread: requests are framed off
+// the stream and answered in order, and a delayed answer waits in queues
+// shared by all connections (closed ones are only reaped once they drain).
+void SipResponder::run_tcp(Worker& w) {
+    const auto relaxed = std::memory_order_relaxed;
+    std::vector<std::unique_ptr<SipTcpConnection>> conns;
+    std::vector<TcpWaitFd> fds;
+    SipRequestView q;
+    std::string extra, fin, ring;
+    std::string_view m;
+
+    struct Held {
+        Clock::time_point due;
+        SipTcpConnection* conn;
+        std::string msg;
+    };
+    std::deque<Held> held, ringing;  // as in run()
+    const auto delay = std::chrono::milliseconds(cfg_.delay_ms);
+    const auto ring_delay = delay + std::chrono::milliseconds(cfg_.ring_ms);
+
+    auto deliver = [&](SipTcpConnection& c, const std::string& msg) {
+        if (c.send(msg)) w.sent.fetch_add(1, relaxed);
+        else w.send_errors.fetch_add(1, relaxed);
+    };
+    auto emit = [&](SipTcpConnection& c, const std::string& msg, std::deque<Held>& dq,
+                    std::chrono::milliseconds after) {
+        if (after.count() > 0) dq.push_back(Held{Clock::now() + after, &c, msg});
+        else deliver(c, msg);
+    };
+
+    while (!stop_.load(relaxed)) {
+        int wait_ms = 100;
+        for (auto* dq : {&held, &ringing}) {
+            if (dq->empty()) continue;
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(dq->front().due - Clock::now()).count();
+            int left = ms < 0 ? 0 : (int)ms;
+            if (left < wait_ms) wait_ms = left;
+        }
+        fds.resize(conns.size() + 1);
+        fds[0] = TcpWaitFd{w.listener.fd()};
+        for (size_t i = 0; i < conns.size(); i++) fds[i + 1] = TcpWaitFd{conns[i]->fd(), conns[i]->want_write()};
+        if (tcp_wait(fds, wait_ms) < 0) break;
+
+        auto now = Clock::now();
+        for (auto* dq : {&held, &ringing}) {
+            while (!dq->empty() && dq->front().due <= now) {
+                deliver(*dq->front().conn, dq->front().msg);
+                dq->pop_front();
+            }
+        }
+
+        for (size_t i = 0; i < conns.size(); i++) {
+            SipTcpConnection& c = *conns[i];
+            if (!c.is_open()) continue;
+            if (fds[i + 1].writable) c.flush();
+            if (!fds[i + 1].readable) continue;
+            c.recv();
+            while (c.framer().next(&m)) {
+                w.received.fetch_add(1, relaxed);
+                if (!parse_sip_request_view(m.data(), m.size(), &q)) {
+                    w.malformed.fetch_add(1, relaxed);
+                    continue;
+                }
+                ring.clear();
+                if (!answer(w, q, extra, fin, ring)) continue;
+                if (ring.empty()) {
+                    emit(c, fin, held, delay);
+                } else {
+                    emit(c, ring, held, delay);
+                    emit(c, fin, ringing, ring_delay);
+                }
+            }
+            if (c.framer().broken()) c.close();
+        }
+
+        if (fds[0].readable) {
+            int fd = w.listener.accept(0);
+            if (fd != -1) {
+                auto c = std::make_unique<SipTcpConnection>();
+                if (c->adopt(fd, UdpAddr{})) conns.push_back(std::move(c));
+            }
+        }
+        if (held.empty() && ringing.empty()) {
+            size_t k = 0;
+            for (size_t i = 0; i < conns.size(); i++) {
+                if (conns[i]->is_open()) conns[k++] = std::move(conns[i]);
+            }
+            conns.resize(k);
+        }
+    }
+}
+
+static void responder_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan responder [--bind 127.0.0.1] [--port 5060] [--workers 4] [--realm frogklan]\n"
+"                     [--creds <file.csv>] [--user <u> --pass <p>] [--nonce-ttl 300]\n"
+"                     [--delay 0] [--ring 0] [--drop 0] [--fail-503 0] [--tcp] [--duration 0]\n"
+"                     [--status-every 5]\n"
+"\n"
+"Answers OPTIONS with 200 and REGISTER with a Digest 401, then 200 for valid\n"
+"credentials (403 otherwise); INVITE with 180, then 200 and an SDP answer\n"
+"--ring ms later, and BYE with 200. Credentials come from a storm-style CSV\n"
+"(aor,contact,user,password) and/or --user/--pass. --delay holds every\n"
+"response for that many ms; --drop and --fail-503 are fractions of requests\n"
+"ignored or answered 503. --tcp also accepts SIP over TCP on the same port.\n"
+"Runs until SIGINT/SIGTERM or --duration seconds.\n"
+"For loopback testing only: never expose it on a network you do not own.\n";
+}
+
+int cmd_responder(int argc, char** argv) {
+    ResponderConfig cfg;
+    std::string creds_path, user, pass;
+    double duration_s = 0;
+    int status_every_s = 5;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--bind") cfg.bind_ip = need("--bind");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--workers") cfg.workers = std::stoi(need("--workers"));
+        else if (a == "--realm") cfg.realm = need("--realm");
+        else if (a == "--creds") creds_path = need("--creds");
+        else if (a == "--user") user = need("--user");
+        else if (a == "--pass") pass = need("--pass");
+        else if (a == "--nonce-ttl") cfg.nonce_ttl_s = std::stoi(need("--nonce-ttl"));
+        else if (a == "--delay") cfg.delay_ms = std::stoi(need("--delay"));
+        else if (a == "--ring") cfg.ring_ms = std::stoi(need("--ring"));
+        else if (a == "--drop") cfg.drop = std::stod(need("--drop"));
+        else if (a == "--fail-503") cfg.fail_503 = std::stod(need("--fail-503"));
+        else if (a == "--tcp") cfg.tcp = true;
+        else if (a == "--duration") duration_s = std::stod(need("--duration"));
+        else if (a == "--status-every") status_every_s = std::stoi(need("--status-every"));
+        else if (a == "--help") { responder_usage(); return 0; }
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (cfg.delay_ms < 0 || cfg.ring_ms < 0 || cfg.drop < 0 || cfg.drop > 1 || cfg.fail_503 < 0 || cfg.fail_503 > 1) {
+        std::cerr << "--delay and --ring must be >= 0; --drop and --fail-503 are fractions in [0, 1]\n";
+        return 2;
+    }
+    if (!creds_path.empty()) {
+        std::vector<StormCredential> creds;
+        std::string err;
+        if (!load_storm_credentials(creds_path, &creds, &err)) {
+            std::cerr << err << "\n";
+            return 2;
+        }
+        for (auto& c : creds) cfg.users[c.user] = c.pass;
+    }
+    if (!user.empty()) cfg.users[user] = pass;
+
+    SipResponder r;
+    std::string err;
+    if (!r.start(cfg, &err)) {
+        std::cerr << "responder: " << err << "\n";
+        return 3;
+    }
+    std::cout << "Responding on " << cfg.bind_ip << ":" << r.port() << " with " << r.workers()
+              << " worker(s)" << (cfg.tcp ? " + TCP" : "") << ", " << cfg.users.size() << " user(s), realm \"" << cfg.realm << "\"\n" << std::flush;
+
+    g_stop = 0;
+    auto prev_int = std::signal(SIGINT, on_stop_signal);
+    auto prev_term = std::signal(SIGTERM, on_stop_signal);
+
+    const auto t0 = Clock::now();
+    auto last = t0;
+    uint64_t last_received = 0;
+    while (!g_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = Clock::now();
+        double up = std::chrono::duration<double>(now - t0).count();
+        if (duration_s > 0 && up >= duration_s) break;
+        if (status_every_s > 0 && now - last >= std::chrono::seconds(status_every_s)) {
+            ResponderStats s = r.stats();
+            double secs = std::chrono::duration<double>(now - last).count();
+            std::cout << "responder: " << (uint64_t)((s.received - last_received) / secs) << " req/s"
+                      << " (options=" << s.options << " register=" << s.registers
+                      << " 200reg=" << s.registered << " invite=" << s.invites << " 503=" << s.busy << " dropped=" << s.dropped << ")\n"
+                      << std::flush;
+            last = now;
+            last_received = s.received;
+        }
+    }
+    r.stop();
+    std::signal(SIGINT, prev_int);
+    std::signal(SIGTERM, prev_term);
+
+    const double elapsed_s = std::chrono::duration<double>(Clock::now() - t0).count();
+    ResponderStats s = r.stats();
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_responder_report.json";
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"bind\": {\"ip\": \"" << json_escape(cfg.bind_ip) << "\", \"port\": " << r.port() << "},\n"
+"  \"workers\": " << r.workers() << ",\n"
+"  \"tcp\": " << (cfg.tcp ? "true" : "false") << ",\n"
+"  \"delay_ms\": " << cfg.delay_ms << ",\n"
+"  \"ring_ms\": " << cfg.ring_ms << ",\n"
+"  \"drop\": " << cfg.drop << ",\n"
+"  \"fail_503\": " << cfg.fail_503 << ",\n"
+"  \"elapsed_s\": " << elapsed_s << ",\n"
+"  \"requests_per_s\": " << (elapsed_s > 0 ? (double)s.received / elapsed_s : 0) << ",\n"
+"  \"received\": " << s.received << ",\n"
+"  \"malformed\": " << s.malformed << ",\n"
+"  \"options\": " << s.options << ",\n"
+"  \"registers\": " << s.registers << ",\n"
+"  \"challenged\": " << s.challenged << ",\n"
+"  \"registered\": " << s.registered << ",\n"
+"  \"forbidden\": " << s.forbidden << ",\n"
+"  \"invites\": " << s.invites << ",\n"
+"  \"byes\": " << s.byes << ",\n"
+"  \"not_allowed\": " << s.not_allowed << ",\n"
+"  \"busy_503\": " << s.busy << ",\n"
+"  \"dropped\": " << s.dropped << ",\n"
+"  \"sent\": " << s.sent << ",\n"
+"  \"send_errors\": " << s.send_errors << "\n"
+"}\n";
+    f.close();
+
+    std::cout << "SIP responder report: " << report_path << "\n";
+    std::cout << "received=" << s.received << " in " << elapsed_s << " s; options=" << s.options
+              << " register=" << s.registers << " (401=" << s.challenged << " 200=" << s.registered
+              << " 403=" << s.forbidden << ") invite=" << s.invites << " bye=" << s.byes << " 405=" << s.not_allowed << " 503=" << s.busy
+              << " dropped=" << s.dropped << " malformed=" << s.malformed
+              << " send_errors=" << s.send_errors << "\n";
+    return 0;
+}
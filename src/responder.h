@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SipRequestView;
+
+struct ResponderConfig {
+    std::string bind_ip = "127.0.0.1";
+    uint16_t port = 5060;      // 0 -> any free port; see SipResponder::port()
+    int workers = 4;           // one SO_REUSEPORT socket and thread each
+    std::string realm = "frogklan";
+    std::unordered_map<std::string, std::string> users;  // user -> password
+    int nonce_ttl_s = 300;     // older nonces are refused with stale=true
+    int delay_ms = 0;          // every response is held this long
+    int ring_ms = 0;           // INVITE: 180 at once, the 200 this much later
+    double drop = 0;           // fraction of requests ignored outright
+    double fail_503 = 0;       // fraction answered 503 Service Unavailable
+    bool tcp = false;          // also take SIP over TCP on the same port, one extra thread
+};
+
+struct ResponderStats {
+    uint64_t received = 0;
+    uint64_t malformed = 0;
+    uint64_t options = 0;
+    uint64_t registers = 0;
+    uint64_t challenged = 0;   // REGISTER answered 401
+    uint64_t registered = 0;   // REGISTER answered 200
+    uint64_t forbidden = 0;    // unknown user or wrong digest
+    uint64_t invites = 0;      // answered 180 then 200 with SDP
+    uint64_t byes = 0;
+    uint64_t not_allowed = 0;  // any other method, answered 405
+    uint64_t busy = 0;         // injected 503s
+    uint64_t dropped = 0;      // injected drops
+    uint64_t sent = 0;
+    uint64_t send_errors = 0;  // refused or socket buffer full
+};
+
+// Stateless UAS stand-in for loopback testing: OPTIONS gets 200; REGISTER
+// gets a Digest 401, then 200 when the credentials check out, 403 when they
+// do not. INVITE gets 180 and a 200 with an SDP answer, BYE gets 200 and ACK
+// nothing; no call state is kept. Nonces carry their issue time under a
+// per-process key, so any worker can verify any nonce without shared state
+// (nonce counts are not tracked). Each worker owns a socket on the same port
+// (SO_REUSEPORT on Linux, a single worker elsewhere) and answers whole
+// recvmmsg batches with one sendmmsg. With tcp set, one more thread accepts
+// connections on the same port and answers pipelined requests on each in
+// arrival order.
+class SipResponder {
+public:
+    SipResponder();
+    ~SipResponder();
+    SipResponder(const SipResponder&) = delete;
+    SipResponder& operator=(const SipResponder&) = delete;
+
+    bool start(const ResponderConfig& cfg, std::string* err);
+    void stop();
+
+    uint16_t port() const { return port_; }
+    int workers() const { return (int)workers_.size(); }
+    // Summed over workers; safe to call while running.
+    ResponderStats stats() const;
+
+private:
+    struct Worker;
+    void run(Worker& w);
+    void run_tcp(Worker& w);
+    // Fills o with the answer to q, and ring with a 180 to send ahead of it
+    // for INVITE; false when nothing should be sent.
+    bool answer(Worker& w, const SipRequestView& q, std::string& extra, std::string& o, std::string& ring);
+
+    ResponderConfig cfg_;
+    std::unordered_map<std::string, std::string> ha1_;  // user -> MD5(user:realm:pass)
+    uint64_t nonce_key_ = 0;
+    std::string sdp_answer_;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Worker> tcp_;
+};
+
+int cmd_responder(int argc, char** argv);
@@ -0,0 +1,457 @@
+#include "resultlog.h"
+#include "app.h"
+#include "mapped_file.h"
+#include "target_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = {'F', 'K', 'L', 'O', 'G', 0, 0, 1};
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t version;
+    uint64_t created_us;
+    uint64_t reserved;
+};
+static_assert(sizeof(SegmentHeader) == 32, "SegmentHeader is an on-disk format");
+
+const size_t kWriteBatch = 4096;   // queued records that wake the writer early
+
+std::string segment_name(uint32_t n) {
+    char b[32];
+    std::snprintf(b, sizeof(b), "seg-%08u.fkl", n);
+    return b;
+}
+
+// Segment files in dir, by number.
+std::vector<std::pair<uint32_t, fs::path>> list_segments(const fs::path& dir) {
+    std::vector<std::pair<uint32_t, fs::path>> out;
+    std::error_code ec;
+    for (auto& e : fs::directory_iterator(dir, ec)) {
+        std::string name = e.path().filename().string();
+        unsigned n;
+        if (name.size() == 16 && std::sscanf(name.c_str(), "seg-%8u.fkl", &n) == 1) out.push_back({n, e.path()});
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// "id<TAB>label" lines from targets.txt.
+void load_targets(const fs::path& path, std::unordered_map<std::string, uint32_t>* ids) {
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        auto tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        (*ids)[line.substr(tab + 1)] = (uint32_t)std::strtoul(line.c_str(), nullptr, 10);
+    }
+}
+
+} // namespace
+
+bool ResultLog::open(const std::string& dir, std::string* err, uint64_t segment_bytes, size_t max_pending) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) { *err = "cannot create " + dir; return false; }
+    dir_ = dir;
+    segment_bytes_ = segment_bytes;
+    max_pending_ = max_pending;
+
+    auto segs = list_segments(dir_);
+    next_segment_ = segs.empty() ? 1 : segs.back().first + 1;
+    fs::path tpath = fs::path(dir_) / "targets.txt";
+    load_targets(tpath, &ids_);
+    targets_ = std::fopen(tpath.string().c_str(), "ab");
+    if (!targets_ || !roll()) { *err = "cannot write to " + dir; return false; }
+
+    pending_.reserve(kWriteBatch * 2);
+    stop_ = false;
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void ResultLog::close() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+    if (seg_) { std::fclose(seg_); seg_ = nullptr; }
+    if (targets_) { std::fclose(targets_); targets_ = nullptr; }
+}
+
+uint32_t ResultLog::target_id(const std::string& label) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = ids_.find(label);
+    if (it != ids_.end()) return it->second;
+    uint32_t id = (uint32_t)ids_.size();
+    ids_[label] = id;
+    if (targets_) {
+        std::fprintf(targets_, "%u\t%s\n", id, label.c_str());
+        std::fflush(targets_);
+    }
+    return id;
+}
+
+void ResultLog::append(const ProbeRecord& r) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (pending_.size() >= max_pending_) { dropped_++; return; }
+    pending_.push_back(r);
+    if (pending_.size() == kWriteBatch) cv_.notify_one();
+}
+
+uint64_t ResultLog::dropped() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return dropped_;
+}
+
+uint64_t ResultLog::write_errors() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return write_errors_;
+}
+
+bool ResultLog::roll() {
+    if (seg_) std::fclose(seg_);
+    // The number is only used up once the header is down, so a disk that
+    // stays full retries one empty file rather than leaving a trail of them.
+    fs::path p = fs::path(dir_) / segment_name(next_segment_);
+    seg_ = std::fopen(p.string().c_str(), "wb");
+    if (!seg_) return false;
+    // Batches are written whole, so stdio buffering saves nothing; without it
+    // fwrite's count is what reached the file, not what reached a buffer.
+    std::setvbuf(seg_, nullptr, _IONBF, 0);
+    SegmentHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.record_size = sizeof(ProbeRecord);
+    h.version = 1;
+    h.created_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    segment_used_ = 0;
+    if (std::fwrite(&h, sizeof(h), 1, seg_) == 1) { next_segment_++; return true; }
+    segment_used_ = segment_bytes_;   // headerless; roll again next batch
+    return false;
+}
+
+void ResultLog::run() {
+    std::vector<ProbeRecord> batch;
+    batch.reserve(kWriteBatch * 2);
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait_for(lk, std::chrono::milliseconds(200),
+                     [this] { return stop_ || pending_.size() >= kWriteBatch; });
+        batch.swap(pending_);
+        bool stopping = stop_;
+        lk.unlock();
+
+        // Whole records only, so a segment never ends mid-record unless the
+        // process dies inside fwrite or the disk refuses one partway; the
+        // reader drops such a tail. After a short write the next records go
+        // to a fresh segment; whatever could not be written is counted.
+        size_t i = 0;
+        uint64_t lost = 0;
+        while (i < batch.size()) {
+            uint64_t room = (segment_bytes_ - std::min(segment_bytes_, segment_used_)) / sizeof(ProbeRecord);
+            if (!seg_ || room == 0) {
+                if (!roll()) break;
+                continue;
+            }
+            size_t n = (size_t)std::min<uint64_t>(room, batch.size() - i);
+            size_t w = std::fwrite(&batch[i], sizeof(ProbeRecord), n, seg_);
+            segment_used_ += w * sizeof(ProbeRecord);
+            if (w < n) {
+                lost += n - w;
+                segment_used_ = segment_bytes_;
+            }
+            i += n;
+        }
+        lost += batch.size() - i;
+        batch.clear();
+
+        lk.lock();
+        write_errors_ += lost;
+        if (stopping && pending_.empty()) break;
+    }
+}
+
+namespace {
+
+struct Agg {
+    uint64_t probes = 0, replied = 0, ok_2xx = 0, timeouts = 0, send_errors = 0, dns_errors = 0, retransmits = 0;
+    uint64_t classes[4] = {0, 0, 0, 0};
+    LatencySketch rtt;
+
+    void add(const ProbeRecord& r) {
+        probes++;
+        retransmits += r.retransmits;
+        switch ((ProbeOutcome)r.outcome) {
+        case ProbeOutcome::Reply:
+            replied++;
+            if (r.status >= 200 && r.status < 300) ok_2xx++;
+            else if (r.status >= 300 && r.status < 700) classes[r.status / 100 - 3]++;
+            if (r.rtt_us != ProbeRecord::kNoRtt) rtt.record(r.rtt_us);
+            break;
+        case ProbeOutcome::Timeout: timeouts++; break;
+        case ProbeOutcome::SendError: send_errors++; break;
+        case ProbeOutcome::DnsError: dns_errors++; break;
+        }
+    }
+    void merge(const Agg& o) {
+        probes += o.probes; replied += o.replied; ok_2xx += o.ok_2xx; timeouts += o.timeouts;
+        send_errors += o.send_errors; dns_errors += o.dns_errors; retransmits += o.retransmits;
+        for (int i = 0; i < 4; i++) classes[i] += o.classes[i];
+        rtt.merge(o.rtt);
+    }
+};
+
+struct Chunk {
+    const ProbeRecord* recs;
+    size_t n;
+};
+
+} // namespace
+
+bool build_log_report(const LogReportConfig& cfg, LogReport* out, std::string* err) {
+    auto t0 = std::chrono::steady_clock::now();
+    const fs::path dir(cfg.dir);
+    std::unordered_map<std::string, uint32_t> ids;
+    load_targets(dir / "targets.txt", &ids);
+    std::unordered_map<uint32_t, std::string> names;
+    for (auto& kv : ids) names[kv.second] = kv.first;
+
+    bool filter = !cfg.target.empty();
+    uint32_t only = 0;
+    if (filter) {
+        auto it = ids.find(cfg.target);
+        if (it == ids.end()) { *err = "no target " + cfg.target + " in " + cfg.dir; return false; }
+        only = it->second;
+    }
+
+    auto segs = list_segments(dir);
+    if (segs.empty()) { *err = "no segments in " + cfg.dir; return false; }
+    std::vector<std::unique_ptr<MappedFile>> maps;
+    std::vector<Chunk> chunks;
+    const size_t kChunk = 1u << 18;
+    for (auto& s : segs) {
+        auto m = std::make_unique<MappedFile>();
+        if (!m->map(s.second) || m->size() < sizeof(SegmentHeader)) continue;
+        SegmentHeader h;
+        std::memcpy(&h, m->data(), sizeof(h));
+        if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.record_size != sizeof(ProbeRecord)) {
+            *err = s.second.string() + ": not a frogklan log segment";
+            return false;
+        }
+        size_t n = (m->size() - sizeof(SegmentHeader)) / sizeof(ProbeRecord);
+        auto* recs = reinterpret_cast<const ProbeRecord*>(m->data() + sizeof(SegmentHeader));
+        for (size_t i = 0; i < n; i += kChunk) chunks.push_back(Chunk{recs + i, std::min(kChunk, n - i)});
+        out->bytes_mapped += m->size();
+        out->records_scanned += n;
+        out->segments++;
+        maps.push_back(std::move(m));
+    }
+
+    int nthreads = cfg.threads > 0 ? cfg.threads : (int)std::thread::hardware_concurrency();
+    if (nthreads < 1) nthreads = 1;
+    if ((size_t)nthreads > chunks.size()) nthreads = chunks.empty() ? 1 : (int)chunks.size();
+    out->threads = nthreads;
+
+    const uint64_t since_us = cfg.since_s * 1000000ull;
+    const uint64_t until_us = cfg.until_s ? cfg.until_s * 1000000ull : ~0ull;
+    const uint64_t window_us = cfg.window_s * 1000000ull;
+    // Key: target id in the high half, window number in the low half.
+    std::vector<std::unordered_map<uint64_t, Agg>> parts(nthreads);
+    std::atomic<size_t> next{0};
+    auto work = [&](int t) {
+        auto& table = parts[t];
+        size_t c;
+        while ((c = next.fetch_add(1)) < chunks.size()) {
+            const Chunk& ch = chunks[c];
+            for (size_t i = 0; i < ch.n; i++) {
+                const ProbeRecord& r = ch.recs[i];
+                if (r.ts_us < since_us || r.ts_us >= until_us) continue;
+                if (filter && r.target != only) continue;
+                uint64_t w = window_us ? r.ts_us / window_us : 0;
+                table[((uint64_t)r.target << 32) | w].add(r);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < nthreads; t++) pool.emplace_back(work, t);
+    work(0);
+    for (auto& th : pool) th.join();
+
+    std::map<std::pair<std::string, uint64_t>, Agg> merged;
+    for (auto& p : parts) {
+        for (auto& kv : p) {
+            uint32_t id = (uint32_t)(kv.first >> 32);
+            auto it = names.find(id);
+            std::string label = it != names.end() ? it->second : "#" + std::to_string(id);
+            merged[{label, kv.first & 0xffffffffull}].merge(kv.second);
+        }
+    }
+    for (auto& kv : merged) {
+        const Agg& a = kv.second;
+        LogReportRow row;
+        row.target = kv.first.first;
+        row.window_start_s = window_us ? kv.first.second * cfg.window_s : cfg.since_s;
+        row.probes = a.probes;
+        row.replied = a.replied;
+        row.ok_2xx = a.ok_2xx;
+        for (int i = 0; i < 4; i++) row.class_3xx_6xx[i] = a.classes[i];
+        row.timeouts = a.timeouts;
+        row.send_errors = a.send_errors;
+        row.dns_errors = a.dns_errors;
+        row.retransmits = a.retransmits;
+        row.rtt_p50_us = a.rtt.percentile(50);
+        row.rtt_p90_us = a.rtt.percentile(90);
+        row.rtt_p99_us = a.rtt.percentile(99);
+        row.rtt_max_us = a.rtt.max();
+        out->rows.push_back(std::move(row));
+    }
+    out->elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return true;
+}
+
+static void report_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan report [--log <dir>] [--since <time>] [--until <time>] [--window <dur>]\n"
+"                  [--target <host:port>] [--threads N]\n"
+"\n"
+"Reads the binary probe log written by monitor/load --log (default\n"
+"<app data>/log). <time> is Unix seconds or a span before now such as 24h;\n"
+"<dur> is seconds or a number with s/m/h/d. Without --window every target\n"
+"gets one row for the whole range.\n";
+}
+
+// "90", "15m", "24h", "7d" -> seconds; 0 on a malformed value.
+static uint64_t parse_span_s(const std::string& v) {
+    char* end = nullptr;
+    uint64_t n = std::strtoull(v.c_str(), &end, 10);
+    if (end == v.c_str()) return 0;
+    switch (*end) {
+    case '\0': case 's': return n;
+    case 'm': return n * 60;
+    case 'h': return n * 3600;
+    case 'd': return n * 86400;
+    default: return 0;
+    }
+}
+
+// Unix seconds as given, or a suffixed span counted back from now.
+static uint64_t parse_time_s(const std::string& v) {
+    bool span = !v.empty() && !std::isdigit((unsigned char)v.back());
+    if (!span) return parse_span_s(v);
+    uint64_t now = (uint64_t)std::time(nullptr);
+    uint64_t back = parse_span_s(v);
+    return back < now ? now - back : 0;
+}
+
+static std::string utc(uint64_t s) {
+    std::time_t t = (std::time_t)s;
+    std::tm tm{};
+#if defined(_WIN32)
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    char b[32];
+    std::strftime(b, sizeof(b), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return b;
+}
+
+int cmd_report(int argc, char** argv) {
+    LogReportConfig cfg;
+    cfg.dir = (app_data_dir() / "log").string();
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--log") cfg.dir = need("--log");
+        else if (a == "--since") cfg.since_s = parse_time_s(need("--since"));
+        else if (a == "--until") cfg.until_s = parse_time_s(need("--until"));
+        else if (a == "--window") cfg.window_s = parse_span_s(need("--window"));
+        else if (a == "--target") cfg.target = need("--target");
+        else if (a == "--threads") cfg.threads = std::stoi(need("--threads"));
+        else if (a == "--help" || a == "-h") { report_usage(); return 0; }
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    LogReport r;
+    std::string err;
+    if (!build_log_report(cfg, &r, &err)) {
+        std::cerr << "report: " << err << "\n";
+        return 3;
+    }
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_log_report.json";
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"log\": \"" << json_escape(cfg.dir) << "\",\n"
+"  \"segments\": " << r.segments << ",\n"
+"  \"records_scanned\": " << r.records_scanned << ",\n"
+"  \"window_s\": " << cfg.window_s << ",\n"
+"  \"rows\": [";
+    for (size_t i = 0; i < r.rows.size(); i++) {
+        const auto& w = r.rows[i];
+        f << (i ? ",\n" : "\n")
+          << "    {\"target\": \"" << json_escape(w.target) << "\", \"window_start_s\": " << w.window_start_s
+          << ", \"probes\": " << w.probes << ", \"replied\": " << w.replied << ", \"ok_2xx\": " << w.ok_2xx
+          << ", \"3xx\": " << w.class_3xx_6xx[0] << ", \"4xx\": " << w.class_3xx_6xx[1]
+          << ", \"5xx\": " << w.class_3xx_6xx[2] << ", \"6xx\": " << w.class_3xx_6xx[3]
+          << ", \"timeouts\": " << w.timeouts << ", \"send_errors\": " << w.send_errors
+          << ", \"dns_errors\": " << w.dns_errors << ", \"retransmits\": " << w.retransmits
+          << ", \"rtt_us\": {\"p50\": " << w.rtt_p50_us << ", \"p90\": " << w.rtt_p90_us
+          << ", \"p99\": " << w.rtt_p99_us << ", \"max\": " << w.rtt_max_us << "}}";
+    }
+    f << "\n  ]\n}\n";
+    f.close();
+
+    std::cout << "SIP log report: " << report_path << "\n";
+    for (const auto& w : r.rows) {
+        double avail = w.probes ? 100.0 * (double)w.replied / (double)w.probes : 0;
+        std::cout << w.target;
+        if (cfg.window_s) std::cout << " " << utc(w.window_start_s);
+        std::cout << ": probes=" << w.probes << " avail=" << avail << "% 2xx=" << w.ok_2xx
+                  << " 3xx/4xx/5xx/6xx=" << w.class_3xx_6xx[0] << "/" << w.class_3xx_6xx[1] << "/"
+                  << w.class_3xx_6xx[2] << "/" << w.class_3xx_6xx[3]
+                  << " timeouts=" << w.timeouts << " send_err=" << w.send_errors << " dns_err=" << w.dns_errors
+                  << " rtt_ms p50=" << w.rtt_p50_us / 1000.0 << " p90=" << w.rtt_p90_us / 1000.0
+                  << " p99=" << w.rtt_p99_us / 1000.0 << " max=" << w.rtt_max_us / 1000.0 << "\n";
+    }
+    std::cout << r.records_scanned << " records in " << r.segments << " segments ("
+              << r.bytes_mapped / (1024 * 1024) << " MB) scanned by " << r.threads << " threads in "
+              << r.elapsed_s << " s\n";
+    return 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class ProbeMethod : uint8_t { Options = 1, Register = 2 };
+enum class ProbeOutcome : uint8_t { Reply = 0, Timeout = 1, SendError = 2, DnsError = 3 };
+
+// One probe outcome as stored on disk, in host byte order (the log is read
+// back on the machine, or at least the endianness, that wrote it).
+struct ProbeRecord {
+    static const uint32_t kNoRtt = 0xffffffffu;
+
+    uint64_t ts_us = 0;          // Unix time of the first transmission
+    uint32_t target = 0;         // ResultLog::target_id
+    uint32_t rtt_us = kNoRtt;    // first transmission -> final response
+    uint32_t peer_ip = 0;        // network byte order; 0 -> no reply
+    uint16_t peer_port = 0;
+    uint16_t status = 0;         // 0 -> no reply
+    uint8_t method = (uint8_t)ProbeMethod::Options;
+    uint8_t outcome = (uint8_t)ProbeOutcome::Reply;
+    uint8_t retransmits = 0;     // capped at 255
+    uint8_t reserved0 = 0;
+    uint32_t reserved1 = 0;
+};
+static_assert(sizeof(ProbeRecord) == 32, "ProbeRecord is an on-disk format");
+
+// Append-only probe log in a directory:
+//   targets.txt          "id<TAB>host:port" lines; ids are stable across runs
+//   seg-00000001.fkl ... 32-byte header, then ProbeRecords back to back
+// Each run starts a new segment and rolls to the next one past
+// segment_bytes. append() only queues the record under a short lock; a
+// background thread writes queued records in batches. If the disk falls
+// behind by max_pending records, further ones are counted in dropped();
+// records the disk refuses (full, I/O error) are counted in write_errors().
+class ResultLog {
+public:
+    ResultLog() = default;
+    ~ResultLog() { close(); }
+    ResultLog(const ResultLog&) = delete;
+    ResultLog& operator=(const ResultLog&) = delete;
+
+    bool open(const std::string& dir, std::string* err,
+              uint64_t segment_bytes = 64ull << 20, size_t max_pending = 1u << 20);
+    // Writes what is queued and stops the writer.
+    void close();
+
+    // Id for a "host:port" label, added to targets.txt on first use. Call
+    // while setting up, before the hot path starts appending.
+    uint32_t target_id(const std::string& label);
+
+    void append(const ProbeRecord& r);
+
+    uint64_t dropped() const;
+    uint64_t write_errors() const;
+
+private:
+    void run();
+    bool roll();
+
+    std::string dir_;
+    uint64_t segment_bytes_ = 0;
+    size_t max_pending_ = 0;
+    uint32_t next_segment_ = 1;
+    uint64_t segment_used_ = 0;
+    std::FILE* seg_ = nullptr;
+    std::FILE* targets_ = nullptr;
+    std::unordered_map<std::string, uint32_t> ids_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<ProbeRecord> pending_;
+    uint64_t dropped_ = 0;
+    uint64_t write_errors_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+struct LogReportConfig {
+    std::string dir;
+    uint64_t since_s = 0;          // Unix seconds; 0 -> from the first record
+    uint64_t until_s = 0;          // exclusive; 0 -> to the last record
+    uint64_t window_s = 0;         // 0 -> one window for the whole range
+    std::string target;            // "" -> every target
+    int threads = 0;               // 0 -> hardware concurrency
+};
+
+// Aggregates for one (target, window) pair.
+struct LogReportRow {
+    std::string target;
+    uint64_t window_start_s = 0;
+    uint64_t probes = 0;
+    uint64_t replied = 0;          // any final response
+    uint64_t ok_2xx = 0;
+    uint64_t class_3xx_6xx[4] = {0, 0, 0, 0};
+    uint64_t timeouts = 0;
+    uint64_t send_errors = 0;
+    uint64_t dns_errors = 0;
+    uint64_t retransmits = 0;
+    uint64_t rtt_p50_us = 0, rtt_p90_us = 0, rtt_p99_us = 0, rtt_max_us = 0;
+};
+
+struct LogReport {
+    uint64_t records_scanned = 0;
+    uint64_t bytes_mapped = 0;
+    int segments = 0;
+    int threads = 0;
+    double elapsed_s = 0;
+    std::vector<LogReportRow> rows;   // by target label, then window
+};
+
+// Memory-maps every segment and aggregates in parallel: records are split
+// into chunks that worker threads claim, each folding into its own table,
+// and the tables are merged at the end. RTT percentiles come from a
+// LatencySketch per (target, window) and are accurate to within about 2%.
+bool build_log_report(const LogReportConfig& cfg, LogReport* out, std::string* err);
+
+int cmd_report(int argc, char** argv);
@@ -0,0 +1,893 @@
+#include "scenario.h"
+#include "app.h"
+#include "dialog.h"
+#include "digest_cache.h"
+#include "net.h"
+#include "resolver.h"
+#include "schedule.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const uint32_t kDefaultTimeoutMs = 32000;  // 64*T1, as Timer B/F
+
+std::string_view next_word(std::string_view& s) {
+    s = sip_trim(s);
+    size_t sp = s.find_first_of(" \t");
+    std::string_view w = s.substr(0, sp);
+    s = sp == std::string_view::npos ? std::string_view() : s.substr(sp);
+    return w;
+}
+
+bool parse_u32(std::string_view s, uint32_t* out) {
+    if (s.empty()) return false;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), *out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+bool fail_at(std::string* err, uint32_t line, const std::string& what) {
+    *err = "line " + std::to_string(line) + ": " + what;
+    return false;
+}
+
+ScenarioVar instance_var(std::string_view name) {
+    if (name == "call_id") return ScenarioVar::CallId;
+    if (name == "tag") return ScenarioVar::Tag;
+    if (name == "to_tag") return ScenarioVar::ToTag;
+    if (name == "branch") return ScenarioVar::Branch;
+    if (name == "cseq") return ScenarioVar::CSeq;
+    if (name == "auth") return ScenarioVar::Auth;
+    if (name == "len") return ScenarioVar::Len;
+    if (name == "local_ip") return ScenarioVar::LocalIp;
+    if (name == "local_port") return ScenarioVar::LocalPort;
+    return ScenarioVar::Literal;
+}
+
+// "200", "2xx" or "18x" -> status range.
+bool parse_code(std::string_view s, uint16_t* lo, uint16_t* hi) {
+    if (s.size() != 3 || s[0] < '1' || s[0] > '6') return false;
+    int l = 0, h = 0;
+    bool wild = false;
+    for (char c : s) {
+        if (c == 'x' || c == 'X') { wild = true; l = l * 10; h = h * 10 + 9; continue; }
+        if (c < '0' || c > '9' || wild) return false;
+        l = l * 10 + (c - '0');
+        h = h * 10 + (c - '0');
+    }
+    *lo = (uint16_t)l;
+    *hi = (uint16_t)h;
+    return true;
+}
+
+// Constants substituted into a step line, e.g. "pause [hold]".
+bool expand(std::string_view s, const std::map<std::string, std::string>& consts, std::string* out,
+            std::string* err, uint32_t no) {
+    out->clear();
+    for (size_t open; (open = s.find('[')) != std::string_view::npos;) {
+        size_t close = s.find(']', open);
+        if (close == std::string_view::npos) return fail_at(err, no, "unterminated [");
+        auto it = consts.find(std::string(s.substr(open + 1, close - open - 1)));
+        if (it == consts.end()) return fail_at(err, no, "unknown variable " + std::string(s.substr(open, close - open + 1)));
+        out->append(s.data(), open);
+        out->append(it->second);
+        s.remove_prefix(close + 1);
+    }
+    out->append(s.data(), s.size());
+    return true;
+}
+
+struct Fixup {
+    size_t step;       // a goto
+    size_t alt;        // or an expect alternative, when step is npos
+    std::string label;
+    uint32_t line;
+};
+
+class Compiler {
+public:
+    Compiler(const std::map<std::string, std::string>& consts, Scenario* sc, std::string* err)
+        : consts_(consts), sc_(sc), err_(err) {}
+
+    // Appends literal bytes, growing the previous piece when it is a literal
+    // that ends where these start.
+    void literal(std::string_view s) {
+        if (s.empty()) return;
+        auto& p = sc_->pieces;
+        if (!p.empty() && p.back().var == ScenarioVar::Literal && p.size() > piece_floor_ &&
+            p.back().off + p.back().len == sc_->text.size()) {
+            p.back().len += (uint32_t)s.size();
+        } else {
+            p.push_back(ScenarioPiece{ScenarioVar::Literal, (uint32_t)sc_->text.size(), (uint32_t)s.size()});
+        }
+        sc_->text.append(s.data(), s.size());
+    }
+    void var(ScenarioVar v) { sc_->pieces.push_back(ScenarioPiece{v, 0, 0}); }
+
+    // One message line with its CRLF. `fixed`, when given, must receive the
+    // whole line with constants in place: no per-instance variable allowed.
+    bool line(std::string_view s, uint32_t no, bool body, std::string* fixed) {
+        if (!body && sip_trim(s) == "[auth]") { var(ScenarioVar::Auth); return true; }
+        while (!s.empty()) {
+            size_t open = s.find('[');
+            if (open == std::string_view::npos) break;
+            size_t close = s.find(']', open);
+            if (close == std::string_view::npos) return fail_at(err_, no, "unterminated [");
+            literal(s.substr(0, open));
+            if (fixed) fixed->append(s.data(), open);
+            std::string name(s.substr(open + 1, close - open - 1));
+            ScenarioVar v = instance_var(name);
+            if (v != ScenarioVar::Literal) {
+                if (fixed) return fail_at(err_, no, "[" + name + "] cannot appear in the request line");
+                if (v == ScenarioVar::Auth) return fail_at(err_, no, "[auth] must be alone on its line");
+                if (body && v == ScenarioVar::Len) return fail_at(err_, no, "[len] cannot appear in the body");
+                var(v);
+            } else {
+                auto it = consts_.find(name);
+                if (it == consts_.end()) return fail_at(err_, no, "unknown variable [" + name + "]");
+                literal(it->second);
+                if (fixed) fixed->append(it->second);
+            }
+            s.remove_prefix(close + 1);
+        }
+        literal(s);
+        literal("\r\n");
+        if (fixed) fixed->append(s.data(), s.size());
+        return true;
+    }
+
+    bool message(const std::vector<std::pair<std::string_view, uint32_t>>& lines, uint32_t at) {
+        if (lines.empty()) return fail_at(err_, at, "empty message");
+        ScenarioMessage m;
+        piece_floor_ = sc_->pieces.size();
+        m.head_begin = (uint32_t)sc_->pieces.size();
+        std::string start_line;
+        if (!line(lines[0].first, lines[0].second, false, &start_line)) return false;
+        std::string_view rest = start_line;
+        m.method = std::string(next_word(rest));
+        m.uri = std::string(next_word(rest));
+        if (m.method.empty() || m.uri.empty() || m.method == "SIP/2.0") {
+            return fail_at(err_, lines[0].second, "expected a request line, e.g. OPTIONS sip:[host] SIP/2.0");
+        }
+        size_t i = 1;
+        for (; i < lines.size() && !sip_trim(lines[i].first).empty(); i++) {
+            if (!line(lines[i].first, lines[i].second, false, nullptr)) return false;
+        }
+        literal("\r\n");
+        m.head_end = (uint32_t)sc_->pieces.size();
+        // The body is kept apart so render can measure it before the head.
+        piece_floor_ = sc_->pieces.size();
+        m.body_begin = (uint32_t)sc_->pieces.size();
+        for (i++; i < lines.size(); i++) {
+            if (!line(lines[i].first, lines[i].second, true, nullptr)) return false;
+        }
+        m.body_end = (uint32_t)sc_->pieces.size();
+        piece_floor_ = sc_->pieces.size();
+        sc_->messages.push_back(std::move(m));
+        return true;
+    }
+
+private:
+    const std::map<std::string, std::string>& consts_;
+    Scenario* sc_;
+    std::string* err_;
+    size_t piece_floor_ = 0;   // literals never merge across a message boundary
+};
+
+void append_uint(std::string& out, uint64_t v) {
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, (size_t)(r.ptr - buf));
+}
+
+} // namespace
+
+bool compile_scenario(std::string_view source, const std::map<std::string, std::string>& consts,
+                      Scenario* out, std::string* err) {
+    Scenario sc;
+    sc.name = out->name;
+    std::map<std::string, std::string> vars = consts;   // plus the file's defaults
+    Compiler c(vars, &sc, err);
+    std::map<std::string, size_t> labels;
+    std::vector<Fixup> fixups;
+    uint32_t timeout_ms = kDefaultTimeoutMs;
+
+    std::vector<std::pair<std::string_view, uint32_t>> lines;
+    uint32_t no = 0;
+    while (!source.empty()) {
+        size_t nl = source.find('\n');
+        std::string_view l = source.substr(0, nl);
+        source = nl == std::string_view::npos ? std::string_view() : source.substr(nl + 1);
+        if (!l.empty() && l.back() == '\r') l.remove_suffix(1);
+        lines.emplace_back(l, ++no);
+    }
+
+    std::string expanded;
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::string_view rest = lines[i].first;
+        const uint32_t at = lines[i].second;
+        std::string_view word = next_word(rest);
+        if (word.empty() || word[0] == '#') continue;
+        if (word == "default") {
+            std::string name(next_word(rest));
+            if (name.empty()) return fail_at(err, at, "default needs a name and a value");
+            vars.emplace(name, std::string(sip_trim(rest)));
+            continue;
+        }
+        if (word != "send") {
+            if (!expand(rest, vars, &expanded, err, at)) return false;
+            rest = expanded;
+        }
+
+        ScenarioStep s;
+        s.line = at;
+        if (word == "send") {
+            std::vector<std::pair<std::string_view, uint32_t>> msg;
+            for (i++; i < lines.size() && lines[i].first != "."; i++) msg.push_back(lines[i]);
+            if (i == lines.size()) return fail_at(err, at, "send without a closing \".\" line");
+            s.op = ScenarioOp::Send;
+            s.arg = (uint32_t)sc.messages.size();
+            if (!c.message(msg, at)) return false;
+        } else if (word == "expect") {
+            s.op = ScenarioOp::Expect;
+            s.arg = timeout_ms;
+            s.alt_begin = (uint32_t)sc.alts.size();
+            for (std::string_view w = next_word(rest); !w.empty(); w = next_word(rest)) {
+                if (w.substr(0, 8) == "timeout=") {
+                    if (!parse_u32(w.substr(8), &s.arg)) return fail_at(err, at, "bad timeout");
+                    continue;
+                }
+                size_t colon = w.find(':');
+                ScenarioAlt a{0, 0, -1};
+                if (!parse_code(w.substr(0, colon), &a.lo, &a.hi)) {
+                    return fail_at(err, at, "bad status \"" + std::string(w) + "\"");
+                }
+                if (colon != std::string_view::npos) {
+                    fixups.push_back(Fixup{std::string::npos, sc.alts.size(), std::string(w.substr(colon + 1)), at});
+                }
+                sc.alts.push_back(a);
+            }
+            s.alt_end = (uint32_t)sc.alts.size();
+            if (s.alt_begin == s.alt_end) return fail_at(err, at, "expect needs at least one status");
+        } else if (word == "pause") {
+            s.op = ScenarioOp::Pause;
+            if (!parse_u32(next_word(rest), &s.arg)) return fail_at(err, at, "pause needs milliseconds");
+        } else if (word == "goto") {
+            s.op = ScenarioOp::Goto;
+            std::string_view name = next_word(rest);
+            if (name.empty()) return fail_at(err, at, "goto needs a label");
+            fixups.push_back(Fixup{sc.steps.size(), 0, std::string(name), at});
+        } else if (word == "label") {
+            std::string name(next_word(rest));
+            if (name.empty()) return fail_at(err, at, "label needs a name");
+            if (!labels.emplace(name, sc.steps.size()).second) return fail_at(err, at, "label " + name + " defined twice");
+            continue;
+        } else if (word == "timeout") {
+            if (!parse_u32(next_word(rest), &timeout_ms)) return fail_at(err, at, "timeout needs milliseconds");
+            continue;
+        } else {
+            return fail_at(err, at, "unknown step \"" + std::string(word) + "\"");
+        }
+        sc.steps.push_back(s);
+    }
+
+    for (auto& f : fixups) {
+        auto it = labels.find(f.label);
+        if (it == labels.end()) return fail_at(err, f.line, "no label " + f.label);
+        if (f.step == std::string::npos) sc.alts[f.alt].target = (int32_t)it->second;
+        else sc.steps[f.step].target = (int32_t)it->second;
+    }
+    if (sc.messages.empty()) { *err = "scenario sends nothing"; return false; }
+
+    // A cycle through gotos and sends that never expects or pauses would
+    // spin one instance forever; refuse it here so the runner need not guard.
+    const size_t n = sc.steps.size();
+    std::vector<uint8_t> seen(n);
+    for (size_t i = 0; i < n; i++) {
+        std::fill(seen.begin(), seen.end(), 0);
+        for (size_t cur = i; cur < n;) {
+            const ScenarioStep& s = sc.steps[cur];
+            if (s.op == ScenarioOp::Expect || s.op == ScenarioOp::Pause) break;
+            seen[cur] = 1;
+            cur = s.op == ScenarioOp::Goto ? (size_t)s.target : cur + 1;
+            if (cur < n && seen[cur]) return fail_at(err, s.line, "loop with no expect or pause");
+        }
+    }
+
+    *out = std::move(sc);
+    return true;
+}
+
+size_t Scenario::render(const ScenarioMessage& m, const ScenarioValues& v, std::string& out, std::string& scratch) const {
+    auto put = [&](std::string& o, const ScenarioPiece& p) {
+        switch (p.var) {
+        case ScenarioVar::Literal: o.append(text.data() + p.off, p.len); break;
+        case ScenarioVar::CallId: o.append(v.call_id.data(), v.call_id.size()); break;
+        case ScenarioVar::Tag: o.append(v.tag.data(), v.tag.size()); break;
+        case ScenarioVar::ToTag: o.append(v.to_tag.data(), v.to_tag.size()); break;
+        case ScenarioVar::Branch: o.append(v.branch.data(), v.branch.size()); break;
+        case ScenarioVar::CSeq: append_uint(o, v.cseq); break;
+        case ScenarioVar::Auth: o.append(v.auth.data(), v.auth.size()); break;
+        case ScenarioVar::Len: append_uint(o, scratch.size()); break;
+        case ScenarioVar::LocalIp: o.append(v.local_ip.data(), v.local_ip.size()); break;
+        case ScenarioVar::LocalPort: o.append(v.local_port.data(), v.local_port.size()); break;
+        }
+    };
+    scratch.clear();
+    for (uint32_t i = m.body_begin; i < m.body_end; i++) put(scratch, pieces[i]);
+    out.clear();
+    for (uint32_t i = m.head_begin; i < m.head_end; i++) put(out, pieces[i]);
+    out.append(scratch);
+    return out.size();
+}
+
+std::string Scenario::describe(size_t i) const {
+    const ScenarioStep& s = steps[i];
+    std::ostringstream o;
+    o << i << " ";
+    switch (s.op) {
+    case ScenarioOp::Send:
+        o << "send " << messages[s.arg].method;
+        break;
+    case ScenarioOp::Expect:
+        o << "expect";
+        for (uint32_t a = s.alt_begin; a < s.alt_end; a++) {
+            const ScenarioAlt& alt = alts[a];
+            o << " " << alt.lo;
+            if (alt.hi != alt.lo) o << "-" << alt.hi;
+            if (alt.target >= 0) o << "->" << alt.target;
+        }
+        o << " (" << s.arg << " ms)";
+        break;
+    case ScenarioOp::Pause:
+        o << "pause " << s.arg << " ms";
+        break;
+    case ScenarioOp::Goto:
+        o << "goto " << s.target;
+        break;
+    }
+    return o.str();
+}
+
+namespace {
+
+// What an instance carries beside its Dialog slot.
+struct Instance {
+    uint32_t step = 0;
+    uint32_t cseq = 0;
+    uint32_t nc = 0;           // nonce count for ch
+    bool proxy = false;        // ch came in a 407
+    bool retx_on = false;      // the last request sent is still unanswered
+    bool invite = false;       // ...and is an INVITE: Timer A, ended by a 1xx
+    int last_final = 0;        // status of the last final response taken
+    uint64_t start_us = 0;
+    uint64_t wait_us = 0;      // entry into the current expect
+    uint64_t deadline_ms = 0;  // end of the current expect
+    uint64_t retx_at_ms = 0;   // next retransmission
+    SipRetransmit retx;
+    SipAuthChallenge ch;       // ch.ok once a 401/407 was seen
+};
+
+// One worker: its own socket, dialog table, timers and instances, starting
+// instances as it claims them from the shared schedule.
+ScenarioResult scenario_worker(const Scenario& sc, const ScenarioConfig& cfg, const UdpAddr& dst,
+                               ScheduleClaims& claims, StartGate& gate, size_t concurrency) {
+    ScenarioResult res;
+    res.steps.resize(sc.steps.size());
+
+    UdpSocket sock;
+    UdpPoller poller;
+    if (!sock.open(8 << 20) || !sock.bind(cfg.local_ip, 0) || !poller.add(sock)) {
+        res.error = "Failed to open UDP socket on " + cfg.local_ip;
+    }
+    const std::string local_port = std::to_string(sock.local_port());
+
+    DialogTable table(concurrency);
+    std::vector<Instance> inst(table.capacity());
+    TimerWheel wheel(0);
+    wheel.reserve(table.capacity());
+    std::vector<uint64_t> fired;
+    DigestAuthCache creds;     // only for HA1; challenges are per instance
+    // The last request each instance sent, kept for retransmission; the
+    // buffers outlive instances so they stop allocating once grown.
+    std::vector<std::string> sent(table.capacity());
+
+    // As in run_calls, requests are staged and sent a batch at a time; an
+    // instance may send several in a row, so staging flushes when full.
+    UdpBatch io;
+    if (res.error.empty() && cfg.uring && io.use_uring() && !poller.use(io)) res.error = "io_uring setup failed";
+    res.uring = io.uring();
+    const size_t kBatch = io.max_batch();
+    std::vector<std::string> msgs(2 * kBatch);
+    std::vector<UdpDatagram> dgrams(2 * kBatch);
+    std::string body, auth;
+    size_t nout = 0;
+    auto flush = [&] {
+        size_t off = 0;
+        while (off < nout) {
+            int r = io.send(sock, dgrams.data() + off, std::min(kBatch, nout - off));
+            if (r <= 0) break;
+            off += (size_t)r;
+        }
+        res.send_errors += nout - off;
+        nout = 0;
+    };
+
+    auto stage = [&](const std::string& msg) {
+        if (nout == msgs.size()) flush();
+        msgs[nout] = msg;
+        dgrams[nout] = UdpDatagram{dst, msgs[nout].data(), msgs[nout].size()};
+        nout++;
+    };
+
+    auto send = [&](Dialog* d, Instance& in, const ScenarioMessage& m, uint64_t now_ms) {
+        const bool ack = m.method == "ACK", cancel = m.method == "CANCEL";
+        if (!ack && !cancel) in.cseq++;
+        // CANCEL, and the ACK for a non-2xx final, belong to the INVITE's
+        // transaction and keep its branch (RFC 3261 9.1, 17.1.1.3).
+        if (!cancel && !(ack && in.last_final >= 300)) sip_id_branch(d->branch);
+        auth.clear();
+        if (in.ch.ok && !cfg.user.empty()) {
+            char nc[9];
+            std::snprintf(nc, sizeof(nc), "%08x", ++in.nc);
+            auth = in.proxy ? "Proxy-Authorization: " : "Authorization: ";
+            auth += build_digest_authorization_ha1(m.method, m.uri, cfg.user, creds.ha1(in.ch.realm, cfg.user, cfg.pass),
+                                                   in.ch, sip_new_cnonce(), nc);
+            auth += "\r\n";
+        }
+        ScenarioValues v;
+        v.call_id = d->call_id_view();
+        v.tag = d->local_tag_view();
+        v.to_tag = d->remote_tag_view();
+        v.branch = d->branch_view();
+        v.auth = auth;
+        v.local_ip = cfg.local_ip;
+        v.local_port = local_port;
+        v.cseq = in.cseq ? in.cseq : 1;
+        if (nout == msgs.size()) flush();
+        sc.render(m, v, msgs[nout], body);
+        dgrams[nout] = UdpDatagram{dst, msgs[nout].data(), msgs[nout].size()};
+        // An ACK gets no response and ends the INVITE's retransmissions;
+        // anything else is resent on Timer A/E until answered.
+        in.retx_on = !ack;
+        if (!ack) {
+            sent[table.index_of(d)] = msgs[nout];
+            in.invite = m.method == "INVITE";
+            in.retx = SipRetransmit{};
+            in.retx_at_ms = in.retx.on_send(cfg.timers, now_ms, in.invite);
+        }
+        nout++;
+    };
+
+    // Next wake-up for an instance in an expect: its retransmission or the
+    // end of the wait, whichever comes first.
+    auto wait_until = [&](const Instance& in) {
+        return in.retx_on ? std::min(in.retx_at_ms, in.deadline_ms) : in.deadline_ms;
+    };
+
+    auto finish = [&](Dialog* d, bool ok, uint64_t now_us) {
+        const Instance& in = inst[table.index_of(d)];
+        if (ok) {
+            res.completed++;
+            res.duration.record(now_us - in.start_us);
+        } else {
+            res.failed++;
+        }
+        if (d->timer) wheel.cancel(d->timer);
+        table.erase(d);
+    };
+
+    // Runs steps until the instance waits or ends. compile_scenario has
+    // ruled out cycles that never wait, so this terminates.
+    auto run = [&](uint32_t idx, uint64_t now_us) {
+        Dialog* d = table.at(idx);
+        Instance& in = inst[idx];
+        d->timer = 0;
+        while (in.step < sc.steps.size()) {
+            const ScenarioStep& s = sc.steps[in.step];
+            switch (s.op) {
+            case ScenarioOp::Send:
+                send(d, in, sc.messages[s.arg], now_us / 1000);
+                res.steps[in.step].sent++;
+                in.step++;
+                break;
+            case ScenarioOp::Goto:
+                in.step = (uint32_t)s.target;
+                break;
+            case ScenarioOp::Expect:
+                in.wait_us = now_us;
+                in.deadline_ms = now_us / 1000 + s.arg;
+                d->timer = wheel.schedule(wait_until(in), idx);
+                return;
+            case ScenarioOp::Pause:
+                d->timer = wheel.schedule(now_us / 1000 + s.arg, idx);
+                return;
+            }
+        }
+        finish(d, true, now_us);
+    };
+
+    const std::chrono::duration<double> interval(1.0 / cfg.rate);
+    // Every worker arrives, set up or not, so none waits forever.
+    const auto start = gate.arrive(std::chrono::milliseconds(10));
+    if (!res.error.empty()) return res;
+    ScheduleCursor cursor(claims);
+    auto due_of = [&](uint64_t k) { return start + std::chrono::duration_cast<Clock::duration>(interval * (double)k); };
+
+    char tagbuf[kSipTagHex];
+    char cidbuf[kSipIdHex + 9];
+    std::memcpy(cidbuf + kSipIdHex, "@frogklan", 9);
+
+    SipResponseView resp;
+    std::vector<int> ready;
+
+    auto on_reply = [&](const char* data, size_t len, uint64_t t_us) {
+        if (!parse_sip_response_view(data, len, &resp)) { res.stray++; return; }
+        Dialog* d = table.find(resp.call_id, sip_header_tag(resp.header("from", "f")));
+        if (!d || sip_top_via_branch(resp) != d->branch_view()) { res.stray++; return; }
+        const uint32_t idx = table.index_of(d);
+        Instance& in = inst[idx];
+        const ScenarioStep& s = sc.steps[in.step];
+        if (s.op != ScenarioOp::Expect) { res.stray++; return; }
+        // A final ends the request's retransmissions, and so does a
+        // provisional to an INVITE (RFC 3261 17.1.1.2).
+        if (resp.status >= 200 || in.invite) in.retx_on = false;
+        if (resp.status >= 200) in.last_final = resp.status;
+
+        const ScenarioAlt* hit = nullptr;
+        for (uint32_t a = s.alt_begin; a < s.alt_end && !hit; a++) {
+            if (resp.status >= sc.alts[a].lo && resp.status <= sc.alts[a].hi) hit = &sc.alts[a];
+        }
+        ScenarioStepStats& st = res.steps[in.step];
+        if (!hit) {
+            // Provisionals nobody asked for are passed over.
+            if (resp.status < 200) return;
+            st.unexpected++;
+            st.statuses[resp.status]++;
+            finish(d, false, t_us);
+            return;
+        }
+        st.matched++;
+        st.statuses[resp.status]++;
+        const uint64_t rtt = t_us - in.wait_us;
+        st.rtt_sum_us += rtt;
+        if (rtt > st.rtt_max_us) st.rtt_max_us = rtt;
+
+        std::string_view to_tag = sip_header_tag(resp.header("to", "t"));
+        if (!to_tag.empty()) d->set_remote_tag(to_tag);
+        if (resp.status == 401 || resp.status == 407) {
+            SipAuthChallenge ch = parse_www_authenticate_digest(resp);
+            if (ch.ok) {
+                in.ch = std::move(ch);
+                in.proxy = resp.status == 407;
+                in.nc = 0;
+            }
+        }
+        wheel.cancel(d->timer);
+        in.step = hit->target >= 0 ? (uint32_t)hit->target : in.step + 1;
+        run(idx, t_us);
+    };
+
+    for (;;) {
+        auto now = Clock::now();
+        const uint64_t now_us = us_between(start, now);
+
+        // Starts that are due go ahead while there is room; the rest wait
+        // for an instance to end.
+        while (table.size() < table.capacity() && cursor.has_next()) {
+            if (due_of(cursor.next()) > now) break;
+            cursor.take();
+            sip_id_unique(cidbuf);
+            sip_id_tag(tagbuf);
+            Dialog* d = table.insert(std::string_view(cidbuf, sizeof(cidbuf)), std::string_view(tagbuf, kSipTagHex));
+            if (!d) { res.failed++; continue; }
+            const uint32_t idx = table.index_of(d);
+            inst[idx] = Instance{};
+            inst[idx].start_us = now_us;
+            res.started++;
+            if (table.size() > res.peak_live) res.peak_live = table.size();
+            run(idx, now_us);
+        }
+
+        // A pause ending moves on; an expect retransmits its request while
+        // Timer A/E runs, and fails the instance when it runs out.
+        fired.clear();
+        const uint64_t now_ms = now_us / 1000;
+        wheel.advance(now_ms, fired);
+        for (uint64_t idx : fired) {
+            Dialog* d = table.at((uint32_t)idx);
+            Instance& in = inst[idx];
+            d->timer = 0;
+            if (sc.steps[in.step].op == ScenarioOp::Pause) {
+                in.step++;
+                run((uint32_t)idx, now_us);
+            } else if (now_ms < in.deadline_ms) {
+                if (in.retx_on && in.retx.expired(cfg.timers, now_ms)) {
+                    in.retx_on = false;
+                } else if (in.retx_on && now_ms >= in.retx_at_ms) {
+                    stage(sent[idx]);
+                    in.retx_at_ms = in.retx.on_send(cfg.timers, now_ms, in.invite);
+                    res.retransmits++;
+                }
+                d->timer = wheel.schedule(wait_until(in), idx);
+            } else {
+                res.steps[in.step].timeouts++;
+                finish(d, false, now_us);
+            }
+        }
+        flush();
+
+        const bool more = cursor.has_next();
+        if (!more && table.size() == 0) break;
+
+        int wait_ms = (int)wheel.next_delay_ms(1000);
+        if (more && table.size() < table.capacity()) {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(due_of(cursor.next()) - Clock::now()).count();
+            if (ms < wait_ms) wait_ms = ms < 0 ? 0 : (int)ms;
+        }
+        if (poller.wait(wait_ms, ready) < 0) { res.error = "poll failed"; break; }
+
+        for (size_t r = 0; r < ready.size(); r++) {
+            int n;
+            while ((n = io.recv(sock)) > 0) {
+                auto batch_t = Clock::now();
+                for (int i = 0; i < n; i++) {
+                    const auto& dg = io.at(i);
+                    on_reply(dg.data, dg.len, us_between(start, udp_rx_time(dg, batch_t)));
+                }
+                flush();
+            }
+        }
+    }
+
+    res.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    return res;
+}
+
+} // namespace
+
+ScenarioResult run_scenario(const Scenario& sc, const ScenarioConfig& cfg) {
+    ScenarioResult res;
+    res.steps.resize(sc.steps.size());
+    if (cfg.rate <= 0 || cfg.concurrency == 0 || cfg.workers < 1) {
+        res.error = "rate, concurrency and workers must be positive";
+        return res;
+    }
+    if (sc.steps.empty()) { res.error = "empty scenario"; return res; }
+
+    UdpAddr dst;
+    if (!resolver_cache().resolve(cfg.host, cfg.port, &dst, &res.dns_us)) { res.error = "DNS resolution failed"; return res; }
+
+    const int nw = cfg.workers;
+    ScheduleClaims claims(cfg.count, ScheduleClaims::chunk_for(cfg.rate, UdpBatch().max_batch()));
+    StartGate gate(nw);
+    const size_t per_worker = std::max<size_t>(1, (cfg.concurrency + (size_t)nw - 1) / (size_t)nw);
+    std::vector<ScenarioResult> parts(nw);
+    auto work = [&](int w) { parts[w] = scenario_worker(sc, cfg, dst, claims, gate, per_worker); };
+    std::vector<std::thread> pool;
+    for (int w = 1; w < nw; w++) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    for (const ScenarioResult& p : parts) {
+        if (res.error.empty()) res.error = p.error;
+        res.elapsed_s = std::max(res.elapsed_s, p.elapsed_s);
+        res.started += p.started;
+        res.completed += p.completed;
+        res.failed += p.failed;
+        res.send_errors += p.send_errors;
+        res.stray += p.stray;
+        res.retransmits += p.retransmits;
+        res.peak_live = std::max(res.peak_live, p.peak_live);
+        res.duration.merge(p.duration);
+        res.per_worker_started.push_back(p.started);
+        res.per_worker_peak_live.push_back(p.peak_live);
+        res.uring = p.uring;
+        for (size_t i = 0; i < res.steps.size(); i++) {
+            ScenarioStepStats& a = res.steps[i];
+            const ScenarioStepStats& b = p.steps[i];
+            a.sent += b.sent;
+            a.matched += b.matched;
+            a.unexpected += b.unexpected;
+            a.timeouts += b.timeouts;
+            a.rtt_sum_us += b.rtt_sum_us;
+            a.rtt_max_us = std::max(a.rtt_max_us, b.rtt_max_us);
+            for (auto& kv : b.statuses) a.statuses[kv.first] += kv.second;
+        }
+    }
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void scenario_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan scenario --file <flow.sf> --host <sip.host> [--port 5060]\n"
+"                    [--rate 10] [--count 1] [--concurrency 1000] [--workers 1]\n"
+"                    [--user <name> --pass <pw>] [--domain <d>] [--local-ip 127.0.0.1]\n"
+"                    [--set name=value]... [--t1 500] [--t2 4000] [--check] [--io-uring]\n"
+"\n"
+"Runs --count instances of a scenario file (send / expect / pause / goto\n"
+"steps; see scenarios/ for examples), started at --rate per second with at\n"
+"most --concurrency live, spread over --workers threads. [host], [port], [user], [domain] and each --set\n"
+"name are substituted once at startup. --check prints the compiled step\n"
+"table and exits. --io-uring moves UDP onto io_uring where the kernel has it.\n"
+"Requests are retransmitted on Timer A/E (--t1, --t2) until answered, for as\n"
+"long as the expect waiting on them lasts.\n"
+"\n"
+"Example:\n"
+"  frogklan scenario --file scenarios/register.sf --host 10.0.0.5 --user qa --pass s3cret --count 100\n";
+}
+
+int cmd_scenario(int argc, char** argv) {
+    ScenarioConfig cfg;
+    std::string file, domain;
+    std::map<std::string, std::string> sets;
+    bool check = false;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--file") file = need("--file");
+        else if (a == "--host") cfg.host = need("--host");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--rate") cfg.rate = std::stod(need("--rate"));
+        else if (a == "--count") cfg.count = std::stoull(need("--count"));
+        else if (a == "--concurrency") cfg.concurrency = (size_t)std::stoull(need("--concurrency"));
+        else if (a == "--workers") cfg.workers = std::stoi(need("--workers"));
+        else if (a == "--user") cfg.user = need("--user");
+        else if (a == "--pass") cfg.pass = need("--pass");
+        else if (a == "--domain") domain = need("--domain");
+        else if (a == "--local-ip") cfg.local_ip = need("--local-ip");
+        else if (a == "--t1") cfg.timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") cfg.timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--set") {
+            std::string kv = need("--set");
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos || eq == 0) { std::cerr << "--set wants name=value\n"; return 2; }
+            sets[kv.substr(0, eq)] = kv.substr(eq + 1);
+        }
+        else if (a == "--check") check = true;
+        else if (a == "--io-uring") cfg.uring = true;
+        else if (a == "--help") { scenario_usage(); return 0; }
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (file.empty() || cfg.host.empty()) {
+        std::cerr << "Missing required args.\n";
+        scenario_usage();
+        return 2;
+    }
+    if (cfg.timers.t1_ms <= 0 || cfg.timers.t2_ms < cfg.timers.t1_ms) {
+        std::cerr << "--t1 must be positive and --t2 at least --t1\n";
+        return 2;
+    }
+
+    std::ifstream in(file, std::ios::binary);
+    if (!in) { std::cerr << "scenario: cannot read " << file << "\n"; return 2; }
+    std::stringstream text;
+    text << in.rdbuf();
+
+    std::map<std::string, std::string> consts = sets;
+    consts["host"] = cfg.host;
+    consts["port"] = std::to_string(cfg.port);
+    consts["user"] = cfg.user;
+    consts["domain"] = domain.empty() ? cfg.host : domain;
+    consts["transport"] = "UDP";
+    consts["user_agent"] = "frogklan-sip-qa/" + std::string(APP_VERSION);
+
+    Scenario sc;
+    sc.name = fs::path(file).stem().string();
+    std::string err;
+    if (!compile_scenario(text.str(), consts, &sc, &err)) {
+        std::cerr << "scenario: " << file << ": " << err << "\n";
+        return 2;
+    }
+    if (check) {
+        for (size_t i = 0; i < sc.steps.size(); i++) std::cout << sc.describe(i) << "\n";
+        std::cout << sc.messages.size() << " messages, " << sc.pieces.size() << " pieces, "
+                  << sc.text.size() << " bytes of literal text\n";
+        return 0;
+    }
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_scenario_report.json";
+
+    ScenarioResult r = run_scenario(sc, cfg);
+    if (!r.ok) {
+        std::cerr << "scenario: " << r.error << "\n";
+        return 3;
+    }
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"scenario\": \"" << json_escape(sc.name) << "\",\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.host) << "\", \"port\": " << cfg.port << "},\n"
+"  \"rate_target\": " << cfg.rate << ",\n"
+"  \"count\": " << cfg.count << ",\n"
+"  \"concurrency\": " << cfg.concurrency << ",\n"
+"  \"dns_us\": " << r.dns_us << ",\n"
+"  \"elapsed_s\": " << r.elapsed_s << ",\n"
+"  \"started\": " << r.started << ",\n"
+"  \"completed\": " << r.completed << ",\n"
+"  \"failed\": " << r.failed << ",\n"
+"  \"send_errors\": " << r.send_errors << ",\n"
+"  \"stray\": " << r.stray << ",\n"
+"  \"retransmits\": " << r.retransmits << ",\n"
+"  \"peak_live\": " << r.peak_live << ",\n"
+"  \"workers\": " << cfg.workers << ",\n"
+"  \"udp_io\": \"" << (r.uring ? "io_uring" : "mmsg") << "\",\n"
+"  \"duration_us\": ";
+    json_hist(f, r.duration);
+    f << ",\n  \"per_worker_started\": [";
+    for (size_t i = 0; i < r.per_worker_started.size(); i++) f << (i ? ", " : "") << r.per_worker_started[i];
+    f << "],\n  \"per_worker_peak_live\": [";
+    for (size_t i = 0; i < r.per_worker_peak_live.size(); i++) f << (i ? ", " : "") << r.per_worker_peak_live[i];
+    f << "],\n  \"steps\": [";
+    for (size_t i = 0; i < r.steps.size(); i++) {
+        const ScenarioStepStats& s = r.steps[i];
+        f << (i ? ",\n" : "\n") << "    {\"step\": \"" << json_escape(sc.describe(i)) << "\", \"sent\": " << s.sent
+          << ", \"matched\": " << s.matched << ", \"unexpected\": " << s.unexpected << ", \"timeouts\": " << s.timeouts
+          << ", \"rtt_mean_us\": " << (s.matched ? s.rtt_sum_us / s.matched : 0) << ", \"rtt_max_us\": " << s.rtt_max_us
+          << ", \"statuses\": {";
+        bool first = true;
+        for (auto& kv : s.statuses) {
+            f << (first ? "" : ", ") << "\"" << kv.first << "\": " << kv.second;
+            first = false;
+        }
+        f << "}}";
+    }
+    f << "\n  ]\n}\n";
+    f.close();
+
+    std::cout << "SIP scenario report: " << report_path << "\n";
+    if (cfg.uring && !r.uring) std::cout << "io_uring unavailable here; ran on recvmmsg/sendmmsg\n";
+    std::cout << "scenario " << sc.name << ": started=" << r.started << " completed=" << r.completed
+              << " failed=" << r.failed << " stray=" << r.stray << " retransmits=" << r.retransmits << " peak_live=" << r.peak_live;
+    if (r.per_worker_peak_live.size() > 1) {
+        std::cout << " (per worker:";
+        for (uint64_t n : r.per_worker_peak_live) std::cout << " " << n;
+        std::cout << ")";
+    }
+    std::cout << "\n";
+    for (size_t i = 0; i < r.steps.size(); i++) {
+        const ScenarioStepStats& s = r.steps[i];
+        std::cout << "  " << sc.describe(i);
+        if (s.sent) std::cout << "  sent=" << s.sent;
+        if (sc.steps[i].op == ScenarioOp::Expect) {
+            std::cout << "  matched=" << s.matched << " unexpected=" << s.unexpected << " timeouts=" << s.timeouts
+                      << " rtt_mean_us=" << (s.matched ? s.rtt_sum_us / s.matched : 0);
+        }
+        std::cout << "\n";
+    }
+    std::cout << "duration_us: p50=" << r.duration.percentile(50) << " p99=" << r.duration.percentile(99)
+              << " max=" << r.duration.max() << " (n=" << r.duration.count() << ")\n";
+    return 0;
+}
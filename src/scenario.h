@@ -0,0 +1,147 @@
+#pragma once
+#include "histogram.h"
+#include "sip_timers.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scenario files describe a flow as send / expect / pause / goto steps:
+//
+//   default expires 3600              a constant unless given with --set
+//   timeout 5000                      default wait for the expects below
+//   send                              a message follows, up to a "." line
+//   REGISTER sip:[host] SIP/2.0
+//   Via: SIP/2.0/UDP [local_ip]:[local_port];branch=[branch]
+//   ...
+//   [auth]                            Authorization line, or nothing
+//   Content-Length: [len]
+//   .
+//   expect 200 401:again 407:again    status, or class like 2xx, then an
+//                                     optional :label to jump to
+//   pause 1000
+//   label again
+//   goto start
+//
+// Per-instance variables: [call_id] [tag] [to_tag] [branch] [cseq] [auth]
+// [len] [local_ip] [local_port]. Anything else in brackets must be a per-run
+// constant ([host], [port], [user], [domain], [user_agent], a --set
+// name=value or a default) and is substituted when the file is compiled,
+// in step lines as well as messages. A fresh branch is drawn for every
+// send except CANCEL and the ACK for a non-2xx final, which keep the
+// INVITE's; [cseq] advances on every request except ACK and CANCEL.
+//
+// compile_scenario turns the file into a flat step table with each message
+// split into literal runs and variable slots, so running a step only copies
+// bytes: no text is parsed after startup.
+
+enum class ScenarioOp : uint8_t { Send, Expect, Pause, Goto };
+enum class ScenarioVar : uint8_t { Literal, CallId, Tag, ToTag, Branch, CSeq, Auth, Len, LocalIp, LocalPort };
+
+struct ScenarioPiece {
+    ScenarioVar var;
+    uint32_t off;              // into Scenario::text, for literals
+    uint32_t len;
+};
+
+struct ScenarioMessage {
+    uint32_t head_begin, head_end;   // pieces of the start line and headers
+    uint32_t body_begin, body_end;   // pieces of the body
+    std::string method;
+    std::string uri;                 // request URI, for Digest
+};
+
+struct ScenarioAlt {
+    uint16_t lo, hi;           // status range
+    int32_t target;            // step to continue at; -1 for the next one
+};
+
+struct ScenarioStep {
+    ScenarioOp op;
+    uint32_t arg = 0;          // Send: message index; Pause: ms; Expect: timeout ms
+    uint32_t alt_begin = 0, alt_end = 0;
+    int32_t target = -1;       // Goto
+    uint32_t line = 0;         // in the source file
+};
+
+// Values a running instance supplies for the per-instance variables.
+struct ScenarioValues {
+    std::string_view call_id, tag, to_tag, branch, auth, local_ip, local_port;
+    uint32_t cseq = 1;
+};
+
+struct Scenario {
+    std::string name;
+    std::string text;
+    std::vector<ScenarioPiece> pieces;
+    std::vector<ScenarioMessage> messages;
+    std::vector<ScenarioAlt> alts;
+    std::vector<ScenarioStep> steps;
+
+    // Clears `out` and writes message m into it. `scratch` holds the body
+    // while the head, whose [len] depends on it, is written. Neither
+    // allocates once grown.
+    size_t render(const ScenarioMessage& m, const ScenarioValues& v, std::string& out, std::string& scratch) const;
+    // One line per step, e.g. "3 expect 200 401->5".
+    std::string describe(size_t step) const;
+};
+
+// False with *err naming the line when the text does not compile.
+bool compile_scenario(std::string_view source, const std::map<std::string, std::string>& consts,
+                      Scenario* out, std::string* err);
+
+struct ScenarioConfig {
+    std::string host;
+    uint16_t port = 5060;
+    std::string user;
+    std::string pass;
+    std::string local_ip = "127.0.0.1";  // [local_ip]; the socket binds here
+    double rate = 10.0;        // instances started per second
+    uint64_t count = 1;        // instances in all
+    size_t concurrency = 1000; // live at once; further starts wait for a slot
+    int workers = 1;           // threads, each with its own socket and share of concurrency
+    bool uring = false;        // UDP over io_uring where the kernel has it (UdpBatch::use_uring)
+    SipTimers timers;          // Timer A/E retransmits; the expect's timeout ends the wait
+};
+
+struct ScenarioStepStats {
+    uint64_t sent = 0;
+    uint64_t matched = 0;      // responses an expect took
+    uint64_t unexpected = 0;   // finals no alternative listed
+    uint64_t timeouts = 0;
+    uint64_t rtt_sum_us = 0;   // expect entry -> matched response
+    uint64_t rtt_max_us = 0;
+    std::map<int, uint64_t> statuses;
+};
+
+struct ScenarioResult {
+    bool ok = false;
+    std::string error;
+    int64_t dns_us = 0;
+    double elapsed_s = 0;
+    uint64_t started = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t send_errors = 0;
+    uint64_t stray = 0;
+    uint64_t retransmits = 0;
+    uint64_t peak_live = 0;    // one worker's own peak; merged, the largest of them
+    LatencyHistogram duration;  // instance start -> last step, completed ones
+    std::vector<ScenarioStepStats> steps;
+    std::vector<uint64_t> per_worker_started;
+    std::vector<uint64_t> per_worker_peak_live;  // peaks need not coincide, so these are not summed
+    bool uring = false;        // io_uring actually carried the traffic
+};
+
+// Runs cfg.count instances of sc on one event loop over UDP. Instances are
+// keyed by Call-ID and tag in a DialogTable and their waits run on a
+// TimerWheel, so thousands can be in flight at once. A request an expect is
+// waiting on is retransmitted on Timer A/E until a response ends it, Timer
+// B/F runs out or the expect times out. With workers > 1 each
+// thread runs its own loop, socket and table and claims starts from a
+// shared schedule (see ScheduleClaims); per-worker results are merged.
+ScenarioResult run_scenario(const Scenario& sc, const ScenarioConfig& cfg);
+
+int cmd_scenario(int argc, char** argv);
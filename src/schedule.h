@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Items 0..total shared by worker threads, which claim the next few
+// whenever they run out: in the open-loop engines item k is the request or
+// instance due at start + k/rate, in the prober it is a target. A worker
+// that falls behind (a busy core, a slow socket) simply claims less and the
+// others take up the slack, so shards never need rebalancing. The only
+// shared write on the hot path is one fetch_add per chunk.
+class ScheduleClaims {
+public:
+    ScheduleClaims(uint64_t total, uint64_t chunk) : total_(total), chunk_(chunk ? chunk : 1) {}
+
+    // Items [*first, *end), or false once every item has been handed out.
+    bool claim(uint64_t* first, uint64_t* end) {
+        uint64_t f = next_.fetch_add(chunk_, std::memory_order_relaxed);
+        if (f >= total_) return false;
+        *first = f;
+        *end = std::min(f + chunk_, total_);
+        return true;
+    }
+    uint64_t total() const { return total_; }
+
+    // About half a millisecond of traffic per claim, capped at one send
+    // batch: small enough that a stalled worker holds up little, large
+    // enough that claims stay rare.
+    static uint64_t chunk_for(double rate, size_t max_batch) {
+        uint64_t c = (uint64_t)(rate / 2000.0);
+        return std::max<uint64_t>(1, std::min<uint64_t>(c, max_batch));
+    }
+
+private:
+    std::atomic<uint64_t> next_{0};
+    const uint64_t total_;
+    const uint64_t chunk_;
+};
+
+// One worker's view of a ScheduleClaims: the item it will send next.
+class ScheduleCursor {
+public:
+    explicit ScheduleCursor(ScheduleClaims& claims) : claims_(claims) {}
+
+    // Claims a fresh chunk when the current one is used up; false when the
+    // whole schedule is.
+    bool has_next() {
+        if (next_ < end_) return true;
+        if (done_) return false;
+        if (!claims_.claim(&next_, &end_)) done_ = true;
+        return !done_;
+    }
+    uint64_t next() const { return next_; }
+    // Items left in the current chunk; batches never cross a chunk, so
+    // unsent ones can be handed back with give_back().
+    uint64_t left_in_chunk() const { return end_ - next_; }
+    void take() { next_++; }
+    void give_back(uint64_t n) { next_ -= n; }
+
+private:
+    ScheduleClaims& claims_;
+    uint64_t next_ = 0;
+    uint64_t end_ = 0;
+    bool done_ = false;
+};
+
+// Lines worker threads up on a common start time once all of them have
+// finished their setup (sockets, connections), so none starts its clock
+// while another is still connecting.
+class StartGate {
+public:
+    explicit StartGate(int workers) : workers_(workers) {}
+
+    // Blocks until every worker has arrived; all get the same start, `lead`
+    // after the last arrival.
+    std::chrono::steady_clock::time_point arrive(std::chrono::milliseconds lead) {
+        if (arrived_.fetch_add(1) + 1 == workers_) {
+            start_ = std::chrono::steady_clock::now() + lead;
+            go_.store(true, std::memory_order_release);
+        }
+        while (!go_.load(std::memory_order_acquire)) std::this_thread::yield();
+        return start_;
+    }
+
+private:
+    const int workers_;
+    std::atomic<int> arrived_{0};
+    std::atomic<bool> go_{false};
+    std::chrono::steady_clock::time_point start_;
+};
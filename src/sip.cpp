@@ -1,8 +1,9 @@
 #include "sip.h"
 #include "md5.h"
+#include "sip_id.h"
 #include <algorithm>
 #include <sstream>
-#include <random>
+#include <vector>
 
 static inline std::string trim(std::string s) {
     auto notsp = [](unsigned char c){ return !std::isspace(c); };
@@ -48,6 +49,219 @@ SipResponse parse_sip_response(const std::string& raw) {
     return r;
 }
 
+static inline char lc(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c | 0x20) : c;
+}
+
+// `lower_name` must already be lowercase.
+static inline bool ieq(std::string_view a, std::string_view lower_name) {
+    if (a.size() != lower_name.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (lc(a[i]) != lower_name[i]) return false;
+    }
+    return true;
+}
+
+static inline std::string_view trim_view(std::string_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && (s[b] == ' ' || s[b] == '\t')) b++;
+    while (e > b && (s[e-1] == ' ' || s[e-1] == '\t' || s[e-1] == '\r' || s[e-1] == '\n')) e--;
+    return s.substr(b, e - b);
+}
+
+std::string_view sip_trim(std::string_view s) {
+    return trim_view(s);
+}
+
+std::string_view SipResponseView::header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; i++) {
+        if (ieq(headers[i].name, name)) return headers[i].value;
+    }
+    return {};
+}
+
+std::string_view SipResponseView::header(std::string_view name, std::string_view compact) const {
+    std::string_view v = header(name);
+    return v.empty() ? header(compact) : v;
+}
+
+bool parse_sip_response_view(const char* data, size_t len, SipResponseView* out) {
+    SipResponseView& r = *out;
+    r.status = 0;
+    r.reason = r.via = r.call_id = r.cseq = r.authenticate = r.body = {};
+    r.header_count = 0;
+
+    std::string_view msg(data, len);
+    size_t eol = msg.find('\n');
+    std::string_view line = msg.substr(0, eol);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    // "SIP/2.0 200 OK"
+    if (line.size() < 11 || line.compare(0, 8, "SIP/2.0 ") != 0) return false;
+    int status = 0;
+    for (size_t i = 8; i < 11; i++) {
+        if (line[i] < '0' || line[i] > '9') return false;
+        status = status * 10 + (line[i] - '0');
+    }
+    r.status = status;
+    r.reason = trim_view(line.substr(11));
+
+    std::string_view www, proxy;
+    SipHeaderView* last = nullptr;
+    std::string_view* cap = nullptr;   // the captured field the current header filled
+    const char* vb = nullptr;          // start of the current header's value
+    size_t pos = (eol == std::string_view::npos) ? len : eol + 1;
+    while (pos < len) {
+        eol = msg.find('\n', pos);
+        size_t next = (eol == std::string_view::npos) ? len : eol + 1;
+        line = msg.substr(pos, next - pos);
+        if (!line.empty() && line.back() == '\n') line.remove_suffix(1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) { pos = next; break; }
+
+        if ((line[0] == ' ' || line[0] == '\t') && vb) {
+            // Folded continuation: the value is contiguous in the buffer, so
+            // widen it, in the flat array and in whichever field captured it.
+            std::string_view v = trim_view(std::string_view(vb, (size_t)(line.data() + line.size() - vb)));
+            if (last) last->value = v;
+            if (cap) *cap = v;
+            pos = next;
+            continue;
+        }
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) { pos = next; continue; }
+        std::string_view name = trim_view(line.substr(0, colon));
+        std::string_view val = trim_view(line.substr(colon + 1));
+        vb = val.data();
+        cap = nullptr;
+
+        // Dispatch on length first so most headers cost one or two compares.
+        switch (name.size()) {
+            case 1:
+                if (lc(name[0]) == 'v' && r.via.empty()) cap = &r.via;
+                else if (lc(name[0]) == 'i' && r.call_id.empty()) cap = &r.call_id;
+                break;
+            case 3:
+                if (r.via.empty() && ieq(name, "via")) cap = &r.via;
+                break;
+            case 4:
+                if (r.cseq.empty() && ieq(name, "cseq")) cap = &r.cseq;
+                break;
+            case 7:
+                if (r.call_id.empty() && ieq(name, "call-id")) cap = &r.call_id;
+                break;
+            case 16:
+                if (www.empty() && ieq(name, "www-authenticate")) cap = &www;
+                break;
+            case 18:
+                if (proxy.empty() && ieq(name, "proxy-authenticate")) cap = &proxy;
+                break;
+            default:
+                break;
+        }
+        if (cap) *cap = val;
+
+        if (r.header_count < SipResponseView::kMaxHeaders) {
+            last = &r.headers[r.header_count++];
+            last->name = name;
+            last->value = val;
+        } else {
+            last = nullptr;
+        }
+        pos = next;
+    }
+    r.authenticate = (status == 407) ? proxy : www;
+    if (pos < len) r.body = msg.substr(pos);
+    return true;
+}
+
+bool parse_sip_request_view(const char* data, size_t len, SipRequestView* out) {
+    SipRequestView& r = *out;
+    r = SipRequestView{};
+
+    std::string_view msg(data, len);
+    size_t eol = msg.find('\n');
+    std::string_view line = msg.substr(0, eol);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    // "OPTIONS sip:host SIP/2.0"
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || line.compare(sp2 + 1, std::string_view::npos, "SIP/2.0") != 0) {
+        return false;
+    }
+    r.method = line.substr(0, sp1);
+    r.uri = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    std::string_view* last = nullptr;
+    size_t pos = (eol == std::string_view::npos) ? len : eol + 1;
+    while (pos < len) {
+        eol = msg.find('\n', pos);
+        size_t next = (eol == std::string_view::npos) ? len : eol + 1;
+        line = msg.substr(pos, next - pos);
+        if (!line.empty() && line.back() == '\n') line.remove_suffix(1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) break;
+
+        if ((line[0] == ' ' || line[0] == '\t') && last) {
+            const char* b = last->data();
+            *last = trim_view(std::string_view(b, (size_t)(line.data() + line.size() - b)));
+            pos = next;
+            continue;
+        }
+
+        last = nullptr;
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) { pos = next; continue; }
+        std::string_view name = trim_view(line.substr(0, colon));
+        std::string_view val = trim_view(line.substr(colon + 1));
+
+        std::string_view* slot = nullptr;
+        switch (name.size()) {
+            case 1:
+                switch (lc(name[0])) {
+                    case 'v': if (r.via_count < SipRequestView::kMaxVias) slot = &r.vias[r.via_count++]; break;
+                    case 'f': slot = &r.from; break;
+                    case 't': slot = &r.to; break;
+                    case 'i': slot = &r.call_id; break;
+                    case 'm': slot = &r.contact; break;
+                    default: break;
+                }
+                break;
+            case 2:
+                if (ieq(name, "to")) slot = &r.to;
+                break;
+            case 3:
+                if (ieq(name, "via") && r.via_count < SipRequestView::kMaxVias) slot = &r.vias[r.via_count++];
+                break;
+            case 4:
+                if (ieq(name, "from")) slot = &r.from;
+                else if (ieq(name, "cseq")) slot = &r.cseq;
+                break;
+            case 7:
+                if (ieq(name, "call-id")) slot = &r.call_id;
+                else if (ieq(name, "contact")) slot = &r.contact;
+                else if (ieq(name, "expires")) slot = &r.expires;
+                break;
+            case 13:
+                if (ieq(name, "authorization")) slot = &r.authorization;
+                break;
+            case 19:
+                if (ieq(name, "proxy-authorization")) slot = &r.authorization;
+                break;
+            default:
+                break;
+        }
+        if (slot) {
+            *slot = val;
+            last = slot;
+        }
+        pos = next;
+    }
+    return true;
+}
+
 static std::map<std::string, std::string> parse_kv_params(const std::string& s) {
     // input like: Digest realm="x", nonce="y", qop="auth"
     std::map<std::string, std::string> m;
@@ -83,12 +297,9 @@ static std::map<std::string, std::string> parse_kv_params(const std::string& s)
     return m;
 }
 
-SipAuthChallenge parse_www_authenticate_digest(const SipResponse& resp) {
+static SipAuthChallenge parse_digest_challenge(const std::string& value) {
     SipAuthChallenge ch;
-    auto it = resp.headers_lc.find("www-authenticate");
-    if (it == resp.headers_lc.end()) return ch;
-
-    auto params = parse_kv_params(it->second);
+    auto params = parse_kv_params(value);
     if (params.count("realm") && params.count("nonce")) {
         ch.ok = true;
         ch.realm = params["realm"];
@@ -97,23 +308,142 @@ SipAuthChallenge parse_www_authenticate_digest(const SipResponse& resp) {
         if (params.count("opaque")) ch.opaque = params["opaque"];
         if (params.count("algorithm")) ch.algorithm = params["algorithm"];
         else ch.algorithm = "MD5";
+        if (params.count("stale")) ch.stale = (lower(params["stale"]) == "true");
     }
     return ch;
 }
 
-static std::string rand_hex(size_t nbytes) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis(0, 255);
-    std::string out;
-    out.reserve(nbytes*2);
-    static const char* h="0123456789abcdef";
-    for (size_t i=0;i<nbytes;i++){
-        int v = dis(gen);
-        out.push_back(h[(v>>4)&15]);
-        out.push_back(h[v&15]);
+SipDigestCredentials parse_digest_credentials(std::string_view value) {
+    SipDigestCredentials c;
+    auto params = parse_kv_params(std::string(value));
+    auto take = [&](const char* k, std::string* out) {
+        auto it = params.find(k);
+        if (it == params.end()) return false;
+        *out = it->second;
+        return true;
+    };
+    c.ok = take("username", &c.username) & take("realm", &c.realm) & take("nonce", &c.nonce) &
+           take("uri", &c.uri) & take("response", &c.response);
+    take("qop", &c.qop);
+    take("nc", &c.nc);
+    take("cnonce", &c.cnonce);
+    take("opaque", &c.opaque);
+    return c;
+}
+
+std::string digest_expected_response(std::string_view method, const SipDigestCredentials& c,
+                                     const std::string& ha1_hex) {
+    std::string ha2 = MD5::md5_hex(std::string(method) + ":" + c.uri);
+    if (!c.qop.empty()) {
+        return MD5::md5_hex(ha1_hex + ":" + c.nonce + ":" + c.nc + ":" + c.cnonce + ":" + c.qop + ":" + ha2);
     }
-    return out;
+    return MD5::md5_hex(ha1_hex + ":" + c.nonce + ":" + ha2);
+}
+
+SipAuthChallenge parse_www_authenticate_digest(const SipResponse& resp) {
+    auto it = resp.headers_lc.find(resp.status == 407 ? "proxy-authenticate" : "www-authenticate");
+    if (it == resp.headers_lc.end()) return SipAuthChallenge{};
+    return parse_digest_challenge(it->second);
+}
+
+SipAuthChallenge parse_www_authenticate_digest(const SipResponseView& resp) {
+    if (resp.authenticate.empty()) return SipAuthChallenge{};
+    return parse_digest_challenge(std::string(resp.authenticate));
+}
+
+static const std::string* find_header(const SipResponse& resp, const char* name, const char* compact) {
+    auto it = resp.headers_lc.find(name);
+    if (it == resp.headers_lc.end()) it = resp.headers_lc.find(compact);
+    return it == resp.headers_lc.end() ? nullptr : &it->second;
+}
+
+std::string sip_top_via_branch(const SipResponse& resp) {
+    const std::string* via = find_header(resp, "via", "v");
+    if (!via) return "";
+    // Duplicates were merged with ", " so the first branch= is the top Via's.
+    auto top = via->substr(0, via->find(','));
+    auto ltop = lower(top);
+    auto idx = ltop.find(";branch=");
+    if (idx == std::string::npos) return "";
+    idx += 8;
+    size_t end = idx;
+    while (end < top.size() && top[end] != ';' && top[end] != ' ' && top[end] != '\t') end++;
+    return top.substr(idx, end - idx);
+}
+
+std::string_view sip_top_via_branch(const SipResponseView& resp) {
+    return sip_via_branch(resp.via);
+}
+
+std::string_view sip_via_branch(std::string_view via) {
+    std::string_view top = via.substr(0, via.find(','));
+    // Case-insensitive search for ";branch=".
+    static const char kParam[] = ";branch=";
+    const size_t plen = sizeof(kParam) - 1;
+    for (size_t i = top.find(';'); i != std::string_view::npos; i = top.find(';', i + 1)) {
+        if (i + plen > top.size() || !ieq(top.substr(i, plen), kParam)) continue;
+        size_t b = i + plen, e = b;
+        while (e < top.size() && top[e] != ';' && top[e] != ' ' && top[e] != '\t') e++;
+        return top.substr(b, e - b);
+    }
+    return {};
+}
+
+std::string_view sip_cseq_method(std::string_view cseq) {
+    size_t sp = cseq.find_first_of(" \t");
+    return sp == std::string_view::npos ? std::string_view() : trim_view(cseq.substr(sp));
+}
+
+std::string_view sip_header_tag(std::string_view value) {
+    // Parameters of a name-addr follow the closing '>'; ones inside belong
+    // to the URI.
+    size_t gt = value.find('>');
+    std::string_view params = gt == std::string_view::npos ? value : value.substr(gt + 1);
+    for (size_t i = params.find(';'); i != std::string_view::npos; i = params.find(';', i + 1)) {
+        size_t b = i + 1;
+        while (b < params.size() && (params[b] == ' ' || params[b] == '\t')) b++;
+        if (b + 4 > params.size() || !ieq(params.substr(b, 4), "tag=")) continue;
+        size_t e = b + 4;
+        while (e < params.size() && params[e] != ';' && params[e] != ' ' && params[e] != '\t' &&
+               params[e] != '\r') e++;
+        return params.substr(b + 4, e - b - 4);
+    }
+    return {};
+}
+
+std::string sip_call_id(const SipResponse& resp) {
+    const std::string* cid = find_header(resp, "call-id", "i");
+    return cid ? *cid : "";
+}
+
+// If qop has multiple, pick auth if present
+static std::string select_qop(const std::string& offered) {
+    if (offered.empty()) return "";
+    auto ql = offered;
+    std::transform(ql.begin(), ql.end(), ql.begin(), ::tolower);
+    if (ql.find("auth") != std::string::npos) return "auth";
+    return trim(offered);
+}
+
+static std::string format_digest_authorization(
+    std::string_view uri, std::string_view username, const SipAuthChallenge& ch,
+    const std::string& resp, const std::string& qop, std::string_view cnonce, std::string_view nc_hex8
+) {
+    std::string o;
+    o.reserve(160 + username.size() + ch.realm.size() + ch.nonce.size() + uri.size() + ch.opaque.size());
+    o.append("Digest username=\"").append(username).append("\"");
+    o.append(", realm=\"").append(ch.realm).append("\"");
+    o.append(", nonce=\"").append(ch.nonce).append("\"");
+    o.append(", uri=\"").append(uri).append("\"");
+    o.append(", response=\"").append(resp).append("\"");
+    o.append(", algorithm=MD5");
+
+    if (!ch.opaque.empty()) o.append(", opaque=\"").append(ch.opaque).append("\"");
+    if (!qop.empty()) {
+        o.append(", qop=").append(qop).append(", nc=").append(nc_hex8);
+        o.append(", cnonce=\"").append(cnonce).append("\"");
+    }
+    return o;
 }
 
 std::string build_digest_authorization(
@@ -129,33 +459,88 @@ std::string build_digest_authorization(
     // HA1 = MD5(username:realm:password)
     // HA2 = MD5(method:uri)
     // response = MD5(HA1:nonce:HA2) OR if qop: MD5(HA1:nonce:nc:cnonce:qop:HA2)
-    std::string ha1 = MD5::md5_hex(username + ":" + ch.realm + ":" + password);
+    return build_digest_authorization_ha1(method, uri, username,
+                                          MD5::md5_hex(username + ":" + ch.realm + ":" + password),
+                                          ch, cnonce, nc_hex8);
+}
+
+std::string build_digest_authorization_ha1(
+    const std::string& method,
+    const std::string& uri,
+    const std::string& username,
+    const std::string& ha1,
+    const SipAuthChallenge& ch,
+    const std::string& cnonce,
+    const std::string& nc_hex8
+) {
     std::string ha2 = MD5::md5_hex(method + ":" + uri);
 
     std::string resp;
-    std::string qop = ch.qop;
-    // If qop has multiple, pick auth if present
+    std::string qop = select_qop(ch.qop);
     if (!qop.empty()) {
-        auto ql = qop;
-        std::transform(ql.begin(), ql.end(), ql.begin(), ::tolower);
-        if (ql.find("auth") != std::string::npos) qop = "auth";
-        else qop = trim(qop);
         resp = MD5::md5_hex(ha1 + ":" + ch.nonce + ":" + nc_hex8 + ":" + cnonce + ":" + qop + ":" + ha2);
     } else {
         resp = MD5::md5_hex(ha1 + ":" + ch.nonce + ":" + ha2);
     }
+    return format_digest_authorization(uri, username, ch, resp, qop, cnonce, nc_hex8);
+}
 
-    std::ostringstream o;
-    o << "Digest username=\"" << username << "\""
-      << ", realm=\"" << ch.realm << "\""
-      << ", nonce=\"" << ch.nonce << "\""
-      << ", uri=\"" << uri << "\""
-      << ", response=\"" << resp << "\""
-      << ", algorithm=MD5";
-
-    if (!ch.opaque.empty()) o << ", opaque=\"" << ch.opaque << "\"";
-    if (!qop.empty()) o << ", qop=" << qop << ", nc=" << nc_hex8 << ", cnonce=\"" << cnonce << "\"";
-    return o.str();
+void build_digest_authorization_batch(const SipDigestInput* in, size_t n, std::string* out) {
+    // Same three hashes as build_digest_authorization, but each stage runs
+    // over the whole batch through md5_batch. Inputs for a stage are packed
+    // into one arena so the views stay valid while it is hashed.
+    std::vector<std::string> qops(n), ha1s(n);
+    std::vector<size_t> offs(n + 1), need;
+    std::vector<std::string_view> views(n);
+    std::vector<uint8_t> ha1(n * 16), ha2(n * 16), resp(n * 16);
+    std::string arena;
+
+    // Hashes m inputs, the k-th written by append_one(k), into digests.
+    auto run_stage = [&](size_t m, auto&& append_one, std::vector<uint8_t>& digests) {
+        arena.clear();
+        for (size_t k = 0; k < m; k++) {
+            offs[k] = arena.size();
+            append_one(k);
+        }
+        offs[m] = arena.size();
+        for (size_t k = 0; k < m; k++) views[k] = std::string_view(arena.data() + offs[k], offs[k+1] - offs[k]);
+        md5_batch(views.data(), m, reinterpret_cast<uint8_t(*)[16]>(digests.data()));
+    };
+    auto hex_of = [](const std::vector<uint8_t>& d, size_t i) { return MD5::hex(d.data() + i * 16, 16); };
+
+    // HA1 only for the entries that did not bring their own.
+    for (size_t i = 0; i < n; i++) {
+        if (in[i].ha1_hex.empty()) need.push_back(i);
+        else ha1s[i] = std::string(in[i].ha1_hex);
+    }
+    if (!need.empty()) {
+        run_stage(need.size(), [&](size_t k){
+            const auto& x = in[need[k]];
+            arena.append(x.username).append(":").append(x.ch->realm).append(":").append(x.password);
+        }, ha1);
+        for (size_t k = 0; k < need.size(); k++) ha1s[need[k]] = hex_of(ha1, k);
+    }
+    run_stage(n, [&](size_t i){
+        arena.append(in[i].method).append(":").append(in[i].uri);
+    }, ha2);
+    run_stage(n, [&](size_t i){
+        const auto& x = in[i];
+        qops[i] = select_qop(x.ch->qop);
+        arena.append(ha1s[i]).append(":").append(x.ch->nonce).append(":");
+        if (!qops[i].empty()) {
+            arena.append(x.nc_hex8).append(":").append(x.cnonce).append(":").append(qops[i]).append(":");
+        }
+        arena.append(hex_of(ha2, i));
+    }, resp);
+
+    for (size_t i = 0; i < n; i++) {
+        const auto& x = in[i];
+        out[i] = format_digest_authorization(x.uri, x.username, *x.ch, hex_of(resp, i), qops[i], x.cnonce, x.nc_hex8);
+    }
+}
+
+const char* sip_transport_name(SipTransport t) {
+    return t == SipTransport::Tcp ? "TCP" : "UDP";
 }
 
 static std::string sip_uri_hostport(const std::string& host, uint16_t port) {
@@ -167,7 +552,7 @@ static std::string sip_uri_hostport(const std::string& host, uint16_t port) {
 
 static std::string ensure_tag(std::string s) {
     if (s.find(";tag=") != std::string::npos) return s;
-    return s + ";tag=" + rand_hex(6);
+    return s + ";tag=" + sip_new_tag();
 }
 
 std::string make_sip_options(
@@ -178,12 +563,13 @@ std::string make_sip_options(
     const std::string& call_id,
     int cseq,
     const std::string& branch,
-    const std::string& local_tag
+    const std::string& local_tag,
+    SipTransport transport
 ) {
     const std::string req_uri = sip_uri_hostport(host, port);
     std::ostringstream o;
     o << "OPTIONS " << req_uri << " SIP/2.0\r\n";
-    o << "Via: SIP/2.0/UDP " << host << ":" << port << ";branch=" << branch << "\r\n";
+    o << "Via: SIP/2.0/" << sip_transport_name(transport) << " " << host << ":" << port << ";branch=" << branch << "\r\n";
     o << "Max-Forwards: 70\r\n";
     o << "From: <" << from_uri << ">;tag=" << local_tag << "\r\n";
     o << "To: <" << to_uri << ">\r\n";
@@ -206,12 +592,14 @@ std::string make_sip_register(
     const std::string& branch,
     const std::string& local_tag,
     int expires_seconds,
-    const std::string& authorization_header
+    const std::string& authorization_header,
+    bool proxy_authorization,
+    SipTransport transport
 ) {
     const std::string req_uri = sip_uri_hostport(host, port);
     std::ostringstream o;
     o << "REGISTER " << req_uri << " SIP/2.0\r\n";
-    o << "Via: SIP/2.0/UDP " << host << ":" << port << ";branch=" << branch << "\r\n";
+    o << "Via: SIP/2.0/" << sip_transport_name(transport) << " " << host << ":" << port << ";branch=" << branch << "\r\n";
     o << "Max-Forwards: 70\r\n";
     o << "From: <" << aor_uri << ">;tag=" << local_tag << "\r\n";
     o << "To: <" << aor_uri << ">\r\n";
@@ -219,7 +607,9 @@ std::string make_sip_register(
     o << "CSeq: " << cseq << " REGISTER\r\n";
     o << "Contact: <" << contact_uri << ">\r\n";
     o << "Expires: " << expires_seconds << "\r\n";
-    if (!authorization_header.empty()) o << "Authorization: " << authorization_header << "\r\n";
+    if (!authorization_header.empty()) {
+        o << (proxy_authorization ? "Proxy-Authorization: " : "Authorization: ") << authorization_header << "\r\n";
+    }
     o << "User-Agent: " << user_agent << "\r\n";
     o << "Content-Length: 0\r\n\r\n";
     return o.str();
@@ -1,7 +1,14 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <map>
 #include <cstdint>
+#include <cstddef>
+
+enum class SipTransport : uint8_t { Udp, Tcp };
+
+// "UDP" / "TCP", as written in the Via sent-protocol.
+const char* sip_transport_name(SipTransport t);
 
 struct SipAuthChallenge {
     bool ok = false;
@@ -10,6 +17,7 @@ struct SipAuthChallenge {
     std::string qop;      // e.g. "auth"
     std::string opaque;
     std::string algorithm; // usually "MD5"
+    bool stale = false;    // server says the nonce expired, credentials were fine
 };
 
 struct SipResponse {
@@ -19,17 +27,105 @@ struct SipResponse {
     std::string raw;
 };
 
+struct SipHeaderView {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Non-owning parse of a response. Every view points into the caller's buffer,
+// which must outlive this struct. Headers past kMaxHeaders are skipped for the
+// flat array but the common ones below are still captured.
+struct SipResponseView {
+    static const size_t kMaxHeaders = 64;
+
+    int status = 0;
+    std::string_view reason;
+    std::string_view via;               // topmost Via header line
+    std::string_view call_id;
+    std::string_view cseq;
+    std::string_view authenticate;      // WWW-Authenticate, or Proxy-Authenticate on 407
+    std::string_view body;
+    SipHeaderView headers[kMaxHeaders];
+    size_t header_count = 0;
+
+    // Case-insensitive lookup of the first header called `name` (lowercase).
+    std::string_view header(std::string_view name) const;
+    // The same, falling back to the compact form ("f" for "from").
+    std::string_view header(std::string_view name, std::string_view compact) const;
+};
+
+// Non-owning parse of a request, for the responder side. Views point into the
+// caller's buffer like SipResponseView's. Every Via line is kept, in order,
+// since a response has to echo them all; lines past kMaxVias are dropped.
+struct SipRequestView {
+    static const size_t kMaxVias = 16;
+
+    std::string_view method;
+    std::string_view uri;
+    std::string_view vias[kMaxVias];
+    size_t via_count = 0;
+    std::string_view from;
+    std::string_view to;
+    std::string_view call_id;
+    std::string_view cseq;
+    std::string_view contact;
+    std::string_view expires;
+    std::string_view authorization;     // Authorization or Proxy-Authorization
+};
+
+// Fields of an Authorization / Proxy-Authorization value (server side).
+struct SipDigestCredentials {
+    bool ok = false;                    // username, realm, nonce, uri and response present
+    std::string username;
+    std::string realm;
+    std::string nonce;
+    std::string uri;
+    std::string response;
+    std::string qop;
+    std::string nc;
+    std::string cnonce;
+    std::string opaque;
+};
+
 struct SipProbeResult {
     bool ok = false;
     int status = 0;
-    int rtt_ms = -1;
+    int64_t rtt_ns = -1;     // first transmission -> final answer, retransmit waits included
+    bool kernel_ts = false;  // rtt_ns measured with kernel socket timestamps
+    int retransmits = 0;
+    int64_t dns_us = 0;      // name lookup, kept out of rtt_ns
     std::string peer_ip;
     uint16_t peer_port = 0;
     std::string note;
 };
 
 SipResponse parse_sip_response(const std::string& raw);
+// Allocation-free parser for hot paths. False if the status line is malformed.
+bool parse_sip_response_view(const char* data, size_t len, SipResponseView* out);
+// Reads WWW-Authenticate, or Proxy-Authenticate when the response is a 407.
 SipAuthChallenge parse_www_authenticate_digest(const SipResponse& resp);
+SipAuthChallenge parse_www_authenticate_digest(const SipResponseView& resp);
+// False if the request line is malformed.
+bool parse_sip_request_view(const char* data, size_t len, SipRequestView* out);
+SipDigestCredentials parse_digest_credentials(std::string_view value);
+// The response= a client holding HA1 = MD5(user:realm:pass) should have sent
+// for `c` on `method`, in lowercase hex.
+std::string digest_expected_response(std::string_view method, const SipDigestCredentials& c,
+                                     const std::string& ha1_hex);
+
+// Transaction-matching keys of a response (RFC 3261 17.1.3): the branch of
+// the topmost Via and the Call-ID. Compact header forms are accepted.
+std::string sip_top_via_branch(const SipResponse& resp);
+std::string sip_call_id(const SipResponse& resp);
+std::string_view sip_top_via_branch(const SipResponseView& resp);
+// The branch of the first Via in a Via value (a request's vias[0], say).
+std::string_view sip_via_branch(std::string_view via);
+// The tag= parameter of a From or To value, "" when there is none.
+std::string_view sip_header_tag(std::string_view value);
+// The method of a CSeq value ("314159 INVITE" -> "INVITE"), "" when absent.
+std::string_view sip_cseq_method(std::string_view cseq);
+// s without leading SP/HT and trailing SP/HT/CR/LF.
+std::string_view sip_trim(std::string_view s);
 
 std::string make_sip_options(
     const std::string& host, uint16_t port,
@@ -39,7 +135,8 @@ std::string make_sip_options(
     const std::string& call_id,
     int cseq,
     const std::string& branch,
-    const std::string& local_tag
+    const std::string& local_tag,
+    SipTransport transport = SipTransport::Udp
 );
 
 std::string make_sip_register(
@@ -52,7 +149,9 @@ std::string make_sip_register(
     const std::string& branch,
     const std::string& local_tag,
     int expires_seconds,
-    const std::string& authorization_header // "" if none
+    const std::string& authorization_header, // "" if none
+    bool proxy_authorization = false,        // answer a 407 with Proxy-Authorization
+    SipTransport transport = SipTransport::Udp
 );
 
 std::string build_digest_authorization(
@@ -64,3 +163,34 @@ std::string build_digest_authorization(
     const std::string& cnonce,
     const std::string& nc_hex8
 );
+
+// As build_digest_authorization, with HA1 = MD5(username:realm:password)
+// supplied precomputed (see DigestAuthCache).
+std::string build_digest_authorization_ha1(
+    const std::string& method,
+    const std::string& uri,
+    const std::string& username,
+    const std::string& ha1_hex,
+    const SipAuthChallenge& ch,
+    const std::string& cnonce,
+    const std::string& nc_hex8
+);
+
+// One entry of a batched digest computation. Views and the challenge must
+// outlive the call.
+struct SipDigestInput {
+    std::string_view method;
+    std::string_view uri;
+    std::string_view username;
+    std::string_view password;
+    const SipAuthChallenge* ch = nullptr;
+    std::string_view cnonce;
+    std::string_view nc_hex8;
+    // Precomputed HA1 (lowercase hex, as DigestAuthCache keeps it); when set,
+    // password is not used and the entry skips the first hash.
+    std::string_view ha1_hex;
+};
+
+// Same result as calling build_digest_authorization for each entry, with the
+// MD5 work done lane-parallel via md5_batch. Writes out[0..n).
+void build_digest_authorization_batch(const SipDigestInput* in, size_t n, std::string* out);
@@ -0,0 +1,131 @@
+#include "sip_id.h"
+#include <atomic>
+#include <cstring>
+#include <random>
+
+namespace {
+
+inline uint64_t mix64(uint64_t z) {
+    // splitmix64 finalizer; a bijection on 64-bit values.
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+struct IdKeys {
+    uint64_t key;
+    std::atomic<uint64_t> next_thread{0};
+    IdKeys() {
+        std::random_device rd;
+        key = ((uint64_t)rd() << 32) ^ rd();
+    }
+};
+
+IdKeys& keys() {
+    static IdKeys k;
+    return k;
+}
+
+struct IdState {
+    uint64_t key;
+    uint64_t thread_bits;   // thread index << 40
+    uint64_t counter = 0;
+    uint64_t rng;
+    IdState() {
+        IdKeys& k = keys();
+        key = k.key;
+        uint64_t t = k.next_thread.fetch_add(1, std::memory_order_relaxed);
+        thread_bits = t << 40;
+        std::random_device rd;
+        rng = mix64(k.key ^ (t * 0x9e3779b97f4a7c15ull)) ^ (((uint64_t)rd() << 32) | rd());
+    }
+};
+
+thread_local IdState t_ids;
+
+// Two hex digits per byte value, built at compile time so the ID helpers are
+// safe to call from other translation units' static initializers.
+struct HexPairs {
+    char p[256][2] = {};
+    constexpr HexPairs() {
+        constexpr char h[] = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) { p[i][0] = h[i >> 4]; p[i][1] = h[i & 15]; }
+    }
+};
+constexpr HexPairs kHex;
+
+inline void hex16(uint64_t v, char* out) {
+    for (int i = 7; i >= 0; i--) {
+        std::memcpy(out + i * 2, kHex.p[v & 0xff], 2);
+        v >>= 8;
+    }
+}
+
+inline uint64_t next_rand(IdState& s) {
+    s.rng += 0x9e3779b97f4a7c15ull;
+    return mix64(s.rng);
+}
+
+// 2^40 IDs per thread before the counter would reach the thread bits.
+inline uint64_t next_unique(IdState& s) {
+    return mix64((s.thread_bits | (s.counter++ & ((1ull << 40) - 1))) ^ s.key);
+}
+
+} // namespace
+
+uint64_t sip_id_rand64() {
+    return next_rand(t_ids);
+}
+
+void sip_id_unique(char* out) {
+    IdState& s = t_ids;
+    hex16(next_unique(s), out);
+    hex16(next_rand(s), out + 16);
+}
+
+void sip_id_branch(char* out) {
+    std::memcpy(out, "z9hG4bK", 7);
+    sip_id_unique(out + 7);
+}
+
+void sip_id_tag(char* out) {
+    hex16(next_unique(t_ids), out);
+}
+
+void sip_id_random(char* out, size_t nhex) {
+    IdState& s = t_ids;
+    char buf[16];
+    while (nhex >= 16) {
+        hex16(next_rand(s), out);
+        out += 16;
+        nhex -= 16;
+    }
+    if (nhex) {
+        hex16(next_rand(s), buf);
+        std::memcpy(out, buf, nhex);
+    }
+}
+
+std::string sip_new_branch() {
+    char b[kSipBranchLen];
+    sip_id_branch(b);
+    return std::string(b, sizeof(b));
+}
+
+std::string sip_new_tag() {
+    char b[kSipTagHex];
+    sip_id_tag(b);
+    return std::string(b, sizeof(b));
+}
+
+std::string sip_new_call_id() {
+    char b[kSipIdHex];
+    sip_id_unique(b);
+    return std::string(b, sizeof(b)) + "@frogklan";
+}
+
+std::string sip_new_cnonce() {
+    char b[16];
+    sip_id_random(b, sizeof(b));
+    return std::string(b, sizeof(b));
+}
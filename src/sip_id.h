@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Identifiers for Via branch, From tag, Call-ID and cnonce, written as
+// lowercase hex straight into caller buffers. Each thread owns a splitmix64
+// generator seeded once, so generating an ID takes no lock, no syscall and no
+// allocation.
+//
+// "Unique" IDs are distinct across every thread of the process by
+// construction, not by chance: their first 16 hex digits are a bijective mix
+// of (thread index, per-thread counter) under a per-process key. The rest is
+// PRNG output, which keeps separate runs from repeating each other.
+
+const size_t kSipIdHex = 32;                      // sip_id_unique()
+const size_t kSipBranchLen = 7 + kSipIdHex;        // "z9hG4bK" + unique id
+const size_t kSipTagHex = 16;                      // sip_id_tag()
+
+// Writes kSipIdHex chars.
+void sip_id_unique(char* out);
+// Writes kSipBranchLen chars: the RFC 3261 magic cookie, then a unique id.
+void sip_id_branch(char* out);
+// Writes kSipTagHex chars, unique within the process.
+void sip_id_tag(char* out);
+// Writes nhex chars of PRNG output (cnonces and the like; not guaranteed unique).
+void sip_id_random(char* out, size_t nhex);
+// Next value of the calling thread's generator.
+uint64_t sip_id_rand64();
+
+// Convenience forms for paths that keep the ID in a std::string anyway.
+std::string sip_new_branch();
+std::string sip_new_tag();
+std::string sip_new_call_id();                     // unique id + "@frogklan"
+std::string sip_new_cnonce();                      // 16 random hex chars
@@ -0,0 +1,150 @@
+#include "sip_template.h"
+#include <charconv>
+
+void SipRequestTemplate::lit(const std::string& s) {
+    // Adjacent literals are merged so render() copies each run once.
+    if (!pieces_.empty() && pieces_.back().slot == Slot::Literal) {
+        pieces_.back().len += (uint32_t)s.size();
+    } else {
+        pieces_.push_back(Piece{Slot::Literal, (uint32_t)text_.size(), (uint32_t)s.size()});
+    }
+    text_ += s;
+}
+
+void SipRequestTemplate::slot(Slot s) {
+    pieces_.push_back(Piece{s, 0, 0});
+}
+
+static std::string req_uri(const std::string& host, uint16_t port) {
+    std::string u = "sip:" + host;
+    if (port != 5060) u += ":" + std::to_string(port);
+    return u;
+}
+
+SipRequestTemplate SipRequestTemplate::options(const std::string& host, uint16_t port,
+                                               const std::string& from_uri, const std::string& to_uri,
+                                               const std::string& user_agent, SipTransport transport) {
+    SipRequestTemplate t;
+    t.lit("OPTIONS " + req_uri(host, port) + " SIP/2.0\r\n");
+    t.lit(std::string("Via: SIP/2.0/") + sip_transport_name(transport) + " " + host + ":" + std::to_string(port) + ";branch=");
+    t.slot(Slot::Branch);
+    t.lit("\r\nMax-Forwards: 70\r\n");
+    t.lit("From: <" + from_uri + ">;tag=");
+    t.slot(Slot::Tag);
+    t.lit("\r\nTo: <" + to_uri + ">\r\n");
+    t.lit("Call-ID: ");
+    t.slot(Slot::CallId);
+    t.lit("\r\nCSeq: ");
+    t.slot(Slot::CSeq);
+    t.lit(" OPTIONS\r\n");
+    t.lit("Contact: <" + from_uri + ">\r\n");
+    t.lit("User-Agent: " + user_agent + "\r\n");
+    t.lit("Accept: application/sdp\r\n");
+    t.lit("Content-Length: 0\r\n\r\n");
+    return t;
+}
+
+SipRequestTemplate SipRequestTemplate::reg(const std::string& host, uint16_t port,
+                                           const std::string& aor_uri, const std::string& contact_uri,
+                                           const std::string& user_agent, int expires_seconds,
+                                           SipTransport transport) {
+    SipRequestTemplate t;
+    auto aor = [&]{ if (aor_uri.empty()) t.slot(Slot::Aor); else t.lit(aor_uri); };
+
+    t.lit("REGISTER " + req_uri(host, port) + " SIP/2.0\r\n");
+    t.lit(std::string("Via: SIP/2.0/") + sip_transport_name(transport) + " " + host + ":" + std::to_string(port) + ";branch=");
+    t.slot(Slot::Branch);
+    t.lit("\r\nMax-Forwards: 70\r\n");
+    t.lit("From: <"); aor(); t.lit(">;tag=");
+    t.slot(Slot::Tag);
+    t.lit("\r\nTo: <"); aor(); t.lit(">\r\n");
+    t.lit("Call-ID: ");
+    t.slot(Slot::CallId);
+    t.lit("\r\nCSeq: ");
+    t.slot(Slot::CSeq);
+    t.lit(" REGISTER\r\n");
+    t.lit("Contact: <");
+    if (contact_uri.empty()) t.slot(Slot::Contact); else t.lit(contact_uri);
+    t.lit(">\r\n");
+    t.lit("Expires: " + std::to_string(expires_seconds) + "\r\n");
+    t.slot(Slot::Authorization);
+    t.lit("User-Agent: " + user_agent + "\r\n");
+    t.lit("Content-Length: 0\r\n\r\n");
+    return t;
+}
+
+SipRequestTemplate SipRequestTemplate::invite(const std::string& host, uint16_t port,
+                                              const std::string& from_uri, const std::string& to_uri,
+                                              const std::string& user_agent, const std::string& sdp,
+                                              SipTransport transport) {
+    SipRequestTemplate t;
+    t.lit("INVITE " + req_uri(host, port) + " SIP/2.0\r\n");
+    t.lit(std::string("Via: SIP/2.0/") + sip_transport_name(transport) + " " + host + ":" + std::to_string(port) + ";branch=");
+    t.slot(Slot::Branch);
+    t.lit("\r\nMax-Forwards: 70\r\n");
+    t.lit("From: <" + from_uri + ">;tag=");
+    t.slot(Slot::Tag);
+    t.lit("\r\nTo: <" + to_uri + ">\r\n");
+    t.lit("Call-ID: ");
+    t.slot(Slot::CallId);
+    t.lit("\r\nCSeq: ");
+    t.slot(Slot::CSeq);
+    t.lit(" INVITE\r\n");
+    t.lit("Contact: <" + from_uri + ">\r\n");
+    t.lit("User-Agent: " + user_agent + "\r\n");
+    t.lit("Content-Type: application/sdp\r\n");
+    t.lit("Content-Length: " + std::to_string(sdp.size()) + "\r\n\r\n");
+    t.lit(sdp);
+    return t;
+}
+
+SipRequestTemplate SipRequestTemplate::in_dialog(const std::string& method, const std::string& host, uint16_t port,
+                                                 const std::string& from_uri, const std::string& to_uri,
+                                                 const std::string& user_agent, SipTransport transport) {
+    SipRequestTemplate t;
+    t.lit(method + " " + req_uri(host, port) + " SIP/2.0\r\n");
+    t.lit(std::string("Via: SIP/2.0/") + sip_transport_name(transport) + " " + host + ":" + std::to_string(port) + ";branch=");
+    t.slot(Slot::Branch);
+    t.lit("\r\nMax-Forwards: 70\r\n");
+    t.lit("From: <" + from_uri + ">;tag=");
+    t.slot(Slot::Tag);
+    t.lit("\r\nTo: <" + to_uri + ">;tag=");
+    t.slot(Slot::ToTag);
+    t.lit("\r\nCall-ID: ");
+    t.slot(Slot::CallId);
+    t.lit("\r\nCSeq: ");
+    t.slot(Slot::CSeq);
+    t.lit(" " + method + "\r\n");
+    t.lit("User-Agent: " + user_agent + "\r\n");
+    t.lit("Content-Length: 0\r\n\r\n");
+    return t;
+}
+
+size_t SipRequestTemplate::render(const Fields& f, std::string& out) const {
+    out.clear();
+    for (const auto& p : pieces_) {
+        switch (p.slot) {
+            case Slot::Literal: out.append(text_.data() + p.off, p.len); break;
+            case Slot::Branch:  out.append(f.branch.data(), f.branch.size()); break;
+            case Slot::Tag:     out.append(f.tag.data(), f.tag.size()); break;
+            case Slot::CallId:  out.append(f.call_id.data(), f.call_id.size()); break;
+            case Slot::Aor:     out.append(f.aor.data(), f.aor.size()); break;
+            case Slot::Contact: out.append(f.contact.data(), f.contact.size()); break;
+            case Slot::ToTag:   out.append(f.to_tag.data(), f.to_tag.size()); break;
+            case Slot::CSeq: {
+                char num[16];
+                auto r = std::to_chars(num, num + sizeof(num), f.cseq);
+                out.append(num, (size_t)(r.ptr - num));
+                break;
+            }
+            case Slot::Authorization:
+                if (!f.authorization.empty()) {
+                    out.append(f.proxy_authorization ? "Proxy-Authorization: " : "Authorization: ");
+                    out.append(f.authorization.data(), f.authorization.size());
+                    out.append("\r\n");
+                }
+                break;
+        }
+    }
+    return out.size();
+}
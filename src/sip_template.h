@@ -0,0 +1,69 @@
+#pragma once
+#include "sip.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A SIP request formatted once per target. The constant text (request line,
+// Via host, From/To, User-Agent, ...) is stored pre-rendered and render()
+// only copies it around the per-transaction slots, so building a request is
+// a handful of memcpy calls into a reused buffer. Output is byte-identical to
+// make_sip_options / make_sip_register given the same values.
+class SipRequestTemplate {
+public:
+    struct Fields {
+        std::string_view branch;
+        std::string_view tag;
+        std::string_view call_id;
+        int cseq = 1;
+        std::string_view authorization;   // "" -> header omitted
+        bool proxy_authorization = false;
+        std::string_view aor;             // REGISTER templates built without an AOR
+        std::string_view contact;         // REGISTER templates built without a Contact
+        std::string_view to_tag;          // in_dialog templates: the peer's tag
+    };
+
+    static SipRequestTemplate options(const std::string& host, uint16_t port,
+                                      const std::string& from_uri, const std::string& to_uri,
+                                      const std::string& user_agent,
+                                      SipTransport transport = SipTransport::Udp);
+
+    // Pass an empty aor_uri / contact_uri to leave them as per-render slots,
+    // e.g. when one template serves many accounts.
+    static SipRequestTemplate reg(const std::string& host, uint16_t port,
+                                  const std::string& aor_uri, const std::string& contact_uri,
+                                  const std::string& user_agent, int expires_seconds,
+                                  SipTransport transport = SipTransport::Udp);
+
+    // INVITE carrying a fixed SDP offer; Contact is from_uri.
+    static SipRequestTemplate invite(const std::string& host, uint16_t port,
+                                     const std::string& from_uri, const std::string& to_uri,
+                                     const std::string& user_agent, const std::string& sdp,
+                                     SipTransport transport = SipTransport::Udp);
+
+    // A bodyless request inside a dialog (ACK, BYE): To carries the peer's
+    // tag and the request URI stays the target's, as no route set is kept.
+    static SipRequestTemplate in_dialog(const std::string& method, const std::string& host, uint16_t port,
+                                        const std::string& from_uri, const std::string& to_uri,
+                                        const std::string& user_agent,
+                                        SipTransport transport = SipTransport::Udp);
+
+    // Clears `out` and writes the request into it; returns out.size(). Does
+    // not allocate once `out` has grown to the message size.
+    size_t render(const Fields& f, std::string& out) const;
+
+private:
+    enum class Slot : uint8_t { Literal, Branch, Tag, CallId, CSeq, Authorization, Aor, Contact, ToTag };
+    struct Piece {
+        Slot slot;
+        uint32_t off;
+        uint32_t len;
+    };
+
+    void lit(const std::string& s);
+    void slot(Slot s);
+
+    std::string text_;
+    std::vector<Piece> pieces_;
+};
@@ -0,0 +1,22 @@
+#include "sip_timers.h"
+
+int SipTimers::next_interval_ms(int prev_ms, bool invite) const {
+    int next = prev_ms * 2;
+    if (!invite && next > t2_ms) next = t2_ms;
+    return next;
+}
+
+uint64_t SipRetransmit::on_send(const SipTimers& t, uint64_t now_ms, bool invite) {
+    if (sent == 0) {
+        start_ms = now_ms;
+        interval_ms = t.t1_ms;
+    } else {
+        interval_ms = t.next_interval_ms(interval_ms, invite);
+    }
+    sent++;
+
+    const uint64_t deadline = start_ms + (uint64_t)t.transaction_timeout_ms();
+    const bool more = t.max_retransmits < 0 || sent - 1 < t.max_retransmits;
+    uint64_t at = more ? now_ms + (uint64_t)interval_ms : deadline;
+    return at < deadline ? at : deadline;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// RFC 3261 section 17.1 client transaction timers, in milliseconds. Requests
+// are retransmitted after T1, doubling each time (capped at T2 for
+// non-INVITE, Timer E; uncapped for INVITE, Timer A) until Timer F/B fires at
+// 64*T1.
+struct SipTimers {
+    int t1_ms = 500;
+    int t2_ms = 4000;
+    int timeout_ms = 0;           // Timer B/F; 0 -> 64*T1
+    int max_retransmits = -1;     // < 0 -> as many as fit before the timeout
+
+    int transaction_timeout_ms() const { return timeout_ms > 0 ? timeout_ms : 64 * t1_ms; }
+    int next_interval_ms(int prev_ms, bool invite) const;
+};
+
+// Retransmission state of one client transaction on an unreliable transport.
+struct SipRetransmit {
+    uint64_t start_ms = 0;        // first transmission
+    int interval_ms = 0;
+    int sent = 0;
+
+    // Records a transmission at now_ms and returns when the transaction's timer
+    // should next fire: the next retransmission or, once those run out, the
+    // final timeout.
+    uint64_t on_send(const SipTimers& t, uint64_t now_ms, bool invite = false);
+    bool expired(const SipTimers& t, uint64_t now_ms) const {
+        return sent > 0 && now_ms >= start_ms + (uint64_t)t.transaction_timeout_ms();
+    }
+    int retransmits() const { return sent > 0 ? sent - 1 : 0; }
+};
@@ -0,0 +1,453 @@
+#include "storm.h"
+#include "app.h"
+#include "digest_cache.h"
+#include "net.h"
+#include "resolver.h"
+#include "sip.h"
+#include "sip_id.h"
+#include "sip_template.h"
+#include "timer_wheel.h"
+#include "txn.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+bool load_storm_credentials(const std::string& path, std::vector<StormCredential>* out, std::string* err) {
+    std::ifstream f(path);
+    if (!f) { *err = "cannot open " + path; return false; }
+
+    std::string line;
+    int lineno = 0;
+    while (std::getline(f, line)) {
+        lineno++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::vector<std::string> cols;
+        std::istringstream ls(line);
+        std::string c;
+        while (std::getline(ls, c, ',')) cols.push_back(c);
+        if (lineno == 1 && !cols.empty() && cols[0] == "aor") continue;
+        if (cols.size() != 4) {
+            *err = path + ":" + std::to_string(lineno) + ": expected aor,contact,user,password";
+            return false;
+        }
+        out->push_back(StormCredential{cols[0], cols[1], cols[2], cols[3]});
+    }
+    return true;
+}
+
+namespace {
+
+enum class RegPhase : uint8_t { Queued, Initial, Authed, Done };
+
+struct RegSlot {
+    uint32_t row = 0;
+    RegPhase phase = RegPhase::Queued;
+    SipRetransmit retx;        // Timer E/F state of the current leg
+    TimerWheel::TimerId timer = TimerWheel::kNoTimer;
+    int cseq = 1;
+    bool preemptive = false;
+    std::string call_id;
+    std::string branch;
+    std::string msg;
+    Clock::time_point due;
+    Clock::time_point leg_sent;    // first transmission of the current leg
+};
+
+struct Challenged {
+    uint32_t idx;
+    SipAuthChallenge ch;
+    bool proxy;
+};
+
+void storm_worker(const std::vector<StormCredential>& creds, std::vector<uint32_t> rows,
+                  UdpAddr dst, const StormConfig& cfg, double rate,
+                  Clock::time_point start, StormResult* out) {
+    StormResult& res = *out;
+
+    UdpSocket sock;
+    UdpPoller poller;
+    if (!sock.open(8 << 20) || !poller.add(sock)) { res.error = "Failed to open UDP socket"; return; }
+
+    const std::string tag = sip_new_tag();
+    const std::string uri = "sip:" + cfg.host + (cfg.port != 5060 ? ":" + std::to_string(cfg.port) : "");
+    const auto tpl = SipRequestTemplate::reg(cfg.host, cfg.port, "", "", cfg.user_agent, cfg.expires);
+    const std::chrono::duration<double> interval(1.0 / rate);
+
+    std::vector<RegSlot> slots(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) slots[i].row = rows[i];
+
+    TxnTable txns;
+    txns.reserve((size_t)cfg.max_inflight * 2);
+    DigestAuthCache auth_cache;
+    std::string preauth;
+    bool preauth_proxy = false;
+    std::string cnonce(16, '0');
+
+    // Each leg's retransmissions and final timeout run on one wheel, in ms
+    // since `base`.
+    const auto base = Clock::now();
+    auto ms_at = [&](Clock::time_point t) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(t - base).count();
+    };
+    TimerWheel wheel(0);
+    wheel.reserve((size_t)cfg.max_inflight);
+    std::vector<uint64_t> fired;
+
+    auto transmit = [&](uint32_t idx) -> bool {
+        auto& s = slots[idx];
+        auto t = Clock::now();
+        int rc = sock.send_to(dst, s.msg.data(), s.msg.size());
+        if (rc == 0) return false;
+        if (rc < 0) res.send_errors++;
+        if (s.retx.sent == 0) s.leg_sent = t;
+        s.timer = wheel.schedule(s.retx.on_send(cfg.timers, ms_at(t)), idx);
+        return true;
+    };
+
+    // IDs are written into the slot's existing buffers, so after warm-up a
+    // new transaction allocates nothing for them.
+    char idbuf[kSipBranchLen];
+    auto new_branch = [&](RegSlot& s) {
+        sip_id_branch(idbuf);
+        s.branch.assign(idbuf, kSipBranchLen);
+    };
+
+    size_t next = 0;
+    size_t inflight = 0;
+    UdpBatch io;
+    std::vector<int> ready;
+    SipResponseView resp;
+    std::vector<Challenged> challenged;
+    std::vector<SipDigestInput> digest_in;
+    std::vector<std::string> cnonces;
+    std::vector<std::string> ncs;
+    std::vector<std::string> auths;
+
+    auto finish = [&](uint32_t idx) {
+        auto& s = slots[idx];
+        s.phase = RegPhase::Done;
+        wheel.cancel(s.timer);
+        txns.remove(s.branch);
+        inflight--;
+    };
+
+    while (next < slots.size() || inflight > 0) {
+        auto now = Clock::now();
+        bool send_blocked = false;
+        while (next < slots.size() && inflight < (size_t)cfg.max_inflight) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(interval * (double)next);
+            if (due > now) break;
+            auto& s = slots[next];
+            const auto& c = creds[s.row];
+            s.due = due;
+            sip_id_unique(idbuf);
+            s.call_id.assign(idbuf, kSipIdHex).append("@frogklan");
+            new_branch(s);
+            SipRequestTemplate::Fields f;
+            f.branch = s.branch;
+            f.tag = tag;
+            f.call_id = s.call_id;
+            f.cseq = s.cseq;
+            f.aor = c.aor;
+            f.contact = c.contact;
+            // Once this worker has seen a challenge, answer it up front with
+            // the next nonce count instead of waiting for our own 401.
+            sip_id_random(&cnonce[0], cnonce.size());
+            s.preemptive = cfg.preemptive &&
+                auth_cache.authorize("REGISTER", uri, c.user, c.pass, cnonce, &preauth, &preauth_proxy);
+            if (s.preemptive) {
+                f.authorization = preauth;
+                f.proxy_authorization = preauth_proxy;
+            }
+            tpl.render(f, s.msg);
+            if (!transmit((uint32_t)next)) { send_blocked = true; break; }
+            if (s.preemptive) res.preemptive++;
+            s.phase = RegPhase::Initial;
+            txns.add(s.branch, s.call_id, (uint32_t)next);
+            res.attempted++;
+            inflight++;
+            next++;
+        }
+
+        auto wake = Clock::time_point::max();
+        if (next < slots.size() && inflight < (size_t)cfg.max_inflight) {
+            wake = start + std::chrono::duration_cast<Clock::duration>(interval * (double)next);
+        }
+        int wait_ms = send_blocked ? 1 : (int)wheel.next_delay_ms(1000);
+        if (!send_blocked && wake != Clock::time_point::max()) {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count();
+            if (ms < wait_ms) wait_ms = ms < 0 ? 0 : (int)ms;
+        }
+        if (poller.wait(wait_ms, ready) < 0) { res.error = "poll failed"; return; }
+
+        if (!ready.empty()) {
+            int got;
+            while ((got = io.recv(sock)) > 0) {
+                auto t = Clock::now();
+                for (int k = 0; k < got; k++) {
+                    const auto& d = io.at(k);
+                    if (!parse_sip_response_view(d.data, d.len, &resp)) continue;
+                    uint32_t idx;
+                    if (!txns.match(sip_top_via_branch(resp), resp.call_id, &idx)) continue;
+                    if (resp.status < 200) continue;
+                    auto& s = slots[idx];
+
+                    if (s.phase == RegPhase::Initial && (resp.status == 401 || resp.status == 407)) {
+                        res.challenge_rtt.record(us_between(s.leg_sent, t));
+                        if (s.preemptive) res.rechallenged++;
+                        auto ch = parse_www_authenticate_digest(resp);
+                        if (!ch.ok) {
+                            res.bad_challenge++;
+                            finish(idx);
+                            continue;
+                        }
+                        // Answered below in one batch with the rest of this pass's
+                        // challenges; stop matching retransmitted 401s meanwhile.
+                        txns.remove(s.branch);
+                        wheel.cancel(s.timer);
+                        s.timer = TimerWheel::kNoTimer;
+                        challenged.push_back(Challenged{idx, std::move(ch), resp.status == 407});
+                        continue;
+                    }
+
+                    res.final_latency.record(us_between(s.due, t));
+                    if (resp.status < 300) res.registered++;
+                    else res.rejected++;
+                    if (resp.status == 503) res.unavailable++;
+                    finish(idx);
+                }
+            }
+        }
+
+        if (!challenged.empty()) {
+            const size_t n = challenged.size();
+            digest_in.resize(n);
+            cnonces.resize(n);
+            ncs.resize(n);
+            auths.resize(n);
+            for (size_t k = 0; k < n; k++) {
+                const auto& c = creds[slots[challenged[k].idx].row];
+                cnonces[k].resize(16);
+                sip_id_random(&cnonces[k][0], 16);
+                // nc comes from the cache, so it never repeats on a nonce
+                // shared by several challenges or reused preemptively later.
+                ncs[k] = auth_cache.next_nc(challenged[k].ch.nonce);
+                // HA1 is cached per (realm, user): only HA2 and the response
+                // are hashed per registration.
+                digest_in[k] = SipDigestInput{"REGISTER", uri, c.user, c.pass, &challenged[k].ch,
+                                              cnonces[k], ncs[k],
+                                              auth_cache.ha1(challenged[k].ch.realm, c.user, c.pass)};
+            }
+            build_digest_authorization_batch(digest_in.data(), n, auths.data());
+            if (cfg.preemptive) auth_cache.remember(challenged.back().ch, challenged.back().proxy);
+
+            auto t = Clock::now();
+            for (size_t k = 0; k < n; k++) {
+                uint32_t idx = challenged[k].idx;
+                auto& s = slots[idx];
+                const auto& c = creds[s.row];
+                new_branch(s);
+                s.cseq++;
+                SipRequestTemplate::Fields f;
+                f.branch = s.branch;
+                f.tag = tag;
+                f.call_id = s.call_id;
+                f.cseq = s.cseq;
+                f.aor = c.aor;
+                f.contact = c.contact;
+                f.authorization = auths[k];
+                f.proxy_authorization = challenged[k].proxy;
+                tpl.render(f, s.msg);
+                txns.add(s.branch, s.call_id, idx);
+                s.phase = RegPhase::Authed;
+                s.retx = SipRetransmit{};
+                // A full socket here is rare; the timer path sends it instead.
+                if (!transmit(idx)) s.timer = wheel.schedule(ms_at(t), idx);
+            }
+            challenged.clear();
+        }
+
+        fired.clear();
+        const uint64_t now_ms = ms_at(Clock::now());
+        wheel.advance(now_ms, fired);
+        for (uint64_t cookie : fired) {
+            uint32_t idx = (uint32_t)cookie;
+            auto& s = slots[idx];
+            s.timer = TimerWheel::kNoTimer;
+            if (s.phase == RegPhase::Done) continue;
+            if (s.retx.expired(cfg.timers, now_ms)) {
+                res.timeouts++;
+                finish(idx);
+            } else if (!transmit(idx)) {
+                s.timer = wheel.schedule(now_ms + 1, idx); // socket full; next tick
+            }
+        }
+    }
+    res.ok = true;
+}
+
+} // namespace
+
+StormResult run_storm(const std::vector<StormCredential>& creds, const StormConfig& cfg) {
+    StormResult res;
+    if (cfg.rate <= 0 || cfg.workers < 1) { res.error = "rate and workers must be positive"; return res; }
+
+    UdpAddr dst;
+    if (!resolver_cache().resolve(cfg.host, cfg.port, &dst, &res.dns_us)) { res.error = "DNS resolution failed"; return res; }
+
+    std::vector<std::vector<uint32_t>> shards(cfg.workers);
+    for (uint32_t i = 0; i < (uint32_t)creds.size(); i++) shards[i % cfg.workers].push_back(i);
+
+    std::vector<StormResult> parts(cfg.workers);
+    std::vector<std::thread> threads;
+    const double worker_rate = cfg.rate / cfg.workers;
+    const auto start = Clock::now() + std::chrono::milliseconds(20);
+    for (int w = 0; w < cfg.workers; w++) {
+        threads.emplace_back(storm_worker, std::cref(creds), std::move(shards[w]), dst,
+                             std::cref(cfg), worker_rate, start, &parts[w]);
+    }
+    for (auto& t : threads) t.join();
+    res.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto& p : parts) {
+        if (!p.ok && res.error.empty()) res.error = p.error;
+        res.attempted += p.attempted;
+        res.registered += p.registered;
+        res.rejected += p.rejected;
+        res.unavailable += p.unavailable;
+        res.timeouts += p.timeouts;
+        res.bad_challenge += p.bad_challenge;
+        res.send_errors += p.send_errors;
+        res.preemptive += p.preemptive;
+        res.rechallenged += p.rechallenged;
+        res.challenge_rtt.merge(p.challenge_rtt);
+        res.final_latency.merge(p.final_latency);
+    }
+    res.ok = res.error.empty();
+    return res;
+}
+
+static void storm_usage() {
+    std::cout <<
+"Usage:\n"
+"  frogklan storm --host <sip.host> [--port 5060] --creds <file.csv> [--rate 1000]\n"
+"                 [--workers 4] [--t1 500] [--t2 4000] [--timeout 64*T1] [--retries N]\n"
+"                 [--expires 300] [--inflight 10000] [--no-preemptive]\n"
+"\n"
+"CSV columns: aor,contact,user,password\n"
+"Retransmits follow RFC 3261 Timer E (T1 doubling to T2) until --timeout\n"
+"(Timer F); --retries caps the number of retransmissions.\n";
+}
+
+int cmd_storm(int argc, char** argv) {
+    StormConfig cfg;
+    std::string creds_path;
+
+    for (int i=2;i<argc;i++){
+        std::string a = argv[i];
+        auto need = [&](const char* name)->std::string{
+            if (i+1 >= argc) { std::cerr << "Missing value for " << name << "\n"; std::exit(2); }
+            return argv[++i];
+        };
+
+        if (a == "--host") cfg.host = need("--host");
+        else if (a == "--port") cfg.port = (uint16_t)std::stoi(need("--port"));
+        else if (a == "--creds") creds_path = need("--creds");
+        else if (a == "--rate") cfg.rate = std::stod(need("--rate"));
+        else if (a == "--workers") cfg.workers = std::stoi(need("--workers"));
+        else if (a == "--t1") cfg.timers.t1_ms = std::stoi(need("--t1"));
+        else if (a == "--t2") cfg.timers.t2_ms = std::stoi(need("--t2"));
+        else if (a == "--timeout") cfg.timers.timeout_ms = std::stoi(need("--timeout"));
+        else if (a == "--retries") cfg.timers.max_retransmits = std::stoi(need("--retries"));
+        else if (a == "--expires") cfg.expires = std::stoi(need("--expires"));
+        else if (a == "--inflight") cfg.max_inflight = std::stoi(need("--inflight"));
+        else if (a == "--no-preemptive") cfg.preemptive = false;
+        else {
+            std::cerr << "Unknown arg: " << a << "\n";
+            return 2;
+        }
+    }
+
+    if (cfg.host.empty() || creds_path.empty()) {
+        std::cerr << "Missing required args.\n";
+        storm_usage();
+        return 2;
+    }
+    if (cfg.timers.t1_ms <= 0 || cfg.timers.t2_ms < cfg.timers.t1_ms) {
+        std::cerr << "--t1 must be positive and --t2 at least --t1\n";
+        return 2;
+    }
+
+    std::vector<StormCredential> creds;
+    std::string err;
+    if (!load_storm_credentials(creds_path, &creds, &err)) {
+        std::cerr << err << "\n";
+        return 2;
+    }
+    if (creds.empty()) {
+        std::cerr << "No credentials in " << creds_path << "\n";
+        return 2;
+    }
+    cfg.user_agent = "frogklan-sip-qa/" + std::string(APP_VERSION);
+
+    fs::path data = app_data_dir();
+    fs::create_directories(data);
+    fs::path report_path = data / "sip_storm_report.json";
+
+    StormResult r = run_storm(creds, cfg);
+    if (!r.ok) {
+        std::cerr << "storm: " << r.error << "\n";
+        return 3;
+    }
+    double reg_per_s = r.elapsed_s > 0 ? (double)r.registered / r.elapsed_s : 0;
+
+    std::ofstream f(report_path);
+    f <<
+"{\n"
+"  \"app\": \"" << APP_NAME << "\",\n"
+"  \"version\": \"" << json_escape(APP_VERSION) << "\",\n"
+"  \"os\": \"" << json_escape(os_name()) << "\",\n"
+"  \"target\": {\"host\": \"" << json_escape(cfg.host) << "\", \"port\": " << cfg.port << "},\n"
+"  \"workers\": " << cfg.workers << ",\n"
+"  \"rate_target\": " << cfg.rate << ",\n"
+"  \"timers\": {\"t1_ms\": " << cfg.timers.t1_ms << ", \"t2_ms\": " << cfg.timers.t2_ms
+    << ", \"timeout_ms\": " << cfg.timers.transaction_timeout_ms() << "},\n"
+"  \"dns_us\": " << r.dns_us << ",\n"
+"  \"elapsed_s\": " << r.elapsed_s << ",\n"
+"  \"registrations_per_s\": " << reg_per_s << ",\n"
+"  \"attempted\": " << r.attempted << ",\n"
+"  \"registered\": " << r.registered << ",\n"
+"  \"rejected\": " << r.rejected << ",\n"
+"  \"unavailable\": " << r.unavailable << ",\n"
+"  \"timeouts\": " << r.timeouts << ",\n"
+"  \"bad_challenge\": " << r.bad_challenge << ",\n"
+"  \"send_errors\": " << r.send_errors << ",\n"
+"  \"preemptive\": " << r.preemptive << ",\n"
+"  \"rechallenged\": " << r.rechallenged << ",\n"
+"  \"challenge_rtt_us\": ";
+    json_hist(f, r.challenge_rtt);
+    f << ",\n  \"final_latency_us\": ";
+    json_hist(f, r.final_latency);
+    f << "\n}\n";
+    f.close();
+
+    std::cout << "SIP storm report: " << report_path << "\n";
+    std::cout << "REGISTER storm: " << r.registered << "/" << creds.size() << " registered in "
+              << r.elapsed_s << " s (" << reg_per_s << " reg/s)\n";
+    std::cout << "rejected=" << r.rejected << " (503=" << r.unavailable << ") timeouts=" << r.timeouts
+              << " bad_challenge=" << r.bad_challenge << " send_errors=" << r.send_errors
+              << " preemptive=" << r.preemptive << " rechallenged=" << r.rechallenged << "\n";
+    print_hist(std::cout, "challenge_rtt_us", r.challenge_rtt);
+    print_hist(std::cout, "final_latency_us", r.final_latency);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "histogram.h"
+#include "sip_timers.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StormCredential {
+    std::string aor;
+    std::string contact;
+    std::string user;
+    std::string pass;
+};
+
+struct StormConfig {
+    std::string host;
+    uint16_t port = 5060;
+    std::string user_agent;
+    double rate = 1000.0;      // initial REGISTERs per second, across all workers
+    int workers = 4;
+    SipTimers timers;          // per leg: Timer E retransmits, Timer F gives up
+    int expires = 300;
+    int max_inflight = 10000;  // per worker
+    bool preemptive = true;    // reuse the worker's last challenge up front
+};
+
+struct StormResult {
+    bool ok = false;
+    std::string error;
+    int64_t dns_us = 0;            // target lookup, done before the clock starts
+    double elapsed_s = 0;
+    uint64_t attempted = 0;
+    uint64_t registered = 0;       // final 2xx
+    uint64_t rejected = 0;         // final non-2xx, including a second 401/407
+    uint64_t unavailable = 0;      // of those, 503
+    uint64_t timeouts = 0;
+    uint64_t bad_challenge = 0;    // 401/407 without a usable Digest challenge
+    uint64_t send_errors = 0;
+    uint64_t preemptive = 0;       // first REGISTER already carried credentials
+    uint64_t rechallenged = 0;     // ...but the cached nonce was refused
+    LatencyHistogram challenge_rtt;  // initial REGISTER -> 401/407, us
+    LatencyHistogram final_latency;  // scheduled start -> final response, us
+};
+
+// CSV rows: aor,contact,user,password. A header row starting with "aor" is skipped.
+bool load_storm_credentials(const std::string& path, std::vector<StormCredential>* out, std::string* err);
+
+// Registers every credential, spread over cfg.workers threads. Each worker
+// owns its socket and runs REGISTER -> 401/407 -> digest -> REGISTER for its
+// share of rows at rate / workers.
+StormResult run_storm(const std::vector<StormCredential>& creds, const StormConfig& cfg);
+
+int cmd_storm(int argc, char** argv);
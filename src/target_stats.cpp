@@ -0,0 +1,126 @@
+#include "target_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const double kGamma = 1.02 / 0.98;
+static const double kLogGamma = std::log(kGamma);
+
+int32_t LatencySketch::key_of(uint64_t us) {
+    if (us <= 1) return 0;
+    return (int32_t)std::ceil(std::log((double)us) / kLogGamma);
+}
+
+double LatencySketch::value_of(int32_t key) {
+    // Midpoint of (g^(k-1), g^k] in relative terms: within 2% of both ends.
+    return 2.0 * std::pow(kGamma, key) / (kGamma + 1.0);
+}
+
+// Moves the window to start at `base`; keys below it fold into the first bin.
+void LatencySketch::rebase(int32_t base) {
+    uint32_t moved[kBins] = {};
+    for (int32_t k = lo_; k <= hi_; k++) {
+        uint32_t c = bins_[k - base_];
+        if (!c) continue;
+        uint32_t& to = moved[std::max(k, base) - base];
+        to = to > UINT32_MAX - c ? UINT32_MAX : to + c;
+    }
+    if (lo_ < base) {
+        lo_ = base;
+        collapsed_ = true;
+    }
+    std::memcpy(bins_, moved, sizeof(bins_));
+    base_ = base;
+}
+
+void LatencySketch::add(int32_t key, uint64_t n, uint64_t lo, uint64_t hi, uint64_t sum) {
+    const int32_t span = (int32_t)kBins;
+    if (count_ == 0) {
+        // Room both ways before the first move.
+        base_ = key - span / 2;
+        lo_ = hi_ = key;
+    } else if (key >= base_ + span) {
+        rebase(key - span + 1);
+    } else if (key < base_) {
+        // Shift down while the top still fits; past that the value joins the
+        // lowest bin.
+        if (hi_ - key < span) rebase(std::max(hi_ - span + 1, key - span / 4));
+        if (key < base_) {
+            key = base_;
+            collapsed_ = true;
+        }
+    }
+    lo_ = std::min(lo_, key);
+    hi_ = std::max(hi_, key);
+    uint32_t& c = bins_[key - base_];
+    c = n > UINT32_MAX - c ? UINT32_MAX : c + (uint32_t)n;
+    count_ += n;
+    sum_ += sum;
+    if (lo < min_) min_ = lo;
+    if (hi > max_) max_ = hi;
+}
+
+void LatencySketch::merge(const LatencySketch& o) {
+    if (!o.count_) return;
+    // Highest bins first, so a merge that widens the range folds our low end
+    // (and then o's) rather than dropping o's tail into the top bin.
+    bool first = true;
+    for (int32_t k = o.hi_; k >= o.lo_; k--) {
+        uint32_t c = o.bins_[k - o.base_];
+        if (!c) continue;
+        // min, max and sum ride along with the first bin added.
+        if (first) add(k, c, o.min_, o.max_, o.sum_);
+        else add(k, c, UINT64_MAX, 0, 0);
+        first = false;
+    }
+    collapsed_ = collapsed_ || o.collapsed_;
+}
+
+uint64_t LatencySketch::percentile(double p) const {
+    if (count_ == 0) return 0;
+    if (p >= 100.0) return max_;
+    uint64_t want = (uint64_t)(p / 100.0 * (double)count_ + 0.5);
+    if (want < 1) want = 1;
+    uint64_t seen = 0;
+    for (int32_t k = lo_; k <= hi_; k++) {
+        seen += bins_[k - base_];
+        if (seen >= want) {
+            uint64_t v = (uint64_t)std::llround(value_of(k));
+            return std::min(std::max(v, min_), max_);
+        }
+    }
+    return max_;
+}
+
+void TargetStats::add_status(int status, uint64_t n) {
+    for (size_t i = 0; i < kCodes; i++) {
+        if (codes_[i] == status) { code_counts_[i] += n; return; }
+        if (codes_[i] == 0) {
+            codes_[i] = (uint16_t)status;
+            code_counts_[i] = n;
+            return;
+        }
+    }
+    other_codes_ += n;
+}
+
+void TargetStats::record_reply(int status, uint64_t rtt_us) {
+    rtt_.record(rtt_us);
+    add_status(status, 1);
+}
+
+void TargetStats::merge(const TargetStats& o) {
+    rtt_.merge(o.rtt_);
+    timeouts_ += o.timeouts_;
+    errors_ += o.errors_;
+    for (size_t i = 0; i < kCodes && o.codes_[i]; i++) add_status(o.codes_[i], o.code_counts_[i]);
+    other_codes_ += o.other_codes_;
+}
+
+uint64_t TargetStats::status_count(int status) const {
+    for (size_t i = 0; i < kCodes && codes_[i]; i++) {
+        if (codes_[i] == status) return code_counts_[i];
+    }
+    return 0;
+}
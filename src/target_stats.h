@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// DDSketch-style latency sketch in microseconds with a fixed footprint of
+// about 700 bytes. Bin k holds values in (g^(k-1), g^k] with g = 1.02/0.98,
+// so any percentile is reported within 2% of the recorded value it stands
+// for. The kBins bins cover a 600x range that follows the data; when a value
+// lands beyond it, the lowest bins are folded into one, so the tail stays
+// exact to 2% and only quantiles below 1/600 of the maximum lose resolution.
+// Sketches merge by adding bins, in any order, across threads or windows.
+class LatencySketch {
+public:
+    static const size_t kBins = 160;
+
+    void record(uint64_t us) { add(key_of(us), 1, us, us, us); }
+    void merge(const LatencySketch& o);
+    void reset() { *this = LatencySketch(); }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / (double)count_ : 0.0; }
+    // Within 2% of the smallest recorded value v such that p percent of
+    // samples are <= v.
+    uint64_t percentile(double p) const;
+    // True once low bins have been folded together.
+    bool collapsed() const { return collapsed_; }
+
+private:
+    static int32_t key_of(uint64_t us);
+    static double value_of(int32_t key);
+
+    void add(int32_t key, uint64_t n, uint64_t lo, uint64_t hi, uint64_t sum);
+    void rebase(int32_t base);
+
+    uint32_t bins_[kBins] = {};      // bins_[i] counts key base_ + i; saturates
+    int32_t base_ = 0;
+    int32_t lo_ = 0, hi_ = 0;        // lowest and highest key in use
+    bool collapsed_ = false;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+// Running totals for one target: the RTT sketch over answered probes, final
+// responses by status code, and the probes that got none. Fixed size, so a
+// table of 50k targets stays in the tens of megabytes, and mergeable like
+// the sketch it holds.
+class TargetStats {
+public:
+    // Distinct status codes kept apart; further codes are counted as other.
+    static const size_t kCodes = 8;
+
+    void record_reply(int status, uint64_t rtt_us);
+    void record_timeout() { timeouts_++; }
+    void record_error() { errors_++; }
+    void merge(const TargetStats& o);
+
+    const LatencySketch& rtt() const { return rtt_; }
+    uint64_t replies() const { return rtt_.count(); }
+    uint64_t timeouts() const { return timeouts_; }
+    uint64_t errors() const { return errors_; }   // send or DNS failures
+    // Codes in the order first seen; 0 past the last one in use.
+    int code(size_t i) const { return codes_[i]; }
+    uint64_t code_count(size_t i) const { return code_counts_[i]; }
+    uint64_t other_codes() const { return other_codes_; }
+    uint64_t status_count(int status) const;
+
+private:
+    void add_status(int status, uint64_t n);
+
+    LatencySketch rtt_;
+    uint64_t timeouts_ = 0;
+    uint64_t errors_ = 0;
+    uint16_t codes_[kCodes] = {};
+    uint64_t code_counts_[kCodes] = {};
+    uint64_t other_codes_ = 0;
+};
@@ -0,0 +1,248 @@
+#include "tcp_transport.h"
+#include "sip.h"
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const size_t kMaxBody = 16u << 20;
+
+bool is_ws(char c) { return c == ' ' || c == '\t'; }
+
+bool name_is(const char* b, const char* e, const char* lc) {
+    for (; b < e && *lc; b++, lc++) {
+        if ((char)(*b | 0x20) != *lc) return false;
+    }
+    return b == e && *lc == 0;
+}
+
+// Content-Length (or "l") in the header block [b, e); 0 when absent, as for
+// a bodyless message. False when the value is not a sane number.
+bool content_length(const char* b, const char* e, size_t* out) {
+    *out = 0;
+    const char* line = b;
+    while (line < e) {
+        const char* eol = line;
+        while (eol < e && *eol != '\r' && *eol != '\n') eol++;
+        const char* colon = line;
+        while (colon < eol && *colon != ':') colon++;
+        if (colon < eol && !is_ws(*line)) {
+            const char* ne = colon;
+            while (ne > line && is_ws(ne[-1])) ne--;
+            if (name_is(line, ne, "content-length") || name_is(line, ne, "l")) {
+                const char* v = colon + 1;
+                while (v < eol && is_ws(*v)) v++;
+                size_t n = 0;
+                const char* d = v;
+                for (; d < eol && *d >= '0' && *d <= '9'; d++) {
+                    n = n * 10 + (size_t)(*d - '0');
+                    if (n > kMaxBody) return false;
+                }
+                while (d < eol && is_ws(*d)) d++;
+                if (d == v || d != eol) return false;
+                *out = n;
+                return true;
+            }
+        }
+        line = eol;
+        while (line < e && (*line == '\r' || *line == '\n')) line++;
+    }
+    return true;
+}
+
+int64_t since_us(Clock::time_point t0) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+void SipStreamFramer::append(const char* data, size_t len) {
+    // Consumed bytes are dropped once they make up the larger part of the
+    // buffer, so compaction stays linear in what passes through.
+    if (head_ > 0 && (head_ == buf_.size() || head_ * 2 >= buf_.size())) {
+        buf_.erase(0, head_);
+        scan_ -= head_;
+        head_ = 0;
+    }
+    buf_.append(data, len);
+}
+
+bool SipStreamFramer::next(std::string_view* msg) {
+    if (broken_) return false;
+    if (need_ == 0) {
+        while (head_ < buf_.size() && (buf_[head_] == '\r' || buf_[head_] == '\n')) head_++;
+        if (scan_ < head_) scan_ = head_;
+        size_t from = scan_ >= head_ + 3 ? scan_ - 3 : head_;
+        size_t end = buf_.find("\r\n\r\n", from);
+        if (end == std::string::npos) {
+            scan_ = buf_.size();
+            if (buf_.size() - head_ > kMaxHeader) broken_ = true;
+            return false;
+        }
+        size_t body = 0;
+        if (end - head_ > kMaxHeader || !content_length(buf_.data() + head_, buf_.data() + end, &body)) {
+            broken_ = true;
+            return false;
+        }
+        need_ = end + 4 - head_ + body;
+    }
+    if (buf_.size() - head_ < need_) return false;
+    *msg = std::string_view(buf_.data() + head_, need_);
+    head_ += need_;
+    scan_ = head_;
+    need_ = 0;
+    return true;
+}
+
+void SipStreamFramer::reset() {
+    buf_.clear();
+    head_ = scan_ = need_ = 0;
+    broken_ = false;
+}
+
+bool SipTcpConnection::connect(const UdpAddr& dst, int timeout_ms, int64_t* connect_us) {
+    close();
+    auto t0 = Clock::now();
+    int fd = tcp_connect_nb(dst, timeout_ms);
+    if (connect_us) *connect_us = since_us(t0);
+    if (fd == -1) return false;
+    return adopt(fd, dst);
+}
+
+bool SipTcpConnection::adopt(int fd, const UdpAddr& peer) {
+    close();
+    if (!tcp_set_nonblocking(fd)) {
+        tcp_close(fd);
+        return false;
+    }
+    fd_ = fd;
+    peer_ = peer;
+    out_.clear();
+    out_off_ = 0;
+    in_.reset();
+    return true;
+}
+
+void SipTcpConnection::close() {
+    if (fd_ != -1) {
+        tcp_close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool SipTcpConnection::send(std::string_view msg) {
+    if (fd_ == -1) return false;
+    if (!want_write()) {
+        out_.clear();
+        out_off_ = 0;
+        // Nothing queued: try the socket first and keep only the remainder.
+        int n = tcp_write(fd_, msg.data(), msg.size());
+        if (n < 0) { close(); return false; }
+        msg.remove_prefix((size_t)n);
+        if (msg.empty()) return true;
+    }
+    out_.append(msg.data(), msg.size());
+    return flush();
+}
+
+bool SipTcpConnection::flush() {
+    if (fd_ == -1) return false;
+    while (want_write()) {
+        int n = tcp_write(fd_, out_.data() + out_off_, out_.size() - out_off_);
+        if (n < 0) { close(); return false; }
+        if (n == 0) break;
+        out_off_ += (size_t)n;
+    }
+    if (!want_write()) {
+        out_.clear();
+        out_off_ = 0;
+    }
+    return true;
+}
+
+bool SipTcpConnection::recv() {
+    if (fd_ == -1) return false;
+    char buf[16384];
+    for (;;) {
+        int n = tcp_read(fd_, buf, sizeof(buf));
+        if (n < 0) { close(); return false; }
+        if (n == 0) return true;
+        in_.append(buf, (size_t)n);
+        if ((size_t)n < sizeof(buf)) return true;
+    }
+}
+
+UdpReply SipTcpConnection::request(const std::string& msg, int timeout_ms) {
+    UdpReply rep;
+    std::string_view branch;
+    size_t b = msg.find(";branch=");
+    if (b != std::string::npos) {
+        b += 8;
+        size_t e = msg.find_first_of(";, \t\r\n", b);
+        branch = std::string_view(msg).substr(b, e == std::string::npos ? std::string::npos : e - b);
+    }
+
+    const auto t0 = Clock::now();
+    const auto deadline = t0 + std::chrono::milliseconds(timeout_ms);
+    if (!send(msg)) return rep;
+
+    std::vector<TcpWaitFd> w(1);
+    SipResponseView resp;
+    std::string_view m;
+    for (;;) {
+        while (in_.next(&m)) {
+            if (!parse_sip_response_view(m.data(), m.size(), &resp) || resp.status < 200 ||
+                sip_top_via_branch(resp) != branch) continue;
+            auto t = Clock::now();
+            rep.ok = true;
+            rep.data.assign(m.data(), m.size());
+            rep.peer_ip = udp_addr_ip(peer_);
+            rep.peer_port = peer_.port;
+            rep.elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - t0).count();
+            rep.rx_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+            return rep;
+        }
+        auto now = Clock::now();
+        if (fd_ == -1 || in_.broken() || now >= deadline) break;
+        w[0].fd = fd_;
+        w[0].want_write = want_write();
+        int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        if (tcp_wait(w, ms < 1 ? 1 : ms) < 0) break;
+        if (w[0].writable && !flush()) break;
+        if (w[0].readable) recv();
+    }
+    if (in_.broken()) close();
+    return rep;
+}
+
+SipTcpPool::SipTcpPool(int per_target, int connect_timeout_ms)
+    : per_target_(per_target < 1 ? 1 : per_target), connect_timeout_ms_(connect_timeout_ms) {}
+
+SipTcpConnection* SipTcpPool::get(const UdpAddr& dst, int64_t* connect_us) {
+    if (connect_us) *connect_us = -1;
+    Target& t = targets_[key(dst)];
+    if ((int)t.conns.size() < per_target_) {
+        auto c = std::make_unique<SipTcpConnection>();
+        if (!c->connect(dst, connect_timeout_ms_, connect_us)) return nullptr;
+        t.conns.push_back(std::move(c));
+        return t.conns.back().get();
+    }
+    SipTcpConnection* c = t.conns[t.next++ % t.conns.size()].get();
+    if (!c->is_open() && !c->connect(dst, connect_timeout_ms_, connect_us)) return nullptr;
+    return c;
+}
+
+void SipTcpPool::connections(const UdpAddr& dst, std::vector<SipTcpConnection*>& out) {
+    out.clear();
+    auto it = targets_.find(key(dst));
+    if (it == targets_.end()) return;
+    for (auto& c : it->second.conns) out.push_back(c.get());
+}
+
+void SipTcpPool::close_all() {
+    for (auto& t : targets_) {
+        for (auto& c : t.second.conns) c->close();
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "net.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Splits a SIP byte stream into messages (RFC 3261 18.3): each is a header
+// block ending in CRLFCRLF plus Content-Length (or compact "l") body bytes.
+// Data arrives in whatever pieces TCP hands over; the header scan resumes
+// where the last one stopped, so bytes are looked at once however thinly
+// they trickle in. CRLF keepalives between messages are skipped.
+class SipStreamFramer {
+public:
+    static const size_t kMaxHeader = 64 * 1024;
+
+    void append(const char* data, size_t len);
+    // Next complete message, valid until the next append(). False when more
+    // bytes are needed or the stream is broken().
+    bool next(std::string_view* msg);
+    // A header block over kMaxHeader or an unreadable Content-Length: the
+    // stream cannot be resynchronised and the connection should go.
+    bool broken() const { return broken_; }
+    size_t buffered() const { return buf_.size() - head_; }
+    void reset();
+
+private:
+    std::string buf_;
+    size_t head_ = 0;   // start of the first unconsumed message
+    size_t scan_ = 0;   // header-end search resumes here
+    size_t need_ = 0;   // whole length of the message at head_ once its header is in
+    bool broken_ = false;
+};
+
+// One persistent, non-blocking SIP connection. Sends are queued and written
+// as far as the socket takes them, so any number of transactions can be in
+// flight at once; replies come back through framer().
+class SipTcpConnection {
+public:
+    SipTcpConnection() {}
+    ~SipTcpConnection() { close(); }
+    SipTcpConnection(const SipTcpConnection&) = delete;
+    SipTcpConnection& operator=(const SipTcpConnection&) = delete;
+
+    // connect_us gets the handshake time, kept apart from any SIP timing.
+    bool connect(const UdpAddr& dst, int timeout_ms, int64_t* connect_us = nullptr);
+    // Takes over an accepted fd (server side).
+    bool adopt(int fd, const UdpAddr& peer);
+    void close();
+    bool is_open() const { return fd_ != -1; }
+    int fd() const { return fd_; }
+    const UdpAddr& peer() const { return peer_; }
+
+    // Queues msg behind anything unsent and writes what the socket takes.
+    // False once the connection has failed; it is then closed.
+    bool send(std::string_view msg);
+    bool flush();
+    bool want_write() const { return out_off_ < out_.size(); }
+    // Reads everything pending into framer(). False on error or peer close;
+    // the connection is then closed but messages already framed stay there.
+    bool recv();
+    SipStreamFramer& framer() { return in_; }
+
+    // For sequential callers: sends msg and waits up to timeout_ms for the
+    // final response carrying msg's top Via branch. Provisional responses
+    // and leftovers from earlier transactions are skipped.
+    UdpReply request(const std::string& msg, int timeout_ms);
+
+private:
+    int fd_ = -1;
+    UdpAddr peer_;
+    std::string out_;
+    size_t out_off_ = 0;
+    SipStreamFramer in_;
+};
+
+// Persistent connections per target, opened lazily up to per_target and
+// handed out round robin; a connection found closed is reopened in place.
+class SipTcpPool {
+public:
+    explicit SipTcpPool(int per_target = 1, int connect_timeout_ms = 3000);
+
+    // nullptr if a needed connect failed. connect_us gets the handshake time
+    // when this call opened the connection, -1 when it was already up.
+    SipTcpConnection* get(const UdpAddr& dst, int64_t* connect_us = nullptr);
+    // Every connection held for dst, open or not.
+    void connections(const UdpAddr& dst, std::vector<SipTcpConnection*>& out);
+    void close_all();
+
+private:
+    struct Target {
+        std::vector<std::unique_ptr<SipTcpConnection>> conns;
+        size_t next = 0;
+    };
+    static uint64_t key(const UdpAddr& a) { return ((uint64_t)a.ip << 16) | a.port; }
+
+    int per_target_;
+    int connect_timeout_ms_;
+    std::unordered_map<uint64_t, Target> targets_;
+};
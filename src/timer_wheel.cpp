@@ -0,0 +1,170 @@
+#include "timer_wheel.h"
+#include <cstring>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+static inline uint32_t lowest_bit(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (uint32_t)i;
+#else
+    return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+TimerWheel::TimerWheel(uint64_t now_ms) : now_(now_ms) {
+    for (auto& h : heads_) h = kNil;
+    std::memset(occupied_, 0, sizeof(occupied_));
+}
+
+void TimerWheel::link(uint32_t list, uint32_t n) {
+    Node& x = nodes_[n];
+    x.list = list;
+    x.prev = kNil;
+    x.next = heads_[list];
+    if (x.next != kNil) nodes_[x.next].prev = n;
+    heads_[list] = n;
+    if (list < kDueList) occupied_[list / kSlots][(list % kSlots) / 64] |= 1ull << (list % 64);
+}
+
+void TimerWheel::unlink(uint32_t n) {
+    Node& x = nodes_[n];
+    if (x.prev != kNil) nodes_[x.prev].next = x.next;
+    else heads_[x.list] = x.next;
+    if (x.next != kNil) nodes_[x.next].prev = x.prev;
+    if (heads_[x.list] == kNil && x.list < kDueList) {
+        occupied_[x.list / kSlots][(x.list % kSlots) / 64] &= ~(1ull << (x.list % 64));
+    }
+    x.list = kNil;
+}
+
+void TimerWheel::release(uint32_t n) {
+    Node& x = nodes_[n];
+    x.gen++;            // stale TimerIds stop matching
+    x.list = kNil;
+    x.next = free_;
+    free_ = n;
+    live_--;
+}
+
+// A timer goes on the finest level whose current rotation still contains its
+// expiry, so every slot holds only timers that are due when that slot is
+// next reached. The top level takes the rest.
+void TimerWheel::place(uint32_t n) {
+    const uint64_t e = nodes_[n].expires;
+    if (e <= now_) { link(kDueList, n); return; }
+    for (int k = 0; k < kLevels; k++) {
+        const int shift = kBits * (k + 1);
+        if (k == kLevels - 1 || (e >> shift) == (now_ >> shift)) {
+            link((uint32_t)k * kSlots + (uint32_t)((e >> (kBits * k)) & (kSlots - 1)), n);
+            return;
+        }
+    }
+}
+
+TimerWheel::TimerId TimerWheel::schedule(uint64_t at_ms, uint64_t cookie) {
+    const uint64_t span = (1ull << (kBits * kLevels)) - 1;
+    if (at_ms > now_ + span) at_ms = now_ + span;
+
+    uint32_t n;
+    if (free_ != kNil) {
+        n = free_;
+        free_ = nodes_[n].next;
+    } else {
+        n = (uint32_t)nodes_.size();
+        nodes_.emplace_back();
+    }
+    Node& x = nodes_[n];
+    x.expires = at_ms;
+    x.cookie = cookie;
+    place(n);
+    live_++;
+    return ((uint64_t)x.gen << 32) | (uint64_t)(n + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    if (id == kNoTimer) return false;
+    uint64_t n = (id & 0xffffffffu) - 1;
+    if (n >= nodes_.size()) return false;
+    Node& x = nodes_[n];
+    if (x.list == kNil || x.gen != (uint32_t)(id >> 32)) return false;
+    unlink((uint32_t)n);
+    release((uint32_t)n);
+    return true;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot) {
+    const uint32_t list = (uint32_t)level * kSlots + slot;
+    uint32_t n = heads_[list];
+    heads_[list] = kNil;
+    occupied_[level][slot / 64] &= ~(1ull << (slot % 64));
+    while (n != kNil) {
+        uint32_t next = nodes_[n].next;
+        place(n);
+        n = next;
+    }
+}
+
+void TimerWheel::fire_list(uint32_t list, std::vector<uint64_t>& fired) {
+    uint32_t n = heads_[list];
+    if (n == kNil) return;
+    heads_[list] = kNil;
+    if (list < kDueList) occupied_[list / kSlots][(list % kSlots) / 64] &= ~(1ull << (list % 64));
+    while (n != kNil) {
+        uint32_t next = nodes_[n].next;
+        fired.push_back(nodes_[n].cookie);
+        release(n);
+        n = next;
+    }
+}
+
+int TimerWheel::next_occupied(int level, uint32_t from) const {
+    for (uint32_t w = from / 64; w < kSlots / 64; w++) {
+        uint64_t bits = occupied_[level][w];
+        if (w == from / 64) bits &= ~0ull << (from % 64);
+        if (bits) return (int)(w * 64 + lowest_bit(bits));
+    }
+    return -1;
+}
+
+size_t TimerWheel::advance(uint64_t now_ms, std::vector<uint64_t>& fired) {
+    const size_t before = fired.size();
+    fire_list(kDueList, fired);
+    while (now_ < now_ms) {
+        // Jump straight to the next occupied level-0 slot or the next rotation
+        // boundary, whichever comes first; nothing can fire in between.
+        uint64_t t = (now_ | (kSlots - 1)) + 1;
+        uint32_t pos = (uint32_t)(now_ & (kSlots - 1));
+        if (pos + 1 < kSlots) {
+            int j = next_occupied(0, pos + 1);
+            if (j >= 0) t = (now_ & ~(uint64_t)(kSlots - 1)) + (uint64_t)j;
+        }
+        if (t > now_ms) t = now_ms;
+        now_ = t;
+
+        if ((t & (kSlots - 1)) == 0) {
+            for (int k = kLevels - 1; k >= 1; k--) {
+                const uint64_t mask = (1ull << (kBits * k)) - 1;
+                if ((t & mask) == 0) cascade(k, (uint32_t)((t >> (kBits * k)) & (kSlots - 1)));
+            }
+        }
+        fire_list(kDueList, fired);
+        fire_list((uint32_t)(t & (kSlots - 1)), fired);
+    }
+    return fired.size() - before;
+}
+
+uint64_t TimerWheel::next_delay_ms(uint64_t max_ms) const {
+    if (live_ == 0) return max_ms;
+    if (heads_[kDueList] != kNil) return 0;
+    uint32_t pos = (uint32_t)(now_ & (kSlots - 1));
+    uint64_t d = kSlots - pos; // next cascade point
+    if (pos + 1 < kSlots) {
+        int j = next_occupied(0, pos + 1);
+        if (j >= 0) d = (uint64_t)j - pos;
+    }
+    return d < max_ms ? d : max_ms;
+}
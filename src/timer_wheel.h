@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel: four levels of 256 slots at 1 ms resolution,
+// covering 2^32 ms (~49 days) ahead of now. schedule() and cancel() are O(1);
+// a timer is cascaded to a finer level at most three times before it fires.
+//
+// The wheel never reads a clock. Callers pass their own notion of "now" in
+// milliseconds to advance(), so a run can be driven by steady_clock or, for
+// offline checks, by a virtual clock stepped by hand.
+class TimerWheel {
+public:
+    using TimerId = uint64_t;            // 0 is never a live timer
+    static const TimerId kNoTimer = 0;
+
+    explicit TimerWheel(uint64_t now_ms = 0);
+
+    uint64_t now() const { return now_; }
+    size_t size() const { return live_; }
+    void reserve(size_t n) { nodes_.reserve(n); }
+
+    // Arms a timer that fires once advance() reaches at_ms. A time at or
+    // before now() fires on the next advance(). Times past the wheel's span
+    // are clamped to it.
+    TimerId schedule(uint64_t at_ms, uint64_t cookie);
+    // False if the timer already fired or was cancelled.
+    bool cancel(TimerId id);
+
+    // Moves the clock forward to now_ms (never back) and appends the cookie
+    // of every timer that came due to `fired`, earliest tick first. Returns
+    // the number appended.
+    size_t advance(uint64_t now_ms, std::vector<uint64_t>& fired);
+
+    // Milliseconds until advance() could next fire something, capped at
+    // max_ms: 0 if a timer is already due. Timers on the coarser levels are
+    // reported as the next cascade point, so this may wake early but never late.
+    uint64_t next_delay_ms(uint64_t max_ms) const;
+
+private:
+    static const int kLevels = 4;
+    static const int kBits = 8;
+    static const uint32_t kSlots = 1u << kBits;
+    static const uint32_t kNil = 0xffffffffu;
+    static const uint32_t kDueList = kLevels * kSlots; // timers scheduled in the past
+
+    struct Node {
+        uint64_t expires = 0;
+        uint64_t cookie = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t gen = 0;
+        uint32_t list = kNil;                 // slot index, kDueList, or kNil when free
+    };
+
+    void place(uint32_t n);
+    void link(uint32_t list, uint32_t n);
+    void unlink(uint32_t n);
+    void release(uint32_t n);
+    void cascade(int level, uint32_t slot);
+    void fire_list(uint32_t list, std::vector<uint64_t>& fired);
+    // First occupied slot at `level` at or after `from`, or -1.
+    int next_occupied(int level, uint32_t from) const;
+
+    uint64_t now_;
+    size_t live_ = 0;
+    std::vector<Node> nodes_;
+    uint32_t free_ = kNil;
+    uint32_t heads_[kLevels * kSlots + 1];
+    uint64_t occupied_[kLevels][kSlots / 64];
+};
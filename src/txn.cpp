@@ -0,0 +1,29 @@
+#include "txn.h"
+
+uint64_t TxnTable::key_of(std::string_view branch) {
+    // FNV-1a; the stored branch is compared on match, so a collision can only
+    // cost a miss, never a wrong attribution.
+    uint64_t h = 1469598103934665603ull;
+    for (char c : branch) {
+        h ^= (uint8_t)c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void TxnTable::add(const std::string& branch, const std::string& call_id, uint32_t id) {
+    map_[key_of(branch)] = Entry{branch, call_id, id};
+}
+
+bool TxnTable::match(std::string_view branch, std::string_view call_id, uint32_t* id) const {
+    if (branch.empty()) return false;
+    auto it = map_.find(key_of(branch));
+    if (it == map_.end() || it->second.branch != branch || it->second.call_id != call_id) return false;
+    *id = it->second.id;
+    return true;
+}
+
+void TxnTable::remove(const std::string& branch) {
+    auto it = map_.find(key_of(branch));
+    if (it != map_.end() && it->second.branch == branch) map_.erase(it);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+// In-flight client transactions, keyed by the Via branch we generated and
+// checked against the Call-ID so a stray or late reply is never credited to
+// the wrong request. Lookups take views into the received datagram and do
+// not allocate.
+class TxnTable {
+public:
+    void add(const std::string& branch, const std::string& call_id, uint32_t id);
+    // True and sets *id when (branch, call_id) belongs to a live transaction.
+    bool match(std::string_view branch, std::string_view call_id, uint32_t* id) const;
+    void remove(const std::string& branch);
+
+    size_t size() const { return map_.size(); }
+    void reserve(size_t n) { map_.reserve(n); }
+
+private:
+    struct Entry {
+        std::string branch;
+        std::string call_id;
+        uint32_t id;
+    };
+    static uint64_t key_of(std::string_view branch);
+
+    std::unordered_map<uint64_t, Entry> map_;
+};
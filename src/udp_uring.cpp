@@ -0,0 +1,451 @@
+#include "udp_uring.h"
+
+#if defined(__linux__)
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// No liburing: the three syscalls and the shared rings are used directly.
+// Userspace owns the SQ tail and the CQ head, the kernel the other ends, so
+// each side reads with acquire and publishes with release.
+namespace {
+
+const uint64_t kRecvTag = 1ull << 63;   // user_data: kRecvTag | fd, else a send slot
+const uint16_t kGroup = 0;              // provided buffer group id
+const size_t kCtrl = 64;                // room for one SCM_TIMESTAMPNS
+// Every provided buffer starts with the recvmsg header, then the source
+// address and control data at their full reserved sizes, then the payload.
+const size_t kHead = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + kCtrl;
+
+int sys_enter(int fd, unsigned submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, min_complete, flags, nullptr, 0);
+}
+
+template <class T> T load_acquire(const T* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+template <class T> void store_release(T* p, T v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+// SCM_TIMESTAMPNS in a received buffer's control area (CLOCK_REALTIME ns),
+// 0 if there is none.
+int64_t stamp_ns(char* ctrl, size_t len) {
+    msghdr m{};
+    m.msg_control = ctrl;
+    m.msg_controllen = len;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+        }
+    }
+    return 0;
+}
+
+void* map(size_t len, int fd, off_t off) {
+    void* p = fd == -1 ? mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                       : mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, off);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+} // namespace
+
+struct UdpUring::Impl {
+    io_uring_params p{};
+    void* sq_map = nullptr;
+    size_t sq_map_len = 0;
+    void* cq_map = nullptr;
+    size_t cq_map_len = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_len = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_flags = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned to_submit = 0;
+
+    // The provided buffer ring. Indexed as a plain array: in C++ the header's
+    // flexible bufs[] member sits 8 bytes past where the kernel reads it.
+    io_uring_buf* br = nullptr;
+    uint16_t* br_tail_p = nullptr;     // shares slot 0 with br[0].resv
+    size_t br_len = 0;
+    char* bufs = nullptr;              // kBuffers x (kHead + kPayload)
+    size_t bufs_len = 0;
+    uint16_t br_tail = 0;
+    size_t with_kernel = 0;            // buffers the kernel can fill
+    bool br_dirty = false;
+
+    msghdr recv_hdr{};                 // shape of every multishot receive
+    std::vector<msghdr> send_hdrs;
+    std::vector<iovec> send_iovs;
+    std::vector<sockaddr_in> send_addrs;
+
+    static size_t buf_len() { return kHead + kPayload; }
+    char* buf(uint16_t bid) { return bufs + (size_t)bid * buf_len(); }
+
+    // Next SQE, zeroed. The SQ is twice a batch and flushed after every
+    // use, so there is always room.
+    io_uring_sqe* sqe() {
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & sq_mask;
+        io_uring_sqe* e = &sqes[idx];
+        std::memset(e, 0, sizeof(*e));
+        sq_array[idx] = idx;
+        store_release(sq_tail, tail + 1);
+        to_submit++;
+        return e;
+    }
+
+    int enter(int fd, unsigned min_complete, unsigned flags) {
+        int r = sys_enter(fd, to_submit, min_complete, flags);
+        if (r > 0) to_submit -= std::min<unsigned>((unsigned)r, to_submit);
+        return r;
+    }
+
+    // Returns a buffer to the kernel. Only addr/len/bid are written, never
+    // resv, which is the ring's tail in slot 0.
+    void give(uint16_t bid) {
+        io_uring_buf* b = &br[br_tail & (UdpUring::kBuffers - 1)];
+        b->addr = (uint64_t)(uintptr_t)buf(bid);
+        b->len = (uint32_t)buf_len();
+        b->bid = bid;
+        br_tail++;
+        with_kernel++;
+        br_dirty = true;
+    }
+    void publish() {
+        if (!br_dirty) return;
+        store_release(br_tail_p, br_tail);
+        br_dirty = false;
+    }
+};
+
+UdpUring::UdpUring() {}
+
+UdpUring::~UdpUring() {
+    // Closing the ring cancels the multishot receives before any memory
+    // they could still write to goes away.
+    if (ring_fd_ != -1) close(ring_fd_);
+    if (!im_) return;
+    if (im_->bufs) munmap(im_->bufs, im_->bufs_len);
+    if (im_->br) munmap(im_->br, im_->br_len);
+    if (im_->sqes) munmap(im_->sqes, im_->sqes_len);
+    if (im_->cq_map && im_->cq_map != im_->sq_map) munmap(im_->cq_map, im_->cq_map_len);
+    if (im_->sq_map) munmap(im_->sq_map, im_->sq_map_len);
+    delete im_;
+}
+
+bool UdpUring::init(size_t max_batch) {
+    if (im_) return ring_fd_ != -1;
+    im_ = new Impl;
+    auto& m = *im_;
+    unsigned entries = 64;
+    while (entries < 2 * max_batch) entries <<= 1;
+    // Room for a completion per provided buffer plus a batch of sends, so
+    // a burst never has to spill into the kernel's overflow list. Completion
+    // work waits for our next syscall instead of interrupting the thread;
+    // TASKRUN_FLAG says when some is pending, and the ring fd still polls
+    // readable for it (udp_uring_supported checks).
+    m.p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    m.p.cq_entries = 4096;
+    ring_fd_ = (int)syscall(__NR_io_uring_setup, entries, &m.p);
+    if (ring_fd_ < 0) { ring_fd_ = -1; return false; }
+
+    m.sq_map_len = m.p.sq_off.array + m.p.sq_entries * sizeof(unsigned);
+    m.cq_map_len = m.p.cq_off.cqes + m.p.cq_entries * sizeof(io_uring_cqe);
+    if (m.p.features & IORING_FEAT_SINGLE_MMAP) m.sq_map_len = m.cq_map_len = std::max(m.sq_map_len, m.cq_map_len);
+    m.sq_map = map(m.sq_map_len, ring_fd_, IORING_OFF_SQ_RING);
+    if (!m.sq_map) return false;
+    m.cq_map = (m.p.features & IORING_FEAT_SINGLE_MMAP) ? m.sq_map : map(m.cq_map_len, ring_fd_, IORING_OFF_CQ_RING);
+    if (!m.cq_map) return false;
+    m.sqes_len = m.p.sq_entries * sizeof(io_uring_sqe);
+    m.sqes = (io_uring_sqe*)map(m.sqes_len, ring_fd_, IORING_OFF_SQES);
+    if (!m.sqes) return false;
+
+    char* sq = (char*)m.sq_map;
+    m.sq_tail = (unsigned*)(sq + m.p.sq_off.tail);
+    m.sq_flags = (unsigned*)(sq + m.p.sq_off.flags);
+    m.sq_array = (unsigned*)(sq + m.p.sq_off.array);
+    m.sq_mask = *(unsigned*)(sq + m.p.sq_off.ring_mask);
+    char* cq = (char*)m.cq_map;
+    m.cq_head = (unsigned*)(cq + m.p.cq_off.head);
+    m.cq_tail = (unsigned*)(cq + m.p.cq_off.tail);
+    m.cq_mask = *(unsigned*)(cq + m.p.cq_off.ring_mask);
+    m.cqes = (io_uring_cqe*)(cq + m.p.cq_off.cqes);
+
+    m.br_len = kBuffers * sizeof(io_uring_buf);
+    m.br = (io_uring_buf*)map(m.br_len, -1, 0);
+    m.bufs_len = kBuffers * Impl::buf_len();
+    m.bufs = (char*)map(m.bufs_len, -1, 0);
+    if (!m.br || !m.bufs) return false;
+    m.br_tail_p = (uint16_t*)((char*)m.br + offsetof(io_uring_buf, resv));
+    io_uring_buf_reg reg{};
+    reg.ring_addr = (uint64_t)(uintptr_t)m.br;
+    reg.ring_entries = (uint32_t)kBuffers;
+    reg.bgid = kGroup;
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) return false;
+    for (size_t i = 0; i < kBuffers; i++) m.give((uint16_t)i);
+    m.publish();
+
+    m.recv_hdr.msg_namelen = sizeof(sockaddr_in);
+    m.recv_hdr.msg_controllen = kCtrl;
+    m.send_hdrs.resize(max_batch);
+    m.send_iovs.resize(max_batch);
+    m.send_addrs.resize(max_batch);
+    send_res_.resize(max_batch);
+    lent_.reserve(max_batch);
+    return true;
+}
+
+UdpUring::Sock* UdpUring::find(int sock) {
+    for (Sock& s : socks_) {
+        if (s.fd == sock) return &s;
+    }
+    return nullptr;
+}
+
+UdpUring::Sock& UdpUring::add(int sock) {
+    socks_.emplace_back();
+    Sock& s = socks_.back();
+    s.fd = sock;
+    s.q.reserve(kBuffers);
+    return s;
+}
+
+bool UdpUring::submit_recv(Sock& s) {
+    auto& m = *im_;
+    io_uring_sqe* e = m.sqe();
+    e->opcode = IORING_OP_RECVMSG;
+    e->fd = s.fd;
+    e->addr = (uint64_t)(uintptr_t)&m.recv_hdr;
+    e->len = 1;
+    e->ioprio = IORING_RECV_MULTISHOT;
+    e->flags = IOSQE_BUFFER_SELECT;
+    e->buf_group = kGroup;
+    e->user_data = kRecvTag | (uint32_t)s.fd;
+    s.armed = true;
+    return m.enter(ring_fd_, 0, 0) >= 0;
+}
+
+bool UdpUring::arm(int sock) {
+    if (ring_fd_ == -1) return false;
+    Sock* s = find(sock);
+    if (!s) s = &add(sock);
+    return s->armed || submit_recv(*s);
+}
+
+void UdpUring::complete(uint64_t user_data, int32_t res, uint32_t flags) {
+    if (!(user_data & kRecvTag)) {
+        if (user_data < send_res_.size()) {
+            send_res_[user_data] = res;
+            send_done_++;
+        }
+        return;
+    }
+    auto& m = *im_;
+    Sock* s = find((int)(uint32_t)user_data);
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+        m.with_kernel--;
+        char* b = m.buf(bid);
+        if (s && res >= (int32_t)kHead) {
+            const auto* out = (const io_uring_recvmsg_out*)b;
+            sockaddr_in sa;
+            std::memcpy(&sa, b + sizeof(*out), sizeof(sa));
+            Rx rx;
+            rx.bid = bid;
+            rx.d.addr.ip = sa.sin_addr.s_addr;
+            rx.d.addr.port = ntohs(sa.sin_port);
+            rx.d.data = b + kHead;
+            rx.d.len = (size_t)res - kHead;   // less than payloadlen if cut short
+            rx.d.rx_ns = 0;
+            if (out->controllen) {
+                if (int64_t t = stamp_ns(b + sizeof(*out) + sizeof(sockaddr_in), out->controllen)) {
+                    if (!shift_) shift_ = steady_ns() - realtime_ns();
+                    rx.d.rx_ns = t + shift_;
+                }
+            }
+            s->q.push_back(rx);
+        } else {
+            m.give(bid);
+        }
+    }
+    // A multishot receive ends on error, or when the buffers ran out
+    // (-ENOBUFS); the latter is re-armed once some come back.
+    if (s && !(flags & IORING_CQE_F_MORE)) {
+        s->armed = false;
+        if (res < 0 && res != -ENOBUFS) s->failed = true;
+    }
+}
+
+void UdpUring::reap() {
+    if (ring_fd_ == -1) return;
+    auto& m = *im_;
+    shift_ = 0;
+    for (int flushes = 0;;) {
+        unsigned head = *m.cq_head;
+        unsigned tail = load_acquire(m.cq_tail);
+        if (head == tail) {
+            // Deferred completion work or an overflowed CQ: one enter runs
+            // or flushes it, then look again.
+            if (flushes++ == 2 || !(load_acquire(m.sq_flags) & (IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN))) break;
+            if (m.enter(ring_fd_, 0, IORING_ENTER_GETEVENTS) < 0) break;
+            continue;
+        }
+        for (; head != tail; head++) {
+            const io_uring_cqe& c = m.cqes[head & m.cq_mask];
+            complete(c.user_data, c.res, c.flags);
+        }
+        store_release(m.cq_head, head);
+    }
+    m.publish();
+    rearm();
+}
+
+void UdpUring::rearm() {
+    if (!im_->with_kernel) return;
+    for (Sock& s : socks_) {
+        if (!s.armed && !s.failed) submit_recv(s);
+    }
+}
+
+void UdpUring::recycle() {
+    if (lent_.empty()) return;
+    for (uint16_t bid : lent_) im_->give(bid);
+    lent_.clear();
+    im_->publish();
+    rearm();
+}
+
+bool UdpUring::pending(int sock) const {
+    for (const Sock& s : socks_) {
+        if (s.fd == sock) return s.head < s.q.size();
+    }
+    return false;
+}
+
+int UdpUring::send(int sock, const UdpDatagram* msgs, size_t n) {
+    if (ring_fd_ == -1) return -1;
+    auto& m = *im_;
+    if (n > send_res_.size()) n = send_res_.size();
+    if (n == 0) return 0;
+    // One linked chain: a datagram the socket refuses cancels the rest, so
+    // what went out is always a prefix, as with sendmmsg.
+    for (size_t i = 0; i < n; i++) {
+        auto& sa = m.send_addrs[i];
+        sa = sockaddr_in{};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(msgs[i].addr.port);
+        sa.sin_addr.s_addr = msgs[i].addr.ip;
+        m.send_iovs[i].iov_base = const_cast<char*>(msgs[i].data);
+        m.send_iovs[i].iov_len = msgs[i].len;
+        auto& h = m.send_hdrs[i];
+        h = msghdr{};
+        h.msg_name = &sa;
+        h.msg_namelen = sizeof(sa);
+        h.msg_iov = &m.send_iovs[i];
+        h.msg_iovlen = 1;
+        io_uring_sqe* e = m.sqe();
+        e->opcode = IORING_OP_SENDMSG;
+        e->fd = sock;
+        e->addr = (uint64_t)(uintptr_t)&h;
+        e->len = 1;
+        e->user_data = i;
+        if (i + 1 < n) e->flags = IOSQE_IO_LINK;
+    }
+    send_done_ = 0;
+    // Non-blocking sockets complete inline, so normally this one call
+    // submits the chain and finds all n completions already posted.
+    unsigned want = (unsigned)n;
+    for (;;) {
+        int r = m.enter(ring_fd_, want, IORING_ENTER_GETEVENTS);
+        if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+        reap();
+        if (send_done_ >= n) break;
+        want = 1;
+    }
+    size_t took = 0;
+    while (took < n && send_res_[took] >= 0) took++;
+    if (took == 0 && send_res_[0] != -EAGAIN) return -1;
+    return (int)took;
+}
+
+int UdpUring::take(int sock, UdpDatagram* out, size_t max) {
+    if (ring_fd_ == -1) return -1;
+    recycle();
+    if (!find(sock)) arm(sock);
+    if (!pending(sock)) reap();
+    Sock& s = *find(sock);
+    size_t n = 0;
+    while (n < max && s.head < s.q.size()) {
+        const Rx& rx = s.q[s.head++];
+        out[n++] = rx.d;
+        lent_.push_back(rx.bid);
+    }
+    if (s.head == s.q.size()) {
+        s.q.clear();
+        s.head = 0;
+        if (!n && s.failed) return -1;
+    }
+    return (int)n;
+}
+
+static bool probe_uring() {
+    UdpUring ring;
+    UdpSocket s;
+    if (!ring.init(4) || !s.open() || !s.bind("127.0.0.1", 0) || !ring.arm(s.fd())) return false;
+    UdpAddr self;
+    self.ip = htonl(INADDR_LOOPBACK);
+    self.port = s.local_port();
+    // A plain send first: the ring fd has to wake a poller on its own, as
+    // that is how the engines wait.
+    if (s.send_to(self, "frogklan", 8) != 8) return false;
+    pollfd pfd{ring.fd(), POLLIN, 0};
+    UdpDatagram got;
+    if (poll(&pfd, 1, 200) != 1 || ring.take(s.fd(), &got, 1) != 1 || got.len != 8) return false;
+    UdpDatagram d;
+    d.addr = self;
+    d.data = "frogklan";
+    d.len = 8;
+    if (ring.send(s.fd(), &d, 1) != 1) return false;
+    for (int i = 0; i < 20; i++) {
+        if (ring.take(s.fd(), &got, 1) == 1) return got.len == 8 && std::memcmp(got.data, "frogklan", 8) == 0;
+        poll(&pfd, 1, 10);
+    }
+    return false;
+}
+
+bool udp_uring_supported() {
+    static const bool ok = probe_uring();
+    return ok;
+}
+
+#else
+
+struct UdpUring::Impl {};
+
+UdpUring::UdpUring() {}
+UdpUring::~UdpUring() {}
+bool UdpUring::init(size_t) { return false; }
+bool UdpUring::arm(int) { return false; }
+int UdpUring::send(int, const UdpDatagram*, size_t) { return -1; }
+void UdpUring::reap() {}
+bool UdpUring::pending(int) const { return false; }
+int UdpUring::take(int, UdpDatagram*, size_t) { return -1; }
+bool udp_uring_supported() { return false; }
+
+#endif
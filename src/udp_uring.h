@@ -0,0 +1,75 @@
+#pragma once
+#include "net.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// True when this kernel runs multishot recvmsg with a provided buffer ring
+// (Linux 6.0 and later, io_uring not disabled by sysctl or seccomp). Probed
+// once with a real loopback datagram; later calls are free.
+bool udp_uring_supported();
+
+// io_uring backend behind UdpBatch (see UdpBatch::use_uring). Each socket
+// gets one multishot recvmsg that the kernel keeps filling from a ring of
+// provided buffers, so receiving costs no syscall at all while datagrams
+// are flowing; sends go in as one linked chain of sendmsg entries per
+// batch and a single io_uring_enter. Completions for any socket are reaped
+// together and queued per socket until that socket's recv(). Datagrams
+// longer than kPayload are cut short. Linux only; elsewhere init() fails.
+class UdpUring {
+public:
+    static const size_t kBuffers = 512;    // provided buffers, power of two
+    static const size_t kPayload = 8192;   // per buffer, after the recvmsg header
+
+    UdpUring();
+    ~UdpUring();
+    UdpUring(const UdpUring&) = delete;
+    UdpUring& operator=(const UdpUring&) = delete;
+
+    bool init(size_t max_batch);
+    // The ring's fd: readable whenever completions are waiting.
+    int fd() const { return ring_fd_; }
+
+    // Starts multishot receive on a socket.
+    bool arm(int sock);
+    // Same contract as sendmmsg: how many of msgs[0..n) the kernel took, in
+    // order, or -1 if the first failed outright. Waits for the sends' own
+    // completions, so msgs may be reused on return.
+    int send(int sock, const UdpDatagram* msgs, size_t n);
+    // Moves waiting completions into the per-socket queues.
+    void reap();
+    bool pending(int sock) const;
+    // Up to max datagrams queued for sock, oldest first, or -1 once its
+    // receive has failed for good. Buffers handed out by the previous take()
+    // go back to the kernel first; an unarmed socket is armed here.
+    int take(int sock, UdpDatagram* out, size_t max);
+
+private:
+    struct Rx {
+        uint16_t bid;
+        UdpDatagram d;
+    };
+    struct Sock {
+        int fd = -1;
+        bool armed = false;
+        bool failed = false;
+        std::vector<Rx> q;
+        size_t head = 0;
+    };
+    struct Impl;
+
+    Sock* find(int sock);
+    Sock& add(int sock);
+    bool submit_recv(Sock& s);
+    void complete(uint64_t user_data, int32_t res, uint32_t flags);
+    void recycle();
+    void rearm();
+
+    int ring_fd_ = -1;
+    std::vector<Sock> socks_;
+    std::vector<uint16_t> lent_;      // buffers out with the caller
+    std::vector<int32_t> send_res_;   // per entry of the batch in flight
+    size_t send_done_ = 0;
+    int64_t shift_ = 0;               // steady - realtime, per reap
+    Impl* im_ = nullptr;
+};